@@ -380,9 +380,31 @@ COMPILE_ASSERT(sizeof(ssize_t) == sizeof(int64_t));
 
 #define ENABLE_LOGGING
 #define DEFAULT_LOG_LEVEL eALL
+// Threads queue formatted log messages, a writer thread writes them to console, files and callbacks. See flushLog
+// #define ENABLE_ASYNC_LOG
 #if !defined(NDEBUG)
 #define ENABLE_MEMORY_TRACKING
 #endif
+// Lightweight alternative to ENABLE_MEMORY_TRACKING: per callsite counters and optional sampling of live blocks,
+// without the global lock of the memory manager. See memTakeSnapshot
+// #define ENABLE_CALLSITE_MEMORY_TRACKING
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+#undef ENABLE_MEMORY_TRACKING
+#endif
+// Size-class allocator with per-thread caches for blocks up to 1 KB behind tf_malloc, larger blocks go to the system allocator
+// #define ENABLE_SMALL_ALLOCATOR
+#if defined(ENABLE_SMALL_ALLOCATOR) && (defined(ENABLE_MEMORY_TRACKING) || !(defined(_WINDOWS) || defined(__linux__) || defined(__APPLE__)))
+#undef ENABLE_SMALL_ALLOCATOR
+#endif
+// Per subsystem memory counters and budgets, see MEMORY_TAG_SCOPE. Always on with ENABLE_MEMORY_TRACKING
+// #define ENABLE_MEMORY_TAGS
+#if defined(ENABLE_MEMORY_TRACKING) && !defined(ENABLE_MEMORY_TAGS)
+#define ENABLE_MEMORY_TAGS
+#endif
+#if defined(FORGE_DEBUG)
+// Fills frame arena memory on reset, so that data used after the end of its frame shows up early
+#define ENABLE_FRAME_ARENA_POISON
+#endif
 // #define ENABLE_FORGE_STACKTRACE_DUMP
 
 #ifdef AUTOMATED_TESTING
@@ -299,6 +299,7 @@ void platformExitFontSystem()
 bool initFontSystem(FontSystemDesc* pDesc)
 {
 #ifdef ENABLE_FORGE_FONTS
+    MEMORY_TAG_SCOPE(MEMORY_TAG_FONTS);
     ASSERT(!gFontstash.mRenderInitialized);
 
     gFontstash.pRenderer = pDesc->pRenderer;
@@ -364,6 +365,7 @@ void exitFontSystem()
 void loadFontSystem(const FontSystemLoadDesc* pDesc)
 {
 #ifdef ENABLE_FORGE_FONTS
+    MEMORY_TAG_SCOPE(MEMORY_TAG_FONTS);
     if (pDesc->mLoadType & (RELOAD_TYPE_SHADER | RELOAD_TYPE_RENDERTARGET))
     {
         if (pDesc->mLoadType & RELOAD_TYPE_SHADER)
@@ -498,6 +500,7 @@ void unloadFontSystem(ReloadType unloadType)
 void cmdDrawTextWithFont(Cmd* pCmd, float2 screenCoordsInPx, const FontDrawDesc* pDesc)
 {
 #ifdef ENABLE_FORGE_FONTS
+    MEMORY_TAG_SCOPE(MEMORY_TAG_FONTS);
     ASSERT(gFontstash.mRenderInitialized && "Font Rendering not initialized! Make sure to call initFontRendering!");
 
     ASSERT(pDesc);
@@ -594,6 +597,7 @@ void cmdDrawDebugFontAtlas(Cmd* pCmd, float2 screenCoordInPx)
 void fntDefineFonts(const FontDesc* pDescs, uint32_t count, uint32_t* pOutIDs)
 {
 #ifdef ENABLE_FORGE_FONTS
+    MEMORY_TAG_SCOPE(MEMORY_TAG_FONTS);
     ASSERT(pDescs);
     ASSERT(pOutIDs);
     ASSERT(count > 0);
@@ -73,9 +73,38 @@ FORGE_API void setAggregateFrames(uint32_t nFrames);
 // Dump profile data to "profile-(date).html" of recorded frames, until a maximum amount of frames
 FORGE_API void dumpProfileData(const char* appName = "", uint32_t nMaxFrames = 64);
 
-// Dump benchmark data to "benchmark-(data).txt" of recorded frames
+// Dump benchmark data to "benchmark-(data).txt" of recorded frames, with per frame timer samples for
+// Tools/BenchmarkCompare/benchmark_compare.py
 FORGE_API void dumpBenchmarkData(IApp::Settings* pSettings, const char* outFilename = "", const char* appName = "");
 
+typedef enum ProfileTraceFormat
+{
+    // Chrome Trace Event JSON, loads in chrome://tracing and ui.perfetto.dev
+    PROFILE_TRACE_FORMAT_CHROME_JSON = 0,
+    // Perfetto protobuf trace, smaller and faster to load for long captures
+    PROFILE_TRACE_FORMAT_PERFETTO,
+} ProfileTraceFormat;
+
+// Stream cpu timers, gpu timers, counters and labels of every frame to "(appName)Trace-(date).json/.perfetto-trace"
+// while frames complete. nFrames == 0 records until stopProfileTrace()
+FORGE_API void startProfileTrace(const char* appName = "", ProfileTraceFormat format = PROFILE_TRACE_FORMAT_PERFETTO, uint32_t nFrames = 0);
+
+// Finish the current trace file and disarm the frame time trigger
+FORGE_API void stopProfileTrace();
+
+// Start a trace on the first frame slower than frameMs: the nFramesBefore frames leading up to it are written from
+// the profiler history, then the slow frame and nFramesAfter more frames. Fires once, call again to re-arm
+FORGE_API void armProfileTraceOnFrameTime(const char* appName, ProfileTraceFormat format, float frameMs, uint32_t nFramesBefore = 8,
+                                          uint32_t nFramesAfter = 8);
+
+// Sample the call stack of every thread with a profiler log nSamplesPerSecond times per second of its cpu time, 0 stops.
+// Samples are attributed to the cpu zones open while they were taken. Linux only, the profiler takes over SIGPROF
+FORGE_API void setProfileSampling(uint32_t nSamplesPerSecond);
+
+// Dump the samples aggregated since sampling started to "(appName)Samples-(date).folded", one "Thread;Group/Zone;function;... count"
+// line per call path, for Tools/ProfilerFlameGraph/flame_graph.py
+FORGE_API void dumpProfileSamples(const char* appName = "");
+
 //------ Profiler UI Widget --------//
 
 // Call once per frame before AppUI.Draw, draw requested Gpu profiler timers
@@ -159,3 +188,19 @@ FORGE_API float getCpuFrameTime();
 FORGE_API float getCpuAvgFrameTime();
 FORGE_API float getCpuMinFrameTime();
 FORGE_API float getCpuMaxFrameTime();
+
+typedef struct ProfilerThreadDesc
+{
+    // Name shown in the profiler, NULL uses the thread name
+    const char* pThreadName = NULL;
+    // Events the thread's log holds, 0 uses PROFILE_PER_THREAD_BUFFER_SIZE
+    uint32_t mLogSize = 0;
+    // A background thread moves a filling log out instead of dropping events once it's full, for threads with spiky frames
+    bool mFlushOnNearFull = false;
+} ProfilerThreadDesc;
+
+// Call on a new thread before its first cpu scope, the thread's log gets allocated here instead of inside its first scope
+FORGE_API void initProfilerThread(const ProfilerThreadDesc* pDesc);
+
+// Events lost to full thread logs, of one thread or all when pThreadID is NULL
+FORGE_API uint64_t getCpuProfileDroppedEvents(ThreadID* pThreadID = NULL);
@@ -181,7 +181,7 @@ void initGpuProfiler(Renderer* pRenderer, Queue* pQueue, GpuProfiler** ppGpuProf
     getTimestampFrequency(pQueue, &pGpuProfiler->mGpuTimeStampFrequency);
 
     // Create buffer to sample from MicroProfile and log for current GpuProfiler
-    pGpuProfiler->pLog = ProfileCreateThreadLog(pName);
+    pGpuProfiler->pLog = ProfileCreateThreadLog(pName, PROFILE_GPU_BUFFER_SIZE);
     pGpuProfiler->pLog->nGpu = 1;
     pGpuProfiler->pLog->nGpuToken = getProfileToken(pGpuProfiler->mProfilerIndex, 0);
 
@@ -43,6 +43,11 @@
 
 #include "../../Utilities/Math/Algorithms.h"
 
+#if PROFILE_SAMPLING
+// Names sampled frames, C++ headers have to come before IMemory.h
+#include <cxxabi.h>
+#endif
+
 #include "../../Utilities/Interfaces/IMemory.h"
 
 #ifdef ENABLE_PROFILER
@@ -113,11 +118,22 @@ struct ProfileDetailedModeTime
     char     mThreadName[64];
 };
 
+// Time a thread of this process ran on a core, from the context switch trace
+struct ProfileDetailedModeCpuSlice
+{
+    uint32_t mCpu;
+    float    mStartTime;
+    float    mEndTime;
+    char     mThreadName[64];
+};
+
 struct ProfileDetailedModeFrame
 {
-    float                    mFrameTime;
+    float                        mFrameTime;
     // ProfileDetailedModeTime[dyn_size]
-    ProfileDetailedModeTime* mTimers;
+    ProfileDetailedModeTime*     mTimers;
+    // ProfileDetailedModeCpuSlice[dyn_size]
+    ProfileDetailedModeCpuSlice* mCpuSlices;
 };
 
 struct ProfileDetailedModeTooltip
@@ -244,6 +260,19 @@ typedef struct TimerRowData
 // pointers to text and color don't change during execution
 TimerRowData** gTimerData = NULL;
 
+#if defined(ENABLE_MEMORY_TAGS)
+// Memory tag rows below the timers: live bytes, peak bytes, budget
+static const uint32_t gMemoryTagColumnsCount = 3;
+uint32_t              gTotalMemoryTags = 0;
+TimerColumnData       gMemoryTagData[MEMORY_TAG_MAX_COUNT][gMemoryTagColumnsCount];
+
+// Counters "memory/<tag>", shown with the other counters in dumps
+ProfileToken gMemoryTagCounters[MEMORY_TAG_MAX_COUNT];
+uint32_t     gMemoryTagCounterCount = 0;
+
+int ProfileFormatCounter(int eFormat, int64_t nCounter, char* pOut, uint32_t nBufferSize);
+#endif
+
 // Timer mode color coding.
 float4 gCriticalColor = float4(1.f, 0.f, 0.f, 1.f);
 float4 gWarningColor = float4(1.f, 1.f, 0.f, 1.f);
@@ -305,6 +334,10 @@ int64_t ProfileGetTick()
 
 #endif
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <sys/syscall.h>
+#endif
+
 #ifdef ENABLE_PROFILER_WEBSERVER
 
 #if defined(_WINDOWS) || defined(XBOX)
@@ -327,16 +360,15 @@ int64_t ProfileGetTick()
 
 #endif
 
-#if defined(ENABLE_PROFILER_WEBSERVER) || PROFILE_CONTEXT_SWITCH_TRACE
 typedef ThreadFunction ProfileThreadFunc;
 
-inline void ProfileThreadStart(ProfileThread* pThread, ProfileThreadFunc Func)
+inline void ProfileThreadStart(ProfileThread* pThread, ProfileThreadFunc Func, const char* pName)
 {
     *pThread = (ThreadHandle*)tf_malloc(sizeof(ThreadHandle));
     ThreadDesc desc = {};
     desc.pFunc = Func;
     desc.pData = *pThread;
-    strncpy(desc.mThreadName, "ProfilerWebServer", sizeof(desc.mThreadName));
+    strncpy(desc.mThreadName, pName, sizeof(desc.mThreadName) - 1);
     initThread(&desc, *pThread);
 }
 inline void ProfileThreadJoin(ProfileThread* pThread)
@@ -345,7 +377,6 @@ inline void ProfileThreadJoin(ProfileThread* pThread)
     tf_free(*pThread);
     *pThread = nullptr;
 }
-#endif
 
 #ifndef PROFILE_DEBUG
 #define PROFILE_DEBUG 0
@@ -519,7 +550,10 @@ void profileCallbkDumpFrames(void* pUserData)
     gDumpFramesNow = true;
 
     for (uint32_t i = 0, end = (uint32_t)arrlen(gDetailedModeDump); i < end; ++i)
+    {
         arrfree(gDetailedModeDump[i].mTimers);
+        arrfree(gDetailedModeDump[i].mCpuSlices);
+    }
     arrsetlen(gDetailedModeDump, 0);
 }
 
@@ -641,7 +675,7 @@ void profileUpdateDetailedModeData(Profile& S)
             continue;
 
         uint32_t nRange[2][2] = { { 0, 0 }, { 0, 0 } };
-        ProfileGetRange(nPut, nGet, nRange);
+        ProfileGetRange(nPut, nGet, pLog->nLogSize, nRange);
 
         uint32_t nStack[PROFILE_STACK_MAX];
         uint32_t nStackPos = 0;
@@ -711,6 +745,50 @@ void profileUpdateDetailedModeData(Profile& S)
         }
     }
 
+#if PROFILE_CONTEXT_SWITCH_TRACE
+    // Per core occupancy of our threads: a slice runs from a switch to one of them until the next switch on that core
+    uint32_t nContextSwitchStart, nContextSwitchEnd;
+    ProfileContextSwitchSearch(&nContextSwitchStart, &nContextSwitchEnd, nBaseTicksCpu, nBaseTicksEndCpu);
+
+    ProfileProcessIdType nProcessId = P_GETCURRENTPROCESSID();
+    ThreadID             nRunningThread[PROFILE_CONTEXT_SWITCH_MAX_CPUS] = { 0 };
+    int64_t              nRunningSince[PROFILE_CONTEXT_SWITCH_MAX_CPUS] = { 0 };
+    for (uint32_t j = nContextSwitchStart; j != nContextSwitchEnd; j = (j + 1) % PROFILE_CONTEXT_SWITCH_BUFFER_SIZE)
+    {
+        const ProfileContextSwitch& CS = S.ContextSwitch[j];
+        uint32_t                    nCpu = (uint32_t)CS.nCpu;
+        if (nCpu >= PROFILE_CONTEXT_SWITCH_MAX_CPUS)
+            continue;
+
+        int64_t nTicks = nBaseTicksCpu + ProfileLogTickDifference(nBaseTicksCpu, CS.nTicks);
+        if (nRunningThread[nCpu])
+        {
+            float fMsStart = max(fToMsCpu * (nRunningSince[nCpu] - nBaseTicksCpu), 0.f);
+            float fMsEnd = min(fToMsCpu * (nTicks - nBaseTicksCpu), fDetailedRange);
+            if (fMsEnd > fMsStart)
+            {
+                ProfileDetailedModeCpuSlice slice;
+                slice.mCpu = nCpu;
+                slice.mStartTime = fMsStart;
+                slice.mEndTime = fMsEnd;
+                snprintf(slice.mThreadName, sizeof(slice.mThreadName), "%llu", (unsigned long long)nRunningThread[nCpu]);
+                for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+                {
+                    if (S.Pool[i] && !S.Pool[i]->nGpu && S.Pool[i]->nSystemThreadId == nRunningThread[nCpu])
+                    {
+                        strncpy(slice.mThreadName, S.Pool[i]->ThreadName, sizeof(slice.mThreadName));
+                        break;
+                    }
+                }
+                arrpush(frameLog.mCpuSlices, slice);
+            }
+        }
+
+        nRunningThread[nCpu] = CS.nProcessIn == nProcessId ? CS.nThreadIn : 0;
+        nRunningSince[nCpu] = nTicks;
+    }
+#endif
+
     arrpush(gDetailedModeDump, frameLog);
 }
 
@@ -793,6 +871,9 @@ void profileDrawDetailedMode(Profile& S)
     float       frameTime = 0.0f;
     float       frameHeight = 0.f;
     uint32_t    timerCount = 0;
+#if PROFILE_CONTEXT_SWITCH_TRACE
+    bool        coreLabeled[PROFILE_CONTEXT_SWITCH_MAX_CPUS] = {};
+#endif
     // Draw all frames in the dump into a timeline.
     for (ptrdiff_t frameIndex = 0; frameIndex < arrlen(gDetailedModeDump); ++frameIndex)
     {
@@ -844,6 +925,57 @@ void profileDrawDetailedMode(Profile& S)
             frameHeight = max(frameHeight, height * 1.2f);
             ++timerCount;
         }
+
+#if PROFILE_CONTEXT_SWITCH_TRACE
+        // One row per core below the timers, showing which of our threads ran on it.
+        const float coreStartHeight = startHeightPixels + gCurrWindowSize.y * 0.035f + (interTimerHeight + timerHeight) * S.nTotalTimers;
+        for (uint32_t i = 0; i < (uint32_t)arrlen(frameToDraw.mCpuSlices); ++i)
+        {
+            if (timerCount > MAX_DETAILED_TIMERS_DRAW)
+                break;
+            ProfileDetailedModeCpuSlice& slice = frameToDraw.mCpuSlices[i];
+            float                        height = coreStartHeight + (interTimerHeight + timerHeight) * slice.mCpu;
+
+            if (!coreLabeled[slice.mCpu])
+            {
+                char coreStr[MAX_TEMP_BUFFER_SIZE];
+                snprintf(coreStr, sizeof(coreStr), "Core %u", slice.mCpu);
+
+                DrawTextWidget coreWidget;
+                coreWidget.mPos = float2(startWidthPixels, height);
+                coreWidget.mColor = float4(0.6f);
+
+                UIWidget* pCoreWidget = uiAddComponentWidget(pWidgetUIComponent, coreStr, &coreWidget, WIDGET_TYPE_DRAW_TEXT);
+                arrpush(gDetailedModeWidgets, pCoreWidget);
+                REGISTER_LUA_WIDGET(pCoreWidget);
+                coreLabeled[slice.mCpu] = true;
+            }
+
+            // Same thread gets the same color on every core.
+            uint32_t threadColor = 2166136261u;
+            for (const char* pChar = slice.mThreadName; *pChar; ++pChar)
+                threadColor = (threadColor ^ (uint8_t)*pChar) * 16777619u;
+
+            FilledRectWidget rectWidget;
+            rectWidget.mPos = float2(startWidthPixels + (frameTime + slice.mStartTime) * msToPixels, height);
+            rectWidget.mScale = float2(max(slice.mEndTime - slice.mStartTime, 0.05f) * msToPixels, timerHeight);
+            rectWidget.mColor = unpackA8B8G8R8((threadColor & 0x00FFFFFF) | 0x7D000000);
+
+            UIWidget* pRectWidget = uiAddComponentWidget(pWidgetUIComponent, slice.mThreadName, &rectWidget, WIDGET_TYPE_FILLED_RECT);
+            arrpush(gDetailedModeWidgets, pRectWidget);
+            REGISTER_LUA_WIDGET(pRectWidget);
+
+            DrawTextWidget textWidget;
+            textWidget.mPos = rectWidget.mPos + float2(rectWidget.mScale.x, 0.f);
+            textWidget.mColor = float4(1.f);
+
+            UIWidget* pTextWidget = uiAddComponentWidget(pWidgetUIComponent, slice.mThreadName, &textWidget, WIDGET_TYPE_DRAW_TEXT);
+            arrpush(gDetailedModeWidgets, pTextWidget);
+            REGISTER_LUA_WIDGET(pTextWidget);
+            frameHeight = max(frameHeight, height * 1.2f);
+            ++timerCount;
+        }
+#endif
         frameTime += frameToDraw.mFrameTime;
     }
 
@@ -1140,9 +1272,100 @@ void profileDrawTimerMode(Profile& S)
 
         REGISTER_LUA_WIDGET(uiAddComponentWidget(pWidgetUIComponent, "", &separator, WIDGET_TYPE_SEPARATOR));
     }
+
+#if defined(ENABLE_MEMORY_TAGS)
+    ColorLabelWidget memoryLabel;
+    memoryLabel.mColor = gFernGreenColor;
+    REGISTER_LUA_WIDGET(
+        uiAddComponentWidget(pWidgetUIComponent, "Memory Tags (live / peak / budget)", &memoryLabel, WIDGET_TYPE_COLOR_LABEL));
+    REGISTER_LUA_WIDGET(uiAddComponentWidget(pWidgetUIComponent, "", &separator, WIDGET_TYPE_SEPARATOR));
+
+    gTotalMemoryTags = memTagCount();
+    for (uint32_t tag = 0; tag < gTotalMemoryTags; ++tag)
+    {
+        UIWidget* columnWidgets[gMemoryTagColumnsCount + 1];
+
+        UIWidget labelBase = {};
+        labelBase.mType = WIDGET_TYPE_LABEL;
+        strncpy(labelBase.mLabel, memTagGetStatistics(tag).pName, sizeof(labelBase.mLabel) - 1);
+
+        LabelWidget labelWidget = {};
+        labelBase.pWidget = &labelWidget;
+        columnWidgets[0] = &labelBase;
+
+        UIWidget          textBases[gMemoryTagColumnsCount];
+        DynamicTextWidget textWidgets[gMemoryTagColumnsCount];
+        for (uint32_t i = 0; i < gMemoryTagColumnsCount; ++i)
+        {
+            TimerColumnData* pColumnData = &gMemoryTagData[tag][i];
+            pColumnData->mColor = gNormalColor;
+            pColumnData->mText = bemptyfromarr(pColumnData->mTextBuf);
+            bassignliteral(&pColumnData->mText, "-");
+
+            textBases[i] = {};
+            textBases[i].mType = WIDGET_TYPE_DYNAMIC_TEXT;
+            textWidgets[i] = {};
+            textWidgets[i].pText = &pColumnData->mText;
+            textWidgets[i].pColor = &pColumnData->mColor;
+            textBases[i].pWidget = &textWidgets[i];
+            columnWidgets[i + 1] = &textBases[i];
+        }
+
+        ColumnWidget tagColWidget = {};
+        tagColWidget.pPerColumnWidgets = columnWidgets;
+        tagColWidget.mWidgetsCount = gMemoryTagColumnsCount + 1;
+        REGISTER_LUA_WIDGET(uiAddComponentWidget(pWidgetUIComponent, labelBase.mLabel, &tagColWidget, WIDGET_TYPE_COLUMN));
+    }
+#endif
 #endif
 }
 
+#if defined(ENABLE_MEMORY_TAGS)
+/// Get data for the memory tag rows of timer mode.
+void profileUpdateMemoryTagData()
+{
+    for (uint32_t tag = 0; tag < gTotalMemoryTags; ++tag)
+    {
+        MemoryTagStatistics stats = memTagGetStatistics(tag);
+        int64_t values[gMemoryTagColumnsCount] = { (int64_t)stats.liveBytes, (int64_t)stats.peakBytes, (int64_t)stats.budgetBytes };
+        bool    overBudget = stats.budgetBytes && stats.liveBytes > stats.budgetBytes;
+
+        for (uint32_t i = 0; i < gMemoryTagColumnsCount; ++i)
+        {
+            TimerColumnData* pCol = &gMemoryTagData[tag][i];
+            char             buffer[MAX_TIME_STR_LEN];
+            if (i == 2 && !values[i])
+                strcpy(buffer, "-");
+            else
+                ProfileFormatCounter(PROFILE_COUNTER_FORMAT_BYTES, values[i], buffer, sizeof(buffer));
+            bassigncstr(&pCol->mText, buffer);
+            pCol->mColor = overBudget ? gCriticalColor : gNormalColor;
+        }
+    }
+}
+
+/// Publish live bytes of every memory tag as profiler counters, budget becomes the counter limit.
+void profileUpdateMemoryTagCounters()
+{
+    uint32_t tagCount = memTagCount();
+    for (uint32_t tag = 0; tag < tagCount; ++tag)
+    {
+        MemoryTagStatistics stats = memTagGetStatistics(tag);
+        if (tag >= gMemoryTagCounterCount)
+        {
+            char name[PROFILE_NAME_MAX_LEN];
+            snprintf(name, sizeof(name), "memory/%s", stats.pName);
+            ProfileCounterConfig(name, PROFILE_COUNTER_FORMAT_BYTES, 0, 0);
+            gMemoryTagCounters[tag] = ProfileGetCounterToken(name);
+            gMemoryTagCounterCount = tag + 1;
+        }
+
+        ProfileCounterSetLimit(gMemoryTagCounters[tag], (int64_t)stats.budgetBytes);
+        ProfileCounterSet(gMemoryTagCounters[tag], (int64_t)stats.liveBytes);
+    }
+}
+#endif
+
 void profileResetTimerModeData(uint32_t tableLocation)
 {
     TimerRowData* pRow = gTimerData[tableLocation];
@@ -1255,6 +1478,7 @@ void resetProfilerUI()
     for (ptrdiff_t i = 0; i < arrlen(gDetailedModeDump); ++i)
     {
         arrfree(gDetailedModeDump[i].mTimers);
+        arrfree(gDetailedModeDump[i].mCpuSlices);
     }
     arrsetlen(gDetailedModeDump, 0);
     arrsetlen(gPlotModeWidgets, 0);
@@ -1756,7 +1980,11 @@ void updateProfilerUI()
     if (gProfilerWidgetUIEnabled)
     {
         // New groups or timers were found. Create the widget table.
-        if (S.nGroupCount != gTotalGroups || S.nTotalTimers != gTotalTimers || gUnloaded)
+        bool memoryTagsChanged = false;
+#if defined(ENABLE_MEMORY_TAGS)
+        memoryTagsChanged = memTagCount() != gTotalMemoryTags;
+#endif
+        if (S.nGroupCount != gTotalGroups || S.nTotalTimers != gTotalTimers || memoryTagsChanged || gUnloaded)
         {
             profileLoadWidgetUI(S);
             gTotalGroups = S.nGroupCount;
@@ -1784,6 +2012,9 @@ void updateProfilerUI()
                     }
                 }
             }
+#if defined(ENABLE_MEMORY_TAGS)
+            profileUpdateMemoryTagData();
+#endif
         }
 
         // Accumulate frames for detailed view.
@@ -1845,7 +2076,10 @@ void ProfileInit()
     if (g_bOnce)
     {
         g_bOnce = false;
-        initMutex(&mutex);
+        // Held only for short bookkeeping, don't sleep in kernel right away
+        MutexDesc mutexDesc = {};
+        mutexDesc.futex = true;
+        initMutexDesc(&mutex, &mutexDesc);
 
         // We do not want to reset the Pool array!
         // It could be that other threads still have a valid log thread.
@@ -1925,8 +2159,10 @@ void initProfiler(ProfilerDesc* pDesc)
     // PROFILER BASE
 #ifdef ENABLE_PROFILER
     ProfileInit();
+    ProfileOnThreadCreate(nullptr);
     ProfileSetEnableAllGroups(true);
     ProfileWebServerStart();
+    ProfileContextSwitchTraceStart();
 
 #ifdef ENABLE_GPU_PROFILER
     initGpuProfilers();
@@ -2102,15 +2338,29 @@ void unloadProfilerUI()
     pMenuUIComponent = 0;
     gTotalGroups = 0;
     gTotalTimers = 0;
+#if defined(ENABLE_MEMORY_TAGS)
+    gTotalMemoryTags = 0;
+#endif
     gUnloaded = true;
 #endif
 }
 
+static void ProfileLogFlushStart();
+static void ProfileLogFlushStop();
+#if PROFILE_SAMPLING
+static void ProfileSampleShutdown();
+#endif
+
 void exitCpuProfiler()
 {
+    ProfileLogFlushStop();
+#if PROFILE_SAMPLING
+    ProfileSampleShutdown();
+#endif
     ProfileOnThreadExit();
     ProfileWebServerStop();
     ProfileContextSwitchTraceStop();
+    stopProfileTrace();
 
     g_bOnce = true;
     g_bUseLock = false;
@@ -2146,6 +2396,312 @@ ProfileThreadLog* ProfileGetThreadLog() { return g_ProfileThreadLog; }
 void ProfileSetThreadLog(ProfileThreadLog* pLog) { g_ProfileThreadLog = pLog; }
 #endif
 
+#if PROFILE_SAMPLING
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+
+// Older glibc headers only have the union member
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+struct ProfileSample
+{
+    int64_t  nTick;
+    uint32_t nDepth;
+    uint32_t nWeight; // sampling intervals, the kernel merges the ones that elapsed between two of its ticks
+    void*    pFrames[PROFILE_SAMPLE_MAX_DEPTH]; // innermost first
+};
+
+// Written by the SIGPROF handler on the owning thread, read by the flip under the profile mutex
+struct ProfileSampleRing
+{
+    tfrg_atomic32_t nPut;
+    tfrg_atomic32_t nGet;
+    tfrg_atomic64_t nDropped;
+    timer_t         Timer;
+    bool            bTimer;
+    ProfileSample   Samples[PROFILE_SAMPLE_BUFFER_SIZE];
+};
+
+enum ProfileSampleNodeType
+{
+    PROFILE_SAMPLE_NODE_ROOT,
+    PROFILE_SAMPLE_NODE_THREAD, // nKey indexes ThreadNames
+    PROFILE_SAMPLE_NODE_ZONE,   // nKey is a timer index
+    PROFILE_SAMPLE_NODE_FRAME,  // nKey is a code address
+};
+
+// Call tree of all attributed samples, children are a linked list through nSibling, 0 ends it since the root is never a child
+struct ProfileSampleNode
+{
+    uint64_t nKey;
+    uint32_t nType;
+    uint32_t nChild;
+    uint32_t nSibling;
+    uint32_t nSamples; // sampling intervals whose innermost frame is this node
+};
+
+struct ProfileSampleThreadName
+{
+    char Name[ProfileThreadLog::THREAD_MAX_LEN];
+};
+
+struct ProfileSamplingState
+{
+    uint32_t                 nSamplesPerSecond;
+    bool                     bHandlerInstalled;
+    ProfileSampleNode*       pNodes;       // stb array
+    ProfileSampleThreadName* pThreadNames; // stb array, threads of the same name share their tree
+    uint64_t                 nSamples;
+    uint64_t                 nDropped; // tree full, ring drops are summed when dumping
+};
+
+static ProfileSamplingState gProfileSampling;
+
+static void ProfileSampleSignalHandler(int nSignal, siginfo_t* pInfo, void* pContext)
+{
+    UNREF_PARAM(nSignal);
+    UNREF_PARAM(pContext);
+    // Only the sampling timers carry the ring, a SIGPROF sent with kill has nothing to write to
+    if (pInfo->si_code != SI_TIMER || !pInfo->si_value.sival_ptr)
+        return;
+
+    int                nErrno = errno;
+    int64_t            nTick = P_TICK();
+    ProfileSampleRing* pRing = (ProfileSampleRing*)pInfo->si_value.sival_ptr;
+    uint32_t           nPut = tfrg_atomic32_load_relaxed(&pRing->nPut);
+    uint32_t           nNextPut = (nPut + 1) % PROFILE_SAMPLE_BUFFER_SIZE;
+    if (nNextPut == tfrg_atomic32_load_acquire(&pRing->nGet))
+    {
+        tfrg_atomic64_add_relaxed(&pRing->nDropped, 1);
+    }
+    else
+    {
+        // The first two frames are this handler and the signal return trampoline
+        void* pFrames[PROFILE_SAMPLE_MAX_DEPTH + 2];
+        int   nFrames = backtrace(pFrames, PROFILE_SAMPLE_MAX_DEPTH + 2);
+
+        ProfileSample* pSample = &pRing->Samples[nPut];
+        pSample->nTick = nTick;
+        pSample->nWeight = 1 + (uint32_t)ProfileMax(pInfo->si_overrun, 0);
+        pSample->nDepth = nFrames > 2 ? (uint32_t)(nFrames - 2) : 0;
+        memcpy(pSample->pFrames, pFrames + 2, sizeof(void*) * pSample->nDepth);
+        tfrg_atomic32_store_release(&pRing->nPut, nNextPut);
+    }
+    errno = nErrno;
+}
+
+static bool ProfileSampleInstallHandler()
+{
+    ProfileSamplingState& P = gProfileSampling;
+    if (P.bHandlerInstalled)
+        return true;
+
+    struct sigaction Old = {};
+    sigaction(SIGPROF, NULL, &Old);
+    if ((Old.sa_flags & SA_SIGINFO) || (Old.sa_handler != SIG_DFL && Old.sa_handler != SIG_IGN))
+    {
+        LOGF(eWARNING, "Profiler sampling disabled, SIGPROF already has a handler installed");
+        return false;
+    }
+
+    // backtrace loads the unwinder on its first call, which must not happen inside the signal handler
+    void* pFrame;
+    backtrace(&pFrame, 1);
+
+    // Stays installed once sampling stops, a timer signal still in flight would terminate the process otherwise
+    struct sigaction Action = {};
+    Action.sa_sigaction = ProfileSampleSignalHandler;
+    Action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&Action.sa_mask);
+    if (sigaction(SIGPROF, &Action, NULL) != 0)
+    {
+        LOGF(eWARNING, "Profiler sampling disabled, failed to install the SIGPROF handler: %s", strerror(errno));
+        return false;
+    }
+    P.bHandlerInstalled = true;
+    return true;
+}
+
+// Arms a timer on the thread's cpu time, called under the profile mutex
+static void ProfileSampleStartThread(ProfileThreadLog* pLog)
+{
+    ProfileSamplingState& P = gProfileSampling;
+    Profile&              S = g_Profile;
+    if (pLog->nGpu || !P.nSamplesPerSecond)
+        return;
+
+    if (!pLog->pSampleRing)
+    {
+        pLog->pSampleRing = (ProfileSampleRing*)tf_calloc(1, sizeof(ProfileSampleRing));
+        S.nMemUsage += sizeof(ProfileSampleRing);
+    }
+    ProfileSampleRing* pRing = pLog->pSampleRing;
+    if (pRing->bTimer)
+        return;
+
+    // nThreadId is not a pthread_t on Linux, the cpu clock is built from the kernel tid the way pthread_getcpuclockid does:
+    // the inverted tid above CPUCLOCK_PERTHREAD_MASK (4) | CPUCLOCK_SCHED (2)
+    clockid_t nClock = (clockid_t)((~(uint32_t)pLog->nSystemThreadId) << 3) | 4 | 2;
+
+    struct sigevent Event = {};
+    Event.sigev_notify = SIGEV_THREAD_ID;
+    Event.sigev_signo = SIGPROF;
+    Event.sigev_value.sival_ptr = pRing;
+    Event.sigev_notify_thread_id = (pid_t)pLog->nSystemThreadId;
+    if (timer_create(nClock, &Event, &pRing->Timer) != 0)
+    {
+        LOGF(eWARNING, "Profiler sampling failed to create a timer for thread '%s': %s", pLog->ThreadName, strerror(errno));
+        return;
+    }
+
+    int64_t           nInterval = 1000000000ll / P.nSamplesPerSecond;
+    struct itimerspec Spec = {};
+    Spec.it_interval.tv_sec = (time_t)(nInterval / 1000000000ll);
+    Spec.it_interval.tv_nsec = (long)(nInterval % 1000000000ll);
+    Spec.it_value = Spec.it_interval;
+    timer_settime(pRing->Timer, 0, &Spec, NULL);
+    pRing->bTimer = true;
+}
+
+static void ProfileSampleStopThread(ProfileThreadLog* pLog)
+{
+    ProfileSampleRing* pRing = pLog->pSampleRing;
+    if (pRing && pRing->bTimer)
+    {
+        // Also discards a signal of this timer that is still pending
+        timer_delete(pRing->Timer);
+        pRing->bTimer = false;
+    }
+}
+
+static uint32_t ProfileSampleChild(uint32_t nParent, uint32_t nType, uint64_t nKey)
+{
+    ProfileSamplingState& P = gProfileSampling;
+    for (uint32_t nNode = P.pNodes[nParent].nChild; nNode; nNode = P.pNodes[nNode].nSibling)
+    {
+        if (P.pNodes[nNode].nKey == nKey && P.pNodes[nNode].nType == nType)
+            return nNode;
+    }
+    if (arrlen(P.pNodes) >= PROFILE_SAMPLE_MAX_NODES)
+        return 0;
+
+    ProfileSampleNode Node = { nKey, nType, 0, P.pNodes[nParent].nChild, 0 };
+    uint32_t          nNode = (uint32_t)arrlen(P.pNodes);
+    arrpush(P.pNodes, Node);
+    P.pNodes[nParent].nChild = nNode;
+    return nNode;
+}
+
+static uint32_t ProfileSampleThreadNode(ProfileThreadLog* pLog)
+{
+    ProfileSamplingState& P = gProfileSampling;
+    uint32_t              nName = 0;
+    while (nName < (uint32_t)arrlen(P.pThreadNames) && strcmp(P.pThreadNames[nName].Name, pLog->ThreadName) != 0)
+    {
+        ++nName;
+    }
+    if (nName == (uint32_t)arrlen(P.pThreadNames))
+    {
+        ProfileSampleThreadName Name;
+        memcpy(Name.Name, pLog->ThreadName, sizeof(Name.Name));
+        arrpush(P.pThreadNames, Name);
+    }
+    return ProfileSampleChild(0, PROFILE_SAMPLE_NODE_THREAD, nName);
+}
+
+// Adds the samples taken before nTick to the call tree below the first nStackPos zones of the thread's stack
+static void ProfileSampleAttribute(ProfileThreadLog* pLog, uint64_t nTick, uint32_t nStackPos)
+{
+    ProfileSamplingState& P = gProfileSampling;
+    ProfileSampleRing*    pRing = pLog->pSampleRing;
+    uint32_t              nGet = tfrg_atomic32_load_relaxed(&pRing->nGet);
+    uint32_t              nPut = tfrg_atomic32_load_acquire(&pRing->nPut);
+    if (nGet == nPut)
+        return;
+
+    if (!P.pNodes)
+    {
+        ProfileSampleNode Root = { 0, PROFILE_SAMPLE_NODE_ROOT, 0, 0, 0 };
+        arrpush(P.pNodes, Root);
+    }
+
+    uint32_t nThreadNode = UINT32_MAX;
+    while (nGet != nPut && ProfileLogTickDifference(pRing->Samples[nGet].nTick, nTick) > 0)
+    {
+        const ProfileSample* pSample = &pRing->Samples[nGet];
+        nGet = (nGet + 1) % PROFILE_SAMPLE_BUFFER_SIZE;
+
+        if (nThreadNode == UINT32_MAX)
+            nThreadNode = ProfileSampleThreadNode(pLog);
+        uint32_t nNode = nThreadNode;
+        for (uint32_t i = 0; i < nStackPos && nNode; ++i)
+        {
+            nNode = ProfileSampleChild(nNode, PROFILE_SAMPLE_NODE_ZONE, ProfileLogTimerIndex(pLog->nStack[i]));
+        }
+        for (uint32_t i = pSample->nDepth; i-- > 0 && nNode;)
+        {
+            // Return addresses point past the call, the one before still belongs to the calling line
+            uint64_t nAddress = (uint64_t)(uintptr_t)pSample->pFrames[i] - (i ? 1 : 0);
+            nNode = ProfileSampleChild(nNode, PROFILE_SAMPLE_NODE_FRAME, nAddress);
+        }
+
+        if (nNode)
+        {
+            P.pNodes[nNode].nSamples += pSample->nWeight;
+            P.nSamples += pSample->nWeight;
+        }
+        else
+        {
+            P.nDropped += pSample->nWeight;
+        }
+    }
+    tfrg_atomic32_store_release(&pRing->nGet, nGet);
+}
+#endif
+
+// Frees the spills of frames up to and including nFrameIndex, spills are kept in frame order
+static void ProfileReleaseLogSpills(ProfileThreadLog* pLog, uint64_t nFrameIndex)
+{
+    Profile&  S = g_Profile;
+    ptrdiff_t nRelease = 0;
+    while (nRelease < arrlen(pLog->pSpills) && pLog->pSpills[nRelease].nFrameIndex <= nFrameIndex)
+    {
+        tf_free(pLog->pSpills[nRelease].pEntries);
+        S.nMemUsage -= sizeof(ProfileLogEntry) * pLog->pSpills[nRelease].nCount;
+        ++nRelease;
+    }
+    if (nRelease)
+        arrdeln(pLog->pSpills, 0, nRelease);
+}
+
+static void ProfileFreeThreadLog(ProfileThreadLog* pLog)
+{
+    Profile& S = g_Profile;
+    if (pLog->Log)
+    {
+        tf_free(pLog->Log);
+        S.nMemUsage -= sizeof(ProfileLogEntry) * pLog->nLogSize;
+    }
+    ProfileReleaseLogSpills(pLog, UINT64_MAX);
+    arrfree(pLog->pSpills);
+#if PROFILE_SAMPLING
+    if (pLog->pSampleRing)
+    {
+        ProfileSampleStopThread(pLog);
+        tf_free(pLog->pSampleRing);
+        S.nMemUsage -= sizeof(ProfileSampleRing);
+    }
+#endif
+
+    pLog->~ProfileThreadLog();
+    tf_free(pLog);
+    S.nMemUsage -= sizeof(ProfileThreadLog);
+}
+
 PROFILE_API void ProfileRemoveThreadLog(ProfileThreadLog* pLog)
 {
     MutexLock lock(ProfileMutex());
@@ -2170,19 +2726,11 @@ PROFILE_API void ProfileRemoveThreadLog(ProfileThreadLog* pLog)
             S.Frames[i].nLogStart[nLogIndex] = 0; //-V557
         }
 
-        if (pLog->Log)
-        {
-            tf_free(pLog->Log);
-            S.nMemUsage -= sizeof(ProfileLogEntry) * PROFILE_BUFFER_SIZE;
-        }
-
-        pLog->~ProfileThreadLog();
-        tf_free(pLog);
-        S.nMemUsage -= sizeof(ProfileThreadLog);
+        ProfileFreeThreadLog(pLog);
     }
 }
 
-ProfileThreadLog* ProfileCreateThreadLog(const char* pName)
+ProfileThreadLog* ProfileCreateThreadLog(const char* pName, uint32_t nLogSize)
 {
     Profile&          S = g_Profile;
     ProfileThreadLog* pLog = 0;
@@ -2205,29 +2753,60 @@ ProfileThreadLog* ProfileCreateThreadLog(const char* pName)
 
     memset(pLog, 0, sizeof(*pLog));
     pLog->nLogIndex = nLogIndex;
+
+    // Allocated up front, a first event allocating the log would be timed as part of its zone.
+    // Clearing it also faults in every page before any zone writes to them
+    pLog->nLogSize = ProfileMax(nLogSize ? nLogSize : (uint32_t)PROFILE_BUFFER_SIZE, (uint32_t)PROFILE_MIN_BUFFER_SIZE);
+    pLog->Log = static_cast<ProfileLogEntry*>(tf_malloc(sizeof(ProfileLogEntry) * pLog->nLogSize));
+    memset(pLog->Log, 0, sizeof(ProfileLogEntry) * pLog->nLogSize);
+    S.nMemUsage += sizeof(ProfileLogEntry) * pLog->nLogSize;
+
     int len = (int)strlen(pName);
     int maxlen = sizeof(pLog->ThreadName) - 1;
     len = len < maxlen ? len : maxlen;
     memcpy(&pLog->ThreadName[0], pName, len);
     pLog->ThreadName[len] = '\0';
     pLog->nThreadId = getCurrentThreadID();
+#if defined(__linux__) && !defined(__ANDROID__)
+    // sched_switch reports kernel tids, pthread ids never match them
+    pLog->nSystemThreadId = (ThreadID)syscall(SYS_gettid);
+#else
+    pLog->nSystemThreadId = pLog->nThreadId;
+#endif
     return pLog;
 }
 
-void ProfileOnThreadCreate(const char* pThreadName)
+void ProfileOnThreadCreateEx(const char* pThreadName, uint32_t nLogSize, bool bFlushOnNearFull)
 {
     g_bUseLock = true;
     ProfileInit();
-    MutexLock lock(ProfileMutex());
-    if (ProfileGetThreadLog() == 0)
+    MutexLock         lock(ProfileMutex());
+    ProfileThreadLog* pLog = ProfileGetThreadLog();
+    if (pLog == 0)
     {
-        ProfileThreadLog* pLog = ProfileCreateThreadLog(pThreadName ? pThreadName : ProfileGetThreadName());
+        pLog = ProfileCreateThreadLog(pThreadName ? pThreadName : ProfileGetThreadName(), nLogSize);
         P_ASSERT(pLog);
         ProfileSetThreadLog(pLog);
         g_ForceProfileThreadExit.EnsureConstruction();
+#if PROFILE_SAMPLING
+        ProfileSampleStartThread(pLog);
+#endif
+    }
+    else if (nLogSize && nLogSize != pLog->nLogSize)
+    {
+        LOGF(eWARNING, "Profiler log of thread '%s' already exists with %u entries, set its size before the first profiled scope",
+             pLog->ThreadName, pLog->nLogSize);
+    }
+
+    if (bFlushOnNearFull && pLog)
+    {
+        pLog->bFlushOnNearFull = 1;
+        ProfileLogFlushStart();
     }
 }
 
+void ProfileOnThreadCreate(const char* pThreadName) { ProfileOnThreadCreateEx(pThreadName, 0, false); }
+
 void ProfileOnThreadExit()
 {
     MutexLock         lock(ProfileMutex());
@@ -2253,15 +2832,7 @@ void ProfileOnThreadExit()
             S.Frames[i].nLogStart[nLogIndex] = 0; //-V557
         }
 
-        if (pLog->Log)
-        {
-            tf_free(pLog->Log);
-            S.nMemUsage -= sizeof(ProfileLogEntry) * PROFILE_BUFFER_SIZE;
-        }
-
-        pLog->~ProfileThreadLog();
-        tf_free(pLog);
-        S.nMemUsage -= sizeof(ProfileThreadLog);
+        ProfileFreeThreadLog(pLog);
 
         ProfileSetThreadLog(0);
     }
@@ -2565,27 +3136,40 @@ ProfileToken ProfileGetCounterToken(const char* pName)
     return nResult;
 }
 
-inline void ProfileLogPut(ProfileToken nToken_, uint64_t nTick, uint64_t nBegin, ProfileThreadLog* pLog)
+static void ProfileRequestLogFlush(ProfileThreadLog* pLog)
 {
-    P_ASSERT(pLog != 0); // this assert is hit if ProfileOnCreateThread is not called
+    // Raised once, cleared again when the flush thread or the next flip made room
+    if (tfrg_atomic32_cas_relaxed(&pLog->nFlushRequest, 0, 1) != 0)
+        return;
+
     Profile& S = g_Profile;
+    acquireMutex(&S.LogFlushMutex);
+    S.bLogFlushWake = true;
+    wakeOneConditionVariable(&S.LogFlushCondition);
+    releaseMutex(&S.LogFlushMutex);
+}
+
+inline void ProfileLogPut(ProfileToken nToken_, uint64_t nTick, uint64_t nBegin, ProfileThreadLog* pLog)
+{
+    P_ASSERT(pLog != 0 && pLog->Log); // this assert is hit if ProfileOnCreateThread is not called
+    uint32_t nLogSize = pLog->nLogSize;
     uint32_t nPos = tfrg_atomic32_load_relaxed(&pLog->nPut);
-    uint32_t nNextPos = (nPos + 1) % PROFILE_BUFFER_SIZE;
-    if (nNextPos == tfrg_atomic32_load_relaxed(&pLog->nGet))
+    uint32_t nNextPos = (nPos + 1) % nLogSize;
+    uint32_t nGet = tfrg_atomic32_load_acquire(&pLog->nGet);
+    if (nNextPos == nGet)
     {
-        S.nOverflow = 100;
+        tfrg_atomic64_add_relaxed(&pLog->nDropped, 1);
     }
     else
     {
-        if (!pLog->Log)
-        {
-            pLog->Log = static_cast<ProfileLogEntry*>(tf_malloc(sizeof(ProfileLogEntry) * PROFILE_BUFFER_SIZE));
-            memset(pLog->Log, 0, sizeof(ProfileLogEntry) * PROFILE_BUFFER_SIZE);
-            S.nMemUsage += sizeof(ProfileLogEntry) * PROFILE_BUFFER_SIZE;
-        }
         pLog->Log[nPos] = ProfileMakeLogIndex(nBegin, nToken_, nTick);
         tfrg_atomic32_store_release(&pLog->nPut, nNextPos);
     }
+
+    if (pLog->bFlushOnNearFull && (nNextPos + nLogSize - nGet) % nLogSize >= nLogSize - nLogSize / 4)
+    {
+        ProfileRequestLogFlush(pLog);
+    }
 }
 
 uint64_t cpuProfileEnter(ProfileToken nToken_)
@@ -2622,7 +3206,7 @@ PROFILE_API uint64_t ProfileEnterGpu(ProfileToken nToken_, uint64_t nTick, Profi
 uint64_t ProfileAllocateLabel(const char* pName)
 {
     Profile& S = g_Profile;
-    char*    pLabelBuffer = (char*)tfrg_atomicptr_load_relaxed(&S.LabelBuffer);
+    char*    pLabelBuffer = (char*)tfrg_atomicptr_load_acquire(&S.LabelBuffer);
     if (!pLabelBuffer)
     {
         MutexLock lock(ProfileMutex());
@@ -2633,7 +3217,7 @@ uint64_t ProfileAllocateLabel(const char* pName)
             pLabelBuffer = static_cast<char*>(tf_malloc(PROFILE_LABEL_BUFFER_SIZE + PROFILE_LABEL_MAX_LEN));
             memset(pLabelBuffer, 0, PROFILE_LABEL_BUFFER_SIZE + PROFILE_LABEL_MAX_LEN);
             S.nMemUsage += PROFILE_LABEL_BUFFER_SIZE + PROFILE_LABEL_MAX_LEN;
-            tfrg_atomic64_store_release(&S.LabelBuffer, *pLabelBuffer);
+            tfrg_atomicptr_store_release(&S.LabelBuffer, (uintptr_t)pLabelBuffer);
         }
     }
 
@@ -2809,7 +3393,7 @@ PROFILE_API void ProfileLeaveGpu(ProfileToken nToken_, uint64_t nTick, ProfileTh
 void ProfileContextSwitchPut(ProfileContextSwitch* pContextSwitch)
 {
     Profile& S = g_Profile;
-    if (S.nRunning || pContextSwitch->nTicks <= S.nPauseTicks)
+    if (S.nRunning || ProfileLogTickDifference(pContextSwitch->nTicks, S.nPauseTicks) >= 0)
     {
         uint32_t nPut = S.nContextSwitchPut;
         S.ContextSwitch[nPut] = *pContextSwitch;
@@ -2817,7 +3401,7 @@ void ProfileContextSwitchPut(ProfileContextSwitch* pContextSwitch)
     }
 }
 
-void ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nRange[2][2])
+void ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nLogSize, uint32_t nRange[2][2])
 {
     if (nPut > nGet)
     {
@@ -2827,8 +3411,8 @@ void ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nRange[2][2])
     }
     else if (nPut != nGet)
     {
-        P_ASSERT(nGet != PROFILE_BUFFER_SIZE);
-        uint32_t nCountEnd = PROFILE_BUFFER_SIZE - nGet;
+        P_ASSERT(nGet != nLogSize);
+        uint32_t nCountEnd = nLogSize - nGet;
         nRange[0][0] = nGet;
         nRange[0][1] = nGet + nCountEnd;
         nRange[1][0] = 0;
@@ -2836,18 +3420,226 @@ void ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nRange[2][2])
     }
 }
 
-void ProfileDumpToFile(Renderer* pRenderer);
-
-void ProfileFlipCpu()
+// Moves the frames of pLog that aren't aggregated yet to spills, so the producer keeps going instead of dropping events.
+// Returns false when nothing could be moved and the request should stay raised until the next flip
+static bool ProfileFlushThreadLog(ProfileThreadLog* pLog)
 {
-    MutexLock lock(ProfileMutex());
-
     Profile& S = g_Profile;
+    // Spills are only aggregated by a running profiler
+    if (!S.nRunning)
+        return false;
 
-    if (S.nToggleRunning)
+    uint32_t nLogIndex = pLog->nLogIndex;
+    uint32_t nLogSize = pLog->nLogSize;
+    uint32_t nPut = tfrg_atomic32_load_acquire(&pLog->nPut);
+    // Frames still waiting for their gpu timers move out as well, the log would wrap over them otherwise
+    uint64_t nFirstFrame = S.nFramePutIndex > PROFILE_GPU_FRAME_DELAY ? S.nFramePutIndex - PROFILE_GPU_FRAME_DELAY : 0;
+
+    uint64_t nCount = 0;
+    for (uint64_t i = nFirstFrame; i <= S.nFramePutIndex; ++i)
     {
-        S.nRunning = !S.nRunning;
-        if (!S.nRunning)
+        uint32_t nStart = S.Frames[i % PROFILE_MAX_FRAME_HISTORY].nLogStart[nLogIndex];
+        uint32_t nEnd = i == S.nFramePutIndex ? nPut : S.Frames[(i + 1) % PROFILE_MAX_FRAME_HISTORY].nLogStart[nLogIndex];
+        nCount += (nEnd + nLogSize - nStart) % nLogSize;
+    }
+    if (!nCount)
+        return false;
+
+    uint64_t nSpilled = 0;
+    for (ptrdiff_t i = 0; i < arrlen(pLog->pSpills); ++i)
+    {
+        if (pLog->pSpills[i].nFrameIndex >= nFirstFrame)
+            nSpilled += pLog->pSpills[i].nCount;
+    }
+    if (sizeof(ProfileLogEntry) * (nSpilled + nCount) > PROFILE_PER_THREAD_FLUSH_MAX_SIZE)
+        return false;
+
+    for (uint64_t i = nFirstFrame; i <= S.nFramePutIndex; ++i)
+    {
+        uint32_t nStart = S.Frames[i % PROFILE_MAX_FRAME_HISTORY].nLogStart[nLogIndex];
+        uint32_t nEnd = i == S.nFramePutIndex ? nPut : S.Frames[(i + 1) % PROFILE_MAX_FRAME_HISTORY].nLogStart[nLogIndex];
+        if (nStart == nEnd)
+            continue;
+
+        uint32_t nRange[2][2] = { { 0, 0 }, { 0, 0 } };
+        ProfileGetRange(nEnd, nStart, nLogSize, nRange);
+        uint32_t nCount0 = nRange[0][1] - nRange[0][0];
+        uint32_t nCount1 = nRange[1][1] - nRange[1][0];
+
+        ProfileLogSpill spill = {};
+        spill.pEntries = static_cast<ProfileLogEntry*>(tf_malloc(sizeof(ProfileLogEntry) * (nCount0 + nCount1)));
+        spill.nCount = nCount0 + nCount1;
+        spill.nFrameIndex = i;
+        memcpy(spill.pEntries, pLog->Log + nRange[0][0], sizeof(ProfileLogEntry) * nCount0);
+        memcpy(spill.pEntries + nCount0, pLog->Log + nRange[1][0], sizeof(ProfileLogEntry) * nCount1);
+        arrpush(pLog->pSpills, spill);
+        S.nMemUsage += sizeof(ProfileLogEntry) * spill.nCount;
+    }
+
+    // What's left of these frames in the log starts at nPut, the views read them as empty for this thread
+    for (uint64_t i = nFirstFrame; i <= S.nFramePutIndex; ++i)
+    {
+        S.Frames[i % PROFILE_MAX_FRAME_HISTORY].nLogStart[nLogIndex] = nPut;
+    }
+    tfrg_atomic32_store_release(&pLog->nGet, nPut);
+    return true;
+}
+
+static void ProfileLogFlushThread(void* pData)
+{
+    UNREF_PARAM(pData);
+    Profile& S = g_Profile;
+    for (;;)
+    {
+        acquireMutex(&S.LogFlushMutex);
+        if (!S.bLogFlushWake && !S.bLogFlushStop)
+            waitConditionVariable(&S.LogFlushCondition, &S.LogFlushMutex, PROFILE_LOG_FLUSH_INTERVAL_MS);
+        bool bStop = S.bLogFlushStop;
+        S.bLogFlushWake = false;
+        releaseMutex(&S.LogFlushMutex);
+
+        if (bStop)
+            break;
+
+        MutexLock lock(ProfileMutex());
+        for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+        {
+            ProfileThreadLog* pLog = S.Pool[i];
+            if (pLog && tfrg_atomic32_load_relaxed(&pLog->nFlushRequest) && ProfileFlushThreadLog(pLog))
+            {
+                tfrg_atomic32_store_relaxed(&pLog->nFlushRequest, 0);
+            }
+        }
+    }
+}
+
+static void ProfileLogFlushStart()
+{
+    Profile& S = g_Profile;
+    if (S.LogFlushThread)
+        return;
+
+    MutexDesc mutexDesc = {};
+    mutexDesc.futex = true;
+    ConditionVariableDesc conditionDesc = {};
+    conditionDesc.futex = true;
+    initMutexDesc(&S.LogFlushMutex, &mutexDesc);
+    initConditionVariableDesc(&S.LogFlushCondition, &conditionDesc);
+    S.bLogFlushWake = false;
+    S.bLogFlushStop = false;
+    ProfileThreadStart(&S.LogFlushThread, ProfileLogFlushThread, "ProfilerLogFlush");
+}
+
+static void ProfileLogFlushStop()
+{
+    Profile& S = g_Profile;
+    if (!S.LogFlushThread)
+        return;
+
+    acquireMutex(&S.LogFlushMutex);
+    S.bLogFlushStop = true;
+    wakeOneConditionVariable(&S.LogFlushCondition);
+    releaseMutex(&S.LogFlushMutex);
+    ProfileThreadJoin(&S.LogFlushThread);
+
+    exitConditionVariable(&S.LogFlushCondition);
+    exitMutex(&S.LogFlushMutex);
+}
+
+// Adds the timers closed by a run of log entries to the frame, returns the new stack depth
+static uint32_t ProfileAccumulateLogEntries(ProfileThreadLog* pLog, const ProfileLogEntry* pEntries, uint32_t nCount, uint32_t nStackPos,
+                                            int64_t* pGroupTicks)
+{
+    Profile&         S = g_Profile;
+    uint8_t*         pTimerToGroup = &S.TimerToGroup[0];
+    uint8_t*         pGroupStackPos = &pLog->nGroupStackPos[0];
+    ProfileLogEntry* pStack = &pLog->nStack[0];
+    int64_t*         pChildTickStack = &pLog->nChildTickStack[0];
+
+    for (uint32_t k = 0; k < nCount; ++k)
+    {
+        ProfileLogEntry LE = pEntries[k];
+        uint64_t        nType = ProfileLogType(LE);
+
+#if PROFILE_SAMPLING
+        // Samples taken before the stack changes belong to the zones open until now
+        if (pLog->pSampleRing && (P_LOG_ENTER == nType || P_LOG_LEAVE == nType))
+        {
+            ProfileSampleAttribute(pLog, LE, nStackPos);
+        }
+#endif
+
+        if (P_LOG_ENTER == nType)
+        {
+            uint64_t nTimer = ProfileLogTimerIndex(LE);
+            uint8_t  nGroup = pTimerToGroup[nTimer];
+            P_ASSERT(nStackPos < PROFILE_STACK_MAX);
+            P_ASSERT(nGroup < PROFILE_MAX_GROUPS);
+            pGroupStackPos[nGroup]++;
+            pStack[nStackPos] = LE;
+            pChildTickStack[nStackPos] = 0;
+            nStackPos++;
+        }
+        else if (P_LOG_META == nType)
+        {
+            if (nStackPos)
+            {
+                int64_t nMetaIndex = ProfileLogTimerIndex(LE);
+                int64_t nMetaCount = ProfileLogGetTick(LE);
+                P_ASSERT(nMetaIndex < PROFILE_META_MAX);
+                int64_t nCounter = ProfileLogTimerIndex(pStack[nStackPos - 1]);
+                S.MetaCounters[nMetaIndex].nCounters[nCounter] += nMetaCount;
+            }
+        }
+        else if (P_LOG_LEAVE == nType)
+        {
+            uint64_t nTimer = ProfileLogTimerIndex(LE);
+            uint8_t  nGroup = pTimerToGroup[nTimer];
+            P_ASSERT(nGroup < PROFILE_MAX_GROUPS);
+            if (nStackPos)
+            {
+                int64_t nTickStart = pStack[nStackPos - 1];
+                int64_t nTicks = ProfileLogTickDifference(nTickStart, LE);
+                int64_t nChildTicks = pChildTickStack[nStackPos];
+                nStackPos--;
+                pChildTickStack[nStackPos] += nTicks;
+
+                if (!pLog->nGpu)
+                {
+                    uint32_t nTimerIndex = (uint32_t)ProfileLogTimerIndex(LE);
+                    S.Frame[nTimerIndex].nTicks += nTicks;
+                    S.FrameExclusive[nTimerIndex] += (nTicks - nChildTicks);
+                    S.Frame[nTimerIndex].nCount += 1;
+                }
+                uint8_t nGroupStackPos = pGroupStackPos[nGroup];
+                if (nGroupStackPos)
+                {
+                    nGroupStackPos--;
+                    if (0 == nGroupStackPos)
+                    {
+                        pGroupTicks[nGroup] += nTicks;
+                    }
+                    pGroupStackPos[nGroup] = nGroupStackPos;
+                }
+            }
+        }
+    }
+    return nStackPos;
+}
+
+void ProfileDumpToFile(Renderer* pRenderer);
+static void ProfileTraceFlip();
+
+void ProfileFlipCpu()
+{
+    MutexLock lock(ProfileMutex());
+
+    Profile& S = g_Profile;
+
+    if (S.nToggleRunning)
+    {
+        S.nRunning = !S.nRunning;
+        if (!S.nRunning)
             S.nPauseTicks = P_TICK();
         S.nToggleRunning = 0;
         for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
@@ -2912,7 +3704,10 @@ void ProfileFlipCpu()
             S.nFlipMax = ProfileMax(S.nFlipMax, nTick);
         }
 
-        uint8_t* pTimerToGroup = &S.TimerToGroup[0];
+        // nFramePutIndex of the frame aggregated below
+        uint64_t nFrameCurrentPutIndex = S.nFramePutIndex > PROFILE_GPU_FRAME_DELAY ? S.nFramePutIndex - PROFILE_GPU_FRAME_DELAY - 1 : 0;
+        bool     bReportDropped = S.nOverflow == 0;
+        bool     bDropped = false;
         for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
         {
             ProfileThreadLog* pLog = S.Pool[i];
@@ -2924,16 +3719,33 @@ void ProfileFlipCpu()
             {
                 uint32_t nPut = tfrg_atomic32_load_acquire(&pLog->nPut);
                 pFramePut->nLogStart[i] = nPut;
-                P_ASSERT(nPut < PROFILE_BUFFER_SIZE);
+                P_ASSERT(nPut < pLog->nLogSize);
                 if (pLog->nGpu && pLog->Log && pFramePut->nFrameStartGpu[i] == 0)
                 {
-                    uint32_t nPreviousPos = (nPut - 1) % PROFILE_BUFFER_SIZE;
+                    uint32_t nPreviousPos = (nPut + pLog->nLogSize - 1) % pLog->nLogSize;
                     pFramePut->nFrameStartGpu[i] = ProfileLogGetTick(pLog->Log[nPreviousPos]);
                 }
                 // need to keep last frame around to close timers. timers more than 1 frame old is ditched.
-                tfrg_atomic32_store_relaxed(&pLog->nGet, nPut);
+                // Logs that flush when near full keep the frames that aren't aggregated yet instead, the flush thread moves them out
+                uint32_t nGet = pLog->bFlushOnNearFull ? pFrameCurrent->nLogStart[i] : nPut;
+                tfrg_atomic32_store_release(&pLog->nGet, nGet);
+                tfrg_atomic32_store_relaxed(&pLog->nFlushRequest, 0);
+
+                uint64_t nDropped = tfrg_atomic64_load_relaxed(&pLog->nDropped);
+                if (nDropped != pLog->nDroppedReported && bReportDropped)
+                {
+                    LOGF(eWARNING, "Profiler log of thread '%s' dropped %llu events, it holds %u entries", pLog->ThreadName,
+                         (unsigned long long)(nDropped - pLog->nDroppedReported), pLog->nLogSize);
+                    pLog->nDroppedReported = nDropped;
+                    bDropped = true;
+                }
             }
         }
+        // Threads keep dropping for as long as the spike lasts, don't warn every frame
+        if (bDropped)
+            S.nOverflow = 100;
+        else if (S.nOverflow)
+            S.nOverflow--;
 
         if (S.nRunning)
         {
@@ -2974,8 +3786,7 @@ void ProfileFlipCpu()
                     if (!pLog)
                         continue;
 
-                    uint8_t* pGroupStackPos = &pLog->nGroupStackPos[0];
-                    int64_t  nGroupTicks[PROFILE_MAX_GROUPS] = { 0 };
+                    int64_t nGroupTicks[PROFILE_MAX_GROUPS] = { 0 };
 
                     uint32_t nPut = pFrameNext->nLogStart[i];
                     uint32_t nGet = pFrameCurrent->nLogStart[i];
@@ -2983,7 +3794,7 @@ void ProfileFlipCpu()
                         { 0, 0 },
                         { 0, 0 },
                     };
-                    ProfileGetRange(nPut, nGet, nRange);
+                    ProfileGetRange(nPut, nGet, pLog->nLogSize, nRange);
 
                     // fetch gpu results.
                     // if (pLog->nGpu)
@@ -3018,75 +3829,30 @@ void ProfileFlipCpu()
                     //	}
                     // }
 
-                    uint32_t* pStack = &pLog->nStack[0];
-                    int64_t*  pChildTickStack = &pLog->nChildTickStack[0];
-                    uint32_t  nStackPos = pLog->nStackPos;
+                    uint32_t nStackPos = pLog->nStackPos;
 
-                    for (uint32_t j = 0; j < 2; ++j)
+                    // Entries the flush thread moved out come first, the rest of the frame is still in the log
+                    for (ptrdiff_t j = 0; j < arrlen(pLog->pSpills) && pLog->pSpills[j].nFrameIndex <= nFrameCurrentPutIndex; ++j)
                     {
-                        uint32_t nStart = nRange[j][0];
-                        uint32_t nEnd = nRange[j][1];
-                        for (uint32_t k = nStart; k < nEnd; ++k)
+                        if (pLog->pSpills[j].nFrameIndex == nFrameCurrentPutIndex)
                         {
-                            ProfileLogEntry LE = pLog->Log[k];
-                            uint64_t        nType = ProfileLogType(LE);
-
-                            if (P_LOG_ENTER == nType)
-                            {
-                                uint64_t nTimer = ProfileLogTimerIndex(LE);
-                                uint8_t  nGroup = pTimerToGroup[nTimer];
-                                P_ASSERT(nStackPos < PROFILE_STACK_MAX);
-                                P_ASSERT(nGroup < PROFILE_MAX_GROUPS);
-                                pGroupStackPos[nGroup]++;
-                                pStack[nStackPos] = k;
-                                pChildTickStack[nStackPos] = 0;
-                                nStackPos++;
-                            }
-                            else if (P_LOG_META == nType)
-                            {
-                                if (nStackPos)
-                                {
-                                    int64_t nMetaIndex = ProfileLogTimerIndex(LE);
-                                    int64_t nMetaCount = ProfileLogGetTick(LE);
-                                    P_ASSERT(nMetaIndex < PROFILE_META_MAX);
-                                    int64_t nCounter = ProfileLogTimerIndex(pLog->Log[pStack[nStackPos - 1]]);
-                                    S.MetaCounters[nMetaIndex].nCounters[nCounter] += nMetaCount;
-                                }
-                            }
-                            else if (P_LOG_LEAVE == nType)
-                            {
-                                uint64_t nTimer = ProfileLogTimerIndex(LE);
-                                uint8_t  nGroup = pTimerToGroup[nTimer];
-                                P_ASSERT(nGroup < PROFILE_MAX_GROUPS);
-                                if (nStackPos)
-                                {
-                                    int64_t nTickStart = pLog->Log[pStack[nStackPos - 1]];
-                                    int64_t nTicks = ProfileLogTickDifference(nTickStart, LE);
-                                    int64_t nChildTicks = pChildTickStack[nStackPos];
-                                    nStackPos--;
-                                    pChildTickStack[nStackPos] += nTicks;
-
-                                    if (!pLog->nGpu)
-                                    {
-                                        uint32_t nTimerIndex = (uint32_t)ProfileLogTimerIndex(LE);
-                                        S.Frame[nTimerIndex].nTicks += nTicks;
-                                        S.FrameExclusive[nTimerIndex] += (nTicks - nChildTicks);
-                                        S.Frame[nTimerIndex].nCount += 1;
-                                    }
-                                    uint8_t nGroupStackPos = pGroupStackPos[nGroup];
-                                    if (nGroupStackPos)
-                                    {
-                                        nGroupStackPos--;
-                                        if (0 == nGroupStackPos)
-                                        {
-                                            nGroupTicks[nGroup] += nTicks;
-                                        }
-                                        pGroupStackPos[nGroup] = nGroupStackPos;
-                                    }
-                                }
-                            }
+                            nStackPos = ProfileAccumulateLogEntries(pLog, pLog->pSpills[j].pEntries, pLog->pSpills[j].nCount, nStackPos,
+                                                                    nGroupTicks);
                         }
                     }
+                    ProfileReleaseLogSpills(pLog, nFrameCurrentPutIndex);
+
+                    for (uint32_t j = 0; j < 2; ++j)
+                    {
+                        nStackPos = ProfileAccumulateLogEntries(pLog, pLog->Log + nRange[j][0], nRange[j][1] - nRange[j][0], nStackPos,
+                                                                nGroupTicks);
+                    }
+#if PROFILE_SAMPLING
+                    if (pLog->pSampleRing)
+                    {
+                        ProfileSampleAttribute(pLog, nFrameEndCpu, nStackPos);
+                    }
+#endif
                     for (uint32_t k = 0; k < PROFILE_MAX_GROUPS; ++k)
                     {
                         pLog->nGroupTicks[k] += nGroupTicks[k];
@@ -3148,6 +3914,12 @@ void ProfileFlipCpu()
             S.nGraphPut = (S.nGraphPut + 1) % PROFILE_GRAPH_HISTORY;
         }
 
+        if (S.nRunning)
+        {
+            PROFILER_SET_CPU_SCOPE("Profile", "Trace", 0x3355ee);
+            ProfileTraceFlip();
+        }
+
         if (S.nRunning && S.nAggregateFlip <= ++S.nAggregateFlipCount)
         {
             nAggregateFlip = 1;
@@ -3270,6 +4042,9 @@ void flipProfiler()
 {
     PROFILER_SET_CPU_SCOPE("Profile", "ProfileFlip", 0x3355ee);
 
+#if defined(ENABLE_MEMORY_TAGS)
+    profileUpdateMemoryTagCounters();
+#endif
     ProfileFlipCpu();
 }
 
@@ -3513,6 +4288,28 @@ float getCpuProfileTime(const char* pGroup, const char* pName, ThreadID* pThread
     return S.Frame[nTimerIndex].nTicks * fToMs;
 }
 
+void initProfilerThread(const ProfilerThreadDesc* pDesc)
+{
+    ASSERT(pDesc);
+    ProfileOnThreadCreateEx(pDesc->pThreadName, pDesc->mLogSize, pDesc->mFlushOnNearFull);
+}
+
+uint64_t getCpuProfileDroppedEvents(ThreadID* pThreadID)
+{
+    MutexLock lock(ProfileMutex());
+    Profile&  S = g_Profile;
+    uint64_t  nDropped = 0;
+    for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+    {
+        ProfileThreadLog* pLog = S.Pool[i];
+        if (pLog && !pLog->nGpu && (!pThreadID || pLog->nThreadId == *pThreadID))
+        {
+            nDropped += tfrg_atomic64_load_relaxed(&pLog->nDropped);
+        }
+    }
+    return nDropped;
+}
+
 float getCpuMinFrameTime()
 {
     float    fToMs = ProfileTickToMsMultiplier(ProfileTicksPerSecondCpu());
@@ -3943,12 +4740,13 @@ void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, cons
     }
     ProfilePrintString(CB, Handle, "];\n\n");
 
+    // Matched against the context switch thread ids, gpu logs have no cpu to run on
     ProfilePrintString(CB, Handle, "\nvar ThreadIds = [");
     for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
     {
         if (!S.Pool[i])
             continue;
-        ProfilePrintUIntComma(CB, Handle, i);
+        ProfilePrintUIntComma(CB, Handle, S.Pool[i]->nGpu ? 0 : S.Pool[i]->nSystemThreadId);
     }
     ProfilePrintString(CB, Handle, "];\n\n");
 
@@ -4076,7 +4874,7 @@ void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, cons
             uint32_t          nLogEnd = S.Frames[nFrameIndexNext].nLogStart[j];
 
             ProfilePrintString(CB, Handle, "[");
-            for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % PROFILE_BUFFER_SIZE)
+            for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % pLog->nLogSize)
             {
                 uint32_t nLogType = (uint32_t)ProfileLogType(pLog->Log[k]);
                 if (nLogType == P_LOG_META)
@@ -4112,7 +4910,7 @@ void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, cons
             //	ProfilePrintf(CB, Handle, "MakeTimesExtra(%e,%e,tt%d[%d],[", fToMs, fToMsCPU, i, j);
             // else
             ProfilePrintf(CB, Handle, "MakeTimes(%e,[", fToMs);
-            for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % PROFILE_BUFFER_SIZE)
+            for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % pLog->nLogSize)
             {
                 uint32_t nLogType = (uint32_t)ProfileLogType(pLog->Log[k]);
                 uint64_t nTick = (nLogType == P_LOG_ENTER || nLogType == P_LOG_LEAVE) ? ProfileLogTickDifference(nStartTick, pLog->Log[k])
@@ -4135,7 +4933,7 @@ void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, cons
 
             uint32_t nLabelIndex = 0;
             ProfilePrintString(CB, Handle, "[");
-            for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % PROFILE_BUFFER_SIZE)
+            for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % pLog->nLogSize)
             {
                 uint32_t nLogType = (uint32_t)ProfileLogType(pLog->Log[k]);
                 uint32_t nTimerIndex = (uint32_t)ProfileLogTimerIndex(pLog->Log[k]);
@@ -4163,7 +4961,7 @@ void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, cons
             uint32_t nLogEnd = S.Frames[nFrameIndexNext].nLogStart[j];
 
             ProfilePrintString(CB, Handle, "[");
-            for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % PROFILE_BUFFER_SIZE)
+            for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % pLog->nLogSize)
             {
                 uint32_t nLogType = (uint32_t)ProfileLogType(pLog->Log[k]);
                 if (nLogType == P_LOG_LABEL || nLogType == P_LOG_LABEL_LITERAL)
@@ -4220,8 +5018,8 @@ void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, cons
     {
         ProfileContextSwitch CS = S.ContextSwitch[j];
         int                  nCpu = CS.nCpu;
-        ProfilePrintUIntComma(CB, Handle, 0);
-        ProfilePrintUIntComma(CB, Handle, 0);
+        ProfilePrintUIntComma(CB, Handle, CS.nThreadIn);
+        ProfilePrintUIntComma(CB, Handle, CS.nThreadOut);
         ProfilePrintUIntComma(CB, Handle, nCpu);
     }
     ProfilePrintString(CB, Handle, "];\n");
@@ -4355,141 +5153,1097 @@ void ProfileWriteFile(void* Handle, size_t nSize, const char* pData)
     }
 }
 
-void ProfileDumpToFile(Renderer* pRenderer)
-{
-    UNREF_PARAM(pRenderer);
-    if (!g_Profile.nRunning)
-        return;
+/////////////////////////////////////////////////////////////////////////////
+// TRACE EXPORT
+//
+// Streams completed frames to Chrome Trace Event JSON (chrome://tracing, ui.perfetto.dev) or Perfetto protobuf.
+// Every frame is written from the thread logs while ProfileFlipCpu finalizes it, so only the open file buffer
+// is kept around no matter how long the capture runs.
+// GPU timers are placed relative to the frame start, the same way the detailed view aligns them.
+
+#define PROFILE_TRACE_MAX_HISTORY_FRAMES (PROFILE_MAX_FRAME_HISTORY - PROFILE_GPU_FRAME_DELAY - 3) // same margin as the html dump
+#define PROFILE_TRACE_PROTO_BUFFER_SIZE  1024
+#define PROFILE_TRACE_FILE_NAME_MAX_LEN  256
+
+// Perfetto track uuids, also used as Chrome Trace thread ids
+#define PROFILE_TRACE_UUID_PROCESS 1
+#define PROFILE_TRACE_UUID_FRAMES  2
+#define PROFILE_TRACE_UUID_COUNTER 0x1000 // + counter index
+#define PROFILE_TRACE_UUID_THREAD  0x2000 // + thread log index + PROFILE_MAX_THREADS * generation
+
+// Field numbers from perfetto/protos/perfetto/trace/trace_packet.proto and friends
+enum ProfileTraceProto
+{
+    PROTO_TRACE_PACKET = 1,
+
+    PROTO_PACKET_TIMESTAMP = 8,
+    PROTO_PACKET_SEQUENCE_ID = 10,
+    PROTO_PACKET_TRACK_EVENT = 11,
+    PROTO_PACKET_INTERNED_DATA = 12,
+    PROTO_PACKET_SEQUENCE_FLAGS = 13,
+    PROTO_PACKET_TRACK_DESCRIPTOR = 60,
+
+    PROTO_SEQUENCE_INCREMENTAL_STATE_CLEARED = 1,
+    PROTO_SEQUENCE_NEEDS_INCREMENTAL_STATE = 2,
+
+    PROTO_TRACK_UUID = 1,
+    PROTO_TRACK_NAME = 2,
+    PROTO_TRACK_PROCESS = 3,
+    PROTO_TRACK_THREAD = 4,
+    PROTO_TRACK_PARENT_UUID = 5,
+    PROTO_TRACK_COUNTER = 8,
+
+    PROTO_PROCESS_PID = 1,
+    PROTO_PROCESS_NAME = 6,
+
+    PROTO_THREAD_PID = 1,
+    PROTO_THREAD_TID = 2,
+    PROTO_THREAD_NAME = 5,
+
+    PROTO_COUNTER_UNIT = 3,
+    PROTO_COUNTER_UNIT_COUNT = 2,
+    PROTO_COUNTER_UNIT_SIZE_BYTES = 3,
+
+    PROTO_EVENT_TYPE = 9,
+    PROTO_EVENT_NAME_IID = 10,
+    PROTO_EVENT_TRACK_UUID = 11,
+    PROTO_EVENT_NAME = 23,
+    PROTO_EVENT_COUNTER_VALUE = 30,
+
+    PROTO_EVENT_TYPE_SLICE_BEGIN = 1,
+    PROTO_EVENT_TYPE_SLICE_END = 2,
+    PROTO_EVENT_TYPE_INSTANT = 3,
+    PROTO_EVENT_TYPE_COUNTER = 4,
+
+    PROTO_INTERNED_EVENT_NAMES = 2,
+    PROTO_EVENT_NAME_ENTRY_IID = 1,
+    PROTO_EVENT_NAME_ENTRY_NAME = 2,
+
+    PROTO_SEQUENCE_ID = 1,
+};
 
-    MutexLock lock(ProfileMutex());
-    Profile&  S = g_Profile;
+struct ProfileTraceState
+{
+    ProfileWriteFileData File;
+    char                 FileName[PROFILE_TRACE_FILE_NAME_MAX_LEN];
+    ProfileTraceFormat   eFormat;
+    bool                 bActive;
+    uint32_t             nFramesLeft; // 0 when capturing until stopProfileTrace
+    uint64_t             nFrameCount;
+    uint32_t             nEventCount;
+    uint32_t             nProcessId;
+    int64_t              nBaseTick;
+    double               fCpuToNs;
+
+    ProfileThreadLog* pThreadLogs[PROFILE_MAX_THREADS];
+    uint64_t          nThreadUuid[PROFILE_MAX_THREADS];
+    uint32_t          nThreadGeneration;
+    uint32_t          nStackDepth[PROFILE_MAX_THREADS];
+    uint64_t          nLastTime[PROFILE_MAX_THREADS];
+    int64_t           nGpuBaseTick[PROFILE_MAX_THREADS];
+    uint64_t          nGpuBaseTime[PROFILE_MAX_THREADS];
+    double            fGpuToNs[PROFILE_MAX_THREADS];
+
+    uint32_t nCounterCount;
+    int64_t  nCounterValue[PROFILE_MAX_COUNTERS];
+    uint64_t nInternedTimers[(PROFILE_MAX_TIMERS + 63) / 64];
+
+    // Frame time trigger
+    bool               bTriggerArmed;
+    char               TriggerAppName[PROFILE_TRACE_FILE_NAME_MAX_LEN];
+    ProfileTraceFormat eTriggerFormat;
+    float              fTriggerMs;
+    uint32_t           nTriggerFramesBefore;
+    uint32_t           nTriggerFramesAfter;
+};
 
-    ProfileWriteFileData data = {};
-    data.mBuffer = bempty();
-    if (fsOpenStreamFromPath(RD_LOG, S.DumpFile, FM_WRITE, &data.mStream))
-    {
-        if (S.eDumpType == ProfileDumpTypeHtml)
-            ProfileDumpHtml(ProfileWriteFile, &data, S.nDumpFrames, 0);
-        else if (S.eDumpType == ProfileDumpTypeCsv)
-            ProfileDumpCsv(ProfileWriteFile, &data, S.nDumpFrames);
+static ProfileTraceState gProfileTrace;
 
-        ProfileWriteFileFlush(&data);
-        fsCloseStream(&data.mStream);
-    }
-    bdestroy(&data.mBuffer);
+struct ProfileProtoBuffer
+{
+    uint8_t  Data[PROFILE_TRACE_PROTO_BUFFER_SIZE];
+    uint32_t nSize;
+};
+
+static void ProfileProtoVarint(ProfileProtoBuffer* pBuffer, uint64_t nValue)
+{
+    P_ASSERT(pBuffer->nSize + 10 <= sizeof(pBuffer->Data));
+    do
+    {
+        uint8_t nByte = nValue & 0x7f;
+        nValue >>= 7;
+        pBuffer->Data[pBuffer->nSize++] = nByte | (nValue ? 0x80 : 0);
+    } while (nValue);
 }
 
-void dumpProfileData(const char* appName, uint32_t nMaxFrames)
+static void ProfileProtoUint(ProfileProtoBuffer* pBuffer, uint32_t nField, uint64_t nValue)
 {
-    if (!g_Profile.nRunning)
-        return;
+    ProfileProtoVarint(pBuffer, (uint64_t)nField << 3);
+    ProfileProtoVarint(pBuffer, nValue);
+}
 
-    MutexLock lock(ProfileMutex());
+static void ProfileProtoBytes(ProfileProtoBuffer* pBuffer, uint32_t nField, const void* pData, uint32_t nSize)
+{
+    ProfileProtoVarint(pBuffer, ((uint64_t)nField << 3) | 2);
+    // Strings are truncated instead of overflowing, the nested messages written by this file always fit
+    uint32_t nSpace = (uint32_t)sizeof(pBuffer->Data) - pBuffer->nSize - 10;
+    nSize = ProfileMin(nSize, nSpace);
+    ProfileProtoVarint(pBuffer, nSize);
+    memcpy(&pBuffer->Data[pBuffer->nSize], pData, nSize);
+    pBuffer->nSize += nSize;
+}
 
-    // Dump frames to file.
-    time_t t = time(0);
+static void ProfileProtoString(ProfileProtoBuffer* pBuffer, uint32_t nField, const char* pString)
+{
+    ProfileProtoBytes(pBuffer, nField, pString, (uint32_t)strlen(pString));
+}
 
-    char   time[64];
-    size_t timeLen = strftime(time, sizeof(time), R"(Profile-%Y-%m-%d-%H.%M.%S.html)", localtime(&t));
-    ASSERT(timeLen < 64);
+static void ProfileProtoMessage(ProfileProtoBuffer* pBuffer, uint32_t nField, const ProfileProtoBuffer* pMessage)
+{
+    ProfileProtoBytes(pBuffer, nField, pMessage->Data, pMessage->nSize);
+}
 
-    char name[256] = {};
-    snprintf(name, sizeof(name), "%s%s", appName, time);
-    ProfileWriteFileData data = {};
-    data.mBuffer = bempty();
-    if (fsOpenStreamFromPath(RD_LOG, name, FM_WRITE, &data.mStream))
+// Trace is a repeated TracePacket, so packets can be appended one at a time
+static void ProfileTraceWritePacket(ProfileProtoBuffer* pPacket)
+{
+    ProfileTraceState& T = gProfileTrace;
+    ProfileProtoUint(pPacket, PROTO_PACKET_SEQUENCE_ID, PROTO_SEQUENCE_ID);
+    if (!T.nEventCount++)
     {
-        ProfileDumpHtml(ProfileWriteFile, &data, nMaxFrames, 0);
-        ProfileWriteFileFlush(&data);
-        fsCloseStream(&data.mStream);
+        ProfileProtoUint(pPacket, PROTO_PACKET_SEQUENCE_FLAGS, PROTO_SEQUENCE_INCREMENTAL_STATE_CLEARED);
     }
-    bdestroy(&data.mBuffer);
+
+    ProfileProtoBuffer Header = {};
+    ProfileProtoVarint(&Header, ((uint64_t)PROTO_TRACE_PACKET << 3) | 2);
+    ProfileProtoVarint(&Header, pPacket->nSize);
+    ProfileWriteFile(&T.File, Header.nSize, (const char*)Header.Data);
+    ProfileWriteFile(&T.File, pPacket->nSize, (const char*)pPacket->Data);
 }
 
-void dumpBenchmarkData(IApp::Settings* pSettings, const char* outFilename, const char* appName)
+static void ProfileTraceWriteTrackDescriptor(const ProfileProtoBuffer* pTrack)
 {
-    if (!g_Profile.nRunning)
-        return;
-
-    time_t        t = time(0);
-    unsigned char nameBuf[256];
-    bstring       name = bemptyfromarr(nameBuf);
-    bformat(&name, "%s", outFilename);
-
-    char   time[64];
-    // bstrlib doesn't have strftime
-    size_t timeLen = strftime(time, sizeof(time), R"(Benchmark-%Y-%m-%d-%H.%M.%S.profile)", localtime(&t));
-    ASSERT(timeLen < 64);
-    bcatblk(&name, time, (int)timeLen);
+    ProfileProtoBuffer Packet = {};
+    ProfileProtoMessage(&Packet, PROTO_PACKET_TRACK_DESCRIPTOR, pTrack);
+    ProfileTraceWritePacket(&Packet);
+}
 
-    FileStream statsFile = {};
-    if (fsOpenStreamFromPath(RD_LOG, (const char*)name.data, FM_WRITE, &statsFile))
+static void ProfileTraceWriteTrackEvent(uint64_t nTime, const ProfileProtoBuffer* pEvent, const ProfileProtoBuffer* pInternedData)
+{
+    ProfileProtoBuffer Packet = {};
+    ProfileProtoUint(&Packet, PROTO_PACKET_TIMESTAMP, nTime);
+    ProfileProtoMessage(&Packet, PROTO_PACKET_TRACK_EVENT, pEvent);
+    if (pInternedData)
     {
-        bstring output = bempty();
-        balloc(&output, 2048);
-
-        bassignliteral(&output, "{\n");
-
-        bformata(&output, "\"Application\": \"%s\", \n", appName);
-        bformata(&output, "\"Width\": %d, \n", pSettings->mWidth);
-        bformata(&output, "\"Height\": %d, \n\n", pSettings->mHeight);
-        bformata(&output, "\"GpuName\": \"%s\", \n", g_Profile.pGpuDesc->mGpuVendorPreset.mGpuName);
-        bformata(&output, "\"VendorID\": \"%#x\", \n", g_Profile.pGpuDesc->mGpuVendorPreset.mVendorId);
-        bformata(&output, "\"ModelID\": \"%#x\", \n\n", g_Profile.pGpuDesc->mGpuVendorPreset.mModelId);
+        ProfileProtoMessage(&Packet, PROTO_PACKET_INTERNED_DATA, pInternedData);
+    }
+    ProfileProtoUint(&Packet, PROTO_PACKET_SEQUENCE_FLAGS, PROTO_SEQUENCE_NEEDS_INCREMENTAL_STATE);
+    ProfileTraceWritePacket(&Packet);
+}
 
-        const Profile& S = *ProfileGet();
-        for (uint32_t groupIndex = 0; groupIndex < S.nGroupCount; ++groupIndex)
+static const char* ProfileTraceJsonEscape(const char* pString, char* pOut, uint32_t nOutSize)
+{
+    uint32_t nPos = 0;
+    for (; *pString && nPos + 7 < nOutSize; ++pString)
+    {
+        unsigned char c = (unsigned char)*pString;
+        if (c == '"' || c == '\\')
         {
-            if (S.GroupInfo[groupIndex].Type != ProfileTokenTypeGpu)
-                continue;
-
-            for (uint32_t timerIndex = 0; timerIndex < S.nTotalTimers; ++timerIndex)
-            {
-                if (strcmp(S.TimerInfo[timerIndex].pName, S.GroupInfo[groupIndex].pName) == 0)
-                {
-                    bformata(&output, "\"%s\": { \n", S.GroupInfo[groupIndex].pName);
-
-                    float    fToMs = ProfileTickToMsMultiplier(getGpuProfileTicksPerSecond(S.GroupInfo[groupIndex].nGpuProfileToken));
-                    uint32_t nAggregateFrames = S.nAggregateFrames ? S.nAggregateFrames : 1;
-                    uint32_t nAggregateCount = S.Aggregate[timerIndex].nCount ? S.Aggregate[timerIndex].nCount : 1;
-                    float    fAverage = fToMs * (float)(S.Aggregate[timerIndex].nTicks / nAggregateFrames);
-                    float    fMax = fToMs * (S.AggregateMax[timerIndex]);
-                    float    fMin = fToMs * (S.AggregateMin[timerIndex]);
-
-                    bformata(&output, "\"Average\": %0.4f, \n", fAverage);
-                    bformata(&output, "\"Min\": %0.4f, \n", fMin);
-                    bformata(&output, "\"Max\": %0.4f, \n", fMax);
-                    bformata(&output, "\"Frames\": %d \n", nAggregateCount);
-                    bformata(&output, "}, \n\n");
-                    break;
-                }
-            }
+            pOut[nPos++] = '\\';
+            pOut[nPos++] = (char)c;
+        }
+        else if (c < 0x20)
+        {
+            nPos += snprintf(&pOut[nPos], nOutSize - nPos, "\\u%04x", c);
+        }
+        else
+        {
+            pOut[nPos++] = (char)c;
         }
+    }
+    pOut[nPos] = '\0';
+    return pOut;
+}
 
-        bformata(&output, "\"Cpu\": { \n");
-        bformata(&output, "\"Average\": %0.4f, \n", getCpuAvgFrameTime());
-        bformata(&output, "\"Min\": %0.4f, \n", getCpuMinFrameTime());
-        bformata(&output, "\"Max\": %0.4f, \n", getCpuMaxFrameTime());
-        bformata(&output, "\"Frames\": %d \n", S.nAggregateFrames);
-        bformata(&output, "} \n");
-        bformata(&output, "}");
+PROFILE_FORMAT(1, 2) static void ProfileTraceJsonEvent(const char* pFmt, ...)
+{
+    ProfileTraceState& T = gProfileTrace;
+    char               Buffer[1024];
+    va_list            args;
+    va_start(args, pFmt);
+    int nSize = vsnprintf(Buffer, sizeof(Buffer), pFmt, args);
+    va_end(args);
+    nSize = ProfileClamp(nSize, 0, (int)sizeof(Buffer) - 1);
 
-        fsWriteToStream(&statsFile, (const char*)output.data, (size_t)output.slen * sizeof(char));
-        fsCloseStream(&statsFile);
-        bdestroy(&output);
+    // Array format, the closing bracket is optional so a capture cut short by a crash still loads
+    if (T.nEventCount++)
+    {
+        ProfileWriteFile(&T.File, 2, ",\n");
     }
+    ProfileWriteFile(&T.File, (size_t)nSize, Buffer);
 }
 
-#ifdef ENABLE_PROFILER_WEBSERVER
-uint32_t ProfileWebServerPort()
+static uint64_t ProfileTraceCpuTime(int64_t nTick)
 {
-    Profile& S = g_Profile;
-    return S.nWebServerPort;
+    ProfileTraceState& T = gProfileTrace;
+    int64_t            nTicks = ProfileLogTickDifference(T.nBaseTick, nTick);
+    return nTicks > 0 ? (uint64_t)(nTicks * T.fCpuToNs) : 0;
 }
 
-void ProfileSendSocket(MpSocket Socket, const char* pData, size_t nSize)
+static void ProfileTraceCounterName(uint32_t nCounter, char* pOut, uint32_t nOutSize)
 {
-#ifdef MSG_NOSIGNAL
+    Profile& S = g_Profile;
+
+    const char* pNames[PROFILE_STACK_MAX];
+    uint32_t    nDepth = 0;
+    for (int nIndex = (int)nCounter; nIndex >= 0 && nDepth < PROFILE_STACK_MAX; nIndex = S.CounterInfo[nIndex].nParent)
+    {
+        pNames[nDepth++] = S.CounterInfo[nIndex].pName;
+    }
+
+    uint32_t nPos = 0;
+    pOut[0] = '\0';
+    while (nDepth-- && nPos < nOutSize)
+    {
+        nPos += snprintf(&pOut[nPos], nOutSize - nPos, "%s%s", nPos ? "/" : "", pNames[nDepth]);
+    }
+}
+
+static void ProfileTraceThreadTrack(uint32_t nLogIndex, ProfileThreadLog* pLog)
+{
+    ProfileTraceState& T = gProfileTrace;
+
+    T.pThreadLogs[nLogIndex] = pLog;
+    T.nThreadUuid[nLogIndex] = PROFILE_TRACE_UUID_THREAD + nLogIndex + (uint64_t)PROFILE_MAX_THREADS * T.nThreadGeneration++;
+    T.nStackDepth[nLogIndex] = 0;
+    T.nLastTime[nLogIndex] = 0;
+    T.fGpuToNs[nLogIndex] = 0.0;
+
+    if (T.eFormat == PROFILE_TRACE_FORMAT_CHROME_JSON)
+    {
+        char Name[PROFILE_NAME_MAX_LEN * 2];
+        ProfileTraceJsonEscape(pLog->ThreadName, Name, sizeof(Name));
+        ProfileTraceJsonEvent("{\"ph\":\"M\",\"pid\":%u,\"tid\":%llu,\"name\":\"thread_name\",\"args\":{\"name\":\"%s%s\"}}", T.nProcessId,
+                              (unsigned long long)T.nThreadUuid[nLogIndex], pLog->nGpu ? "GPU: " : "", Name);
+        return;
+    }
+
+    ProfileProtoBuffer Track = {};
+    ProfileProtoUint(&Track, PROTO_TRACK_UUID, T.nThreadUuid[nLogIndex]);
+    if (pLog->nGpu)
+    {
+        char Name[PROFILE_NAME_MAX_LEN + 8];
+        snprintf(Name, sizeof(Name), "GPU: %s", pLog->ThreadName);
+        ProfileProtoString(&Track, PROTO_TRACK_NAME, Name);
+        ProfileProtoUint(&Track, PROTO_TRACK_PARENT_UUID, PROFILE_TRACE_UUID_PROCESS);
+    }
+    else
+    {
+        ProfileProtoBuffer Thread = {};
+        ProfileProtoUint(&Thread, PROTO_THREAD_PID, T.nProcessId);
+        ProfileProtoUint(&Thread, PROTO_THREAD_TID, (uint32_t)T.nThreadUuid[nLogIndex]);
+        ProfileProtoString(&Thread, PROTO_THREAD_NAME, pLog->ThreadName);
+        ProfileProtoMessage(&Track, PROTO_TRACK_THREAD, &Thread);
+    }
+    ProfileTraceWriteTrackDescriptor(&Track);
+}
+
+static void ProfileTraceSlice(uint32_t nLogIndex, uint64_t nTime, bool bBegin, uint32_t nTimerIndex)
+{
+    ProfileTraceState& T = gProfileTrace;
+    Profile&           S = g_Profile;
+
+    T.nLastTime[nLogIndex] = ProfileMax(T.nLastTime[nLogIndex], nTime);
+
+    if (T.eFormat == PROFILE_TRACE_FORMAT_CHROME_JSON)
+    {
+        if (bBegin)
+        {
+            char Name[PROFILE_NAME_MAX_LEN * 2];
+            char Group[PROFILE_NAME_MAX_LEN * 2];
+            ProfileTraceJsonEscape(S.TimerInfo[nTimerIndex].pName, Name, sizeof(Name));
+            ProfileTraceJsonEscape(S.GroupInfo[S.TimerInfo[nTimerIndex].nGroupIndex].pName, Group, sizeof(Group));
+            ProfileTraceJsonEvent("{\"ph\":\"B\",\"pid\":%u,\"tid\":%llu,\"ts\":%.3f,\"name\":\"%s\",\"cat\":\"%s\"}", T.nProcessId,
+                                  (unsigned long long)T.nThreadUuid[nLogIndex], nTime / 1000.0, Name, Group);
+        }
+        else
+        {
+            ProfileTraceJsonEvent("{\"ph\":\"E\",\"pid\":%u,\"tid\":%llu,\"ts\":%.3f}", T.nProcessId,
+                                  (unsigned long long)T.nThreadUuid[nLogIndex], nTime / 1000.0);
+        }
+        return;
+    }
+
+    ProfileProtoBuffer  Event = {};
+    ProfileProtoBuffer  InternedData = {};
+    ProfileProtoBuffer* pInternedData = NULL;
+    ProfileProtoUint(&Event, PROTO_EVENT_TYPE, bBegin ? PROTO_EVENT_TYPE_SLICE_BEGIN : PROTO_EVENT_TYPE_SLICE_END);
+    ProfileProtoUint(&Event, PROTO_EVENT_TRACK_UUID, T.nThreadUuid[nLogIndex]);
+    if (bBegin)
+    {
+        // Timer names are interned, the first event using a timer carries its name
+        uint64_t nBit = 1ull << (nTimerIndex % 64);
+        if (!(T.nInternedTimers[nTimerIndex / 64] & nBit))
+        {
+            T.nInternedTimers[nTimerIndex / 64] |= nBit;
+            ProfileProtoBuffer Name = {};
+            ProfileProtoUint(&Name, PROTO_EVENT_NAME_ENTRY_IID, nTimerIndex + 1);
+            ProfileProtoString(&Name, PROTO_EVENT_NAME_ENTRY_NAME, S.TimerInfo[nTimerIndex].pName);
+            ProfileProtoMessage(&InternedData, PROTO_INTERNED_EVENT_NAMES, &Name);
+            pInternedData = &InternedData;
+        }
+        ProfileProtoUint(&Event, PROTO_EVENT_NAME_IID, nTimerIndex + 1);
+    }
+    ProfileTraceWriteTrackEvent(nTime, &Event, pInternedData);
+}
+
+static void ProfileTraceInstant(uint32_t nLogIndex, uint64_t nTime, const char* pName)
+{
+    ProfileTraceState& T = gProfileTrace;
+
+    if (T.eFormat == PROFILE_TRACE_FORMAT_CHROME_JSON)
+    {
+        char Name[PROFILE_LABEL_MAX_LEN * 2];
+        ProfileTraceJsonEscape(pName, Name, sizeof(Name));
+        ProfileTraceJsonEvent("{\"ph\":\"i\",\"s\":\"t\",\"pid\":%u,\"tid\":%llu,\"ts\":%.3f,\"name\":\"%s\"}", T.nProcessId,
+                              (unsigned long long)T.nThreadUuid[nLogIndex], nTime / 1000.0, Name);
+        return;
+    }
+
+    ProfileProtoBuffer Event = {};
+    ProfileProtoUint(&Event, PROTO_EVENT_TYPE, PROTO_EVENT_TYPE_INSTANT);
+    ProfileProtoUint(&Event, PROTO_EVENT_TRACK_UUID, T.nThreadUuid[nLogIndex]);
+    ProfileProtoString(&Event, PROTO_EVENT_NAME, pName);
+    ProfileTraceWriteTrackEvent(nTime, &Event, NULL);
+}
+
+static void ProfileTraceCounters(uint64_t nTime)
+{
+    ProfileTraceState& T = gProfileTrace;
+    Profile&           S = g_Profile;
+
+    for (uint32_t i = 0; i < S.nNumCounters; ++i)
+    {
+        int64_t nValue = tfrg_atomic64_load_relaxed(&S.Counters[i]);
+        bool    bNew = i >= T.nCounterCount;
+        if (!bNew && nValue == T.nCounterValue[i])
+        {
+            continue;
+        }
+        T.nCounterValue[i] = nValue;
+
+        char Name[PROFILE_TRACE_FILE_NAME_MAX_LEN];
+        ProfileTraceCounterName(i, Name, sizeof(Name));
+
+        if (T.eFormat == PROFILE_TRACE_FORMAT_CHROME_JSON)
+        {
+            char Escaped[PROFILE_TRACE_FILE_NAME_MAX_LEN * 2];
+            ProfileTraceJsonEscape(Name, Escaped, sizeof(Escaped));
+            ProfileTraceJsonEvent("{\"ph\":\"C\",\"pid\":%u,\"ts\":%.3f,\"name\":\"%s\",\"args\":{\"value\":%lld}}", T.nProcessId,
+                                  nTime / 1000.0, Escaped, (long long)nValue);
+            continue;
+        }
+
+        if (bNew)
+        {
+            ProfileProtoBuffer Counter = {};
+            ProfileProtoUint(&Counter, PROTO_COUNTER_UNIT,
+                             S.CounterInfo[i].eFormat == PROFILE_COUNTER_FORMAT_BYTES ? PROTO_COUNTER_UNIT_SIZE_BYTES
+                                                                                      : PROTO_COUNTER_UNIT_COUNT);
+            ProfileProtoBuffer Track = {};
+            ProfileProtoUint(&Track, PROTO_TRACK_UUID, PROFILE_TRACE_UUID_COUNTER + i);
+            ProfileProtoString(&Track, PROTO_TRACK_NAME, Name);
+            ProfileProtoUint(&Track, PROTO_TRACK_PARENT_UUID, PROFILE_TRACE_UUID_PROCESS);
+            ProfileProtoMessage(&Track, PROTO_TRACK_COUNTER, &Counter);
+            ProfileTraceWriteTrackDescriptor(&Track);
+        }
+
+        ProfileProtoBuffer Event = {};
+        ProfileProtoUint(&Event, PROTO_EVENT_TYPE, PROTO_EVENT_TYPE_COUNTER);
+        ProfileProtoUint(&Event, PROTO_EVENT_TRACK_UUID, PROFILE_TRACE_UUID_COUNTER + i);
+        ProfileProtoUint(&Event, PROTO_EVENT_COUNTER_VALUE, (uint64_t)nValue);
+        ProfileTraceWriteTrackEvent(nTime, &Event, NULL);
+    }
+    T.nCounterCount = ProfileMax(T.nCounterCount, S.nNumCounters);
+}
+
+static void ProfileTraceFrameSlice(uint64_t nStart, uint64_t nEnd)
+{
+    ProfileTraceState& T = gProfileTrace;
+
+    char Name[32];
+    snprintf(Name, sizeof(Name), "Frame %llu", (unsigned long long)T.nFrameCount++);
+
+    if (T.eFormat == PROFILE_TRACE_FORMAT_CHROME_JSON)
+    {
+        ProfileTraceJsonEvent("{\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"%s\"}", T.nProcessId,
+                              PROFILE_TRACE_UUID_FRAMES, nStart / 1000.0, (nEnd - nStart) / 1000.0, Name);
+        return;
+    }
+
+    ProfileProtoBuffer Event = {};
+    ProfileProtoUint(&Event, PROTO_EVENT_TYPE, PROTO_EVENT_TYPE_SLICE_BEGIN);
+    ProfileProtoUint(&Event, PROTO_EVENT_TRACK_UUID, PROFILE_TRACE_UUID_FRAMES);
+    ProfileProtoString(&Event, PROTO_EVENT_NAME, Name);
+    ProfileTraceWriteTrackEvent(nStart, &Event, NULL);
+
+    Event.nSize = 0;
+    ProfileProtoUint(&Event, PROTO_EVENT_TYPE, PROTO_EVENT_TYPE_SLICE_END);
+    ProfileProtoUint(&Event, PROTO_EVENT_TRACK_UUID, PROFILE_TRACE_UUID_FRAMES);
+    ProfileTraceWriteTrackEvent(nEnd, &Event, NULL);
+}
+
+static void ProfileTraceWriteFrame(uint32_t nFrameIndex)
+{
+    ProfileTraceState& T = gProfileTrace;
+    Profile&           S = g_Profile;
+
+    uint32_t                 nFrameIndexNext = (nFrameIndex + 1) % PROFILE_MAX_FRAME_HISTORY;
+    const ProfileFrameState& Frame = S.Frames[nFrameIndex];
+    const ProfileFrameState& FrameNext = S.Frames[nFrameIndexNext];
+    uint64_t                 nFrameStart = ProfileTraceCpuTime(Frame.nFrameStartCpu);
+
+    ProfileTraceFrameSlice(nFrameStart, ProfileTraceCpuTime(FrameNext.nFrameStartCpu));
+    ProfileTraceCounters(nFrameStart);
+
+    for (uint32_t j = 0; j < PROFILE_MAX_THREADS; ++j)
+    {
+        ProfileThreadLog* pLog = S.Pool[j];
+        if (!pLog || !pLog->Log)
+            continue;
+        if (T.pThreadLogs[j] != pLog)
+        {
+            ProfileTraceThreadTrack(j, pLog);
+        }
+
+        if (pLog->nGpu && T.fGpuToNs[j] == 0.0)
+        {
+            // GPU logs start once they have a reference tick and the timestamp frequency is known
+            uint64_t nTicksPerSecond = getGpuProfileTicksPerSecond(pLog->nGpuToken);
+            if (!Frame.nFrameStartGpu[j] || !nTicksPerSecond)
+                continue;
+            T.nGpuBaseTick[j] = Frame.nFrameStartGpu[j];
+            T.nGpuBaseTime[j] = nFrameStart;
+            T.fGpuToNs[j] = 1e9 / (double)nTicksPerSecond;
+        }
+
+        uint32_t nLogStart = Frame.nLogStart[j];
+        uint32_t nLogEnd = FrameNext.nLogStart[j];
+        for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % pLog->nLogSize)
+        {
+            ProfileLogEntry LE = pLog->Log[k];
+            uint64_t        nType = ProfileLogType(LE);
+            if (nType != P_LOG_ENTER && nType != P_LOG_LEAVE && nType != P_LOG_LABEL && nType != P_LOG_LABEL_LITERAL)
+                continue;
+
+            uint64_t nTime = T.nLastTime[j];
+            if (nType == P_LOG_ENTER || nType == P_LOG_LEAVE)
+            {
+                if (pLog->nGpu)
+                {
+                    int64_t nTime64 =
+                        (int64_t)T.nGpuBaseTime[j] + (int64_t)(ProfileLogTickDifference(T.nGpuBaseTick[j], LE) * T.fGpuToNs[j]);
+                    nTime = nTime64 > 0 ? (uint64_t)nTime64 : 0;
+                }
+                else
+                {
+                    nTime = ProfileTraceCpuTime(LE);
+                }
+            }
+
+            if (nType == P_LOG_ENTER)
+            {
+                T.nStackDepth[j]++;
+                ProfileTraceSlice(j, nTime, true, (uint32_t)ProfileLogTimerIndex(LE));
+            }
+            else if (nType == P_LOG_LEAVE)
+            {
+                // Scopes entered before the capture started have no begin event
+                if (T.nStackDepth[j])
+                {
+                    T.nStackDepth[j]--;
+                    ProfileTraceSlice(j, nTime, false, (uint32_t)ProfileLogTimerIndex(LE));
+                }
+            }
+            else if (const char* pLabel = ProfileGetLabel((uint32_t)nType, ProfileLogGetTick(LE)))
+            {
+                ProfileTraceInstant(j, nTime, pLabel);
+            }
+        }
+    }
+}
+
+static bool ProfileTraceOpen(const char* appName, ProfileTraceFormat eFormat, int64_t nBaseTick)
+{
+    ProfileTraceState& T = gProfileTrace;
+    P_ASSERT(!T.bActive);
+
+    time_t t = time(0);
+    char   time[64];
+    size_t timeLen = strftime(time, sizeof(time), R"(Trace-%Y-%m-%d-%H.%M.%S)", localtime(&t));
+    ASSERT(timeLen < 64);
+    snprintf(T.FileName, sizeof(T.FileName), "%s%s%s", appName, time,
+             eFormat == PROFILE_TRACE_FORMAT_CHROME_JSON ? ".json" : ".perfetto-trace");
+
+    T.File.mBuffer = bempty();
+    if (!fsOpenStreamFromPath(RD_LOG, T.FileName, FM_WRITE, &T.File.mStream))
+    {
+        LOGF(eERROR, "Failed to open profile trace file '%s'", T.FileName);
+        return false;
+    }
+
+    T.bActive = true;
+    T.eFormat = eFormat;
+    T.nFramesLeft = 0;
+    T.nFrameCount = 0;
+    T.nEventCount = 0;
+    T.nProcessId = (uint32_t)P_GETCURRENTPROCESSID();
+    T.nBaseTick = nBaseTick;
+    T.fCpuToNs = 1e9 / (double)ProfileTicksPerSecondCpu();
+    T.nCounterCount = 0;
+    memset(T.pThreadLogs, 0, sizeof(T.pThreadLogs));
+    memset(T.nInternedTimers, 0, sizeof(T.nInternedTimers));
+
+    if (eFormat == PROFILE_TRACE_FORMAT_CHROME_JSON)
+    {
+        char Name[PROFILE_TRACE_FILE_NAME_MAX_LEN * 2];
+        ProfileTraceJsonEscape(appName[0] ? appName : "The Forge", Name, sizeof(Name));
+        ProfileWriteFile(&T.File, 2, "[\n");
+        ProfileTraceJsonEvent("{\"ph\":\"M\",\"pid\":%u,\"name\":\"process_name\",\"args\":{\"name\":\"%s\"}}", T.nProcessId, Name);
+        ProfileTraceJsonEvent("{\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"Frames\"}}", T.nProcessId,
+                              PROFILE_TRACE_UUID_FRAMES);
+    }
+    else
+    {
+        ProfileProtoBuffer Process = {};
+        ProfileProtoUint(&Process, PROTO_PROCESS_PID, T.nProcessId);
+        ProfileProtoString(&Process, PROTO_PROCESS_NAME, appName[0] ? appName : "The Forge");
+        ProfileProtoBuffer Track = {};
+        ProfileProtoUint(&Track, PROTO_TRACK_UUID, PROFILE_TRACE_UUID_PROCESS);
+        ProfileProtoMessage(&Track, PROTO_TRACK_PROCESS, &Process);
+        ProfileTraceWriteTrackDescriptor(&Track);
+
+        Track.nSize = 0;
+        ProfileProtoUint(&Track, PROTO_TRACK_UUID, PROFILE_TRACE_UUID_FRAMES);
+        ProfileProtoString(&Track, PROTO_TRACK_NAME, "Frames");
+        ProfileProtoUint(&Track, PROTO_TRACK_PARENT_UUID, PROFILE_TRACE_UUID_PROCESS);
+        ProfileTraceWriteTrackDescriptor(&Track);
+    }
+    return true;
+}
+
+static void ProfileTraceClose()
+{
+    ProfileTraceState& T = gProfileTrace;
+    if (!T.bActive)
+        return;
+
+    // Close scopes still open so every begin has its end
+    for (uint32_t j = 0; j < PROFILE_MAX_THREADS; ++j)
+    {
+        while (T.pThreadLogs[j] && T.nStackDepth[j])
+        {
+            T.nStackDepth[j]--;
+            ProfileTraceSlice(j, T.nLastTime[j], false, 0);
+        }
+    }
+    if (T.eFormat == PROFILE_TRACE_FORMAT_CHROME_JSON)
+    {
+        ProfileWriteFile(&T.File, 3, "\n]\n");
+    }
+
+    ProfileWriteFileFlush(&T.File);
+    fsCloseStream(&T.File.mStream);
+    bdestroy(&T.File.mBuffer);
+    T.bActive = false;
+    LOGF(eINFO, "Profile trace with %llu frames written to '%s'", (unsigned long long)T.nFrameCount, T.FileName);
+}
+
+// Called from ProfileFlipCpu once S.nFrameCurrent has all its cpu and gpu entries
+static void ProfileTraceFlip()
+{
+    ProfileTraceState& T = gProfileTrace;
+    Profile&           S = g_Profile;
+
+    // A capture started from code keeps the trigger armed until it is done
+    if (T.bTriggerArmed && !T.bActive && S.nFlipTicks * ProfileTickToMsMultiplier(ProfileTicksPerSecondCpu()) > T.fTriggerMs)
+    {
+        T.bTriggerArmed = false;
+        uint32_t nFramesBefore = ProfileMin(T.nTriggerFramesBefore, (uint32_t)PROFILE_TRACE_MAX_HISTORY_FRAMES - 1);
+        uint32_t nFirstFrame = (S.nFrameCurrent + PROFILE_MAX_FRAME_HISTORY - nFramesBefore) % PROFILE_MAX_FRAME_HISTORY;
+        if (ProfileTraceOpen(T.TriggerAppName, T.eTriggerFormat, S.Frames[nFirstFrame].nFrameStartCpu))
+        {
+            for (uint32_t i = 0; i < nFramesBefore; ++i)
+            {
+                ProfileTraceWriteFrame((nFirstFrame + i) % PROFILE_MAX_FRAME_HISTORY);
+            }
+            T.nFramesLeft = T.nTriggerFramesAfter + 1;
+        }
+    }
+
+    if (!T.bActive)
+        return;
+
+    ProfileTraceWriteFrame(S.nFrameCurrent);
+    if (T.nFramesLeft && --T.nFramesLeft == 0)
+    {
+        ProfileTraceClose();
+    }
+}
+
+void startProfileTrace(const char* appName, ProfileTraceFormat format, uint32_t nFrames)
+{
+    MutexLock lock(ProfileMutex());
+    Profile&  S = g_Profile;
+
+    ProfileTraceClose();
+    // First frame written is the one ProfileFlipCpu finalizes next
+    uint32_t nFrameNext = (S.nFrameCurrent + 1) % PROFILE_MAX_FRAME_HISTORY;
+    if (ProfileTraceOpen(appName, format, S.Frames[nFrameNext].nFrameStartCpu))
+    {
+        gProfileTrace.nFramesLeft = nFrames;
+    }
+}
+
+void stopProfileTrace()
+{
+    MutexLock lock(ProfileMutex());
+    ProfileTraceClose();
+    gProfileTrace.bTriggerArmed = false;
+}
+
+void armProfileTraceOnFrameTime(const char* appName, ProfileTraceFormat format, float frameMs, uint32_t nFramesBefore,
+                                uint32_t nFramesAfter)
+{
+    MutexLock          lock(ProfileMutex());
+    ProfileTraceState& T = gProfileTrace;
+
+    strncpy(T.TriggerAppName, appName, sizeof(T.TriggerAppName) - 1);
+    T.TriggerAppName[sizeof(T.TriggerAppName) - 1] = '\0';
+    T.eTriggerFormat = format;
+    T.fTriggerMs = frameMs;
+    T.nTriggerFramesBefore = nFramesBefore;
+    T.nTriggerFramesAfter = nFramesAfter;
+    T.bTriggerArmed = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SAMPLE EXPORT
+//
+// The sample call tree is written as folded stacks, one "Thread;Group/Zone;...;function count" line per call path.
+// flamegraph.pl, speedscope and Tools/ProfilerFlameGraph/flame_graph.py all read this format.
+/////////////////////////////////////////////////////////////////////////////
+
+#if PROFILE_SAMPLING
+#define PROFILE_SAMPLE_MAX_PATH_LEN (16 << 10)
+
+static uint32_t ProfileSampleAppendName(char* pPath, uint32_t nLength, const char* pName)
+{
+    if (nLength && nLength < PROFILE_SAMPLE_MAX_PATH_LEN)
+        pPath[nLength++] = ';';
+    // ';' separates frames and the line ends the path
+    for (; *pName && nLength < PROFILE_SAMPLE_MAX_PATH_LEN; ++pName)
+        pPath[nLength++] = (*pName == ';' || *pName == '\n') ? '_' : *pName;
+    return nLength;
+}
+
+static void ProfileSampleFrameName(uint64_t nAddress, char* pOut, size_t nSize)
+{
+    Dl_info Info = {};
+    if (!dladdr((void*)(uintptr_t)nAddress, &Info) || !Info.dli_fname)
+    {
+        snprintf(pOut, nSize, "0x%" PRIx64, nAddress);
+        return;
+    }
+    if (Info.dli_sname)
+    {
+        int   nStatus = 0;
+        char* pDemangled = abi::__cxa_demangle(Info.dli_sname, NULL, NULL, &nStatus);
+        snprintf(pOut, nSize, "%s", pDemangled ? pDemangled : Info.dli_sname);
+        // Allocated by the C runtime, the parentheses keep the tf_free reminder macro from expanding
+        (free)(pDemangled);
+        return;
+    }
+    // Only exported symbols resolve at runtime, flame_graph.py --addr2line resolves the rest from debug info
+    snprintf(pOut, nSize, "%s+0x%" PRIx64, Info.dli_fname, nAddress - (uint64_t)(uintptr_t)Info.dli_fbase);
+}
+
+static void ProfileSampleWriteNode(ProfileWriteFileData* pFile, uint32_t nNode, char* pPath, uint32_t nLength)
+{
+    ProfileSamplingState&    P = gProfileSampling;
+    Profile&                 S = g_Profile;
+    const ProfileSampleNode& Node = P.pNodes[nNode];
+
+    char Name[1024];
+    switch (Node.nType)
+    {
+    case PROFILE_SAMPLE_NODE_THREAD:
+        nLength = ProfileSampleAppendName(pPath, nLength, P.pThreadNames[Node.nKey].Name);
+        break;
+    case PROFILE_SAMPLE_NODE_ZONE:
+        snprintf(Name, sizeof(Name), "%s/%s", S.GroupInfo[S.TimerInfo[Node.nKey].nGroupIndex].pName, S.TimerInfo[Node.nKey].pName);
+        nLength = ProfileSampleAppendName(pPath, nLength, Name);
+        break;
+    case PROFILE_SAMPLE_NODE_FRAME:
+        ProfileSampleFrameName(Node.nKey, Name, sizeof(Name));
+        nLength = ProfileSampleAppendName(pPath, nLength, Name);
+        break;
+    default:
+        break;
+    }
+
+    if (Node.nSamples)
+    {
+        char Count[32];
+        int  nCountLen = snprintf(Count, sizeof(Count), " %u\n", Node.nSamples);
+        ProfileWriteFile(pFile, nLength, pPath);
+        ProfileWriteFile(pFile, nCountLen, Count);
+    }
+    for (uint32_t nChild = Node.nChild; nChild; nChild = P.pNodes[nChild].nSibling)
+    {
+        ProfileSampleWriteNode(pFile, nChild, pPath, nLength);
+    }
+}
+
+void setProfileSampling(uint32_t nSamplesPerSecond)
+{
+    MutexLock             lock(ProfileMutex());
+    ProfileSamplingState& P = gProfileSampling;
+    Profile&              S = g_Profile;
+
+    if (nSamplesPerSecond && !ProfileSampleInstallHandler())
+        return;
+
+    // Higher rates overflow the sample rings before the flip gets to attribute them
+    nSamplesPerSecond = ProfileMin(nSamplesPerSecond, (uint32_t)PROFILE_SAMPLE_MAX_RATE);
+    if (!P.nSamplesPerSecond && nSamplesPerSecond)
+    {
+        // A new session starts with an empty tree
+        arrfree(P.pNodes);
+        arrfree(P.pThreadNames);
+        P.nSamples = 0;
+        P.nDropped = 0;
+        for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+        {
+            if (S.Pool[i] && S.Pool[i]->pSampleRing)
+                tfrg_atomic64_store_relaxed(&S.Pool[i]->pSampleRing->nDropped, 0);
+        }
+    }
+
+    P.nSamplesPerSecond = nSamplesPerSecond;
+    for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+    {
+        if (S.Pool[i])
+        {
+            ProfileSampleStopThread(S.Pool[i]);
+            ProfileSampleStartThread(S.Pool[i]);
+        }
+    }
+}
+
+void dumpProfileSamples(const char* appName)
+{
+    MutexLock             lock(ProfileMutex());
+    ProfileSamplingState& P = gProfileSampling;
+    Profile&              S = g_Profile;
+
+    if (!P.nSamples)
+    {
+        LOGF(eWARNING, "No profiler samples to dump, start sampling with setProfileSampling");
+        return;
+    }
+
+    uint64_t nDropped = P.nDropped;
+    for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+    {
+        if (S.Pool[i] && S.Pool[i]->pSampleRing)
+            nDropped += tfrg_atomic64_load_relaxed(&S.Pool[i]->pSampleRing->nDropped);
+    }
+
+    time_t t = time(0);
+    char   time[64];
+    size_t timeLen = strftime(time, sizeof(time), R"(Samples-%Y-%m-%d-%H.%M.%S)", localtime(&t));
+    ASSERT(timeLen < 64);
+    char FileName[256];
+    snprintf(FileName, sizeof(FileName), "%s%s.folded", appName, time);
+
+    ProfileWriteFileData data = {};
+    data.mBuffer = bempty();
+    if (!fsOpenStreamFromPath(RD_LOG, FileName, FM_WRITE, &data.mStream))
+    {
+        LOGF(eERROR, "Failed to open profile samples file '%s'", FileName);
+        return;
+    }
+
+    char* pPath = (char*)tf_malloc(PROFILE_SAMPLE_MAX_PATH_LEN);
+    ProfileSampleWriteNode(&data, 0, pPath, 0);
+    tf_free(pPath);
+
+    ProfileWriteFileFlush(&data);
+    fsCloseStream(&data.mStream);
+    bdestroy(&data.mBuffer);
+    LOGF(eINFO, "%llu profiler samples written to '%s', %llu dropped", (unsigned long long)P.nSamples, FileName,
+         (unsigned long long)nDropped);
+}
+
+static void ProfileSampleShutdown()
+{
+    setProfileSampling(0);
+
+    MutexLock             lock(ProfileMutex());
+    ProfileSamplingState& P = gProfileSampling;
+    arrfree(P.pNodes);
+    arrfree(P.pThreadNames);
+    P.nSamples = 0;
+    P.nDropped = 0;
+}
+#else
+void setProfileSampling(uint32_t nSamplesPerSecond)
+{
+    if (nSamplesPerSecond)
+        LOGF(eWARNING, "Profiler sampling is only supported on Linux");
+}
+
+void dumpProfileSamples(const char* appName) { UNREF_PARAM(appName); }
+#endif
+
+void ProfileDumpToFile(Renderer* pRenderer)
+{
+    UNREF_PARAM(pRenderer);
+    if (!g_Profile.nRunning)
+        return;
+
+    MutexLock lock(ProfileMutex());
+    Profile&  S = g_Profile;
+
+    ProfileWriteFileData data = {};
+    data.mBuffer = bempty();
+    if (fsOpenStreamFromPath(RD_LOG, S.DumpFile, FM_WRITE, &data.mStream))
+    {
+        if (S.eDumpType == ProfileDumpTypeHtml)
+            ProfileDumpHtml(ProfileWriteFile, &data, S.nDumpFrames, 0);
+        else if (S.eDumpType == ProfileDumpTypeCsv)
+            ProfileDumpCsv(ProfileWriteFile, &data, S.nDumpFrames);
+
+        ProfileWriteFileFlush(&data);
+        fsCloseStream(&data.mStream);
+    }
+    bdestroy(&data.mBuffer);
+}
+
+void dumpProfileData(const char* appName, uint32_t nMaxFrames)
+{
+    if (!g_Profile.nRunning)
+        return;
+
+    MutexLock lock(ProfileMutex());
+
+    // Dump frames to file.
+    time_t t = time(0);
+
+    char   time[64];
+    size_t timeLen = strftime(time, sizeof(time), R"(Profile-%Y-%m-%d-%H.%M.%S.html)", localtime(&t));
+    ASSERT(timeLen < 64);
+
+    char name[256] = {};
+    snprintf(name, sizeof(name), "%s%s", appName, time);
+    ProfileWriteFileData data = {};
+    data.mBuffer = bempty();
+    if (fsOpenStreamFromPath(RD_LOG, name, FM_WRITE, &data.mStream))
+    {
+        ProfileDumpHtml(ProfileWriteFile, &data, nMaxFrames, 0);
+        ProfileWriteFileFlush(&data);
+        fsCloseStream(&data.mStream);
+    }
+    bdestroy(&data.mBuffer);
+}
+
+// Per frame samples behind the aggregates, so runs can be compared by distribution (see Tools/BenchmarkCompare).
+// A timer's sample is its inclusive time summed over all threads, frames it didn't run in are left out.
+static void ProfileBenchmarkWriteSamples(bstring* pOutput)
+{
+    Profile& S = g_Profile;
+
+    // Newest frames may still miss their gpu timers
+    uint32_t nNumFrames = S.nAggregateFrames ? S.nAggregateFrames : 1;
+    nNumFrames = ProfileMin(nNumFrames, (uint32_t)(PROFILE_MAX_FRAME_HISTORY - 2 * PROFILE_GPU_FRAME_DELAY - 3));
+    uint32_t nFirstFrame = (S.nFrameCurrent + 2 * PROFILE_MAX_FRAME_HISTORY - nNumFrames - PROFILE_GPU_FRAME_DELAY) % PROFILE_MAX_FRAME_HISTORY;
+
+    // nNumFrames samples per timer, negative while the timer didn't run in that frame
+    float* pSamples = (float*)tf_malloc(sizeof(float) * nNumFrames * ProfileMax(S.nTotalTimers, 1u));
+    for (uint32_t i = 0; i < nNumFrames * S.nTotalTimers; ++i)
+        pSamples[i] = -1.f;
+
+    float    fToMsCpu = ProfileTickToMsMultiplier(ProfileTicksPerSecondCpu());
+    uint32_t nStackTimer[PROFILE_STACK_MAX];
+    uint64_t nStackTick[PROFILE_STACK_MAX];
+    for (uint32_t j = 0; j < PROFILE_MAX_THREADS; ++j)
+    {
+        ProfileThreadLog* pLog = S.Pool[j];
+        if (!pLog || !pLog->Log)
+            continue;
+
+        float    fToMs = pLog->nGpu ? ProfileTickToMsMultiplier(getGpuProfileTicksPerSecond(pLog->nGpuToken)) : fToMsCpu;
+        uint32_t nStackPos = 0;
+        for (uint32_t i = 0; i < nNumFrames; ++i)
+        {
+            uint32_t nFrameIndex = (nFirstFrame + i) % PROFILE_MAX_FRAME_HISTORY;
+            uint32_t nLogStart = S.Frames[nFrameIndex].nLogStart[j];
+            uint32_t nLogEnd = S.Frames[(nFrameIndex + 1) % PROFILE_MAX_FRAME_HISTORY].nLogStart[j];
+            for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % pLog->nLogSize)
+            {
+                ProfileLogEntry LE = pLog->Log[k];
+                uint64_t        nType = ProfileLogType(LE);
+                uint32_t        nTimerIndex = (uint32_t)ProfileLogTimerIndex(LE);
+                if (nType == P_LOG_ENTER && nStackPos < PROFILE_STACK_MAX)
+                {
+                    nStackTimer[nStackPos] = nTimerIndex;
+                    nStackTick[nStackPos++] = LE;
+                }
+                else if (nType == P_LOG_LEAVE && nStackPos && nStackTimer[nStackPos - 1] == nTimerIndex)
+                {
+                    --nStackPos;
+
+                    // Recursive scopes are already counted by their outermost instance
+                    bool bNested = false;
+                    for (uint32_t l = 0; l < nStackPos && !bNested; ++l)
+                        bNested = nStackTimer[l] == nTimerIndex;
+                    if (bNested || nTimerIndex >= S.nTotalTimers)
+                        continue;
+
+                    // Scopes spanning a frame boundary count for the frame they end in
+                    float& fSample = pSamples[nTimerIndex * nNumFrames + i];
+                    fSample = ProfileMax(fSample, 0.f) + fToMs * ProfileLogTickDifference(nStackTick[nStackPos], LE);
+                }
+            }
+        }
+    }
+
+    char Name[256];
+    bformata(pOutput, "%s", "\"Timers\": [\n");
+    bool bFirst = true;
+    for (uint32_t nTimerIndex = 0; nTimerIndex < S.nTotalTimers; ++nTimerIndex)
+    {
+        const float* pTimerSamples = &pSamples[nTimerIndex * nNumFrames];
+        uint32_t     nCount = 0;
+        for (uint32_t i = 0; i < nNumFrames; ++i)
+            nCount += pTimerSamples[i] >= 0.f;
+        if (!nCount)
+            continue;
+
+        const ProfileTimerInfo& TI = S.TimerInfo[nTimerIndex];
+        bformata(pOutput, "%s{ \"Group\": \"%s\", ", bFirst ? "" : ",\n",
+                 ProfileTraceJsonEscape(S.GroupInfo[TI.nGroupIndex].pName, Name, sizeof(Name)));
+        bformata(pOutput, "\"Name\": \"%s\", \"Gpu\": %s, \"Samples\": [", ProfileTraceJsonEscape(TI.pName, Name, sizeof(Name)),
+                 S.GroupInfo[TI.nGroupIndex].Type == ProfileTokenTypeGpu ? "true" : "false");
+        for (uint32_t i = 0, nWritten = 0; i < nNumFrames; ++i)
+        {
+            if (pTimerSamples[i] >= 0.f)
+                bformata(pOutput, "%s%0.4f", nWritten++ ? ", " : "", pTimerSamples[i]);
+        }
+        bformata(pOutput, "%s", "] }");
+        bFirst = false;
+    }
+    bformata(pOutput, "%s", "\n], \n\n");
+
+    // Frame times of the same frames for the "Cpu" block
+    bformata(pOutput, "%s", "\"FrameTimes\": [");
+    for (uint32_t i = 0; i < nNumFrames; ++i)
+    {
+        uint32_t nFrameIndex = (nFirstFrame + i) % PROFILE_MAX_FRAME_HISTORY;
+        int64_t  nTicks = S.Frames[(nFrameIndex + 1) % PROFILE_MAX_FRAME_HISTORY].nFrameStartCpu - S.Frames[nFrameIndex].nFrameStartCpu;
+        bformata(pOutput, "%s%0.4f", i ? ", " : "", fToMsCpu * nTicks);
+    }
+    bformata(pOutput, "%s", "], \n\n");
+
+    tf_free(pSamples);
+}
+
+void dumpBenchmarkData(IApp::Settings* pSettings, const char* outFilename, const char* appName)
+{
+    if (!g_Profile.nRunning)
+        return;
+
+    time_t        t = time(0);
+    unsigned char nameBuf[256];
+    bstring       name = bemptyfromarr(nameBuf);
+    bformat(&name, "%s", outFilename);
+
+    char   time[64];
+    // bstrlib doesn't have strftime
+    size_t timeLen = strftime(time, sizeof(time), R"(Benchmark-%Y-%m-%d-%H.%M.%S.profile)", localtime(&t));
+    ASSERT(timeLen < 64);
+    bcatblk(&name, time, (int)timeLen);
+
+    FileStream statsFile = {};
+    if (fsOpenStreamFromPath(RD_LOG, (const char*)name.data, FM_WRITE, &statsFile))
+    {
+        bstring output = bempty();
+        balloc(&output, 2048);
+
+        bassignliteral(&output, "{\n");
+
+        bformata(&output, "\"Application\": \"%s\", \n", appName);
+        bformata(&output, "\"Width\": %d, \n", pSettings->mWidth);
+        bformata(&output, "\"Height\": %d, \n\n", pSettings->mHeight);
+        bformata(&output, "\"GpuName\": \"%s\", \n", g_Profile.pGpuDesc->mGpuVendorPreset.mGpuName);
+        bformata(&output, "\"VendorID\": \"%#x\", \n", g_Profile.pGpuDesc->mGpuVendorPreset.mVendorId);
+        bformata(&output, "\"ModelID\": \"%#x\", \n\n", g_Profile.pGpuDesc->mGpuVendorPreset.mModelId);
+
+        const Profile& S = *ProfileGet();
+        for (uint32_t groupIndex = 0; groupIndex < S.nGroupCount; ++groupIndex)
+        {
+            if (S.GroupInfo[groupIndex].Type != ProfileTokenTypeGpu)
+                continue;
+
+            for (uint32_t timerIndex = 0; timerIndex < S.nTotalTimers; ++timerIndex)
+            {
+                if (strcmp(S.TimerInfo[timerIndex].pName, S.GroupInfo[groupIndex].pName) == 0)
+                {
+                    bformata(&output, "\"%s\": { \n", S.GroupInfo[groupIndex].pName);
+
+                    float    fToMs = ProfileTickToMsMultiplier(getGpuProfileTicksPerSecond(S.GroupInfo[groupIndex].nGpuProfileToken));
+                    uint32_t nAggregateFrames = S.nAggregateFrames ? S.nAggregateFrames : 1;
+                    uint32_t nAggregateCount = S.Aggregate[timerIndex].nCount ? S.Aggregate[timerIndex].nCount : 1;
+                    float    fAverage = fToMs * (float)(S.Aggregate[timerIndex].nTicks / nAggregateFrames);
+                    float    fMax = fToMs * (S.AggregateMax[timerIndex]);
+                    float    fMin = fToMs * (S.AggregateMin[timerIndex]);
+
+                    bformata(&output, "\"Average\": %0.4f, \n", fAverage);
+                    bformata(&output, "\"Min\": %0.4f, \n", fMin);
+                    bformata(&output, "\"Max\": %0.4f, \n", fMax);
+                    bformata(&output, "\"Frames\": %d \n", nAggregateCount);
+                    bformata(&output, "}, \n\n");
+                    break;
+                }
+            }
+        }
+
+        ProfileBenchmarkWriteSamples(&output);
+
+        bformata(&output, "\"Cpu\": { \n");
+        bformata(&output, "\"Average\": %0.4f, \n", getCpuAvgFrameTime());
+        bformata(&output, "\"Min\": %0.4f, \n", getCpuMinFrameTime());
+        bformata(&output, "\"Max\": %0.4f, \n", getCpuMaxFrameTime());
+        bformata(&output, "\"Frames\": %d \n", S.nAggregateFrames);
+        bformata(&output, "} \n");
+        bformata(&output, "}");
+
+        fsWriteToStream(&statsFile, (const char*)output.data, (size_t)output.slen * sizeof(char));
+        fsCloseStream(&statsFile);
+        bdestroy(&output);
+    }
+}
+
+#ifdef ENABLE_PROFILER_WEBSERVER
+uint32_t ProfileWebServerPort()
+{
+    Profile& S = g_Profile;
+    return S.nWebServerPort;
+}
+
+void ProfileSendSocket(MpSocket Socket, const char* pData, size_t nSize)
+{
+#ifdef MSG_NOSIGNAL
     int nFlags = MSG_NOSIGNAL;
 #else
     int                          nFlags = 0;
@@ -4682,7 +6436,7 @@ void ProfileWebServerStart()
     Profile& S = g_Profile;
     if (!S.WebServerThread)
     {
-        ProfileThreadStart(&S.WebServerThread, ProfileWebServerUpdate);
+        ProfileThreadStart(&S.WebServerThread, ProfileWebServerUpdate, "ProfilerWebServer");
     }
 }
 
@@ -4894,7 +6648,7 @@ void ProfileContextSwitchTraceStart()
     Profile& S = g_Profile;
     if (!S.ContextSwitchThread)
     {
-        ProfileThreadStart(&S.ContextSwitchThread, ProfileTraceThread);
+        ProfileThreadStart(&S.ContextSwitchThread, ProfileTraceThread, "ProfilerContextSwitch");
     }
 }
 
@@ -4924,11 +6678,12 @@ void ProfileContextSwitchSearch(uint32_t* pContextSwitchStart, uint32_t* pContex
     {
         uint32_t nIndex = (nContextSwitchPut + PROFILE_CONTEXT_SWITCH_BUFFER_SIZE - (i + 1)) % PROFILE_CONTEXT_SWITCH_BUFFER_SIZE;
         ProfileContextSwitch& CS = S.ContextSwitch[nIndex];
-        if (CS.nTicks > nSearchEnd)
+        // nTicks only keeps the low 56 bits, nanosecond ticks of CLOCK_REALTIME don't fit
+        if (ProfileLogTickDifference(nSearchEnd, CS.nTicks) > 0)
         {
             nContextSwitchEnd = nIndex;
         }
-        if (CS.nTicks > nSearchBegin)
+        if (ProfileLogTickDifference(nSearchBegin, CS.nTicks) > 0)
         {
             nContextSwitchStart = nIndex;
         }
@@ -4949,7 +6704,7 @@ uint32_t ProfileContextSwitchGatherThreads(uint32_t nContextSwitchStart, uint32_
         if (!S.Pool[i])
             continue;
         Threads[nNumThreads].nProcessId = nCurrentProcessId;
-        Threads[nNumThreads].nThreadId = S.Pool[i]->nThreadId;
+        Threads[nNumThreads].nThreadId = S.Pool[i]->nSystemThreadId;
         nNumThreads++;
     }
 
@@ -5105,6 +6860,304 @@ void ProfileTraceThread(void*)
         S.bContextSwitchRunning = false;
     }
 }
+#elif defined(__linux__) && !defined(__ANDROID__)
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+// Data pages of the sched_switch ring of each cpu, must be a power of two
+#define PROFILE_CONTEXT_SWITCH_RING_PAGES 64
+#define PROFILE_CONTEXT_SWITCH_TGID_CACHE 4096
+
+static bool ProfileReadSystemFile(const char* pPath, char* Buffer, uint32_t nSize)
+{
+    // procfs and tracefs report a size of 0, read until the end instead of trusting the file size
+    int fd = open(pPath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    uint32_t nRead = 0;
+    ssize_t  nResult;
+    while (nRead < nSize - 1 && (nResult = read(fd, Buffer + nRead, nSize - 1 - nRead)) > 0)
+        nRead += (uint32_t)nResult;
+    close(fd);
+
+    Buffer[nRead] = 0;
+    return nRead > 0;
+}
+
+const char* ProfileGetProcessName(ProfileProcessIdType nId, char* Buffer, uint32_t nSize)
+{
+    char Path[64];
+    snprintf(Path, sizeof(Path), "/proc/%u/comm", nId);
+    if (!ProfileReadSystemFile(Path, Buffer, nSize))
+        return nullptr;
+
+    char* pNewLine = strchr(Buffer, '\n');
+    if (pNewLine)
+        *pNewLine = 0;
+
+    return Buffer;
+}
+
+struct ProfileSchedSwitchFormat
+{
+    uint32_t nId;
+    uint32_t nPrevPidOffset;
+    uint32_t nNextPidOffset;
+};
+
+static bool ProfileGetSchedSwitchFormat(ProfileSchedSwitchFormat* pFormat)
+{
+    // tracefs moved out of debugfs in 4.1, older kernels only have the second one
+    static const char* pTracingDirs[] = { "/sys/kernel/tracing", "/sys/kernel/debug/tracing" };
+
+    char Path[128];
+    char Buffer[4096];
+    for (uint32_t i = 0; i < TF_ARRAY_COUNT(pTracingDirs); ++i)
+    {
+        snprintf(Path, sizeof(Path), "%s/events/sched/sched_switch/id", pTracingDirs[i]);
+        if (!ProfileReadSystemFile(Path, Buffer, sizeof(Buffer)))
+            continue;
+        pFormat->nId = (uint32_t)strtoul(Buffer, nullptr, 10);
+
+        // Field offsets of the raw record changed between kernel versions, take them from the format description
+        snprintf(Path, sizeof(Path), "%s/events/sched/sched_switch/format", pTracingDirs[i]);
+        if (!ProfileReadSystemFile(Path, Buffer, sizeof(Buffer)))
+            continue;
+
+        const char* pPrev = strstr(Buffer, " prev_pid;");
+        const char* pNext = strstr(Buffer, " next_pid;");
+        pPrev = pPrev ? strstr(pPrev, "offset:") : nullptr;
+        pNext = pNext ? strstr(pNext, "offset:") : nullptr;
+        if (!pPrev || !pNext)
+            continue;
+
+        pFormat->nPrevPidOffset = (uint32_t)strtoul(pPrev + 7, nullptr, 10);
+        pFormat->nNextPidOffset = (uint32_t)strtoul(pNext + 7, nullptr, 10);
+        return true;
+    }
+
+    return false;
+}
+
+struct ProfileTgidCacheEntry
+{
+    uint32_t nTid;
+    uint32_t nTgid;
+};
+
+// sched_switch only carries thread ids, the process of a thread comes from the samples it was switched out in
+// and from /proc for threads that were not seen yet
+static ProfileProcessIdType ProfileGetThreadProcessId(ProfileTgidCacheEntry* pCache, uint32_t nTid)
+{
+    if (0 == nTid)
+        return 0;
+
+    ProfileTgidCacheEntry& Entry = pCache[(nTid * 2654435761u) % PROFILE_CONTEXT_SWITCH_TGID_CACHE];
+    if (Entry.nTid == nTid)
+        return Entry.nTgid;
+
+    char Path[64];
+    char Buffer[1024];
+    snprintf(Path, sizeof(Path), "/proc/%u/status", nTid);
+    if (!ProfileReadSystemFile(Path, Buffer, sizeof(Buffer)))
+        return 0;
+
+    const char* pTgid = strstr(Buffer, "Tgid:");
+    Entry.nTid = nTid;
+    Entry.nTgid = pTgid ? (uint32_t)strtoul(pTgid + 5, nullptr, 10) : 0;
+    return Entry.nTgid;
+}
+
+static void ProfileRingRead(const uint8_t* pData, uint64_t nDataSize, uint64_t nOffset, void* pDst, uint32_t nSize)
+{
+    // Records wrap around the end of the ring
+    uint64_t nStart = nOffset & (nDataSize - 1);
+    uint64_t nFirst = min((uint64_t)nSize, nDataSize - nStart);
+    memcpy(pDst, pData + nStart, (size_t)nFirst);
+    memcpy((uint8_t*)pDst + nFirst, pData, (size_t)(nSize - nFirst));
+}
+
+static bool ProfileCompareContextSwitchTicks(const void* pLhs, const void* pRhs, void* pUserData)
+{
+    UNREF_PARAM(pUserData);
+    return ProfileLogTickDifference(((const ProfileContextSwitch*)pLhs)->nTicks, ((const ProfileContextSwitch*)pRhs)->nTicks) > 0;
+}
+
+void ProfileTraceThread(void*)
+{
+    Profile& S = g_Profile;
+
+    ProfileSchedSwitchFormat Format;
+    if (!ProfileGetSchedSwitchFormat(&Format))
+    {
+        LOGF(eINFO, "Context switch trace disabled: sched_switch tracepoint is not readable, mount tracefs and allow access to it");
+        return;
+    }
+
+    const uint32_t nPageSize = (uint32_t)sysconf(_SC_PAGESIZE);
+    const uint64_t nDataSize = (uint64_t)nPageSize * PROFILE_CONTEXT_SWITCH_RING_PAGES;
+    const uint32_t nNumCpus = min((uint32_t)sysconf(_SC_NPROCESSORS_CONF), (uint32_t)PROFILE_CONTEXT_SWITCH_MAX_CPUS);
+
+    struct perf_event_attr Attr = {};
+    Attr.size = sizeof(Attr);
+    Attr.type = PERF_TYPE_TRACEPOINT;
+    Attr.config = Format.nId;
+    Attr.sample_period = 1;
+    Attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU | PERF_SAMPLE_RAW;
+    Attr.disabled = 1;
+    // CLOCK_REALTIME is refused for tracepoints on some kernels, samples are moved to P_TICK time below
+    Attr.use_clockid = 1;
+    Attr.clockid = CLOCK_MONOTONIC;
+    Attr.watermark = 1;
+    Attr.wakeup_watermark = (uint32_t)(nDataSize / 4);
+
+    struct pollfd Fds[PROFILE_CONTEXT_SWITCH_MAX_CPUS];
+    void*         pRings[PROFILE_CONTEXT_SWITCH_MAX_CPUS];
+    uint32_t      nNumFds = 0;
+    bool          bFailed = false;
+    for (uint32_t nCpu = 0; nCpu < nNumCpus; ++nCpu)
+    {
+        // pid -1 with a cpu records every process scheduled on it
+        int fd = (int)syscall(SYS_perf_event_open, &Attr, -1, (int)nCpu, -1, PERF_FLAG_FD_CLOEXEC);
+        if (fd < 0)
+        {
+            // Offline cpus fail with ENODEV, keep the ones that are there
+            if (ENODEV == errno)
+                continue;
+
+            LOGF(eINFO, "Context switch trace disabled: perf_event_open failed with '%s', needs CAP_PERFMON or "
+                           "/proc/sys/kernel/perf_event_paranoid <= 0", strerror(errno));
+            bFailed = true;
+            break;
+        }
+
+        void* pRing = mmap(nullptr, nPageSize + nDataSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (MAP_FAILED == pRing)
+        {
+            LOGF(eINFO, "Context switch trace disabled: could not map the perf ring of cpu %u, '%s'", nCpu, strerror(errno));
+            close(fd);
+            bFailed = true;
+            break;
+        }
+
+        Fds[nNumFds].fd = fd;
+        Fds[nNumFds].events = POLLIN;
+        pRings[nNumFds] = pRing;
+        ++nNumFds;
+    }
+
+    bool bStarted = nNumFds > 0 && !bFailed;
+    for (uint32_t i = 0; bStarted && i < nNumFds; ++i)
+        ioctl(Fds[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+
+    ProfileTgidCacheEntry* pTgidCache =
+        bStarted ? (ProfileTgidCacheEntry*)tf_calloc(PROFILE_CONTEXT_SWITCH_TGID_CACHE, sizeof(ProfileTgidCacheEntry)) : nullptr;
+    // ProfileContextSwitch[dyn_size]
+    ProfileContextSwitch* pSwitches = NULL;
+    uint64_t              nLost = 0;
+
+    S.bContextSwitchRunning = bStarted;
+    while (bStarted && !S.bContextSwitchStop)
+    {
+        poll(Fds, nNumFds, 100);
+
+        // Offset is taken per batch so clock adjustments of CLOCK_REALTIME are followed
+        timespec Realtime, Monotonic;
+        clock_gettime(CLOCK_REALTIME, &Realtime);
+        clock_gettime(CLOCK_MONOTONIC, &Monotonic);
+        int64_t nTickOffset = (Realtime.tv_sec - Monotonic.tv_sec) * 1000000000ll + (Realtime.tv_nsec - Monotonic.tv_nsec);
+
+        for (uint32_t i = 0; i < nNumFds; ++i)
+        {
+            perf_event_mmap_page* pHeader = (perf_event_mmap_page*)pRings[i];
+            const uint8_t*        pData = (const uint8_t*)pRings[i] + nPageSize;
+            uint64_t              nHead = __atomic_load_n(&pHeader->data_head, __ATOMIC_ACQUIRE);
+            uint64_t              nTail = pHeader->data_tail;
+
+            while (nTail < nHead)
+            {
+                perf_event_header Record;
+                ProfileRingRead(pData, nDataSize, nTail, &Record, sizeof(Record));
+
+                // Sample layout follows the PERF_SAMPLE_ bit order: pid, tid, time, cpu, res, raw size, raw data
+                uint8_t Sample[512];
+                if (PERF_RECORD_SAMPLE == Record.type && Record.size <= sizeof(Sample))
+                {
+                    ProfileRingRead(pData, nDataSize, nTail, Sample, Record.size);
+
+                    uint32_t nPid, nTid, nCpu, nRawSize;
+                    uint64_t nTime;
+                    int32_t  nPrevPid, nNextPid;
+                    memcpy(&nPid, Sample + 8, sizeof(nPid));
+                    memcpy(&nTid, Sample + 12, sizeof(nTid));
+                    memcpy(&nTime, Sample + 16, sizeof(nTime));
+                    memcpy(&nCpu, Sample + 24, sizeof(nCpu));
+                    memcpy(&nRawSize, Sample + 32, sizeof(nRawSize));
+
+                    const uint8_t* pRaw = Sample + 36;
+                    if (36 + nRawSize <= Record.size && Format.nPrevPidOffset + sizeof(int32_t) <= nRawSize &&
+                        Format.nNextPidOffset + sizeof(int32_t) <= nRawSize && nCpu < PROFILE_CONTEXT_SWITCH_MAX_CPUS)
+                    {
+                        memcpy(&nPrevPid, pRaw + Format.nPrevPidOffset, sizeof(nPrevPid));
+                        memcpy(&nNextPid, pRaw + Format.nNextPidOffset, sizeof(nNextPid));
+
+                        // The tracepoint fires on the thread being switched out
+                        if (nTid)
+                        {
+                            ProfileTgidCacheEntry& Entry = pTgidCache[(nTid * 2654435761u) % PROFILE_CONTEXT_SWITCH_TGID_CACHE];
+                            Entry.nTid = nTid;
+                            Entry.nTgid = nPid;
+                        }
+
+                        ProfileContextSwitch Switch;
+                        Switch.nThreadOut = (ThreadID)nPrevPid;
+                        Switch.nThreadIn = (ThreadID)nNextPid;
+                        Switch.nProcessIn = ProfileGetThreadProcessId(pTgidCache, (uint32_t)nNextPid);
+                        Switch.nCpu = nCpu;
+                        Switch.nTicks = (int64_t)nTime + nTickOffset;
+                        arrpush(pSwitches, Switch);
+                    }
+                }
+                else if (PERF_RECORD_LOST == Record.type)
+                {
+                    uint64_t nLostRecord[3];
+                    ProfileRingRead(pData, nDataSize, nTail, nLostRecord, sizeof(nLostRecord));
+                    nLost += nLostRecord[2];
+                }
+
+                nTail += Record.size;
+            }
+
+            __atomic_store_n(&pHeader->data_tail, nTail, __ATOMIC_RELEASE);
+        }
+
+        // Search of the context switch buffer expects increasing ticks, cpu rings are only ordered on their own
+        sort(pSwitches, arrlenu(pSwitches), sizeof(ProfileContextSwitch), ProfileCompareContextSwitchTicks, NULL);
+        for (ptrdiff_t i = 0; i < arrlen(pSwitches); ++i)
+            ProfileContextSwitchPut(&pSwitches[i]);
+        arrsetlen(pSwitches, 0);
+    }
+    S.bContextSwitchRunning = false;
+
+    if (nLost)
+    {
+        LOGF(eINFO, "Context switch trace lost %llu sched_switch records, increase PROFILE_CONTEXT_SWITCH_RING_PAGES",
+             (unsigned long long)nLost);
+    }
+
+    for (uint32_t i = 0; i < nNumFds; ++i)
+    {
+        munmap(pRings[i], nPageSize + nDataSize);
+        close(Fds[i].fd);
+    }
+    arrfree(pSwitches);
+    tf_free(pTgidCache);
+}
 #endif
 #else
 void     ProfileContextSwitchTraceStart() {}
@@ -5153,6 +7206,14 @@ void  exitProfiler() {}
 void  flipProfiler() {}
 void  dumpProfileData(const char* appName, uint32_t nMaxFrames) {}
 void  dumpBenchmarkData(IApp::Settings* pSettings, const char* outFilename, const char* appName) {}
+void  startProfileTrace(const char* appName, ProfileTraceFormat format, uint32_t nFrames) {}
+void  stopProfileTrace() {}
+void  setProfileSampling(uint32_t nSamplesPerSecond) {}
+void  dumpProfileSamples(const char* appName) {}
+void  armProfileTraceOnFrameTime(const char* appName, ProfileTraceFormat format, float frameMs, uint32_t nFramesBefore,
+                                 uint32_t nFramesAfter)
+{
+}
 void  setAggregateFrames(uint32_t nFrames) {}
 float getCpuProfileTime(const char* pGroup, const char* pName, ThreadID* pThreadID) { return -1.0f; }
 float getCpuProfileAvgTime(const char* pGroup, const char* pName, ThreadID* pThreadID) { return -1.0f; }
@@ -5166,6 +7227,8 @@ float getCpuMaxFrameTime() { return -1.0f; }
 
 uint64_t     cpuProfileEnter(ProfileToken nToken) { return 0; }
 void         cpuProfileLeave(ProfileToken nToken, uint64_t nTick) {}
+void         initProfilerThread(const ProfilerThreadDesc* pDesc) {}
+uint64_t     getCpuProfileDroppedEvents(ThreadID* pThreadID) { return 0; }
 ProfileToken getCpuProfileToken(const char* pGroup, const char* pName, uint32_t nColor) { return PROFILE_INVALID_TOKEN; }
 
 float2 cmdDrawGpuProfile(Cmd* pCmd, float2 screenCoordsInPx, ProfileToken nProfileToken, FontDrawDesc* pDrawDesc) { return float2{}; }
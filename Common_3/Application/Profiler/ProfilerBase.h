@@ -176,6 +176,10 @@
     do                             \
     {                              \
     } while (0)
+#define ProfileOnThreadCreateEx(foo, size, flush) \
+    do                                            \
+    {                                             \
+    } while (0)
 #define ProfileFlip() \
     do                \
     {                 \
@@ -426,6 +430,15 @@ typedef uint16_t ProfileGroupId;
 #define PROFILE_PER_THREAD_GPU_BUFFER_SIZE (1024 << 10)
 #endif
 
+#ifndef PROFILE_PER_THREAD_FLUSH_MAX_SIZE
+// Most memory the flush thread holds for one flush-on-near-full thread log until its frames are aggregated, then events get dropped
+#define PROFILE_PER_THREAD_FLUSH_MAX_SIZE (64 << 20)
+#endif
+
+#ifndef PROFILE_LOG_FLUSH_INTERVAL_MS
+#define PROFILE_LOG_FLUSH_INTERVAL_MS 4
+#endif
+
 #ifndef PROFILE_MAX_FRAME_HISTORY
 #define PROFILE_MAX_FRAME_HISTORY 512
 #endif
@@ -532,6 +545,9 @@ PROFILE_API void ProfileForceEnableGroup(const char* pGroup, ProfileTokenType Ty
 PROFILE_API void ProfileForceDisableGroup(const char* pGroup, ProfileTokenType Type);
 
 PROFILE_API void ProfileOnThreadCreate(const char* pThreadName); // should be called from newly created threads
+// nLogSize is in log entries, 0 uses PROFILE_BUFFER_SIZE.
+// bFlushOnNearFull has the flush thread move a filling log out instead of dropping events
+PROFILE_API void ProfileOnThreadCreateEx(const char* pThreadName, uint32_t nLogSize, bool bFlushOnNearFull);
 PROFILE_API void ProfileOnThreadExit();                          // call on exit to reuse log
 PROFILE_API void ProfileSetForceEnable(bool bForceEnable);
 PROFILE_API bool ProfileGetForceEnable();
@@ -546,9 +562,9 @@ PROFILE_API void ProfileDisableMetaCounter(const char* pMet);
 PROFILE_API int  ProfileGetAggregateFrames();
 PROFILE_API int  ProfileGetCurrentAggregateFrames();
 PROFILE_API Profile* ProfileGet();
-PROFILE_API void     ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nRange[2][2]);
+PROFILE_API void     ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nLogSize, uint32_t nRange[2][2]);
 PROFILE_API Mutex&                   ProfileGetMutex();
-PROFILE_API struct ProfileThreadLog* ProfileCreateThreadLog(const char* pName);
+PROFILE_API struct ProfileThreadLog* ProfileCreateThreadLog(const char* pName, uint32_t nLogSize = 0);
 PROFILE_API void                     ProfileRemoveThreadLog(struct ProfileThreadLog* pLog);
 
 PROFILE_API void ProfileContextSwitchTraceStart();
@@ -604,6 +620,7 @@ struct ProfileScopeHandlerCpu
 #define PROFILE_GRAPH_HISTORY              128
 #define PROFILE_BUFFER_SIZE                ((PROFILE_PER_THREAD_BUFFER_SIZE) / sizeof(ProfileLogEntry))
 #define PROFILE_GPU_BUFFER_SIZE            ((PROFILE_PER_THREAD_GPU_BUFFER_SIZE) / sizeof(ProfileLogEntry))
+#define PROFILE_MIN_BUFFER_SIZE            (4 << 10)
 #define PROFILE_GPU_FRAMES                 ((PROFILE_GPU_FRAME_DELAY) + 1)
 #define PROFILE_MAX_CONTEXT_SWITCH_THREADS 256
 #define PROFILE_STACK_MAX                  32
@@ -637,11 +654,14 @@ struct ProfileScopeHandlerCpu
 
 // We disable context switch trace because it's unable to open the file needed, and because
 // no documentation was found on how to use this
+// Linux reads sched_switch through perf_event_open, which needs perf_event_paranoid <= 0 or CAP_PERFMON
 #ifndef PROFILE_CONTEXT_SWITCH_TRACE
 #if defined(_WINDOWS) || defined(XBOX)
 #define PROFILE_CONTEXT_SWITCH_TRACE 0
 #elif defined(__APPLE__) && !TARGET_OS_IPHONE
 #define PROFILE_CONTEXT_SWITCH_TRACE 0
+#elif defined(__linux__) && !defined(__ANDROID__)
+#define PROFILE_CONTEXT_SWITCH_TRACE 1
 #else
 #define PROFILE_CONTEXT_SWITCH_TRACE 0
 #endif
@@ -649,11 +669,29 @@ struct ProfileScopeHandlerCpu
 
 #if PROFILE_CONTEXT_SWITCH_TRACE
 #define PROFILE_CONTEXT_SWITCH_BUFFER_SIZE (128 * 1024) // 2mb with 16 byte entry size
+#define PROFILE_CONTEXT_SWITCH_MAX_CPUS    128          // nCpu of ProfileContextSwitch is a signed 8 bit field
 #else
 #define PROFILE_CONTEXT_SWITCH_BUFFER_SIZE (1)
 //-V:PROFILE_CONTEXT_SWITCH_BUFFER_SIZE:1063
 #endif
 
+// Stack sampling, see setProfileSampling. Every thread with a profiler log gets a timer on its own cpu time that
+// interrupts it with SIGPROF, the handler records a backtrace which the flip attributes to the zones open at that time
+#ifndef PROFILE_SAMPLING
+#if defined(__linux__) && !defined(__ANDROID__)
+#define PROFILE_SAMPLING 1
+#else
+#define PROFILE_SAMPLING 0
+#endif
+#endif
+
+#if PROFILE_SAMPLING
+#define PROFILE_SAMPLE_BUFFER_SIZE 1024 // per thread, has to hold the samples of PROFILE_GPU_FRAMES frames
+#define PROFILE_SAMPLE_MAX_DEPTH   32
+#define PROFILE_SAMPLE_MAX_NODES   (1 << 20) // call tree nodes, 24 bytes each
+#define PROFILE_SAMPLE_MAX_RATE    10000     // samples per second of thread cpu time
+#endif
+
 #ifndef PROFILE_MINIZ
 #define PROFILE_MINIZ 0
 #endif
@@ -797,20 +835,41 @@ struct ProfileFrameState
     uint32_t nLogStart[PROFILE_MAX_THREADS];
 };
 
+// Entries the flush thread moved out of a thread log, aggregated with the rest of their frame on flip
+struct ProfileLogSpill
+{
+    ProfileLogEntry* pEntries;
+    uint32_t         nCount;
+    uint64_t         nFrameIndex; // nFramePutIndex of the frame the entries were logged in
+};
+
 struct ProfileThreadLog
 {
     ProfileLogEntry* Log;
     tfrg_atomic32_t  nPut;
     tfrg_atomic32_t  nGet;
+    uint32_t         nLogSize;
+    // Events lost to a full log, only the owning thread adds to it
+    tfrg_atomic64_t  nDropped;
+    uint64_t         nDroppedReported;
+
+    uint32_t         bFlushOnNearFull;
+    tfrg_atomic32_t  nFlushRequest;
+    ProfileLogSpill* pSpills; // stb array, guarded by the profile mutex
+    // Stack samples not yet attributed to a zone, NULL when the thread was never sampled
+    struct ProfileSampleRing* pSampleRing;
 
     uint32_t     nGpu;
     ThreadID     nThreadId;
+    // Id the scheduler reports in context switches, the kernel tid on Linux
+    ThreadID     nSystemThreadId;
     uint32_t     nLogIndex;
     ProfileToken nGpuToken;
 
-    uint32_t nStack[PROFILE_STACK_MAX];
-    int64_t  nChildTickStack[PROFILE_STACK_MAX];
-    uint32_t nStackPos;
+    // Enter entries rather than log positions, spilled entries are no longer in Log
+    ProfileLogEntry nStack[PROFILE_STACK_MAX];
+    int64_t         nChildTickStack[PROFILE_STACK_MAX];
+    uint32_t        nStackPos;
 
     uint8_t nGroupStackPos[PROFILE_MAX_GROUPS];
     int64_t nGroupTicks[PROFILE_MAX_GROUPS];
@@ -858,7 +917,7 @@ struct Profile
     uint32_t nAllGroupsWanted;
     uint32_t nAllThreadsWanted;
 
-    uint32_t nOverflow;
+    uint32_t nOverflow; // frames until dropped events get reported again
 
     uint64_t        nGroupMask;
     uint64_t        nGroupMaskGpu;
@@ -965,6 +1024,12 @@ struct Profile
     uint32_t             nContextSwitchPut;
     ProfileContextSwitch ContextSwitch[PROFILE_CONTEXT_SWITCH_BUFFER_SIZE];
 
+    ProfileThread     LogFlushThread;
+    Mutex             LogFlushMutex;
+    ConditionVariable LogFlushCondition;
+    bool              bLogFlushWake;
+    bool              bLogFlushStop;
+
     ProfileThread WebServerThread;
 
     MpSocket WebServerSocket;
@@ -974,7 +1039,7 @@ struct Profile
     uint32_t nWebServerPut;
     uint64_t nWebServerDataSent;
 
-    tfrg_atomic64_t LabelBuffer;
+    tfrg_atomicptr_t LabelBuffer;
     tfrg_atomic64_t nLabelPut;
 
     char               CounterNames[PROFILE_MAX_COUNTER_NAME_CHARS];
@@ -2165,6 +2165,7 @@ void removeWidget(UIWidget* pWidget, bool freeUnderlying)
 UIWidget* uiAddDynamicWidgets(DynamicUIWidgets* pDynamicUI, const char* pLabel, const void* pWidget, WidgetType type)
 {
 #ifdef ENABLE_FORGE_UI
+    MEMORY_TAG_SCOPE(MEMORY_TAG_UI);
     UIWidget widget{};
     widget.mType = type;
     widget.pWidget = (void*)pWidget;
@@ -2219,6 +2220,7 @@ void uiRemoveDynamicWidgets(DynamicUIWidgets* pDynamicUI)
 void uiAddComponent(const char* pTitle, const UIComponentDesc* pDesc, UIComponent** ppUIComponent)
 {
 #ifdef ENABLE_FORGE_UI
+    MEMORY_TAG_SCOPE(MEMORY_TAG_UI);
     ASSERT(ppUIComponent);
     UIComponent* pComponent = (UIComponent*)(tf_calloc(1, sizeof(UIComponent)));
     pComponent->mHasCloseButton = false;
@@ -2339,6 +2341,7 @@ void uiSetComponentActive(UIComponent* pUIComponent, bool active)
 UIWidget* uiAddComponentWidget(UIComponent* pGui, const char* pLabel, const void* pWidget, WidgetType type, bool clone /* = true*/)
 {
 #ifdef ENABLE_FORGE_UI
+    MEMORY_TAG_SCOPE(MEMORY_TAG_UI);
     UIWidget* pBaseWidget = (UIWidget*)tf_calloc(1, sizeof(UIWidget));
     pBaseWidget->mType = type;
     pBaseWidget->pWidget = (void*)pWidget;
@@ -2605,23 +2608,17 @@ void platformUpdateUserInterface(float deltaTime)
         }
     }
 
-    // (UIComponent*)[dyn_size]
-    UIComponent** activeComponents = NULL;
-    arrsetcap(activeComponents, arrlen(pUserInterface->mComponents));
+    // Rebuilt every frame, so it goes to the frame arena
+    UIComponent** activeComponents = (UIComponent**)tf_frame_malloc(arrlenu(pUserInterface->mComponents) * sizeof(UIComponent*));
+    uint32_t      activeComponentCount = 0;
 
-    for (ptrdiff_t i = 0; i < arrlen(pUserInterface->mComponents); ++i)
+    for (ptrdiff_t i = 0; activeComponents && i < arrlen(pUserInterface->mComponents); ++i)
         if (pUserInterface->mComponents[i]->mActive)
-            arrpush(activeComponents, pUserInterface->mComponents[i]);
-
-    if (arrlen(activeComponents) == 0)
-    {
-        if (arrcap(activeComponents) > 0)
-            arrfree(activeComponents);
-    }
+            activeComponents[activeComponentCount++] = pUserInterface->mComponents[i];
 
     GUIDriverUpdate guiUpdate = {};
-    guiUpdate.pUIComponents = activeComponents;
-    guiUpdate.componentCount = (uint32_t)arrlenu(activeComponents);
+    guiUpdate.pUIComponents = activeComponentCount ? activeComponents : NULL;
+    guiUpdate.componentCount = activeComponentCount;
     guiUpdate.deltaTime = deltaTime;
     guiUpdate.width = pUserInterface->mDisplayWidth;
     guiUpdate.height = pUserInterface->mDisplayHeight;
@@ -2784,8 +2781,6 @@ void platformUpdateUserInterface(float deltaTime)
         }
     }
 
-    arrfree(activeComponents);
-
     extern void updateProfilerUI();
     updateProfilerUI();
 #endif
@@ -2910,6 +2905,7 @@ static void cmdDrawUICommand(Cmd* pCmd, const ImDrawCmd* pImDrawCmd, const float
 void initUserInterface(UserInterfaceDesc* pDesc)
 {
 #ifdef ENABLE_FORGE_UI
+    MEMORY_TAG_SCOPE(MEMORY_TAG_UI);
     pUserInterface->pRenderer = pDesc->pRenderer;
     pUserInterface->pPipelineCache = pDesc->pCache;
     pUserInterface->mMaxDynamicUIUpdatesPerBatch = pDesc->mMaxDynamicUIUpdatesPerBatch;
@@ -3228,6 +3224,7 @@ void drawVirtualJoystick(Cmd* pCmd, const float4* color, uint64_t vOffset)
 void loadUserInterface(const UserInterfaceLoadDesc* pDesc)
 {
 #ifdef ENABLE_FORGE_UI
+    MEMORY_TAG_SCOPE(MEMORY_TAG_UI);
     if (pDesc->mLoadType & (RELOAD_TYPE_SHADER | RELOAD_TYPE_RENDERTARGET))
     {
         if (pDesc->mLoadType & RELOAD_TYPE_SHADER)
@@ -3369,6 +3366,7 @@ void unloadUserInterface(uint32_t unloadType)
 void cmdDrawUserInterface(Cmd* pCmd)
 {
 #ifdef ENABLE_FORGE_UI
+    MEMORY_TAG_SCOPE(MEMORY_TAG_UI);
 
     // Early return if UI rendering has been disabled
     if (!pUserInterface->mEnableRendering)
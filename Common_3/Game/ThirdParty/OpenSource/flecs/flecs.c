@@ -14019,17 +14019,17 @@ void tf_flecs_cond_wait(ecs_os_cond_t cond, ecs_os_mutex_t mtx)
 
 int tf_flecs_ainc(int32_t *a)
 {
-    const int prev = (int)tfrg_atomic32_add_relaxed(a, 1);
+    const int prev = (int)tfrg_atomic32_add_acq_rel(a, 1);
     
-    // We do +1 because tfrg_atomic32_add_relaxed returns the original value of the variable, flecs expects the changed one
+    // We do +1 because tfrg_atomic32_add_acq_rel returns the original value of the variable, flecs expects the changed one
     return prev + 1;
 }
 
 int tf_flecs_adec(int32_t *a)
 {
-    const int prev = (int)tfrg_atomic32_add_relaxed(a, -1);
+    const int prev = (int)tfrg_atomic32_add_acq_rel(a, -1);
     
-    // We do -1 because tfrg_atomic32_add_relaxed returns the original value of the variable, flecs expects the changed one
+    // We do -1 because tfrg_atomic32_add_acq_rel returns the original value of the variable, flecs expects the changed one
     return prev - 1;
 }
 
@@ -6430,11 +6430,20 @@ void cmdDispatch(Cmd* pCmd, uint32_t groupCountX, uint32_t groupCountY, uint32_t
 #endif
 }
 
+// Barrier batches up to this size stay on the stack, larger ones go to the heap.
+// Barrier count has no upper bound, so alloca could overflow small task fiber stacks.
+static const uint32_t gMaxStackResourceBarriers = 32;
+
 void cmdResourceBarrier(Cmd* pCmd, uint32_t numBufferBarriers, BufferBarrier* pBufferBarriers, uint32_t numTextureBarriers,
                         TextureBarrier* pTextureBarriers, uint32_t numRtBarriers, RenderTargetBarrier* pRtBarriers)
 {
-    D3D12_RESOURCE_BARRIER* barriers =
-        (D3D12_RESOURCE_BARRIER*)alloca((numBufferBarriers + numTextureBarriers + numRtBarriers) * sizeof(D3D12_RESOURCE_BARRIER));
+    D3D12_RESOURCE_BARRIER  stackBarriers[gMaxStackResourceBarriers];
+    D3D12_RESOURCE_BARRIER* barriers = stackBarriers;
+    if (numBufferBarriers + numTextureBarriers + numRtBarriers > gMaxStackResourceBarriers)
+    {
+        barriers =
+            (D3D12_RESOURCE_BARRIER*)tf_malloc((numBufferBarriers + numTextureBarriers + numRtBarriers) * sizeof(D3D12_RESOURCE_BARRIER));
+    }
     uint32_t transitionCount = 0;
 
 #if defined(ENABLE_GRAPHICS_VALIDATION) && defined(_WINDOWS)
@@ -6619,6 +6628,11 @@ void cmdResourceBarrier(Cmd* pCmd, uint32_t numBufferBarriers, BufferBarrier* pB
             pCmd->mDx.pCmdList->ResourceBarrier(transitionCount, barriers);
         }
     }
+
+    if (barriers != stackBarriers)
+    {
+        tf_free(barriers);
+    }
 }
 
 void cmdUpdateBuffer(Cmd* pCmd, Buffer* pBuffer, uint64_t dstOffset, Buffer* pSrcBuffer, uint64_t srcOffset, uint64_t size)
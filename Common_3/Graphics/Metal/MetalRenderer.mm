@@ -4992,7 +4992,7 @@ void queueSubmit(Queue* pQueue, const QueueSubmitDesc* pDesc)
         for (uint32_t i = 0; i < cmdCount; i++)
         {
             [ppCmds[i]->pCommandBuffer addCompletedHandler:^(id<MTLCommandBuffer> buffer) {
-                uint32_t handlersCalled = 1u + tfrg_atomic32_add_relaxed(&commandsFinished, 1);
+                uint32_t handlersCalled = 1u + tfrg_atomic32_add_acq_rel(&commandsFinished, 1);
 
                 if (handlersCalled == cmdCount)
                 {
@@ -8648,13 +8648,19 @@ void cmdDispatch(Cmd* pCmd, uint32_t groupCountX, uint32_t groupCountY, uint32_t
     vkCmdDispatch(pCmd->mVk.pCmdBuf, groupCountX, groupCountY, groupCountZ);
 }
 
+// Barrier batches up to this size stay on the stack, larger ones go to the heap.
+// Barrier count has no upper bound, so alloca could overflow small task fiber stacks.
+static const uint32_t VK_MAX_STACK_IMAGE_BARRIERS = 32;
+
 void cmdResourceBarrier(Cmd* pCmd, uint32_t numBufferBarriers, BufferBarrier* pBufferBarriers, uint32_t numTextureBarriers,
                         TextureBarrier* pTextureBarriers, uint32_t numRtBarriers, RenderTargetBarrier* pRtBarriers)
 {
-    VkImageMemoryBarrier* imageBarriers =
-        (numTextureBarriers + numRtBarriers)
-            ? (VkImageMemoryBarrier*)alloca((numTextureBarriers + numRtBarriers) * sizeof(VkImageMemoryBarrier))
-            : NULL;
+    VkImageMemoryBarrier  stackImageBarriers[VK_MAX_STACK_IMAGE_BARRIERS];
+    VkImageMemoryBarrier* imageBarriers = stackImageBarriers;
+    if (numTextureBarriers + numRtBarriers > VK_MAX_STACK_IMAGE_BARRIERS)
+    {
+        imageBarriers = (VkImageMemoryBarrier*)tf_malloc((numTextureBarriers + numRtBarriers) * sizeof(VkImageMemoryBarrier));
+    }
     uint32_t imageBarrierCount = 0;
 
     VkMemoryBarrier memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
@@ -8815,6 +8821,11 @@ void cmdResourceBarrier(Cmd* pCmd, uint32_t numBufferBarriers, BufferBarrier* pB
         vkCmdPipelineBarrier(pCmd->mVk.pCmdBuf, srcStageMask, dstStageMask, 0, memoryBarrier.srcAccessMask ? 1 : 0,
                              memoryBarrier.srcAccessMask ? &memoryBarrier : NULL, 0, NULL, imageBarrierCount, imageBarriers);
     }
+
+    if (imageBarriers != stackImageBarriers)
+    {
+        tf_free(imageBarriers);
+    }
 }
 
 void cmdUpdateBuffer(Cmd* pCmd, Buffer* pBuffer, uint64_t dstOffset, Buffer* pSrcBuffer, uint64_t srcOffset, uint64_t size)
@@ -915,6 +915,7 @@ int AndroidMain(void* param, IApp* app)
         {
             pApp->Draw();
             baseSubsystemAppDrawn = true;
+            tf_frame_arena_end_frame();
         }
 
         if (gShowPlatformUI != pApp->mSettings.mShowPlatformUI)
@@ -27,9 +27,13 @@
 #define _GNU_SOURCE // sched_setaffinity
 #define __USE_GNU
 
+#include <limits.h>
+#include <linux/futex.h>
 #include <sched.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #include "../../Utilities/Interfaces/ILog.h"
 #include "../../Utilities/Interfaces/IThread.h"
@@ -48,7 +52,14 @@ void callOnce(CallOnceGuard* pGuard, CallOnceFn pFn) { pthread_once(pGuard, pFn)
 
 bool initMutex(Mutex* pMutex)
 {
-    pMutex->mSpinCount = MUTEX_DEFAULT_SPIN_COUNT;
+    MutexDesc desc = { 0 };
+    return initMutexDesc(pMutex, &desc);
+}
+
+// Futex Mutex is Linux only, spin count is still honored
+bool initMutexDesc(Mutex* pMutex, const MutexDesc* pDesc)
+{
+    pMutex->mSpinCount = pDesc->spinCount ? pDesc->spinCount : MUTEX_DEFAULT_SPIN_COUNT;
     pMutex->pHandle = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
     pthread_mutexattr_t attr;
     int                 status = pthread_mutexattr_init(&attr);
@@ -80,6 +91,13 @@ void releaseMutex(Mutex* pMutex) { pthread_mutex_unlock(&pMutex->pHandle); }
 
 bool initConditionVariable(ConditionVariable* pCv)
 {
+    ConditionVariableDesc desc = { 0 };
+    return initConditionVariableDesc(pCv, &desc);
+}
+
+bool initConditionVariableDesc(ConditionVariable* pCv, const ConditionVariableDesc* pDesc)
+{
+    UNREF_PARAM(pDesc);
     pCv->pHandle = (pthread_cond_t)PTHREAD_COND_INITIALIZER;
     int res = pthread_cond_init(&pCv->pHandle, NULL);
     ASSERT(res == 0);
@@ -116,6 +134,28 @@ void wakeOneConditionVariable(ConditionVariable* pCv) { pthread_cond_signal(&pCv
 
 void wakeAllConditionVariable(ConditionVariable* pCv) { pthread_cond_broadcast(&pCv->pHandle); }
 
+static void futexWait(volatile uint32_t* address, uint32_t expected, uint32_t ms)
+{
+    struct timespec  timeout;
+    struct timespec* pTimeout = NULL;
+    if (ms != TIMEOUT_INFINITE)
+    {
+        timeout.tv_sec = ms / 1000;
+        timeout.tv_nsec = (long)(ms % 1000) * (long)NSEC_PER_MSEC;
+        pTimeout = &timeout;
+    }
+    // EAGAIN (value changed), EINTR and ETIMEDOUT are all fine, caller rechecks
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, pTimeout, NULL, 0);
+}
+
+static void futexWake(volatile uint32_t* address, int count) { syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0); }
+
+void waitAddress(volatile uint32_t* address, uint32_t expected, uint32_t ms) { futexWait(address, expected, ms); }
+
+void wakeOneAddress(volatile uint32_t* address) { futexWake(address, 1); }
+
+void wakeAllAddress(volatile uint32_t* address) { futexWake(address, INT_MAX); }
+
 static ThreadID mainThreadID = 0;
 
 /*  void Thread::SetPriority(int priority)
@@ -184,6 +224,8 @@ void* ThreadFunctionStatic(void* data)
     }
 
     item.pFunc(item.pData);
+    exitLogThread();
+    exitMemAllocThread();
     return 0;
 }
 
@@ -52,7 +52,14 @@ void callOnce(CallOnceGuard* pGuard, CallOnceFn pFn) { pthread_once(pGuard, pFn)
 
 bool initMutex(Mutex* pMutex)
 {
-    pMutex->mSpinCount = MUTEX_DEFAULT_SPIN_COUNT;
+    MutexDesc desc = { 0 };
+    return initMutexDesc(pMutex, &desc);
+}
+
+// Futex Mutex is Linux only, spin count is still honored
+bool initMutexDesc(Mutex* pMutex, const MutexDesc* pDesc)
+{
+    pMutex->mSpinCount = pDesc->spinCount ? pDesc->spinCount : MUTEX_DEFAULT_SPIN_COUNT;
     pMutex->pHandle = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
     pthread_mutexattr_t attr;
     int                 status = pthread_mutexattr_init(&attr);
@@ -85,6 +92,13 @@ void releaseMutex(Mutex* pMutex) { pthread_mutex_unlock(&pMutex->pHandle); }
 
 bool initConditionVariable(ConditionVariable* pCv)
 {
+    ConditionVariableDesc desc = { 0 };
+    return initConditionVariableDesc(pCv, &desc);
+}
+
+bool initConditionVariableDesc(ConditionVariable* pCv, const ConditionVariableDesc* pDesc)
+{
+    UNREF_PARAM(pDesc);
     pCv->pHandle = (pthread_cond_t)PTHREAD_COND_INITIALIZER;
     int res = pthread_cond_init(&pCv->pHandle, NULL);
     ASSERT(res == 0);
@@ -115,6 +129,73 @@ void wakeOneConditionVariable(ConditionVariable* pCv) { pthread_cond_signal(&pCv
 
 void wakeAllConditionVariable(ConditionVariable* pCv) { pthread_cond_broadcast(&pCv->pHandle); }
 
+// There is no public futex before macOS 14.4 / iOS 17.4,
+// so address waits park on one of a few hashed mutex + condition pairs.
+// Waiter compares value under bucket lock and waker takes the same lock before signaling,
+// which closes the window between the compare and the sleep.
+#define ADDRESS_WAIT_BUCKET_COUNT 64
+
+typedef struct AddressWaitBucket
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    uint8_t         padding[64];
+} AddressWaitBucket;
+
+static AddressWaitBucket gAddressWaitBuckets[ADDRESS_WAIT_BUCKET_COUNT];
+static pthread_once_t    gAddressWaitBucketsOnce = PTHREAD_ONCE_INIT;
+
+static void initAddressWaitBuckets(void)
+{
+    for (uint32_t i = 0; i < ADDRESS_WAIT_BUCKET_COUNT; ++i)
+    {
+        pthread_mutex_init(&gAddressWaitBuckets[i].mutex, NULL);
+        pthread_cond_init(&gAddressWaitBuckets[i].cond, NULL);
+    }
+}
+
+static AddressWaitBucket* getAddressWaitBucket(volatile uint32_t* address)
+{
+    pthread_once(&gAddressWaitBucketsOnce, initAddressWaitBuckets);
+    uintptr_t key = (uintptr_t)address >> 2;
+    return &gAddressWaitBuckets[(key ^ (key >> 6)) % ADDRESS_WAIT_BUCKET_COUNT];
+}
+
+void waitAddress(volatile uint32_t* address, uint32_t expected, uint32_t ms)
+{
+    AddressWaitBucket* bucket = getAddressWaitBucket(address);
+    pthread_mutex_lock(&bucket->mutex);
+    if (__atomic_load_n(address, __ATOMIC_ACQUIRE) == expected)
+    {
+        if (ms == TIMEOUT_INFINITE)
+        {
+            pthread_cond_wait(&bucket->cond, &bucket->mutex);
+        }
+        else
+        {
+            struct timespec time;
+            time.tv_sec = ms / 1000;
+            time.tv_nsec = (ms % 1000) * NSEC_PER_MSEC;
+            pthread_cond_timedwait_relative_np(&bucket->cond, &bucket->mutex, &time);
+        }
+    }
+    pthread_mutex_unlock(&bucket->mutex);
+}
+
+void wakeOneAddress(volatile uint32_t* address)
+{
+    // Bucket can be shared with other addresses, waking one could pick wrong waiter
+    wakeAllAddress(address);
+}
+
+void wakeAllAddress(volatile uint32_t* address)
+{
+    AddressWaitBucket* bucket = getAddressWaitBucket(address);
+    pthread_mutex_lock(&bucket->mutex);
+    pthread_cond_broadcast(&bucket->cond);
+    pthread_mutex_unlock(&bucket->mutex);
+}
+
 static ThreadID mainThreadID;
 
 /*  void Thread::SetPriority(int priority)
@@ -157,6 +238,8 @@ void* ThreadFunctionStatic(void* data)
     // TODO: implement affinity mask, if Apple at some point allows to set it.
 
     item.pFunc(item.pData);
+    exitLogThread();
+    exitMemAllocThread();
     return 0;
 }
 
@@ -666,6 +666,7 @@ char     benchmarkOutput[1024] = { "\0" };
 
     pApp->Draw();
     gBaseSubsystemAppDrawn = true;
+    tf_frame_arena_end_frame();
 
     if (gShowPlatformUI != pApp->mSettings.mShowPlatformUI)
     {
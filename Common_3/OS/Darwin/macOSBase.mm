@@ -766,6 +766,7 @@ char     benchmarkOutput[1024] = { "\0" };
 
     pApp->Draw();
     gBaseSubsystemAppDrawn = true;
+    tf_frame_arena_end_frame();
 
     if (gShowPlatformUI != pApp->mSettings.mShowPlatformUI)
     {
@@ -433,6 +433,7 @@ int LinuxMain(int argc, char** argv, IApp* app)
 
 #ifdef AUTOMATED_TESTING
     char benchmarkOutput[1024] = { "\0" };
+    bool headless = false;
     // Check if benchmarking was given through command line
     for (int i = 0; i < argc; i += 1)
     {
@@ -456,6 +457,11 @@ int LinuxMain(int argc, char** argv, IApp* app)
         {
             strcpy(benchmarkOutput, argv[i + 1]);
         }
+        // Benchmark without showing the window, frames are still rendered and presented to it
+        else if (strcmp(argv[i], "--headless") == 0)
+        {
+            headless = true;
+        }
     }
 #endif
 
@@ -481,6 +487,8 @@ int LinuxMain(int argc, char** argv, IApp* app)
 #ifdef AUTOMATED_TESTING
     if (pSettings->mBenchmarking)
         setAggregateFrames(targetFrameCount / 2);
+    if (headless)
+        hideWindow(&gWindow);
 #endif
 
     initCpuInfo(&gCpu);
@@ -509,6 +517,12 @@ int LinuxMain(int argc, char** argv, IApp* app)
 
         gQuit = handleMessages(gWindowDesc);
 
+#ifdef AUTOMATED_TESTING
+        // Window managers may report the hidden window as minimized, which would stop the benchmark
+        if (headless)
+            gWindow.minimized = false;
+#endif
+
         // UPDATE BASE INTERFACES
         updateBaseSubsystems(deltaTime, baseSubsystemAppDrawn);
         baseSubsystemAppDrawn = false;
@@ -544,6 +558,7 @@ int LinuxMain(int argc, char** argv, IApp* app)
         pApp->Update(deltaTime);
         pApp->Draw();
         baseSubsystemAppDrawn = true;
+        tf_frame_arena_end_frame();
 
         if (gShowPlatformUI != pApp->mSettings.mShowPlatformUI)
         {
@@ -32,6 +32,7 @@
 #include "../../Utilities/Interfaces/IThread.h"
 #include "../Interfaces/IOperatingSystem.h"
 
+#include "../../Utilities/Threading/Atomics.h"
 #include "../../Utilities/Threading/UnixThreadID.h"
 
 #include "../../Utilities/Interfaces/IMemory.h"
@@ -72,7 +73,11 @@ size_t GetActiveTime(const CPUData* e)
 
 #endif
 
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #define NSEC_PER_USEC 1000ull
 #define USEC_PER_SEC  1000000ull
@@ -81,9 +86,42 @@ size_t GetActiveTime(const CPUData* e)
 
 void callOnce(CallOnceGuard* pGuard, CallOnceFn pFn) { pthread_once(pGuard, pFn); }
 
+static void futexWait(volatile uint32_t* address, uint32_t expected, uint32_t ms)
+{
+    struct timespec  timeout;
+    struct timespec* pTimeout = NULL;
+    if (ms != TIMEOUT_INFINITE)
+    {
+        timeout.tv_sec = ms / 1000;
+        timeout.tv_nsec = (long)(ms % 1000) * (long)NSEC_PER_MSEC;
+        pTimeout = &timeout;
+    }
+    // EAGAIN (value changed), EINTR and ETIMEDOUT are all fine, caller rechecks
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, pTimeout, NULL, 0);
+}
+
+static void futexWake(volatile uint32_t* address, int count) { syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0); }
+
 bool initMutex(Mutex* pMutex)
 {
-    pMutex->mSpinCount = MUTEX_DEFAULT_SPIN_COUNT;
+    MutexDesc desc = { 0 };
+    return initMutexDesc(pMutex, &desc);
+}
+
+bool initMutexDesc(Mutex* pMutex, const MutexDesc* pDesc)
+{
+    memset(pMutex, 0, sizeof *pMutex);
+    if (pDesc->futex)
+    {
+        pMutex->mFutexMutex = true;
+        pMutex->mSpinCount = pDesc->spinCount ? pDesc->spinCount : MUTEX_FUTEX_DEFAULT_SPIN_COUNT;
+        // On single core the owner can't run while we spin
+        if (getNumCPUCores() == 1)
+            pMutex->mSpinCount = 0;
+        return true;
+    }
+
+    pMutex->mSpinCount = pDesc->spinCount ? pDesc->spinCount : MUTEX_DEFAULT_SPIN_COUNT;
     pMutex->pHandle = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
     pthread_mutexattr_t attr;
     int                 status = pthread_mutexattr_init(&attr);
@@ -93,10 +131,103 @@ bool initMutex(Mutex* pMutex)
     return status == 0;
 }
 
-void exitMutex(Mutex* pMutex) { pthread_mutex_destroy(&pMutex->pHandle); }
+void exitMutex(Mutex* pMutex)
+{
+    if (pMutex->mFutexMutex)
+    {
+        ASSERT(tfrg_atomic32_load_relaxed(&pMutex->mFutex) == 0 && "Mutex is destroyed while locked");
+        return;
+    }
+    pthread_mutex_destroy(&pMutex->pHandle);
+}
+
+// getCurrentThreadID goes through pthread_getspecific, too slow for every lock
+static THREAD_LOCAL uint32_t gFutexMutexThreadId;
+
+static inline uint32_t futexMutexSelf(void)
+{
+    if (!gFutexMutexThreadId)
+        gFutexMutexThreadId = (uint32_t)getCurrentThreadID();
+    return gFutexMutexThreadId;
+}
+
+// Recursive, like pthread based Mutex.
+// Only the owner writes its id into mOwner, so seeing own id means we hold the lock.
+static inline bool futexMutexTryRecursion(Mutex* pMutex, uint32_t self)
+{
+    if (tfrg_atomic32_load_relaxed(&pMutex->mOwner) != self)
+        return false;
+    ++pMutex->mRecursion;
+    return true;
+}
+
+// Plain store, tfrg_atomic32_store_* is an exchange and would double the cost of uncontended lock
+static inline void futexMutexSetOwner(Mutex* pMutex, uint32_t owner) { __atomic_store_n(&pMutex->mOwner, owner, __ATOMIC_RELAXED); }
+
+static void acquireFutexMutex(Mutex* pMutex)
+{
+    uint32_t self = futexMutexSelf();
+    if (futexMutexTryRecursion(pMutex, self))
+        return;
+
+    uint32_t state = tfrg_atomic32_cas_acq_rel(&pMutex->mFutex, 0, 1);
+    if (state != 0)
+    {
+        for (uint32_t i = 0; i < pMutex->mSpinCount; ++i)
+        {
+            tfrg_cpu_pause();
+            state = tfrg_atomic32_load_relaxed(&pMutex->mFutex);
+            if (state == 0 && (state = tfrg_atomic32_cas_acq_rel(&pMutex->mFutex, 0, 1)) == 0)
+                break;
+        }
+
+        // Mark lock as contended, so the owner wakes us on release.
+        // We don't know if we are the last sleeper, so lock taken here stays in contended state.
+        while (state != 0)
+        {
+            if (state == 2 || tfrg_atomic32_cas_acq_rel(&pMutex->mFutex, 1, 2) != 0)
+                futexWait(&pMutex->mFutex, 2, TIMEOUT_INFINITE);
+            state = tfrg_atomic32_cas_acq_rel(&pMutex->mFutex, 0, 2);
+        }
+    }
+
+    futexMutexSetOwner(pMutex, self);
+    pMutex->mRecursion = 1;
+}
+
+static bool tryAcquireFutexMutex(Mutex* pMutex)
+{
+    uint32_t self = futexMutexSelf();
+    if (futexMutexTryRecursion(pMutex, self))
+        return true;
+
+    if (tfrg_atomic32_cas_acq_rel(&pMutex->mFutex, 0, 1) != 0)
+        return false;
+
+    futexMutexSetOwner(pMutex, self);
+    pMutex->mRecursion = 1;
+    return true;
+}
+
+static void releaseFutexMutex(Mutex* pMutex)
+{
+    ASSERT(tfrg_atomic32_load_relaxed(&pMutex->mOwner) == futexMutexSelf() && "Mutex is released by non owner");
+    if (--pMutex->mRecursion > 0)
+        return;
+
+    futexMutexSetOwner(pMutex, 0);
+    if (tfrg_atomic32_store_release(&pMutex->mFutex, 0) == 2)
+        futexWake(&pMutex->mFutex, 1);
+}
 
 void acquireMutex(Mutex* pMutex)
 {
+    if (pMutex->mFutexMutex)
+    {
+        acquireFutexMutex(pMutex);
+        return;
+    }
+
     uint32_t count = 0;
 
     while (count < pMutex->mSpinCount && pthread_mutex_trylock(&pMutex->pHandle) != 0)
@@ -109,22 +240,86 @@ void acquireMutex(Mutex* pMutex)
     }
 }
 
-bool tryAcquireMutex(Mutex* pMutex) { return pthread_mutex_trylock(&pMutex->pHandle) == 0; }
+bool tryAcquireMutex(Mutex* pMutex)
+{
+    if (pMutex->mFutexMutex)
+        return tryAcquireFutexMutex(pMutex);
+    return pthread_mutex_trylock(&pMutex->pHandle) == 0;
+}
 
-void releaseMutex(Mutex* pMutex) { pthread_mutex_unlock(&pMutex->pHandle); }
+void releaseMutex(Mutex* pMutex)
+{
+    if (pMutex->mFutexMutex)
+    {
+        releaseFutexMutex(pMutex);
+        return;
+    }
+    pthread_mutex_unlock(&pMutex->pHandle);
+}
 
 bool initConditionVariable(ConditionVariable* pCv)
 {
+    ConditionVariableDesc desc = { 0 };
+    return initConditionVariableDesc(pCv, &desc);
+}
+
+bool initConditionVariableDesc(ConditionVariable* pCv, const ConditionVariableDesc* pDesc)
+{
+    memset(pCv, 0, sizeof *pCv);
+    if (pDesc->futex)
+    {
+        pCv->mFutexCondition = true;
+        return true;
+    }
+
     pCv->pHandle = (pthread_cond_t)PTHREAD_COND_INITIALIZER;
     int res = pthread_cond_init(&pCv->pHandle, NULL);
     ASSERT(res == 0);
     return res == 0;
 }
 
-void exitConditionVariable(ConditionVariable* pCv) { pthread_cond_destroy(&pCv->pHandle); }
+void exitConditionVariable(ConditionVariable* pCv)
+{
+    if (!pCv->mFutexCondition)
+        pthread_cond_destroy(&pCv->pHandle);
+}
+
+static void waitFutexConditionVariable(ConditionVariable* pCv, Mutex* mutex, uint32_t ms)
+{
+    ASSERTMSG(!mutex->mFutexMutex || mutex->mRecursion == 1, "Recursively locked Mutex can't be released by wait");
+
+    tfrg_atomic32_add_relaxed(&pCv->mWaiterCount, 1);
+    // Read under the lock: any wake after we unlock changes the value, so the wait below returns right away
+    uint32_t sequence = tfrg_atomic32_load_acquire(&pCv->mSequence);
+
+    releaseMutex(mutex);
+    futexWait(&pCv->mSequence, sequence, ms);
+    acquireMutex(mutex);
+
+    tfrg_atomic32_add_relaxed(&pCv->mWaiterCount, (uint32_t)-1);
+}
+
+static void wakeFutexConditionVariable(ConditionVariable* pCv, int count)
+{
+    // Waiter count is changed under the mutex, and wakes are usually sent under it too.
+    // Fence covers the case of waking after unlocking.
+    tfrg_memorybarrier_full();
+    if (tfrg_atomic32_load_relaxed(&pCv->mWaiterCount) == 0)
+        return;
+    tfrg_atomic32_add_acq_rel(&pCv->mSequence, 1);
+    futexWake(&pCv->mSequence, count);
+}
 
 void waitConditionVariable(ConditionVariable* pCv, Mutex* mutex, uint32_t ms)
 {
+    if (pCv->mFutexCondition)
+    {
+        waitFutexConditionVariable(pCv, mutex, ms);
+        return;
+    }
+
+    ASSERTMSG(!mutex->mFutexMutex, "Futex Mutex requires futex ConditionVariable");
+
     pthread_mutex_t* mutexHandle = (pthread_mutex_t*)&mutex->pHandle;
     if (ms == TIMEOUT_INFINITE)
     {
@@ -139,9 +334,31 @@ void waitConditionVariable(ConditionVariable* pCv, Mutex* mutex, uint32_t ms)
     acquireMutex(mutex);
 }
 
-void wakeOneConditionVariable(ConditionVariable* pCv) { pthread_cond_signal(&pCv->pHandle); }
+void wakeOneConditionVariable(ConditionVariable* pCv)
+{
+    if (pCv->mFutexCondition)
+    {
+        wakeFutexConditionVariable(pCv, 1);
+        return;
+    }
+    pthread_cond_signal(&pCv->pHandle);
+}
+
+void wakeAllConditionVariable(ConditionVariable* pCv)
+{
+    if (pCv->mFutexCondition)
+    {
+        wakeFutexConditionVariable(pCv, INT_MAX);
+        return;
+    }
+    pthread_cond_broadcast(&pCv->pHandle);
+}
+
+void waitAddress(volatile uint32_t* address, uint32_t expected, uint32_t ms) { futexWait(address, expected, ms); }
+
+void wakeOneAddress(volatile uint32_t* address) { futexWake(address, 1); }
 
-void wakeAllConditionVariable(ConditionVariable* pCv) { pthread_cond_broadcast(&pCv->pHandle); }
+void wakeAllAddress(volatile uint32_t* address) { futexWake(address, INT_MAX); }
 
 static ThreadID mainThreadID;
 
@@ -198,6 +415,8 @@ static void* ThreadFunctionStatic(void* data)
     }
 
     item.pFunc(item.pData);
+    exitLogThread();
+    exitMemAllocThread();
     return 0;
 }
 
@@ -444,6 +444,7 @@ int WindowsMain(int argc, char** argv, IApp* app)
 #ifdef AUTOMATED_TESTING
     bool paramRenderingAPIFound = false;
     char benchmarkOutput[1024] = { "\0" };
+    bool headless = false;
     // Check if benchmarking was given through command line
     for (int i = 0; i < argc; i += 1)
     {
@@ -468,6 +469,11 @@ int WindowsMain(int argc, char** argv, IApp* app)
         {
             strcpy(benchmarkOutput, argv[i + 1]);
         }
+        // Benchmark without showing the window, frames are still rendered and presented to it
+        else if (strcmp(argv[i], "--headless") == 0)
+        {
+            headless = true;
+        }
         // Allow to set renderer API through command line so that we are able to test the same build with differnt APIs
         // On the TheForge Jenkins setup we change APIs through a lua script that changes the selector variable in the UI,
         // but for projects where we compile without our lua interface we cannot do this.
@@ -541,6 +547,8 @@ int WindowsMain(int argc, char** argv, IApp* app)
 #ifdef AUTOMATED_TESTING
     if (pSettings->mBenchmarking)
         setAggregateFrames(targetFrameCount / 2);
+    if (headless)
+        hideWindow(gWindow);
 #endif
 
     bool    baseSubsystemAppDrawn = false;
@@ -571,6 +579,12 @@ int WindowsMain(int argc, char** argv, IApp* app)
         extern bool handleMessages();
         quit = handleMessages() || pSettings->mQuit;
 
+#ifdef AUTOMATED_TESTING
+        // Window managers may report the hidden window as minimized, which would stop the benchmark
+        if (headless)
+            gWindow->minimized = false;
+#endif
+
         // UPDATE BASE INTERFACES
         updateBaseSubsystems(deltaTime, baseSubsystemAppDrawn);
         baseSubsystemAppDrawn = false;
@@ -664,6 +678,7 @@ int WindowsMain(int argc, char** argv, IApp* app)
         pApp->Update(deltaTime);
         pApp->Draw();
         baseSubsystemAppDrawn = true;
+        tf_frame_arena_end_frame();
 
         if (gShowPlatformUI != pApp->mSettings.mShowPlatformUI)
         {
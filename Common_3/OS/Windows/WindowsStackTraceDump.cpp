@@ -39,7 +39,13 @@ Mutex   WindowsStackTrace::mDbgHelpMutex;
 uint8_t WindowsStackTrace::mPreallocatedMemory[mPreallocatedMemorySize];
 size_t  WindowsStackTrace::mUsedMemorySize = 0;
 
-static LONG WINAPI dumpStackTrace(EXCEPTION_POINTERS* pExceptionInfo) { return WindowsStackTrace::Dump(pExceptionInfo); }
+static LONG WINAPI dumpStackTrace(EXCEPTION_POINTERS* pExceptionInfo)
+{
+    LONG result = WindowsStackTrace::Dump(pExceptionInfo);
+    // Messages queued by async log would be lost with the process
+    flushLog();
+    return result;
+}
 
 bool WindowsStackTrace::Init()
 {
@@ -58,6 +58,11 @@ uint64_t       pOldPprocUsage[MAX_PERFORMANCE_STATS_CORES];
 #endif // ENABLE_THREAD_PERFORMANCE_STATS
 
 #include <process.h> // _beginthreadex
+#include <synchapi.h> // WaitOnAddress
+
+#if !defined(XBOX)
+#pragma comment(lib, "Synchronization.lib")
+#endif
 
 /*
  * Function pointer can't be casted to void*,
@@ -87,7 +92,15 @@ void callOnce(CallOnceGuard* pGuard, CallOnceFn fn)
 
 bool initMutex(Mutex* mutex)
 {
-    return InitializeCriticalSectionAndSpinCount((CRITICAL_SECTION*)&mutex->mHandle, (DWORD)MUTEX_DEFAULT_SPIN_COUNT);
+    MutexDesc desc = { 0 };
+    return initMutexDesc(mutex, &desc);
+}
+
+// Critical section already spins before sleeping in kernel, futex flag is ignored
+bool initMutexDesc(Mutex* mutex, const MutexDesc* pDesc)
+{
+    DWORD spinCount = (DWORD)(pDesc->spinCount ? pDesc->spinCount : MUTEX_DEFAULT_SPIN_COUNT);
+    return InitializeCriticalSectionAndSpinCount((CRITICAL_SECTION*)&mutex->mHandle, spinCount);
 }
 
 void exitMutex(Mutex* mutex)
@@ -105,6 +118,13 @@ void releaseMutex(Mutex* mutex) { LeaveCriticalSection((CRITICAL_SECTION*)&mutex
 
 bool initConditionVariable(ConditionVariable* cv)
 {
+    ConditionVariableDesc desc = { 0 };
+    return initConditionVariableDesc(cv, &desc);
+}
+
+bool initConditionVariableDesc(ConditionVariable* cv, const ConditionVariableDesc* pDesc)
+{
+    UNREF_PARAM(pDesc);
     cv->pHandle = (CONDITION_VARIABLE*)tf_calloc(1, sizeof(CONDITION_VARIABLE));
     InitializeConditionVariable((PCONDITION_VARIABLE)cv->pHandle);
     return true;
@@ -121,6 +141,15 @@ void wakeOneConditionVariable(ConditionVariable* cv) { WakeConditionVariable((PC
 
 void wakeAllConditionVariable(ConditionVariable* cv) { WakeAllConditionVariable((PCONDITION_VARIABLE)cv->pHandle); }
 
+void waitAddress(volatile uint32_t* address, uint32_t expected, uint32_t ms)
+{
+    WaitOnAddress(address, &expected, sizeof expected, ms == TIMEOUT_INFINITE ? INFINITE : ms);
+}
+
+void wakeOneAddress(volatile uint32_t* address) { WakeByAddressSingle((PVOID)address); }
+
+void wakeAllAddress(volatile uint32_t* address) { WakeByAddressAll((PVOID)address); }
+
 static ThreadID mainThreadID = 0;
 
 void setMainThread() { mainThreadID = getCurrentThreadID(); }
@@ -194,6 +223,8 @@ unsigned WINAPI ThreadFunctionStatic(void* data)
     }
 
     item.pFunc(item.pData);
+    exitLogThread();
+    exitMemAllocThread();
     return 0;
 }
 
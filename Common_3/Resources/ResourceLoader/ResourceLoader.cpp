@@ -56,10 +56,13 @@
 #if defined(ENABLE_FORGE_RELOAD_SHADER)
 #include "../../Tools/ReloadServer/ReloadClient.h"
 #endif
-// If facing strange gfx issues, corruption, GPU hangs, enable this for verbose logging of resource loading
+// If facing strange gfx issues, corruption, GPU hangs, enable this for verbose logging of resource loading.
+// 1 logs to the text log, 2 logs to the binary log (see initBinaryLog) which is cheap enough to keep on in production
 #define RESOURCE_LOADER_VERBOSE 0
-#if RESOURCE_LOADER_VERBOSE
-#define LOADER_LOGF(...) LOGF(eINFO, __VA_ARGS__)
+#if RESOURCE_LOADER_VERBOSE == 2
+#define LOADER_LOGF(log_level, ...) LOGB(log_level, __VA_ARGS__)
+#elif RESOURCE_LOADER_VERBOSE
+#define LOADER_LOGF(log_level, ...) LOGF(log_level, __VA_ARGS__)
 #else
 #define LOADER_LOGF(...)
 #endif
@@ -674,6 +677,8 @@ struct ResourceLoader
     ConditionVariable mTokenCond;
     // array of stb_ds arrays
     UpdateRequest*    mRequestQueue[MAX_MULTIPLE_GPUS];
+    // Drained request queues, swapped back in empty so their capacity is reused
+    UpdateRequest*    mSpareRequestQueue[MAX_MULTIPLE_GPUS];
 
     tfrg_atomic64_t mTokenCompleted;
     tfrg_atomic64_t mTokenSubmitted;
@@ -1969,6 +1974,7 @@ static bool areTasksAvailable(ResourceLoader* pLoader)
 
 static void streamerThreadFunc(void* pThreadData)
 {
+    MEMORY_TAG_SCOPE(MEMORY_TAG_RESOURCE_LOADER);
     ResourceLoader* pLoader = (ResourceLoader*)pThreadData;
     ASSERT(pLoader);
 
@@ -2007,6 +2013,8 @@ static void streamerThreadFunc(void* pThreadData)
         tfrg_atomic64_store_release(&pLoader->mTokenCompleted, pLoader->mCurrentTokenState[pLoader->pCopyEngines[0].activeSet]);
         releaseMutex(&pLoader->mTokenMutex);
         wakeAllConditionVariable(&pLoader->mTokenCond);
+        LOADER_LOGF(eDEBUG, "Streamer completed tokens up to %llu",
+                    (unsigned long long)tfrg_atomic64_load_relaxed(&pLoader->mTokenCompleted));
 
         uint64_t completionMask = 0;
 
@@ -2024,7 +2032,8 @@ static void streamerThreadFunc(void* pThreadData)
             }
 
             UpdateRequest* activeQueue = *pRequestQueue;
-            *pRequestQueue = NULL;
+            *pRequestQueue = pLoader->mSpareRequestQueue[nodeIndex];
+            pLoader->mSpareRequestQueue[nodeIndex] = NULL;
             releaseMutex(&pLoader->mQueueMutex);
 
             Renderer* pRenderer = pLoader->ppRenderers[nodeIndex];
@@ -2072,9 +2081,12 @@ static void streamerThreadFunc(void* pThreadData)
                 }
 
                 ASSERT(result != UPLOAD_FUNCTION_RESULT_STAGING_BUFFER_FULL);
+                LOADER_LOGF(eDEBUG, "Streamer node %u request type %d result %d wait token %llu", nodeIndex, (int)updateState.mType,
+                            (int)result, (unsigned long long)updateState.mWaitIndex);
             }
 
-            arrfree(activeQueue);
+            arrsetlen(activeQueue, 0);
+            pLoader->mSpareRequestQueue[nodeIndex] = activeQueue;
             pLoader->mMaxToken = max(pLoader->mMaxToken, maxNodeToken);
         }
 
@@ -2177,9 +2189,14 @@ static void initResourceLoader(Renderer** ppRenderers, uint32_t rendererCount, R
     pLoader->mDesc = *pDesc;
 
     initMutex(&pLoader->mQueueMutex);
-    initMutex(&pLoader->mTokenMutex);
     initConditionVariable(&pLoader->mQueueCond);
-    initConditionVariable(&pLoader->mTokenCond);
+    // Token updates are a few stores under the lock
+    MutexDesc tokenMutexDesc = {};
+    tokenMutexDesc.futex = true;
+    initMutexDesc(&pLoader->mTokenMutex, &tokenMutexDesc);
+    ConditionVariableDesc tokenCondDesc = {};
+    tokenCondDesc.futex = true;
+    initConditionVariableDesc(&pLoader->mTokenCond, &tokenCondDesc);
     initMutex(&pLoader->mSemaphoreMutex);
     initMutex(&pLoader->mUploadEngineMutex);
 
@@ -2283,6 +2300,9 @@ static void exitResourceLoader(ResourceLoader* pLoader)
 
         Renderer* renderer = pLoader->ppRenderers[nodeIndex];
         cleanupCopyEngine(renderer, &pLoader->pUploadEngines[nodeIndex]);
+
+        arrfree(pLoader->mRequestQueue[nodeIndex]);
+        arrfree(pLoader->mSpareRequestQueue[nodeIndex]);
     }
 
     exitConditionVariable(&pLoader->mQueueCond);
@@ -2444,6 +2464,7 @@ static void waitForTokenSubmitted(ResourceLoader* pLoader, const SyncToken* toke
 /************************************************************************/
 void initResourceLoaderInterface(Renderer* pRenderer, ResourceLoaderDesc* pDesc)
 {
+    MEMORY_TAG_SCOPE(MEMORY_TAG_RESOURCE_LOADER);
     initResourceLoader(&pRenderer, 1, pDesc, &pResourceLoader);
 
 #ifdef ENABLE_FORGE_MATERIALS
@@ -2541,6 +2562,7 @@ void exitResourceLoaderInterface(Renderer* pRenderer)
 
 void initResourceLoaderInterface(Renderer** ppRenderers, uint32_t rendererCount, ResourceLoaderDesc* pDesc)
 {
+    MEMORY_TAG_SCOPE(MEMORY_TAG_RESOURCE_LOADER);
     initResourceLoader(ppRenderers, rendererCount, pDesc, &pResourceLoader);
 }
 
@@ -3114,6 +3136,7 @@ void getResourceSizeAlign(const TextureLoadDesc* pDesc, ResourceSizeAlign* pOut)
 
 void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 {
+    MEMORY_TAG_SCOPE(MEMORY_TAG_RESOURCE_LOADER);
     if (token)
     {
         *token = max<uint64_t>(0, *token);
@@ -3177,6 +3200,7 @@ void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 
 void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 {
+    MEMORY_TAG_SCOPE(MEMORY_TAG_RESOURCE_LOADER);
     ASSERT(pTextureDesc->ppTexture);
 
     if (token)
@@ -3256,6 +3280,7 @@ void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 
 void addResource(GeometryLoadDesc* pDesc, SyncToken* token)
 {
+    MEMORY_TAG_SCOPE(MEMORY_TAG_RESOURCE_LOADER);
     ASSERT(pDesc->pVertexLayout);
     ASSERT(pDesc->ppGeometry);
 
@@ -0,0 +1,284 @@
+# Copyright (c) 2017-2024 The Forge Interactive Inc.
+#
+# This file is part of The-Forge
+# (see https://github.com/ConfettiFX/The-Forge).
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+Compares benchmark dumps written by dumpBenchmarkData (see Common_3/Application/Interfaces/IProfiler.h).
+Timers are matched by group and name; mean/median/p95/p99 deltas are reported with a Mann-Whitney U test
+on the per frame samples. Exits with 1 when a timer regressed past the threshold, 2 when a dump can't be read.
+
+Repeatable dumps come from running an app built with AUTOMATED_TESTING:
+    App -b 480 --headless -o Baseline
+
+Usage: python benchmark_compare.py Baseline.profile Candidate.profile [More.profile ...]
+           [--threshold 5] [--alpha 0.05] [--metric median] [--markdown report.md] [--json report.json]
+"""
+
+import argparse
+import json
+import math
+import sys
+
+METRICS = ("mean", "median", "p95", "p99")
+
+# Keys of the dump that are not timers
+RUN_KEYS = ("Application", "Width", "Height", "GpuName", "VendorID", "ModelID", "Timers", "FrameTimes", "Cpu")
+
+
+class Run:
+    def __init__(self, path):
+        self.path = path
+        with open(path, "r", encoding="utf-8") as file:
+            data = json.load(file)
+
+        self.info = {key: data[key] for key in RUN_KEYS[:6] if key in data}
+        # "Group/Name" -> per frame milliseconds, dumps without samples only fill aggregates
+        self.samples = {}
+        self.aggregates = {}
+
+        for timer in data.get("Timers", []):
+            key = "%s/%s" % (timer["Group"], timer["Name"])
+            self.samples.setdefault(key, []).extend(timer["Samples"])
+
+        cpu = data.get("Cpu")
+        if cpu is not None:
+            self.aggregates["Cpu/Frame"] = cpu
+            if "FrameTimes" in data:
+                self.samples["Cpu/Frame"] = data["FrameTimes"]
+
+        # Dumps written before samples existed only have the gpu frame aggregates
+        for key, value in data.items():
+            if key not in RUN_KEYS and isinstance(value, dict) and "Average" in value:
+                self.aggregates["%s/%s" % (key, key)] = value
+
+
+def percentile(sorted_values, fraction):
+    # Linear interpolation between closest ranks
+    if len(sorted_values) == 1:
+        return sorted_values[0]
+    position = fraction * (len(sorted_values) - 1)
+    lower = int(math.floor(position))
+    upper = min(lower + 1, len(sorted_values) - 1)
+    return sorted_values[lower] + (sorted_values[upper] - sorted_values[lower]) * (position - lower)
+
+
+def describe(samples):
+    values = sorted(samples)
+    return {
+        "count": len(values),
+        "mean": sum(values) / len(values),
+        "median": percentile(values, 0.5),
+        "p95": percentile(values, 0.95),
+        "p99": percentile(values, 0.99),
+    }
+
+
+def mann_whitney_u(a, b):
+    """Two sided p-value of the Mann-Whitney U test, normal approximation with tie and continuity correction.
+    Frame times are far from normal, which rules out a t-test."""
+    n1, n2 = len(a), len(b)
+    if n1 < 2 or n2 < 2:
+        return None
+
+    combined = sorted([(value, 0) for value in a] + [(value, 1) for value in b])
+    rank_sum = 0.0
+    tie_term = 0.0
+    i = 0
+    while i < len(combined):
+        j = i
+        while j + 1 < len(combined) and combined[j + 1][0] == combined[i][0]:
+            j += 1
+        rank = (i + j) / 2.0 + 1.0
+        ties = j - i + 1
+        tie_term += ties**3 - ties
+        rank_sum += sum(rank for k in range(i, j + 1) if combined[k][1] == 0)
+        i = j + 1
+
+    n = n1 + n2
+    u = rank_sum - n1 * (n1 + 1) / 2.0
+    mean_u = n1 * n2 / 2.0
+    variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)))
+    if variance <= 0.0:
+        return 1.0
+    z = (abs(u - mean_u) - 0.5) / math.sqrt(variance)
+    return min(1.0, math.erfc(max(z, 0.0) / math.sqrt(2.0)))
+
+
+def relative(base, candidate):
+    if base == 0.0:
+        return 0.0 if candidate == 0.0 else math.inf
+    return (candidate - base) / base * 100.0
+
+
+def compare(baseline, candidate, args):
+    rows = []
+    for key in sorted(set(baseline.samples) | set(baseline.aggregates) | set(candidate.samples) | set(candidate.aggregates)):
+        row = {"timer": key}
+        if key in baseline.samples and key in candidate.samples and baseline.samples[key] and candidate.samples[key]:
+            base = describe(baseline.samples[key])
+            cand = describe(candidate.samples[key])
+            row["p_value"] = mann_whitney_u(baseline.samples[key], candidate.samples[key])
+        elif key in baseline.aggregates and key in candidate.aggregates:
+            # No samples: compare the aggregated average, significance can't be tested
+            base = {"count": baseline.aggregates[key].get("Frames", 0), "mean": baseline.aggregates[key]["Average"]}
+            cand = {"count": candidate.aggregates[key].get("Frames", 0), "mean": candidate.aggregates[key]["Average"]}
+            row["p_value"] = None
+        else:
+            row["status"] = "only in baseline" if key in baseline.samples or key in baseline.aggregates else "only in candidate"
+            rows.append(row)
+            continue
+
+        row["baseline"] = base
+        row["candidate"] = cand
+        row["delta_ms"] = {metric: cand[metric] - base[metric] for metric in METRICS if metric in base}
+        row["delta_percent"] = {metric: relative(base[metric], cand[metric]) for metric in METRICS if metric in base}
+
+        metric = args.metric if args.metric in base else "mean"
+        change = row["delta_percent"][metric]
+        significant = row["p_value"] is not None and row["p_value"] < args.alpha
+        # Tiny timers jump by large percentages on noise alone
+        large_enough = abs(row["delta_ms"][metric]) >= args.min_delta_ms
+        if significant and large_enough and change > args.threshold:
+            row["status"] = "regression"
+        elif significant and large_enough and change < -args.threshold:
+            row["status"] = "improvement"
+        else:
+            row["status"] = "unchanged"
+        rows.append(row)
+
+    # Regressions first, then by how much the timer got slower
+    order = {"regression": 0, "improvement": 1, "unchanged": 2}
+    rows.sort(key=lambda row: (order.get(row["status"], 3), -max(row.get("delta_percent", {}).values(), default=0.0)))
+    return rows
+
+
+def format_percent(value):
+    return "inf" if math.isinf(value) else "%+.1f%%" % value
+
+
+def markdown_cell(text):
+    return text.replace("|", "\\|")
+
+
+def markdown_report(baseline, comparisons, args):
+    lines = ["# Benchmark comparison", ""]
+    lines.append("Baseline: `%s` %s" % (baseline.path, describe_run(baseline)))
+    lines.append("")
+    lines.append(
+        "Regression: %s up more than %.1f%%, at least %.3f ms, Mann-Whitney p < %.3f"
+        % (args.metric, args.threshold, args.min_delta_ms, args.alpha)
+    )
+
+    for candidate, rows in comparisons:
+        lines += ["", "## `%s` %s" % (candidate.path, describe_run(candidate)), ""]
+        regressions = sum(1 for row in rows if row["status"] == "regression")
+        improvements = sum(1 for row in rows if row["status"] == "improvement")
+        lines.append("%d regressions, %d improvements" % (regressions, improvements))
+        lines.append("")
+        lines.append("| Timer | Base %s ms | New %s ms | Mean | Median | p95 | p99 | p | Status |" % (args.metric, args.metric))
+        lines.append("|---|---:|---:|---:|---:|---:|---:|---:|---|")
+        for row in rows:
+            if "baseline" not in row:
+                lines.append("| %s | | | | | | | | %s |" % (markdown_cell(row["timer"]), row["status"]))
+                continue
+            metric = args.metric if args.metric in row["baseline"] else "mean"
+            deltas = [format_percent(row["delta_percent"][m]) if m in row["delta_percent"] else "" for m in METRICS]
+            p_value = "%.4f" % row["p_value"] if row["p_value"] is not None else "n/a"
+            status = "**%s**" % row["status"] if row["status"] == "regression" else row["status"]
+            lines.append(
+                "| %s | %.4f | %.4f | %s | %s | %s | %s | %s | %s |"
+                % (markdown_cell(row["timer"]), row["baseline"][metric], row["candidate"][metric], *deltas, p_value, status)
+            )
+    return "\n".join(lines) + "\n"
+
+
+def describe_run(run):
+    parts = [str(run.info[key]) for key in ("Application", "GpuName") if run.info.get(key)]
+    if "Width" in run.info and "Height" in run.info:
+        parts.append("%dx%d" % (run.info["Width"], run.info["Height"]))
+    return "(%s)" % ", ".join(parts) if parts else ""
+
+
+def json_report(baseline, comparisons, args):
+    def clean(value):
+        # JSON has no infinity
+        if isinstance(value, float) and math.isinf(value):
+            return None
+        if isinstance(value, dict):
+            return {key: clean(item) for key, item in value.items()}
+        return value
+
+    return {
+        "baseline": {"path": baseline.path, "info": baseline.info},
+        "settings": {"metric": args.metric, "threshold": args.threshold, "alpha": args.alpha, "min_delta_ms": args.min_delta_ms},
+        "candidates": [
+            {
+                "path": candidate.path,
+                "info": candidate.info,
+                "regressions": sum(1 for row in rows if row["status"] == "regression"),
+                "timers": [clean(row) for row in rows],
+            }
+            for candidate, rows in comparisons
+        ],
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compares dumpBenchmarkData dumps and flags regressions")
+    parser.add_argument("baseline", help="dump all others are compared against")
+    parser.add_argument("candidates", nargs="+", help="dumps to compare")
+    parser.add_argument("--metric", choices=METRICS, default="median", help="statistic the threshold applies to")
+    parser.add_argument("--threshold", type=float, default=5.0, help="regression threshold in percent")
+    parser.add_argument("--alpha", type=float, default=0.05, help="significance level of the Mann-Whitney U test")
+    parser.add_argument("--min-delta-ms", type=float, default=0.01, help="ignore changes smaller than this many milliseconds")
+    parser.add_argument("--markdown", help="Markdown report to write, stdout when neither report is given")
+    parser.add_argument("--json", help="JSON report to write")
+    args = parser.parse_args()
+
+    try:
+        baseline = Run(args.baseline)
+        candidates = [Run(path) for path in args.candidates]
+    except (OSError, ValueError, KeyError) as error:
+        print("Could not read benchmark dump: %s" % error, file=sys.stderr)
+        return 2
+
+    comparisons = [(candidate, compare(baseline, candidate, args)) for candidate in candidates]
+
+    if args.markdown or not args.json:
+        report = markdown_report(baseline, comparisons, args)
+        if args.markdown:
+            with open(args.markdown, "w", encoding="utf-8") as file:
+                file.write(report)
+        else:
+            sys.stdout.write(report)
+    if args.json:
+        with open(args.json, "w", encoding="utf-8") as file:
+            json.dump(json_report(baseline, comparisons, args), file, indent=2)
+
+    regressions = [row["timer"] for _, rows in comparisons for row in rows if row["status"] == "regression"]
+    if regressions:
+        print("%d timers regressed: %s" % (len(regressions), ", ".join(sorted(set(regressions)))), file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
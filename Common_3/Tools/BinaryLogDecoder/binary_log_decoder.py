@@ -0,0 +1,250 @@
+# Copyright (c) 2017-2024 The Forge Interactive Inc.
+#
+# This file is part of The-Forge
+# (see https://github.com/ConfettiFX/The-Forge).
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+Turns binary logs written by LOGB (see initBinaryLog in Common_3/Utilities/Log/Log.h) into text,
+in the same layout as regular log files. File format is described in Common_3/Utilities/Log/BinaryLog.c
+
+Usage: python binary_log_decoder.py App.blog [-o App.decoded.log] [--level-mask 0x1f]
+"""
+
+import argparse
+import re
+import struct
+import sys
+import time
+
+MAGIC = b"TFBLOG\0\0"
+VERSION = 1
+
+CHUNK_FORMAT = 1
+CHUNK_RECORDS = 2
+
+ARG_INT32 = 1
+ARG_INT64 = 2
+ARG_DOUBLE = 3
+ARG_POINTER = 4
+ARG_STRING = 5
+
+THREAD_NAME_SIZE = 32
+FILENAME_NAME_LENGTH_LOG = 23
+
+# Same order and prefixes as writeLogVaList
+LEVEL_PREFIXES = [(8, "WARN| "), (4, "INFO| "), (2, " DBG| "), (16, " ERR| ")]
+
+# Conversion of a printf format: flags, width, precision, length modifier, conversion
+CONVERSION = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|j|q|z|t|I64|L)?([diuoxXcfFeEgGaAps%])")
+
+
+class Format:
+    def __init__(self, level, line, file_name, text, arg_types):
+        self.level = level
+        self.line = line
+        self.file_name = file_name
+        self.text = text
+        self.arg_types = arg_types
+        self.pieces = split_format(text)
+
+
+def split_format(text):
+    """Splits format into literal strings and (spec without length modifier, conversion) tuples."""
+    pieces = []
+    pos = 0
+    for match in CONVERSION.finditer(text):
+        if match.start() > pos:
+            pieces.append(text[pos : match.start()])
+        flags, width, precision, _, conversion = match.groups()
+        if conversion == "%":
+            pieces.append("%")
+        else:
+            spec = "%" + flags + (width or "")
+            if precision is not None:
+                spec += "." + precision
+            pieces.append((spec, conversion))
+        pos = match.end()
+    if pos < len(text):
+        pieces.append(text[pos:])
+    return pieces
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, fmt):
+        values = struct.unpack_from("<" + fmt, self.data, self.pos)
+        self.pos += struct.calcsize("<" + fmt)
+        return values if len(values) > 1 else values[0]
+
+    def bytes(self, count):
+        value = self.data[self.pos : self.pos + count]
+        self.pos += count
+        return value
+
+
+def decode_record(reader, formats):
+    usec, format_id, level = reader.take("qHH")
+    fmt = formats.get(format_id)
+    if fmt is None:
+        raise ValueError("record references unknown format %u" % format_id)
+
+    args = []
+    types = []
+    for arg_type in fmt.arg_types:
+        if arg_type == ARG_INT32:
+            args.append(reader.take("i"))
+        elif arg_type == ARG_INT64:
+            args.append(reader.take("q"))
+        elif arg_type == ARG_DOUBLE:
+            args.append(reader.take("d"))
+        elif arg_type == ARG_POINTER:
+            args.append(reader.take("Q"))
+        elif arg_type == ARG_STRING:
+            length = reader.take("H")
+            args.append(reader.bytes(length).decode("utf-8", "replace"))
+        else:
+            raise ValueError("unknown argument type %u in format %u" % (arg_type, format_id))
+        types.append(arg_type)
+    return usec, fmt, level, args, types
+
+
+def render(fmt, args, types):
+    # Unsigned conversions use the argument type to know the size the call site passed
+    out = []
+    index = 0
+    for piece in fmt.pieces:
+        if isinstance(piece, str):
+            out.append(piece)
+            continue
+
+        spec, conversion = piece
+        while "*" in spec:
+            spec = spec.replace("*", str(args[index]), 1)
+            index += 1
+        if index >= len(args):
+            out.append(spec + conversion)
+            continue
+        value = args[index]
+        arg_type = types[index]
+        index += 1
+
+        if conversion in "uoxX":
+            bits = 32 if arg_type == ARG_INT32 else 64
+            value &= (1 << bits) - 1
+            conversion = "d" if conversion == "u" else conversion
+        elif conversion == "i":
+            conversion = "d"
+        elif conversion == "c":
+            value = chr(value & 0xFF)
+            conversion = "s"
+        elif conversion in "aA":
+            # Python % has no hex float conversion, logs written before %a fell back to text can contain it
+            value = float.hex(value).upper() if conversion == "A" else float.hex(value)
+            spec = "%"
+            conversion = "s"
+        elif conversion == "p":
+            value = "0x%x" % value
+            spec = "%"
+            conversion = "s"
+        out.append((spec + conversion) % value)
+    return "".join(out)
+
+
+def decode(data, level_mask):
+    if data[:8] != MAGIC:
+        raise ValueError("not a binary log file")
+    reader = Reader(data)
+    reader.pos = 8
+    version, _ = reader.take("II")
+    if version != VERSION:
+        raise ValueError("unsupported binary log version %u" % version)
+    start_usec, start_time = reader.take("qq")
+
+    formats = {}
+    records = []
+    while reader.pos + 8 <= len(data):
+        chunk_type, size = reader.take("II")
+        end = reader.pos + size
+        if end > len(data):
+            # Process ended while the chunk was written
+            break
+
+        if chunk_type == CHUNK_FORMAT:
+            format_id, level, line, file_length, text_length, arg_count = reader.take("HHIHHB")
+            arg_types = list(reader.bytes(arg_count))
+            file_name = reader.bytes(file_length).decode("utf-8", "replace")
+            text = reader.bytes(text_length).decode("utf-8", "replace")
+            formats[format_id] = Format(level, line, file_name, text, arg_types)
+        elif chunk_type == CHUNK_RECORDS:
+            _thread_id = reader.take("Q")
+            thread_name = reader.bytes(THREAD_NAME_SIZE).split(b"\0", 1)[0].decode("utf-8", "replace")
+            while reader.pos < end:
+                usec, fmt, level, args, types = decode_record(reader, formats)
+                # Sequence number keeps records of one thread with the same timestamp in order
+                records.append((usec, len(records), thread_name, fmt, level, args, types))
+
+        reader.pos = end
+
+    # Threads write their buffers out at different times
+    records.sort(key=lambda record: (record[0], record[1]))
+
+    for usec, _, thread_name, fmt, level, args, types in records:
+        wall = time.localtime(start_time + (usec - start_usec) // 1000000)
+        preamble = "%s [%-15s] %23.*s:%-5i " % (
+            time.strftime("%Y-%m-%d %H:%M:%S", wall),
+            thread_name or "NoName",
+            FILENAME_NAME_LENGTH_LOG,
+            fmt.file_name,
+            fmt.line,
+        )
+        message = render(fmt, args, types)
+        for mask, prefix in LEVEL_PREFIXES:
+            if level & mask & level_mask:
+                yield preamble + prefix + message
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decodes binary logs written with LOGB into text")
+    parser.add_argument("input", help="binary log file")
+    parser.add_argument("-o", "--output", help="text file to write, stdout when not given")
+    parser.add_argument("--level-mask", type=lambda value: int(value, 0), default=0xFFFFFFFF, help="LogLevel bits to output")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as file:
+        data = file.read()
+
+    output = open(args.output, "w", encoding="utf-8") if args.output else sys.stdout
+    try:
+        for line in decode(data, args.level_mask):
+            output.write(line + "\n")
+    except ValueError as error:
+        print("%s: %s" % (args.input, error), file=sys.stderr)
+        return 1
+    finally:
+        if args.output:
+            output.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -32,6 +32,7 @@
 #include "../../Utilities/Interfaces/ITime.h"
 
 #include "../../Utilities/Threading/Atomics.h"
+#include "../../Utilities/Threading/RingQueue.h"
 #include "../../Utilities/Threading/ThreadSystem.h"
 
 #include "utf8.h"
@@ -87,6 +88,7 @@ static void validateCompressionLevel(enum BunyArFileFormat format, int* cl)
     }
     break;
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
     {
         if (*cl == BUNYAR_LIB_COMPRESSION_LEVEL_DEFAULT)
         {
@@ -409,16 +411,30 @@ static void bunyArLibCreatePostprocessDesc(struct BunyArLibCreateDesc* desc, cha
 /// Prepare archive metadata                                                 ///
 ////////////////////////////////////////////////////////////////////////////////
 
+struct ZstdCDictSlot
+{
+    int         compressionLevel;
+    ZSTD_CDict* cdict;
+};
+
 struct BunyArLibCreateMetadata
 {
     uint64_t                nodeCount;
     struct BunyArNode*      nodes;
     struct BunyArHashTable* hashTable;
+    enum BunyArHashTableType hashTableType;
     uint64_t                maxBlockSize;
     char*                   names;
     uint32_t                namesSize;
     bool                    lz4Used;
     bool                    zstdUsed;
+    bool                    zstdDictUsed;
+
+    // trained over BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS entries
+    uint8_t*              zstdDictionary;
+    uint64_t              zstdDictionarySize;
+    // one digested dictionary per compression level, read-only for compression threads
+    struct ZstdCDictSlot* zstdCDicts;
 };
 
 // TODO experiment with this
@@ -428,6 +444,7 @@ static uint32_t convertBlockSize(enum BunyArFileFormat format, uint32_t blockSiz
     {
     case BUNYAR_FILE_FORMAT_LZ4_BLOCKS:
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
         if (blockSizeKb == BUNYAR_LIB_BLOCK_SIZE_KB_DEFAULT)
             return 256 * 1024;
         return blockSizeKb * 1024;
@@ -438,6 +455,11 @@ static uint32_t convertBlockSize(enum BunyArFileFormat format, uint32_t blockSiz
 
 static void bunyArLibCreateMetadataDestroy(struct BunyArLibCreateMetadata* md)
 {
+    for (size_t i = 0; i < (size_t)arrlenu(md->zstdCDicts); ++i)
+        ZSTD_freeCDict(md->zstdCDicts[i].cdict);
+    arrfree(md->zstdCDicts);
+
+    tf_free(md->zstdDictionary);
     tf_free(md->nodes);
     tf_free(md->names);
     tf_free(md->hashTable);
@@ -447,6 +469,7 @@ static void bunyArLibCreateMetadataDestroy(struct BunyArLibCreateMetadata* md)
 static bool bunyArLibCreateMetadataDetail(const struct BunyArLibCreateDesc* desc, struct BunyArLibCreateMetadata* md)
 {
     md->nodeCount = desc->entryCount;
+    md->hashTableType = desc->hashTableType;
 
     md->nodes = (struct BunyArNode*)tf_calloc(1, (sizeof(*md->nodes)) * md->nodeCount);
     if (!md->nodes)
@@ -486,6 +509,10 @@ static bool bunyArLibCreateMetadataDetail(const struct BunyArLibCreateDesc* desc
         case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
             md->zstdUsed = true;
             break;
+        case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
+            md->zstdUsed = true;
+            md->zstdDictUsed = true;
+            break;
         default:
             LOGF(eERROR, "Unsupported format: %llu\n", node->format);
             return false;
@@ -529,7 +556,269 @@ static void hashTableTask(void* pUser)
 {
     struct BunyArLibCreateMetadata* md = (struct BunyArLibCreateMetadata*)pUser;
 
-    md->hashTable = bunyArHashTableConstruct(md->nodeCount, md->nodes, md->names);
+    md->hashTable = bunyArHashTableConstructType(md->hashTableType, md->nodeCount, md->nodes, md->names);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function bunyArLibCreate (part two and a half)                          ///
+/// Train zstd dictionary over BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS entries   ///
+////////////////////////////////////////////////////////////////////////////////
+
+static void* tfAllocForZstd(void* pUser, size_t size)
+{
+    (void)pUser;
+    return tf_malloc(size);
+}
+static void tfFreeForZstd(void* pUser, void* memory)
+{
+    (void)pUser;
+    tf_free(memory);
+}
+static const ZSTD_customMem ZSTD_MEMORY_ALLOCATOR = {
+    tfAllocForZstd,
+    tfFreeForZstd,
+    NULL,
+};
+
+// Only the beginning of large files is used for training
+#define BUNYAR_DICT_SAMPLE_SIZE_MAX       (128 * 1024)
+// zstd recommends ~100x dictionary size of samples
+#define BUNYAR_DICT_SAMPLES_SIZE_MULTIPLE 100
+#define BUNYAR_DICT_DMER_SIZE             8
+#define BUNYAR_DICT_SEGMENT_SIZE          1024
+#define BUNYAR_DICT_HASH_LOG              20
+
+static inline uint32_t dictDmerHash(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof v);
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ULL) >> (64 - BUNYAR_DICT_HASH_LOG));
+}
+
+// Simplified COVER algorithm (Liao, Petri, Moffat, Wirth) without parameter search.
+// d-mer frequency is number of samples containing it.
+// Samples are splitted to epochs, the best segment of each epoch is taken,
+// d-mers of taken segment are not rewarded anymore.
+// Result is raw content dictionary, zstd uses it as a history prefix.
+static bool bunyArLibTrainZstdDictionary(const uint8_t* samples, const size_t* sampleSizes, size_t sampleCount, uint8_t* dict,
+                                         size_t capacity, size_t* outSize)
+{
+    const size_t d = BUNYAR_DICT_DMER_SIZE;
+    const size_t k = BUNYAR_DICT_SEGMENT_SIZE;
+
+    size_t totalSize = 0;
+    for (size_t i = 0; i < sampleCount; ++i)
+        totalSize += sampleSizes[i];
+
+    // Nothing to select from, samples are dictionary
+    if (totalSize <= capacity)
+    {
+        if (totalSize)
+            memcpy(dict, samples, totalSize);
+        *outSize = totalSize;
+        return true;
+    }
+
+    const size_t hashCount = (size_t)1 << BUNYAR_DICT_HASH_LOG;
+
+    uint32_t* freqs = (uint32_t*)tf_calloc(hashCount, sizeof *freqs);
+    uint32_t* lastSample = (uint32_t*)tf_malloc(hashCount * sizeof *lastSample);
+    uint32_t* inSegment = (uint32_t*)tf_calloc(hashCount, sizeof *inSegment);
+    if (!freqs || !lastSample || !inSegment)
+    {
+        tf_free(freqs);
+        tf_free(lastSample);
+        tf_free(inSegment);
+        return false;
+    }
+
+    memset(lastSample, 0xff, hashCount * sizeof *lastSample);
+
+    const uint8_t* sample = samples;
+    for (size_t si = 0; si < sampleCount; sample += sampleSizes[si++])
+    {
+        for (size_t i = 0; i + d <= sampleSizes[si]; ++i)
+        {
+            uint32_t h = dictDmerHash(sample + i);
+            if (lastSample[h] == (uint32_t)si)
+                continue;
+            lastSample[h] = (uint32_t)si;
+            ++freqs[h];
+        }
+    }
+
+    size_t epochCount = capacity / k;
+    if (epochCount == 0)
+        epochCount = 1;
+    size_t epochSize = totalSize / epochCount;
+    if (epochSize < k)
+        epochSize = k;
+
+    // Segments are placed from the end of dictionary,
+    // zstd finds matches with smaller offsets faster
+    size_t tail = capacity;
+
+    for (size_t epochBeg = 0; epochBeg + d <= totalSize && tail > 0; epochBeg += epochSize)
+    {
+        size_t epochEnd = epochBeg + epochSize;
+        if (epochEnd > totalSize)
+            epochEnd = totalSize;
+
+        size_t segmentSize = k < tail ? k : tail;
+        if (segmentSize < d || epochEnd - epochBeg < segmentSize)
+            continue;
+
+        // Sliding window over epoch, each distinct d-mer is counted once
+        uint64_t score = 0;
+        uint64_t bestScore = 0;
+        size_t   bestBeg = epochBeg;
+        size_t   windowDmers = segmentSize - d + 1;
+
+        for (size_t i = epochBeg; i + d <= epochEnd; ++i)
+        {
+            uint32_t h = dictDmerHash(samples + i);
+            if (inSegment[h]++ == 0)
+                score += freqs[h];
+
+            if (i >= epochBeg + windowDmers)
+            {
+                uint32_t oh = dictDmerHash(samples + i - windowDmers);
+                if (--inSegment[oh] == 0)
+                    score -= freqs[oh];
+            }
+
+            if (i + 1 >= epochBeg + windowDmers && score > bestScore)
+            {
+                bestScore = score;
+                bestBeg = i + 1 - windowDmers;
+            }
+        }
+
+        // clear window counters for the next epoch
+        size_t windowBeg = epochEnd - d + 1 > windowDmers + epochBeg ? epochEnd - d + 1 - windowDmers : epochBeg;
+        for (size_t i = windowBeg; i + d <= epochEnd; ++i)
+            inSegment[dictDmerHash(samples + i)] = 0;
+
+        if (bestScore == 0)
+            continue;
+
+        for (size_t i = bestBeg; i < bestBeg + windowDmers; ++i)
+            freqs[dictDmerHash(samples + i)] = 0;
+
+        tail -= segmentSize;
+        memcpy(dict + tail, samples + bestBeg, segmentSize);
+    }
+
+    tf_free(freqs);
+    tf_free(lastSample);
+    tf_free(inSegment);
+
+    *outSize = capacity - tail;
+    memmove(dict, dict + tail, *outSize);
+    return true;
+}
+
+static const ZSTD_CDict* bunyArLibFindZstdCDict(const struct BunyArLibCreateMetadata* md, int compressionLevel)
+{
+    for (size_t i = 0; i < (size_t)arrlenu(md->zstdCDicts); ++i)
+    {
+        if (md->zstdCDicts[i].compressionLevel == compressionLevel)
+            return md->zstdCDicts[i].cdict;
+    }
+    return NULL;
+}
+
+static bool bunyArLibCreateZstdDictionary(const struct BunyArLibCreateDesc* desc, struct BunyArLibCreateMetadata* md)
+{
+    size_t capacity = desc->zstdDictionarySize ? desc->zstdDictionarySize : BUNYAR_LIB_ZSTD_DICTIONARY_SIZE_DEFAULT;
+    size_t samplesLimit = capacity * BUNYAR_DICT_SAMPLES_SIZE_MULTIPLE;
+
+    uint8_t* samples = NULL;
+    size_t*  sampleSizes = NULL;
+    bool     success = true;
+
+    int64_t startTime = getUSec(true);
+
+    for (uint64_t i = 0; i < desc->entryCount && (size_t)arrlenu(samples) < samplesLimit; ++i)
+    {
+        const struct BunyArLibEntryCreateDesc* entry = desc->entries + i;
+        if (entry->format != BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS)
+            continue;
+
+        FileStream fs = { 0 };
+        if (!fsOpenStreamFromPath(entry->inputRd, entry->inputPath, FM_READ | FM_ALLOW_READ, &fs))
+        {
+            LOGF(eERROR, "Failed to open dictionary sample '%s%s'", fsGetResourceDirectory(entry->inputRd), entry->inputPath);
+            success = false;
+            break;
+        }
+
+        size_t sampleSize = (size_t)fsGetStreamFileSize(&fs);
+        if (sampleSize > BUNYAR_DICT_SAMPLE_SIZE_MAX)
+            sampleSize = BUNYAR_DICT_SAMPLE_SIZE_MAX;
+        if (sampleSize > samplesLimit - arrlenu(samples))
+            sampleSize = samplesLimit - arrlenu(samples);
+
+        size_t offset = arrlenu(samples);
+        arrsetlen(samples, offset + sampleSize);
+        sampleSize = fsReadFromStream(&fs, samples + offset, sampleSize);
+        arrsetlen(samples, offset + sampleSize);
+        fsCloseStream(&fs);
+
+        if (sampleSize)
+            arrpush(sampleSizes, sampleSize);
+    }
+
+    if (success)
+    {
+        md->zstdDictionary = (uint8_t*)tf_malloc(capacity);
+        success = md->zstdDictionary && bunyArLibTrainZstdDictionary(samples, sampleSizes, arrlenu(sampleSizes), md->zstdDictionary,
+                                                                     capacity, &md->zstdDictionarySize);
+    }
+
+    if (success && desc->verbose > 1)
+    {
+        fprintf(stdout, "Zstd dictionary %s trained on %llu samples (%s) in %s\n\n", humanReadableSize(md->zstdDictionarySize).str,
+                (unsigned long long)arrlenu(sampleSizes), humanReadableSize(arrlenu(samples)).str,
+                humanReadableTime(getUSec(true) - startTime).str);
+    }
+
+    arrfree(samples);
+    arrfree(sampleSizes);
+
+    if (!success)
+    {
+        LOGF(eERROR, "Failed to train zstd dictionary");
+        return false;
+    }
+
+    // All dictionary entries are empty, archive is written without dictionary and their nodes have no blocks
+    if (!md->zstdDictionarySize)
+        return true;
+
+    // Digest dictionary once for every compression level in use
+    for (uint64_t i = 0; i < desc->entryCount; ++i)
+    {
+        const struct BunyArLibEntryCreateDesc* entry = desc->entries + i;
+        if (entry->format != BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS || bunyArLibFindZstdCDict(md, entry->compressionLevel))
+            continue;
+
+        ZSTD_compressionParameters cParams = ZSTD_getCParams(entry->compressionLevel, 0, md->zstdDictionarySize);
+
+        struct ZstdCDictSlot slot;
+        slot.compressionLevel = entry->compressionLevel;
+        slot.cdict = ZSTD_createCDict_advanced(md->zstdDictionary, md->zstdDictionarySize, ZSTD_dlm_byRef, ZSTD_dct_rawContent, cParams,
+                                               ZSTD_MEMORY_ALLOCATOR);
+        if (!slot.cdict)
+        {
+            LOGF(eERROR, "Failed to create zstd compression dictionary for level %i", entry->compressionLevel);
+            return false;
+        }
+
+        arrpush(md->zstdCDicts, slot);
+    }
+
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -552,15 +841,16 @@ struct Packet
     struct FileBlock*        block;
 };
 
+// Packets in flight between task manager and archive writer
+#define PACKET_QUEUE_CAPACITY 4096
+
 struct PacketWaiterData
 {
-    uint64_t          nPacketsUsed;
-    struct Packet*    packets;
-    bool              kill;
-    bool              done;
-    struct Packet*    packetsQueue;
-    Mutex             mutex;
-    ConditionVariable condition;
+    // task manager -> archive writer, packet with both pointers NULL ends the stream
+    SpscQueue       queue;
+    tfrg_atomic32_t kill;
+    // writer stops receiving once this is set
+    const bool*     writerError;
 };
 
 enum BlockTaskStatusId
@@ -640,6 +930,8 @@ struct ThreadsSharedMemory
 
     struct CompressionContext* compressionContexts;
 
+    const struct BunyArLibCreateMetadata* md;
+
     tfrg_atomic64_t priorityEntryIndex_Atomic64;
 
     uint64_t                 maxAssemblyLines;
@@ -774,22 +1066,6 @@ static void releaseFileBlock(struct FileAssemblyLine* file, struct FileBlock* bl
     reportActivity(tsm);
 }
 
-static void* tfAllocForZstd(void* pUser, size_t size)
-{
-    (void)pUser;
-    return tf_malloc(size);
-}
-static void tfFreeForZstd(void* pUser, void* memory)
-{
-    (void)pUser;
-    tf_free(memory);
-}
-static const ZSTD_customMem ZSTD_MEMORY_ALLOCATOR = {
-    tfAllocForZstd,
-    tfFreeForZstd,
-    NULL,
-};
-
 static bool compressionContextInit(struct CompressionContext* ctx, bool lz4FormatUsed, bool zstdFormatUsed)
 {
     memset(ctx, 0, sizeof(*ctx));
@@ -820,8 +1096,9 @@ static void compressionContextDestroy(struct CompressionContext* ctx)
     memset(ctx, 0, sizeof *ctx);
 }
 
-static bool bunyArLibTaskCompress(struct CompressionContext* ctx, enum BunyArFileFormat format, int compressionLevel, const void* src,
-                                  uint64_t size, void* dst,
+static bool bunyArLibTaskCompress(struct CompressionContext* ctx, enum BunyArFileFormat format, int compressionLevel,
+                                  const ZSTD_CDict* cdict, // BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS only
+                                  const void* src, uint64_t size, void* dst,
                                   uint64_t* dstLimitAndOutSize) // UINT64_MAX if not fit
 {
     if (size == 0)
@@ -851,8 +1128,10 @@ static bool bunyArLibTaskCompress(struct CompressionContext* ctx, enum BunyArFil
         return true;
     }
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
     {
-        size_t compressedSize = ZSTD_compressCCtx(ctx->zstdCtx, dst, *dstLimitAndOutSize, src, size, compressionLevel);
+        size_t compressedSize = cdict ? ZSTD_compress_usingCDict(ctx->zstdCtx, dst, *dstLimitAndOutSize, src, size, cdict)
+                                      : ZSTD_compressCCtx(ctx->zstdCtx, dst, *dstLimitAndOutSize, src, size, compressionLevel);
 
         ZSTD_ErrorCode error = ZSTD_getErrorCode(compressedSize);
 
@@ -904,6 +1183,7 @@ static bool initializeEntryBlockStream(enum BunyArFileFormat format, uint32_t bl
     {
     case BUNYAR_FILE_FORMAT_LZ4_BLOCKS:
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
         break;
     default:
         return true;
@@ -957,7 +1237,9 @@ static bool bunyArLibArchiveWrite(ResourceDirectory rd, const char* dstPath, str
 
     enum BunyArLibWriteResult result = BUNYAR_LIB_RESULT_SUCCESS;
 
-    uint64_t offset = sizeof(struct BunyArHeader) + desc->entryCount * sizeof(struct BunyArNode) + md->namesSize;
+    // zstd dictionary goes right after names
+    uint64_t offset =
+        sizeof(struct BunyArHeader) + desc->entryCount * sizeof(struct BunyArNode) + md->namesSize + md->zstdDictionarySize;
 
     uint64_t           filesDone = 0;
     struct BunyArNode* refNode = NULL;
@@ -1197,7 +1479,7 @@ static bool bunyArLibArchiveWrite(ResourceDirectory rd, const char* dstPath, str
 
         if (desc->verbose > 1 && hashTableSize)
         {
-            fprintf(stdout, "Hash Table %s\n\n", humanReadableSize(hashTableSize).str);
+            fprintf(stdout, "Hash Table (%s) %s\n\n", bunyArHashTableTypeName(md->hashTableType), humanReadableSize(hashTableSize).str);
         }
 
         if (desc->verbose)
@@ -1217,15 +1499,24 @@ static bool bunyArLibArchiveWrite(ResourceDirectory rd, const char* dstPath, str
         header.hashTablePointer.offset = offset;
         header.hashTablePointer.size = hashTableSize;
 
+        if (md->zstdDictionarySize)
+        {
+            header.flags |= BUNYAR_HEADER_FLAG_ZSTD_DICTIONARY;
+            header.zstdDictionaryPointer.offset = header.namesPointer.offset + header.namesPointer.size;
+            header.zstdDictionaryPointer.size = md->zstdDictionarySize;
+        }
+
         if (!tf_seek(&archiveFs, 0) || !tf_write(&archiveFs, sizeof(header), &header) ||
             !tf_write(&archiveFs, header.nodesPointer.size, md->nodes) || !tf_write(&archiveFs, header.namesPointer.size, md->names) ||
+            (md->zstdDictionarySize && !tf_write(&archiveFs, header.zstdDictionaryPointer.size, md->zstdDictionary)) ||
             (md->hashTable &&
              (!tf_seek(&archiveFs, header.hashTablePointer.offset) || !tf_write(&archiveFs, header.hashTablePointer.size, md->hashTable))))
             return BUNYAR_LIB_RESULT_OUTPUT_ERROR;
 
         if (desc->verbose > 1)
         {
-            size_t metadataSize = sizeof(header) + header.nodesPointer.size + header.namesPointer.size + header.hashTablePointer.size;
+            size_t metadataSize = sizeof(header) + header.nodesPointer.size + header.namesPointer.size +
+                                  header.zstdDictionaryPointer.size + header.hashTablePointer.size;
 
             fprintf(stdout, "|- %s\n\n", humanReadableSize(metadataSize).str);
         }
@@ -1294,9 +1585,13 @@ static void fileAssemblyCompressTask(void* data, uint64_t thid)
 
     struct CompressionContext* ctx = tsm->compressionContexts + thid;
 
+    const ZSTD_CDict* cdict = NULL;
+    if (file->entry->format == BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS)
+        cdict = bunyArLibFindZstdCDict(tsm->md, file->entry->compressionLevel);
+
     block->compressedSize = block->bufferSize;
-    if (!bunyArLibTaskCompress(ctx, file->entry->format, file->entry->compressionLevel, block->bufferUncompressed, block->rawSize,
-                               block->bufferCompressed, &block->compressedSize))
+    if (!bunyArLibTaskCompress(ctx, file->entry->format, file->entry->compressionLevel, cdict, block->bufferUncompressed,
+                               block->rawSize, block->bufferCompressed, &block->compressedSize))
     {
         tfrg_atomic32_store_relaxed(&block->compressStatusId_Atomic32, BLOCK_TASK_STATUS_ERROR);
         file->error = true;
@@ -1440,48 +1735,27 @@ static bool packetReceiverFunc(void* pUser, struct FileAssemblyLine** outFile, s
 {
     struct PacketWaiterData* p = (struct PacketWaiterData*)pUser;
 
-    for (; !p->kill;)
-    {
-        if (p->packets)
-        {
-            size_t nPackets = arrlenu(p->packets);
-            if (p->nPacketsUsed < nPackets)
-            {
-                struct Packet packet;
-                packet = p->packets[p->nPacketsUsed++];
-                *outFile = packet.file;
-                *outBlock = packet.block;
-                return true;
-            }
-
-            arrfree(p->packets);
-            p->packets = NULL;
-            p->nPacketsUsed = 0;
-        }
-
-        acquireMutex(&p->mutex);
-        while (p->packetsQueue == NULL && !p->done)
-        {
-            waitConditionVariable(&p->condition, &p->mutex, TIMEOUT_INFINITE);
-        }
-        p->packets = p->packetsQueue;
-        p->packetsQueue = NULL;
-        releaseMutex(&p->mutex);
+    struct Packet packet;
+    if (tfrg_atomic32_load_relaxed(&p->kill) || !spscQueuePop(&p->queue, &packet, TIMEOUT_INFINITE))
+        return false;
 
-        if (p->packets == NULL && p->done)
-            return false;
-    }
+    if (!packet.file && !packet.block)
+        return false;
 
-    return false;
+    *outFile = packet.file;
+    *outBlock = packet.block;
+    return true;
 }
 
 static void packetSend(struct PacketWaiterData* p, struct FileAssemblyLine* file, struct FileBlock* block)
 {
-    acquireMutex(&p->mutex);
     struct Packet packet = { file, block };
-    arrpush(p->packetsQueue, packet);
-    wakeOneConditionVariable(&p->condition);
-    releaseMutex(&p->mutex);
+    // queue stays full forever once writer has stopped receiving
+    while (!spscQueuePush(&p->queue, &packet, 100))
+    {
+        if (*p->writerError || tfrg_atomic32_load_relaxed(&p->kill))
+            return;
+    }
 }
 
 static void destroyAssemblyLine(struct FileAssemblyLine* file)
@@ -1622,10 +1896,7 @@ static void destroyThreadSharedMemory(struct ThreadsSharedMemory* tsm)
     exitMutex(&tsm->mutexBlocks);
     exitConditionVariable(&tsm->conditionBlocks);
 
-    arrfree(tsm->packetIo.packetsQueue);
-    arrfree(tsm->packetIo.packets);
-    exitMutex(&tsm->packetIo.mutex);
-    exitConditionVariable(&tsm->packetIo.condition);
+    spscQueueExit(&tsm->packetIo.queue);
 
     exitMutex(&tsm->managerMutex);
     exitConditionVariable(&tsm->managerCondition);
@@ -1638,6 +1909,8 @@ static bool initThreadSharedMemory(struct ThreadsSharedMemory* tsm, ResourceDire
 {
     memset(tsm, 0, sizeof(*tsm));
 
+    tsm->md = md;
+
     // waiter + scheduler + thread pool
     uint64_t threadPoolSize = (uint64_t)desc->threadPoolSize;
 
@@ -1750,11 +2023,9 @@ static bool initThreadSharedMemory(struct ThreadsSharedMemory* tsm, ResourceDire
     if (tsm->singlethreadRun)
         return true;
 
-    if (!initConditionVariable(&tsm->packetIo.condition))
-        goto ERROR_RETURN;
-
-    if (!initMutex(&tsm->packetIo.mutex))
+    if (!spscQueueInit(&tsm->packetIo.queue, PACKET_QUEUE_CAPACITY, sizeof(struct Packet)))
         goto ERROR_RETURN;
+    tsm->packetIo.writerError = &tsm->archiveError;
 
     if (!initConditionVariable(&tsm->managerCondition))
         goto ERROR_RETURN;
@@ -1903,6 +2174,7 @@ void bunyArLibCompressionLevelLimits(enum BunyArFileFormat format, int* min, int
         *max = LZ4HC_CLEVEL_MAX;
         break;
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
         *min = ZSTD_minCLevel();
         *max = ZSTD_maxCLevel();
         break;
@@ -1947,10 +2219,9 @@ static bool bunyArLibCreateArchive(ResourceDirectory rd, const char* dstPath, co
         }
 
         if (tsm.error)
-            tsm.packetIo.kill = true;
-        tsm.packetIo.done = true;
+            tfrg_atomic32_store_relaxed(&tsm.packetIo.kill, 1);
+        packetSend(&tsm.packetIo, NULL, NULL);
 
-        wakeOneConditionVariable(&tsm.packetIo.condition);
         joinThread(tsm.writerThread);
     }
 
@@ -1980,6 +2251,13 @@ bool bunyArLibCreate(ResourceDirectory rd, const char* dstPath, const struct Bun
         LOGF(eERROR, "Failed to initialize metadata for archive '%s'", dstPath);
     }
 
+    if (success && md.zstdDictUsed)
+    {
+        success = bunyArLibCreateZstdDictionary(&desc, &md);
+        if (!success)
+            LOGF(eERROR, "Failed to create zstd dictionary for archive '%s'", dstPath);
+    }
+
     if (success)
         success = bunyArLibCreateArchive(rd, dstPath, &desc, &md);
 
@@ -1989,10 +2267,27 @@ bool bunyArLibCreate(ResourceDirectory rd, const char* dstPath, const struct Bun
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// Function bunyArLibExtract                                               ///
+/// Function bunyArLibExtract (singlethreaded)                              ///
 ////////////////////////////////////////////////////////////////////////////////
 
-bool bunyArLibExtract(struct IFileSystem* archive, ResourceDirectory rd, const char* dstDir, const struct BunyArLibExtractDesc* desc)
+static uint64_t bunyArLibExtractTotalSize(IFileSystem* archive, const struct BunyArLibExtractDesc* desc, uint64_t loopLimit)
+{
+    uint64_t totalSize = 0;
+    for (uint64_t i = 0; i < loopLimit; ++i)
+    {
+        uint64_t uid = i;
+        if (desc->fileNameCount > 0 && !fsArchiveGetNodeId(archive, desc->fileNames[i], &uid))
+            continue;
+
+        struct BunyArNodeDescription node;
+        fsArchiveGetNodeDescription(archive, uid, &node);
+        totalSize += node.fileSize;
+    }
+    return totalSize;
+}
+
+static bool bunyArLibExtractSingleThreaded(IFileSystem* archive, ResourceDirectory rd, const char* dstDir,
+                                           const struct BunyArLibExtractDesc* desc)
 {
     struct BunyArDescription archiveInfo;
     fsArchiveGetDescription(archive, &archiveInfo);
@@ -2014,12 +2309,24 @@ bool bunyArLibExtract(struct IFileSystem* archive, ResourceDirectory rd, const c
 
     uint64_t failureCount = 0;
 
+    struct BunyArLibExtractProgress progress = { 0 };
+    progress.fileCount = loopLimit;
+    if (desc->progressCallback)
+        progress.bytesTotal = bunyArLibExtractTotalSize(archive, desc, loopLimit);
+
     for (uint64_t i = 0; i < loopLimit; ++i)
     {
         const char* error = NULL;
 
         uint64_t uid = i;
 
+        if (desc->progressCallback)
+        {
+            progress.filesDone = i;
+            progress.failureCount = failureCount;
+            desc->progressCallback(desc->progressUserData, &progress);
+        }
+
         uint64_t totalSize = 0;
         char     buffer[64 * 1024];
         ASSERT(sizeof buffer >= FS_MAX_PATH);
@@ -2098,6 +2405,7 @@ bool bunyArLibExtract(struct IFileSystem* archive, ResourceDirectory rd, const c
             }
 
             totalSize += size;
+            progress.bytesDone += size;
         }
 
         if (totalSize != node.fileSize)
@@ -2123,6 +2431,13 @@ bool bunyArLibExtract(struct IFileSystem* archive, ResourceDirectory rd, const c
         }
     }
 
+    if (desc->progressCallback)
+    {
+        progress.filesDone = loopLimit;
+        progress.failureCount = failureCount;
+        desc->progressCallback(desc->progressUserData, &progress);
+    }
+
     if (desc->verbose && failureCount)
     {
         fprintf(stdout, "\nSome files are not extracted (%llu/%llu)\n", (unsigned long long)loopLimit - failureCount,
@@ -2137,80 +2452,604 @@ bool bunyArLibExtract(struct IFileSystem* archive, ResourceDirectory rd, const c
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// Function bunyArLibPrintBlockAnalysis                                    ///
+/// Function bunyArLibExtract (multithreaded)                               ///
 ////////////////////////////////////////////////////////////////////////////////
 
-void bunyArLibPrintBlockAnalysis(const struct BunyArBlockFormatHeader* header, const BunyArBlockPointer* blocks)
-{
-    uint64_t nRaws = 0;
-    uint64_t sizeCompressed = 0;
-    uint64_t rawpercent = 0;
-    double   avgCompression = 1;
+// Files are splitted to ranges which are decompressed in parallel.
+// Ranges are dispatched in order, and memory for them is reserved in order,
+// so the earliest unwritten range always owns its memory and extraction always progresses.
+// Thread completing a range writes all consecutive completed ranges of its file.
 
-    if (header->blockCount)
-    {
-        for (uint64_t bi = 0; bi < header->blockCount - 1; ++bi)
-        {
-            struct BunyArBlockInfo block = bunyArDecodeBlockPointer(blocks[bi]);
+#define BUNYAR_LIB_EXTRACT_RANGE_SIZE            (4 * 1024 * 1024)
+#define BUNYAR_LIB_EXTRACT_MAX_OPEN_FILES        256
 
-            if (block.isCompressed)
-                sizeCompressed += block.size;
-            else
-                ++nRaws;
-        }
+struct ExtractThreadsSharedMemory;
 
-        struct BunyArBlockInfo lastblock = bunyArDecodeBlockPointer(blocks[header->blockCount - 1]);
+struct ExtractRange
+{
+    struct ExtractFile* file;
+    uint64_t            offset;
+    uint64_t            size;
+    uint8_t*            buffer;
+    bool                completed;
+};
 
-        if (lastblock.isCompressed)
-            sizeCompressed += lastblock.size;
+struct ExtractFile
+{
+    struct ExtractThreadsSharedMemory* tsm;
 
-        rawpercent = ((nRaws + !lastblock.isCompressed) * 100) / header->blockCount;
+    uint64_t    uid;
+    const char* name;
+    uint64_t    fileSize;
 
-        if (sizeCompressed)
-        {
-            uint64_t uncompressedSize = ((header->blockCount - 1) - nRaws) * header->blockSize;
+    FileStream fsOut;
+    Mutex      mutex;
 
-            if (lastblock.isCompressed)
-                uncompressedSize += header->blockSizeLast;
+    // guarded by mutex
+    uint32_t    nextRangeToWrite;
+    const char* error;
 
-            avgCompression = (double)uncompressedSize / (double)sizeCompressed;
-        }
-    }
+    uint32_t            rangeCount;
+    struct ExtractRange ranges[1];
+};
 
-    fprintf(stdout, "%llu of %lluKB blocks, %llu%% raw", (unsigned long long)header->blockCount,
-            (unsigned long long)header->blockSize / 1024, (unsigned long long)rawpercent);
+struct ExtractThreadsSharedMemory
+{
+    ThreadSystem                       threadSystem;
+    IFileSystem*                       archive;
+    const struct BunyArLibExtractDesc* desc;
+    size_t                             memoryLimit;
 
-    if (rawpercent != 0 && rawpercent != 100)
-        fprintf(stdout, " (%.2f non-raw rate)", avgCompression);
-}
+    // Guarded by mutex
+    Mutex             mutex;
+    // Notified when range memory is released
+    ConditionVariable condition;
+    uint64_t          memoryInUse;
+    uint64_t          openFileCount;
+    int               counterWidth;
+    bool              abort;
 
-////////////////////////////////////////////////////////////////////////////////
-/// Function bunyArLibHashTableBenchmarks                                   ///
-////////////////////////////////////////////////////////////////////////////////
+    struct BunyArLibExtractProgress progress;
+};
 
-static int BunyArNodeNodeCmp(const void* v0, const void* v1)
+static void extractFileDone(struct ExtractFile* file)
 {
-    const struct BunyArNode* n0 = (const struct BunyArNode*)v0;
-    const struct BunyArNode* n1 = (const struct BunyArNode*)v1;
+    struct ExtractThreadsSharedMemory* tsm = file->tsm;
 
-    const char* names = NULL;
-    memcpy((void*)&names, (const void*)&n0->filePointer, sizeof(char*)); //-V512_UNDERFLOW_OFF
+    if (!fsCloseStream(&file->fsOut) && !file->error)
+        file->error = "failed to close output file";
 
-    return strcmp(names + n0->namePointer.offset, names + n1->namePointer.offset);
+    if (file->error)
+        LOGF(eERROR, "Failed to extract file '%s': %s", file->name, file->error);
+
+    acquireMutex(&tsm->mutex);
+
+    ++tsm->progress.filesDone;
+    if (file->error)
+    {
+        ++tsm->progress.failureCount;
+        if (!tsm->desc->continueOnError)
+            tsm->abort = true;
+    }
+    else if (tsm->desc->verbose)
+    {
+        fprintf(stdout, "%*llu/%*llu '%s'\n", tsm->counterWidth, (unsigned long long)tsm->progress.filesDone, tsm->counterWidth,
+                (unsigned long long)tsm->progress.fileCount, file->name);
+    }
+
+    --tsm->openFileCount;
+    wakeOneConditionVariable(&tsm->condition);
+    releaseMutex(&tsm->mutex);
+
+    exitMutex(&file->mutex);
+    tf_free(file);
 }
 
-static void randomizeStr(char* str, size_t length)
+static void extractRangeTask(void* user, uint64_t threadId)
 {
-    const char CHARSET[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ/.-_0123456789";
+    (void)threadId;
 
-    if (!length)
-        return;
+    struct ExtractRange*               range = (struct ExtractRange*)user;
+    struct ExtractFile*                file = range->file;
+    struct ExtractThreadsSharedMemory* tsm = file->tsm;
 
-    for (size_t n = 0; n < length - 1; n++)
+    const char* error = NULL;
+
+    if (!tsm->abort && !file->error)
+    {
+        FileStream fsIn = { 0 };
+        if (!fsIoOpenByUid(tsm->archive, file->uid, FM_READ, &fsIn))
+            error = "file is corrupted or archive stream failure";
+        else if (!fsSeekStream(&fsIn, SBO_START_OF_FILE, (ssize_t)range->offset))
+            error = "archive stream seek failure";
+        else if (fsReadFromStream(&fsIn, range->buffer, range->size) != range->size)
+            error = "File size mismatch";
+        fsCloseStream(&fsIn);
+    }
+
+    acquireMutex(&file->mutex);
+
+    range->completed = true;
+    if (error && !file->error)
+        file->error = error;
+
+    uint64_t bytesWritten = 0;
+    uint64_t memoryReleased = 0;
+
+    // Write all consecutive completed ranges
+    while (file->nextRangeToWrite < file->rangeCount && file->ranges[file->nextRangeToWrite].completed)
+    {
+        struct ExtractRange* r = file->ranges + file->nextRangeToWrite++;
+
+        if (!file->error && !tsm->abort && fsWriteToStream(&file->fsOut, r->buffer, r->size) != r->size)
+            file->error = "failed to write data to output file";
+
+        if (!file->error)
+            bytesWritten += r->size;
+
+        memoryReleased += r->size;
+        tf_free(r->buffer);
+        r->buffer = NULL;
+    }
+
+    bool fileDone = file->nextRangeToWrite == file->rangeCount;
+
+    releaseMutex(&file->mutex);
+
+    acquireMutex(&tsm->mutex);
+    tsm->memoryInUse -= memoryReleased;
+    tsm->progress.bytesDone += bytesWritten;
+    wakeOneConditionVariable(&tsm->condition);
+    releaseMutex(&tsm->mutex);
+
+    if (fileDone)
+        extractFileDone(file);
+}
+
+static void extractReportProgress(struct ExtractThreadsSharedMemory* tsm, struct BunyArLibExtractProgress* lastReported)
+{
+    if (!tsm->desc->progressCallback)
+        return;
+
+    acquireMutex(&tsm->mutex);
+    struct BunyArLibExtractProgress progress = tsm->progress;
+    releaseMutex(&tsm->mutex);
+
+    if (memcmp(&progress, lastReported, sizeof progress) == 0)
+        return;
+
+    *lastReported = progress;
+    tsm->desc->progressCallback(tsm->desc->progressUserData, &progress);
+}
+
+static inline bool extractFits(const struct ExtractThreadsSharedMemory* tsm, uint64_t memorySize, bool openFile)
+{
+    // single range larger than limit is allowed, when nothing else is in flight
+    bool memoryFits = tsm->memoryInUse == 0 || tsm->memoryInUse + memorySize <= tsm->memoryLimit;
+    bool fileFits = !openFile || tsm->openFileCount < BUNYAR_LIB_EXTRACT_MAX_OPEN_FILES;
+    return memoryFits && fileFits;
+}
+
+// Reserves memory and file slot for the next range.
+// Caller thread helps with tasks while waiting.
+// Returns false if extraction is aborted.
+static bool extractWaitFor(struct ExtractThreadsSharedMemory* tsm, uint64_t memorySize, bool openFile,
+                           struct BunyArLibExtractProgress* lastReported)
+{
+    for (;;)
+    {
+        extractReportProgress(tsm, lastReported);
+
+        acquireMutex(&tsm->mutex);
+        bool abort = tsm->abort;
+        if (!abort && extractFits(tsm, memorySize, openFile))
+        {
+            tsm->memoryInUse += memorySize;
+            tsm->openFileCount += openFile;
+        }
+        else if (!abort)
+        {
+            releaseMutex(&tsm->mutex);
+
+            if (threadSystemAssist(tsm->threadSystem))
+                continue;
+
+            acquireMutex(&tsm->mutex);
+            if (!tsm->abort && !extractFits(tsm, memorySize, openFile))
+                waitConditionVariable(&tsm->condition, &tsm->mutex, 100);
+            releaseMutex(&tsm->mutex);
+            continue;
+        }
+        releaseMutex(&tsm->mutex);
+        return !abort;
+    }
+}
+
+static bool bunyArLibExtractMultiThreaded(IFileSystem* archive, ResourceDirectory rd, const char* dstDir,
+                                          const struct BunyArLibExtractDesc* desc)
+{
+    struct BunyArDescription archiveInfo;
+    fsArchiveGetDescription(archive, &archiveInfo);
+
+    bool     loopFileNames = desc->fileNameCount > 0;
+    uint64_t loopLimit = loopFileNames ? desc->fileNameCount : archiveInfo.nodeCount;
+
+    struct ExtractThreadsSharedMemory tsm;
+    memset(&tsm, 0, sizeof tsm);
+
+    tsm.archive = archive;
+    tsm.desc = desc;
+    tsm.memoryLimit = desc->memoryLimit ? desc->memoryLimit : BUNYAR_LIB_EXTRACT_MEMORY_LIMIT_DEFAULT;
+    tsm.progress.fileCount = loopLimit;
+
+    if (desc->verbose)
+    {
+        char buffer[32];
+        tsm.counterWidth = snprintf(buffer, sizeof buffer, "%llu", (unsigned long long)loopLimit);
+    }
+
+    tsm.progress.bytesTotal = bunyArLibExtractTotalSize(archive, desc, loopLimit);
+
+    struct ThreadSystemInitDesc tsInfo = { 0 };
+    tsInfo.threadCount = desc->threadPoolSize < 0 ? getNumCPUCores() : (uint64_t)desc->threadPoolSize;
+    tsInfo.threadName = "Extract";
+
+    if (!initMutex(&tsm.mutex))
+        return false;
+
+    if (!initConditionVariable(&tsm.condition))
+    {
+        exitMutex(&tsm.mutex);
+        return false;
+    }
+
+    if (!threadSystemInit(&tsm.threadSystem, &tsInfo))
+    {
+        LOGF(eERROR, "Failed to start thread pool");
+        exitConditionVariable(&tsm.condition);
+        exitMutex(&tsm.mutex);
+        return false;
+    }
+
+    struct BunyArLibExtractProgress lastReported = { 0 };
+
+    for (uint64_t i = 0; i < loopLimit; ++i)
+    {
+        const char* error = NULL;
+
+        uint64_t uid = i;
+
+        struct BunyArNodeDescription node;
+
+        if (loopFileNames && !fsArchiveGetNodeId(archive, desc->fileNames[i], &uid))
+        {
+            node.name = desc->fileNames[i];
+            error = "no such file";
+            goto FILE_FAILED;
+        }
+
+        fsArchiveGetNodeDescription(archive, uid, &node);
+
+        if (strncmp(node.name, "../", 3) == 0)
+        {
+            LOGF(eERROR, "Archive file '%s' contains backlinks, so it is skipped.", node.name);
+            acquireMutex(&tsm.mutex);
+            ++tsm.progress.filesDone;
+            releaseMutex(&tsm.mutex);
+            continue;
+        }
+
+        // Align ranges to compressed blocks, so no block is decompressed twice
+        uint64_t rangeSize = BUNYAR_LIB_EXTRACT_RANGE_SIZE;
+        {
+            FileStream                     fsIn = { 0 };
+            struct BunyArBlockFormatHeader blocksHeader;
+            const BunyArBlockPointer*      blocks;
+            if (!fsIoOpenByUid(archive, uid, FM_READ, &fsIn))
+            {
+                error = "file is corrupted or archive stream failure";
+                goto FILE_FAILED;
+            }
+            if (fsArchiveGetFileBlockMetadata(&fsIn, &blocksHeader, &blocks) && blocksHeader.blockSize)
+                rangeSize = (rangeSize / blocksHeader.blockSize + (rangeSize < blocksHeader.blockSize)) * blocksHeader.blockSize;
+            fsCloseStream(&fsIn);
+        }
+
+        uint64_t rangeCount = node.fileSize / rangeSize + (node.fileSize % rangeSize != 0);
+        if (rangeCount == 0)
+            rangeCount = 1; // empty file still has to be created
+
+        struct ExtractFile* file = (struct ExtractFile*)tf_calloc(1, sizeof *file + sizeof file->ranges[0] * (rangeCount - 1));
+        if (!file || !initMutex(&file->mutex))
+        {
+            tf_free(file);
+            error = "out of memory";
+            goto FILE_FAILED;
+        }
+
+        file->tsm = &tsm;
+        file->uid = uid;
+        file->name = node.name;
+        file->fileSize = node.fileSize;
+        file->rangeCount = (uint32_t)rangeCount;
+
+        { // prepare directory and output file on the caller thread
+            char buffer[FS_MAX_PATH];
+            char subDir[FS_MAX_PATH];
+            fsGetParentPath(node.name, subDir);
+            fsAppendPathComponent(dstDir, subDir, buffer);
+            if (!fsCreateDirectory(rd, buffer, true))
+            {
+                error = "failed to create directory";
+            }
+            else
+            {
+                fsAppendPathComponent(dstDir, node.name, buffer);
+                if (!fsOpenStreamFromPath(rd, buffer, FM_WRITE, &file->fsOut))
+                    error = "failed to create output file";
+            }
+
+            if (error)
+            {
+                exitMutex(&file->mutex);
+                tf_free(file);
+                goto FILE_FAILED;
+            }
+        }
+
+        for (uint32_t ri = 0; ri < file->rangeCount; ++ri)
+        {
+            struct ExtractRange* range = file->ranges + ri;
+            range->file = file;
+            range->offset = ri * rangeSize;
+            range->size = node.fileSize - range->offset < rangeSize ? node.fileSize - range->offset : rangeSize;
+
+            if (!extractWaitFor(&tsm, range->size, ri == 0, &lastReported))
+            {
+                // Remaining ranges are completed without work, so file is released by the last one
+                for (uint32_t rj = ri; rj < file->rangeCount; ++rj)
+                {
+                    file->ranges[rj].file = file;
+                    file->ranges[rj].size = 0;
+                }
+                if (ri == 0)
+                {
+                    acquireMutex(&tsm.mutex);
+                    ++tsm.openFileCount;
+                    releaseMutex(&tsm.mutex);
+                }
+                threadSystemAddTaskGroup(tsm.threadSystem, extractRangeTask, file->rangeCount - ri, file->ranges + ri);
+                break;
+            }
+
+            range->buffer = range->size ? (uint8_t*)tf_malloc(range->size) : NULL;
+            if (range->size && !range->buffer)
+            {
+                acquireMutex(&file->mutex);
+                file->error = "out of memory";
+                releaseMutex(&file->mutex);
+            }
+
+            threadSystemAddTask(tsm.threadSystem, extractRangeTask, range);
+        }
+
+        continue;
+
+    FILE_FAILED:
+        LOGF(eERROR, "Failed to extract file '%s': %s", node.name, error);
+        acquireMutex(&tsm.mutex);
+        ++tsm.progress.filesDone;
+        ++tsm.progress.failureCount;
+        if (!desc->continueOnError)
+            tsm.abort = true;
+        releaseMutex(&tsm.mutex);
+
+        if (tsm.abort)
+            break;
+    }
+
+    while (threadSystemAssist(tsm.threadSystem))
+        extractReportProgress(&tsm, &lastReported);
+
+    threadSystemWaitIdle(tsm.threadSystem);
+    threadSystemExit(&tsm.threadSystem, &gThreadSystemExitDescDefault);
+
+    extractReportProgress(&tsm, &lastReported);
+
+    exitConditionVariable(&tsm.condition);
+    exitMutex(&tsm.mutex);
+
+    uint64_t failureCount = tsm.progress.failureCount;
+
+    if (desc->verbose && failureCount)
+    {
+        fprintf(stdout, "\nSome files are not extracted (%llu/%llu)\n", (unsigned long long)(loopLimit - failureCount),
+                (unsigned long long)loopLimit);
+    }
+    else if (desc->verbose)
+    {
+        fprintf(stdout, "\nAll files are extracted (%llu)\n", (unsigned long long)loopLimit);
+    }
+
+    return failureCount == 0 && !tsm.abort;
+}
+
+bool bunyArLibExtract(IFileSystem* archive, ResourceDirectory rd, const char* dstDir, const struct BunyArLibExtractDesc* desc)
+{
+    if (desc->threadPoolSize == 0)
+        return bunyArLibExtractSingleThreaded(archive, rd, dstDir, desc);
+    return bunyArLibExtractMultiThreaded(archive, rd, dstDir, desc);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function bunyArLibPrintBlockAnalysis                                    ///
+////////////////////////////////////////////////////////////////////////////////
+
+void bunyArLibPrintBlockAnalysis(const struct BunyArBlockFormatHeader* header, const BunyArBlockPointer* blocks)
+{
+    uint64_t nRaws = 0;
+    uint64_t sizeCompressed = 0;
+    uint64_t rawpercent = 0;
+    double   avgCompression = 1;
+
+    if (header->blockCount)
+    {
+        for (uint64_t bi = 0; bi < header->blockCount - 1; ++bi)
+        {
+            struct BunyArBlockInfo block = bunyArDecodeBlockPointer(blocks[bi]);
+
+            if (block.isCompressed)
+                sizeCompressed += block.size;
+            else
+                ++nRaws;
+        }
+
+        struct BunyArBlockInfo lastblock = bunyArDecodeBlockPointer(blocks[header->blockCount - 1]);
+
+        if (lastblock.isCompressed)
+            sizeCompressed += lastblock.size;
+
+        rawpercent = ((nRaws + !lastblock.isCompressed) * 100) / header->blockCount;
+
+        if (sizeCompressed)
+        {
+            uint64_t uncompressedSize = ((header->blockCount - 1) - nRaws) * header->blockSize;
+
+            if (lastblock.isCompressed)
+                uncompressedSize += header->blockSizeLast;
+
+            avgCompression = (double)uncompressedSize / (double)sizeCompressed;
+        }
+    }
+
+    fprintf(stdout, "%llu of %lluKB blocks, %llu%% raw", (unsigned long long)header->blockCount,
+            (unsigned long long)header->blockSize / 1024, (unsigned long long)rawpercent);
+
+    if (rawpercent != 0 && rawpercent != 100)
+        fprintf(stdout, " (%.2f non-raw rate)", avgCompression);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function bunyArLibHashTableBenchmarks                                   ///
+////////////////////////////////////////////////////////////////////////////////
+
+static int BunyArNodeNodeCmp(const void* v0, const void* v1)
+{
+    const struct BunyArNode* n0 = (const struct BunyArNode*)v0;
+    const struct BunyArNode* n1 = (const struct BunyArNode*)v1;
+
+    const char* names = NULL;
+    memcpy((void*)&names, (const void*)&n0->filePointer, sizeof(char*)); //-V512_UNDERFLOW_OFF
+
+    return strcmp(names + n0->namePointer.offset, names + n1->namePointer.offset);
+}
+
+static void randomizeStr(char* str, size_t length)
+{
+    const char CHARSET[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ/.-_0123456789";
+
+    if (!length)
+        return;
+
+    for (size_t n = 0; n < length - 1; n++)
         str[n] = CHARSET[rand() % (int)(sizeof CHARSET - 1)];
     str[length - 1] = 0;
 }
 
+static bool bunyArLibHashTableBenchmark(enum BunyArHashTableType type, size_t keyCount, const struct BunyArNode* nodes, const char* names)
+{
+    const char* typeName = bunyArHashTableTypeName(type);
+
+    bool success = true;
+
+    ///////////////////
+    // Contruction test
+
+    int64_t startTime = getUSec(true);
+
+    struct BunyArHashTable* hashTable = bunyArHashTableConstructType(type, keyCount, nodes, names);
+
+    int64_t endTime = getUSec(true);
+
+    size_t htsize = bunyArHashTableSize(hashTable);
+
+    LOGF(eINFO, "Archive %s hash table %s for %llu keys in %s. %s (%f bits/key).", typeName,
+         hashTable ? "construction" : "construction failure", (unsigned long long)keyCount, humanReadableTime(endTime - startTime).str,
+         humanReadableSize(htsize).str, (double)(8 * htsize) / (double)keyCount);
+
+    if (!hashTable)
+    {
+        success = false;
+        goto CLEANUP;
+    }
+
+    //////////////
+    // Lookup test
+
+    startTime = getUSec(true);
+
+    for (size_t i = 0; i < keyCount; ++i)
+    {
+        uint64_t value = bunyArHashTableLookup(hashTable, names + nodes[i].namePointer.offset, keyCount, nodes, names);
+
+        if (value >= keyCount)
+        {
+            LOGF(eERROR, "Archive %s hash table lookup test failed: key wasn't found.", typeName);
+            success = false;
+            goto CLEANUP;
+        }
+
+        if (value != i)
+        {
+            LOGF(eERROR, "Archive %s hash table lookup test failed: got the wrong key.", typeName);
+            success = false;
+            goto CLEANUP;
+        }
+    }
+
+    endTime = getUSec(true);
+
+    LOGF(eINFO, "Archive %s hash table lookup for %llu keys in %s. %s/key", typeName, (unsigned long long)keyCount,
+         humanReadableTime(endTime - startTime).str, humanReadableTimeD((double)(endTime - startTime) / (double)keyCount).str);
+
+    ///////////////////
+    // Miss lookup test
+
+    {
+        // Keys are ASCII, so flipping high bit of the last character makes unknown key
+        char key[FS_MAX_PATH];
+
+        size_t missCount = 0;
+
+        startTime = getUSec(true);
+
+        for (size_t i = 0; i < keyCount; ++i)
+        {
+            const struct BunyArNode* node = nodes + i;
+            size_t                   size = node->namePointer.size < sizeof(key) - 1 ? node->namePointer.size : sizeof(key) - 1;
+
+            memcpy(key, names + node->namePointer.offset, size);
+            key[size] = 0;
+            if (size)
+                key[size - 1] ^= 0x80;
+
+            missCount += bunyArHashTableLookup(hashTable, key, keyCount, nodes, names) >= keyCount;
+        }
+
+        endTime = getUSec(true);
+
+        LOGF(eINFO, "Archive %s hash table miss lookup for %llu keys in %s. %s/key", typeName, (unsigned long long)missCount,
+             humanReadableTime(endTime - startTime).str, humanReadableTimeD((double)(endTime - startTime) / (double)keyCount).str);
+    }
+
+    ///////////////////////
+    // Cleanup
+
+CLEANUP:
+    tf_free(hashTable);
+    return success;
+}
+
 bool bunyArLibHashTableBenchmarks(size_t keyCount, size_t keySize)
 {
     if (keyCount == 0 || keySize == 0)
@@ -2283,62 +3122,157 @@ bool bunyArLibHashTableBenchmarks(size_t keyCount, size_t keySize)
     LOGF(eINFO, "%llu unique %llu-bit keys generated in %s", (unsigned long long)keyCount, (unsigned long long)keySize * 8,
          humanReadableTime(endTime - startTime).str);
 
-    ///////////////////
-    // Contruction test
+    for (int type = 0; type < BUNYAR_HASH_TABLE_TYPE_COUNT && success; ++type)
+        success = bunyArLibHashTableBenchmark((enum BunyArHashTableType)type, keyCount, nodes, names);
 
-    startTime = getUSec(true);
+    tf_free(nodes);
 
-    struct BunyArHashTable* hashTable = bunyArHashTableConstruct(keyCount, nodes, names);
+    return success;
+}
 
-    endTime = getUSec(true);
+////////////////////////////////////////////////////////////////////////////////
+/// Function bunyArLibZstdDictionaryBenchmarks                              ///
+////////////////////////////////////////////////////////////////////////////////
 
-    size_t htsize = bunyArHashTableSize(hashTable);
+#define BUNYAR_DICT_BENCHMARK_ITERATIONS 5
 
-    LOGF(eINFO, "Archive hash table %s for %llu keys in %s. %s (%f bits/key).", hashTable ? "construction" : "construction failure",
-         (unsigned long long)keyCount, humanReadableTime(endTime - startTime).str, humanReadableSize(htsize).str,
-         (double)(8 * htsize) / (double)keyCount);
+struct BunyArLibZstdDictionaryBenchmarkResult
+{
+    int64_t  createTime;
+    uint64_t archiveSize;
+    uint64_t filesSize;
+    uint64_t nodeCount;
+    // best of iterations
+    int64_t  openTime;
+    int64_t  readTime;
+};
 
-    if (!hashTable)
+static bool bunyArLibZstdDictionaryBenchmarkRun(ResourceDirectory rd, const char* inputPath, const char* tmpPath,
+                                                enum BunyArFileFormat format, size_t dictionarySize,
+                                                struct BunyArLibZstdDictionaryBenchmarkResult* result)
+{
+    memset(result, 0, sizeof *result);
+
+    struct BunyArLibEntryCreateDesc entry = BUNYAR_LIB_FUNC_CREATE_DEFAULT_ENTRY_DESC;
+    entry.inputRd = rd;
+    entry.inputPath = inputPath;
+    entry.format = format;
+    entry.compressionLevel = ZSTD_CLEVEL_DEFAULT;
+
+    struct BunyArLibCreateDesc createDesc = { 0 };
+    createDesc.entryCount = 1;
+    createDesc.entries = &entry;
+    createDesc.threadPoolSize = -1;
+    createDesc.zstdDictionarySize = dictionarySize;
+
+    int64_t startTime = getUSec(true);
+    if (!bunyArLibCreate(rd, tmpPath, &createDesc))
+        return false;
+    result->createTime = getUSec(true) - startTime;
+
+    FileStream fs = { 0 };
+    if (fsOpenStreamFromPath(rd, tmpPath, FM_READ, &fs))
     {
-        success = false;
-        goto CLEANUP;
+        result->archiveSize = (uint64_t)fsGetStreamFileSize(&fs);
+        fsCloseStream(&fs);
     }
 
-    //////////////
-    // Lookup test
+    bool     success = true;
+    uint8_t* buffer = NULL;
 
-    startTime = getUSec(true);
+    result->openTime = INT64_MAX;
+    result->readTime = INT64_MAX;
 
-    for (size_t i = 0; i < keyCount; ++i)
+    for (int it = 0; it < BUNYAR_DICT_BENCHMARK_ITERATIONS && success; ++it)
     {
-        uint64_t value = bunyArHashTableLookup(hashTable, names + nodes[i].namePointer.offset, keyCount, nodes, names);
+        struct ArchiveOpenDesc openDesc = { 0 };
+        IFileSystem            archive;
 
-        if (value >= keyCount)
+        startTime = getUSec(true);
+        if (!fsArchiveOpen(rd, tmpPath, &openDesc, &archive))
         {
-            LOGF(eERROR, "Archive hash table lookup test failed: key wasn't found.");
             success = false;
-            goto CLEANUP;
+            break;
         }
+        int64_t openTime = getUSec(true) - startTime;
 
-        if (value != i)
+        struct BunyArDescription archiveInfo;
+        fsArchiveGetDescription(&archive, &archiveInfo);
+
+        result->nodeCount = archiveInfo.nodeCount;
+        result->filesSize = 0;
+
+        startTime = getUSec(true);
+        for (uint64_t uid = 0; uid < archiveInfo.nodeCount; ++uid)
         {
-            LOGF(eERROR, "Archive hash table lookup test failed: got the wrong key.");
-            success = false;
-            goto CLEANUP;
+            struct BunyArNodeDescription node;
+            fsArchiveGetNodeDescription(&archive, uid, &node);
+
+            if (arrlenu(buffer) < node.fileSize)
+                arrsetlen(buffer, node.fileSize);
+
+            FileStream file = { 0 };
+            if (!fsIoOpenByUid(&archive, uid, FM_READ, &file))
+            {
+                LOGF(eERROR, "Failed to open file '%s' from archive '%s'", node.name, tmpPath);
+                success = false;
+                break;
+            }
+
+            size_t read = fsReadFromStream(&file, buffer, node.fileSize);
+            fsCloseStream(&file);
+
+            if (read != node.fileSize)
+            {
+                LOGF(eERROR, "Failed to read file '%s' from archive '%s'", node.name, tmpPath);
+                success = false;
+                break;
+            }
+
+            result->filesSize += node.fileSize;
         }
+        int64_t readTime = getUSec(true) - startTime;
+
+        fsArchiveClose(&archive);
+
+        if (openTime < result->openTime)
+            result->openTime = openTime;
+        if (readTime < result->readTime)
+            result->readTime = readTime;
     }
 
-    endTime = getUSec(true);
+    arrfree(buffer);
+    return success;
+}
 
-    LOGF(eINFO, "Archive hash table lookup for %llu keys in %s. %s/key", (unsigned long long)keyCount,
-         humanReadableTime(endTime - startTime).str, humanReadableTimeD((double)(endTime - startTime) / (double)keyCount).str);
+static void bunyArLibZstdDictionaryBenchmarkPrint(const char* name, const struct BunyArLibZstdDictionaryBenchmarkResult* r)
+{
+    uint64_t nodeCount = r->nodeCount ? r->nodeCount : 1;
 
-    ///////////////////////
-    // Cleanup
+    LOGF(eINFO, "%-9s %llu files %s -> %s (x%.2f). Created in %s. Archive open %s. Open+read %s/file",
+         name, (unsigned long long)r->nodeCount, humanReadableSize(r->filesSize).str, humanReadableSize(r->archiveSize).str,
+         r->archiveSize ? (double)r->filesSize / (double)r->archiveSize : 0.0, humanReadableTime(r->createTime).str,
+         humanReadableTime(r->openTime).str, humanReadableTimeD((double)r->readTime / (double)nodeCount).str);
+}
 
-CLEANUP:
-    tf_free(hashTable);
-    tf_free(nodes);
+bool bunyArLibZstdDictionaryBenchmarks(ResourceDirectory rd, const char* inputPath, const char* tmpPath, size_t dictionarySize)
+{
+    struct BunyArLibZstdDictionaryBenchmarkResult zstd;
+    struct BunyArLibZstdDictionaryBenchmarkResult dict;
 
-    return success;
+    if (!bunyArLibZstdDictionaryBenchmarkRun(rd, inputPath, tmpPath, BUNYAR_FILE_FORMAT_ZSTD_BLOCKS, 0, &zstd) ||
+        !bunyArLibZstdDictionaryBenchmarkRun(rd, inputPath, tmpPath, BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS, dictionarySize, &dict))
+    {
+        LOGF(eERROR, "Zstd dictionary benchmark failed for '%s'", inputPath);
+        return false;
+    }
+
+    bunyArLibZstdDictionaryBenchmarkPrint(bunyArFormatName(BUNYAR_FILE_FORMAT_ZSTD_BLOCKS), &zstd);
+    bunyArLibZstdDictionaryBenchmarkPrint(bunyArFormatName(BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS), &dict);
+
+    if (zstd.archiveSize)
+    {
+        LOGF(eINFO, "Dictionary archive is %.2f%% of the plain zstd archive size", 100.0 * (double)dict.archiveSize / (double)zstd.archiveSize);
+    }
+    return true;
 }
@@ -32,6 +32,8 @@ extern "C"
 #define BUNYAR_LIB_COMPRESSION_LEVEL_DEFAULT INT_MIN
 #define BUNYAR_LIB_BLOCK_SIZE_KB_DEFAULT     UINT32_MAX
 #define BUNYAR_LIB_FORMAT_DEFAULT            BUNYAR_FILE_FORMAT_LZ4_BLOCKS
+// same as zstd "--maxdict" default
+#define BUNYAR_LIB_ZSTD_DICTIONARY_SIZE_DEFAULT (110 * 1024)
 
     struct BunyArLibEntryCreateDesc
     {
@@ -71,6 +73,8 @@ extern "C"
         struct BunyArLibEntryCreateDesc* entries;
 
         bool     skipHashTable;
+        // BUNYAR_HASH_TABLE_TYPE_PERFECT by default
+        enum BunyArHashTableType hashTableType;
         // larger value, more details
         unsigned verbose;
 
@@ -88,6 +92,12 @@ extern "C"
         // Minimum is 4KB
         // If 0, it sets to default 4MB
         size_t memorySizePerThread;
+
+        // Capacity of zstd dictionary trained over
+        // BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS entries.
+        // Dictionary is only created if such entries exist.
+        // If 0, it sets to BUNYAR_LIB_ZSTD_DICTIONARY_SIZE_DEFAULT
+        size_t zstdDictionarySize;
     };
 
     static const struct BunyArLibEntryCreateDesc BUNYAR_LIB_FUNC_CREATE_DEFAULT_ENTRY_DESC = {
@@ -105,6 +115,21 @@ extern "C"
 
     bool bunyArLibCreate(ResourceDirectory rd, const char* dstPath, const struct BunyArLibCreateDesc* desc);
 
+    struct BunyArLibExtractProgress
+    {
+        uint64_t fileCount;
+        // including failed ones
+        uint64_t filesDone;
+        uint64_t failureCount;
+        uint64_t bytesTotal;
+        uint64_t bytesDone;
+    };
+
+    // Called on the thread calling bunyArLibExtract
+    typedef void (*BunyArLibExtractProgressFunc)(void* pUserData, const struct BunyArLibExtractProgress* progress);
+
+#define BUNYAR_LIB_EXTRACT_MEMORY_LIMIT_DEFAULT (256 * 1024 * 1024)
+
     struct BunyArLibExtractDesc
     {
         // if fileNameCount is 0, all files are extracted
@@ -119,6 +144,21 @@ extern "C"
         // Try all files even after failing extracting anyone,
         // e.g. if one from "fileNames" is missing, extract others anyway
         bool continueOnError;
+
+        // if < 0, uses getNumCPUCores()
+        // if = 0, uses single-threaded code path
+        // if > 0, threadPoolSize + calling thread
+        // Multithreaded extraction requires archive opened with
+        // ArchiveOpenDesc::mmap or ArchiveOpenDesc::protectStreamCriticalSection
+        int threadPoolSize;
+
+        // Limit of decompressed data waiting to be written.
+        // If 0, it sets to BUNYAR_LIB_EXTRACT_MEMORY_LIMIT_DEFAULT
+        size_t memoryLimit;
+
+        // optional
+        BunyArLibExtractProgressFunc progressCallback;
+        void*                        progressUserData;
     };
 
     bool bunyArLibExtract(struct IFileSystem* archiveFs, ResourceDirectory rd, const char* dstPath,
@@ -128,6 +168,10 @@ extern "C"
 
     bool bunyArLibHashTableBenchmarks(size_t keyCount, size_t keySize);
 
+    // Creates archives at "tmpPath" (overwritten) from "inputPath" entry with and without zstd dictionary.
+    // Compares archive size and time spent to open archive and read all files.
+    bool bunyArLibZstdDictionaryBenchmarks(ResourceDirectory rd, const char* inputPath, const char* tmpPath, size_t dictionarySize);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,6 +24,7 @@
 
 #include <locale.h>
 
+#include "../../Utilities/Benchmarks/Benchmarks.h"
 #include "../../Utilities/Interfaces/ILog.h"
 
 #include "Buny.h"
@@ -56,6 +57,19 @@ enum ArgType
     AT_PARALLEL_READS,
     AT_MEMORY_SIZE,
     AT_THREADS,
+    AT_DICTIONARY_SIZE,
+    AT_DICTIONARY_INPUT,
+    AT_SWEEP,
+    AT_MEMORY_STREAM,
+    AT_WRITE_SIZE,
+    AT_THREAD_SYSTEM,
+    AT_PARALLEL_FOR,
+    AT_ATOMICS,
+    AT_QUEUES,
+    AT_MUTEX,
+    AT_LANES,
+    AT_ALLOC,
+    AT_LOG,
 };
 
 struct ArgTracker
@@ -70,7 +84,8 @@ struct ArgTracker
 struct BunyArToolCtx
 {
     // archive create flags
-    bool hashMap;
+    bool                     hashMap;
+    enum BunyArHashTableType hashTableType;
 
     // archive create entry args
     size_t                outputNameCutLength; // only set by drag&drop
@@ -83,6 +98,7 @@ struct BunyArToolCtx
     int                   threadCount;
     size_t                parallelFileReads;
     size_t                MBPerThread;
+    size_t                dictionarySizeKb;
 
     // inspect
     bool inspectBlocks;
@@ -93,6 +109,18 @@ struct BunyArToolCtx
     // benchmark
     size_t keyCount;
     size_t keySize;
+    bool   sweep;
+    size_t memoryStreamMB;
+    size_t writeSize;
+    char*  dictionaryInput;
+    size_t threadSystemTaskCount;
+    size_t parallelForIterationCount;
+    size_t atomicsOpCount;
+    size_t queueItemCount;
+    size_t mutexOpCount;
+    size_t lanesFrameCount;
+    size_t allocOpCount;
+    size_t logOpCount;
 
     // global
     bool     archivePathDontWanna;
@@ -122,12 +150,15 @@ static struct ArgTracker ARG_TRACKER_CREATE[] = {
 	{ "--raw",            AT_FORMAT,            0, 0, "no   compression for next entries" },
 	{ "--zstd",           AT_FORMAT,            0, 0, "ZSTD compression for next entries" },
 	{ "--lz4",            AT_FORMAT,            0, 0, "LZ4  compression for next entries" },
+	{ "--dict",           AT_FORMAT,            0, 0, "ZSTD compression with trained dictionary for next entries, uses --zstdcl" },
+	{ "--dict-size",      AT_DICTIONARY_SIZE,   1, 1024, "size of trained ZSTD dictionary in KB" },
 	{ "--threads",        AT_THREADS,          -1, 99, "thread pool size. 0 singlethreaded. -1 auto" },
 	{ "--parallel-reads", AT_PARALLEL_READS,    1, 99, "max number of file streams when thread pool enabled" },
 	{ "--thread-memory",  AT_MEMORY_SIZE,       1, 64, "MB of memory allocated per thread. Threads can starve on low amount." },
 	{ "--bsize",          AT_BLOCK_SIZE,        1, (BUNYAR_BLOCK_MAX_SIZE_MINUS_ONE + 1) / 1024, "size of compressed data block in KB" },
 	{ "--hashmap",        AT_HASHMAP,           0, 0, "precompute hash table (enabled by default)" },
 	{ "--no-hashmap",     AT_HASHMAP,           0, 0, "disable hash table precomputing" },
+	{ "--swiss-hashmap",  AT_HASHMAP,           0, 0, "precompute SIMD probed hash table, faster to build" },
 	{ "--optional",       AT_OPTIONAL,          0, 0, "keep going if next entries are missing" },
 	{ "--required",       AT_OPTIONAL,          0, 0, "undo --optional" },
 	{ "--help",           AT_HELP,              0, 0, "be provided with something that is useful or necessary in achieving" },
@@ -140,6 +171,8 @@ static struct ArgTracker ARG_TRACKER_INSPECT[] = {
 };
 static struct ArgTracker ARG_TRACKER_EXTRACT[] = {
 	{ "--keep-going", AT_CONTINUE_ON_ERROR, 0, 0, "continue on error" },
+	{ "--threads",    AT_THREADS,          -1, 99, "thread pool size. 0 singlethreaded. -1 auto" },
+	{ "--memory",     AT_MEMORY_SIZE,       1, 64 * 1024, "MB of decompressed data kept in memory while writing" },
 	{ "--quiet",      AT_VERBOSITY,         0, 0, "disable stdout output (log not affected)" },
 	{ "--verbose",    AT_VERBOSITY,         0, 0, "display statistics" },
 	{ "--help",       AT_HELP,              0, 0, "gain assistance or support to achieve goals" },
@@ -148,6 +181,20 @@ static struct ArgTracker ARG_TRACKER_EXTRACT[] = {
 static struct ArgTracker ARG_TRACKER_BENCHMARK[] = {
 	{ "--key-count",  AT_KEY_COUNT,         0, 1000 * 1000 * 1000, "number of keys" },
 	{ "--key-size",   AT_KEYSIZE,           1, 512, "size of key in bytes" },
+	{ "--sweep",      AT_SWEEP,             0, 0, "run for 1K, 10K, 100K, 1M and 10M keys" },
+	{ "--memory-stream", AT_MEMORY_STREAM,  1, 16 * 1024, "run memory stream benchmark writing MB instead" },
+	{ "--write-size", AT_WRITE_SIZE,        1, 64 * 1024 * 1024, "size of a single memory stream write in bytes" },
+	{ "--dict-input", AT_DICTIONARY_INPUT,  1, 0, "run ZSTD dictionary benchmark on directory instead" },
+	{ "--dict-size",  AT_DICTIONARY_SIZE,   1, 1024, "size of trained ZSTD dictionary in KB" },
+	{ "--thread-system", AT_THREAD_SYSTEM,  1, 10 * 1000 * 1000, "run thread system scheduler benchmark with number of tasks instead" },
+	{ "--parallel-for", AT_PARALLEL_FOR,    1, 1000 * 1000 * 1000, "run parallel for benchmark with number of iterations instead" },
+	{ "--atomics",    AT_ATOMICS,           1, 1000 * 1000 * 1000, "run atomics contention benchmark with number of operations per thread instead" },
+	{ "--queues",     AT_QUEUES,            1, 1000 * 1000 * 1000, "run lock-free queue benchmark with number of items per producer instead" },
+	{ "--mutex",      AT_MUTEX,             1, 1000 * 1000 * 1000, "run mutex benchmark with number of locks per thread instead" },
+	{ "--lanes",      AT_LANES,             1, 1000 * 1000, "run thread system priority lanes benchmark with number of frames instead" },
+	{ "--alloc",      AT_ALLOC,             1, 1000 * 1000 * 1000, "run tf_malloc benchmark with number of alloc/free pairs per thread instead" },
+	{ "--log",        AT_LOG,               1, 100 * 1000 * 1000, "run log throughput benchmark with number of messages per thread instead" },
+	{ "--threads",    AT_THREADS,           1, 64, "max thread count for thread system benchmarks" },
 	{ "--help",       AT_HELP,              0, 0, "get support or aid" },
 	{ NULL,           AT_UNRECOGNIZED,      0, 0, NULL },
 };
@@ -253,10 +300,47 @@ static bool nextArg(struct BunyArToolCtx* ctx, char** out)
             case 'z':
                 ctx->format = BUNYAR_FILE_FORMAT_ZSTD_BLOCKS;
                 break;
+            case 'd':
+                ctx->format = BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS;
+                break;
             }
             break;
         case AT_HASHMAP:
             ctx->hashMap = resolver != 'n';
+            ctx->hashTableType = resolver == 's' ? BUNYAR_HASH_TABLE_TYPE_SWISS : BUNYAR_HASH_TABLE_TYPE_PERFECT;
+            break;
+        case AT_SWEEP:
+            ctx->sweep = true;
+            break;
+        case AT_MEMORY_STREAM:
+            ctx->memoryStreamMB = (size_t)value;
+            break;
+        case AT_WRITE_SIZE:
+            ctx->writeSize = (size_t)value;
+            break;
+        case AT_THREAD_SYSTEM:
+            ctx->threadSystemTaskCount = (size_t)value;
+            break;
+        case AT_PARALLEL_FOR:
+            ctx->parallelForIterationCount = (size_t)value;
+            break;
+        case AT_ATOMICS:
+            ctx->atomicsOpCount = (size_t)value;
+            break;
+        case AT_QUEUES:
+            ctx->queueItemCount = (size_t)value;
+            break;
+        case AT_MUTEX:
+            ctx->mutexOpCount = (size_t)value;
+            break;
+        case AT_LANES:
+            ctx->lanesFrameCount = (size_t)value;
+            break;
+        case AT_ALLOC:
+            ctx->allocOpCount = (size_t)value;
+            break;
+        case AT_LOG:
+            ctx->logOpCount = (size_t)value;
             break;
         case AT_VERBOSITY:
             ctx->verbose = resolver == 'q' ? 0 : 2;
@@ -291,6 +375,12 @@ static bool nextArg(struct BunyArToolCtx* ctx, char** out)
         case AT_MEMORY_SIZE:
             ctx->MBPerThread = (size_t)value;
             break;
+        case AT_DICTIONARY_SIZE:
+            ctx->dictionarySizeKb = (size_t)value;
+            break;
+        case AT_DICTIONARY_INPUT:
+            ctx->dictionaryInput = b;
+            break;
         case AT_UNRECOGNIZED:
         default:
             fprintf(stderr, "Unrecognized argument '%s'\n", a);
@@ -404,6 +494,7 @@ static int bunyArToolCreate(struct BunyArToolCtx* ctx)
             entry->compressionLevel = ctx->lz4cl;
             break;
         case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+        case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
             entry->compressionLevel = ctx->zstdcl;
             break;
         case BUNYAR_FILE_FORMAT_RAW:
@@ -415,11 +506,13 @@ static int bunyArToolCreate(struct BunyArToolCtx* ctx)
     if (success)
     {
         info.skipHashTable = !ctx->hashMap;
+        info.hashTableType = ctx->hashTableType;
         info.verbose = ctx->verbose;
 
         info.maxParallelFileReads = ctx->parallelFileReads;
         info.threadPoolSize = ctx->threadCount;
         info.memorySizePerThread = ctx->MBPerThread * 1024 * 1024;
+        info.zstdDictionarySize = ctx->dictionarySizeKb * 1024;
 
         success = bunyArLibCreate(TF_RD, ctx->archivePath, &info);
     }
@@ -509,6 +602,16 @@ static int bunyArToolInspect(struct BunyArToolCtx* ctx)
     return 0;
 }
 
+static void extractProgressPrint(void* pUserData, const struct BunyArLibExtractProgress* progress)
+{
+    (void)pUserData;
+    fprintf(stdout, "\r%llu/%llu files, %s/%s", (unsigned long long)progress->filesDone, (unsigned long long)progress->fileCount,
+            humanReadableSize(progress->bytesDone).str, humanReadableSize(progress->bytesTotal).str);
+    if (progress->filesDone == progress->fileCount)
+        fprintf(stdout, "%s\n", progress->failureCount ? ", some files are not extracted" : "");
+    fflush(stdout);
+}
+
 static int bunyArToolExtract(struct BunyArToolCtx* ctx)
 {
     ctx->argTrackers = ARG_TRACKER_EXTRACT;
@@ -546,11 +649,22 @@ static int bunyArToolExtract(struct BunyArToolCtx* ctx)
 
     desc.verbose = ctx->verbose;
     desc.continueOnError = ctx->keepGoing;
+    desc.threadPoolSize = ctx->threadCount;
+    desc.memoryLimit = ctx->MBPerThread * 1024 * 1024;
+    if (ctx->verbose == 1 && ctx->threadCount != 0)
+    {
+        // file names are printed in completion order, so show overall progress instead
+        desc.verbose = 0;
+        desc.progressCallback = extractProgressPrint;
+    }
 
     struct ArchiveOpenDesc adesc = { 0 };
 
     adesc.disableHashTable = desc.fileNameCount == 0;
     adesc.validation = true;
+    // required for multithreaded extraction
+    adesc.mmap = true;
+    adesc.protectStreamCriticalSection = true;
 
     IFileSystem archiveFs = { 0 };
     if (success && !fsArchiveOpen(TF_RD, ctx->archivePath, &adesc, &archiveFs))
@@ -576,8 +690,20 @@ static int bunyArToolBenchmark(struct BunyArToolCtx* ctx)
 
     // clang-format off
 	ctx->helpStr =
-	  "Hash table benchmark.\n"
-	  "\nUsage:\n\tbenchmark --key-size=8 --key-count=100000000\n";
+	  "Hash table, ZSTD dictionary, memory stream, thread system, parallel for, atomics, queue, mutex, "
+	  "priority lanes, allocator or log benchmark.\n"
+	  "\nUsage:\n\tbenchmark --key-size=8 --key-count=100000000\n"
+	  "\tbenchmark --key-size=64 --sweep\n"
+	  "\tbenchmark --dict-input=Art --dict-size=110\n"
+	  "\tbenchmark --memory-stream=512 --write-size=4096\n"
+	  "\tbenchmark --thread-system=20000 --threads=64\n"
+	  "\tbenchmark --parallel-for=1000000 --threads=64\n"
+	  "\tbenchmark --atomics=1000000 --threads=64\n"
+	  "\tbenchmark --queues=1000000 --threads=16\n"
+	  "\tbenchmark --mutex=1000000 --threads=16\n"
+	  "\tbenchmark --lanes=1000 --threads=64\n"
+	  "\tbenchmark --alloc=1000000 --threads=64\n"
+	  "\tbenchmark --log=100000 --threads=32\n";
     // clang-format on
 
     for (;;)
@@ -593,6 +719,47 @@ static int bunyArToolBenchmark(struct BunyArToolCtx* ctx)
         return -1;
     }
 
+    if (ctx->dictionaryInput)
+    {
+        return bunyArLibZstdDictionaryBenchmarks(TF_RD, ctx->dictionaryInput, "buny_dict_benchmark.buny", ctx->dictionarySizeKb * 1024)
+                   ? 0
+                   : -1;
+    }
+
+    uint64_t maxThreadCount = ctx->threadCount > 0 ? (uint64_t)ctx->threadCount : 64;
+
+    if (ctx->memoryStreamMB)
+        return benchmarkMemoryStream(ctx->memoryStreamMB * 1024 * 1024, ctx->writeSize) ? 0 : -1;
+    if (ctx->threadSystemTaskCount)
+        return benchmarkThreadSystem(ctx->threadSystemTaskCount, maxThreadCount) ? 0 : -1;
+    if (ctx->parallelForIterationCount)
+        return benchmarkParallelFor(ctx->parallelForIterationCount, maxThreadCount) ? 0 : -1;
+    if (ctx->atomicsOpCount)
+        return benchmarkAtomics(ctx->atomicsOpCount, maxThreadCount) ? 0 : -1;
+    if (ctx->queueItemCount)
+        return benchmarkQueues(ctx->queueItemCount, maxThreadCount) ? 0 : -1;
+    if (ctx->mutexOpCount)
+        return benchmarkMutex(ctx->mutexOpCount, maxThreadCount) ? 0 : -1;
+    if (ctx->lanesFrameCount)
+        return benchmarkLanes(ctx->lanesFrameCount, maxThreadCount) ? 0 : -1;
+    if (ctx->allocOpCount)
+        return benchmarkAlloc(ctx->allocOpCount, maxThreadCount) ? 0 : -1;
+    if (ctx->logOpCount)
+    {
+        uint64_t logThreadCount = ctx->threadCount > 0 ? (uint64_t)ctx->threadCount : 32;
+        return benchmarkLog(TF_RD, "buny_log_benchmark.log", ctx->logOpCount, logThreadCount) ? 0 : -1;
+    }
+
+    if (ctx->sweep)
+    {
+        for (size_t keyCount = 1000; keyCount <= 10 * 1000 * 1000; keyCount *= 10)
+        {
+            if (!bunyArLibHashTableBenchmarks(keyCount, ctx->keySize))
+                return -1;
+        }
+        return 0;
+    }
+
     return bunyArLibHashTableBenchmarks(ctx->keyCount, ctx->keySize) ? 0 : -1;
 }
 
@@ -851,6 +1018,7 @@ static int bunyArTool(int argCount, char** args)
 
     ctx.keyCount = 10000000;
     ctx.keySize = 8;
+    ctx.writeSize = 4096;
 
     ctx.argBeg = args + 2;
     ctx.argEnd = args + argCount;
@@ -0,0 +1,236 @@
+# Copyright (c) 2017-2024 The Forge Interactive Inc.
+#
+# This file is part of The-Forge
+# (see https://github.com/ConfettiFX/The-Forge).
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+Renders profiler samples written by dumpProfileSamples (see Common_3/Application/Interfaces/IProfiler.h) as an SVG
+flame graph. Every line of the .folded file is "Thread;Group/Zone;...;function;... count": the thread first, then the
+cpu zones open while the samples were taken, then the call stack from the outermost frame.
+
+Frames the app couldn't name at runtime are written as "module+0xoffset", --addr2line resolves them from the debug
+info of the module. The same files also load in flamegraph.pl and speedscope.
+
+Usage: python flame_graph.py App.folded [More.folded ...] [-o App.svg] [--addr2line] [--thread Main] [--zone Group/Name]
+"""
+
+import argparse
+import collections
+import html
+import os
+import re
+import subprocess
+import sys
+
+FRAME_HEIGHT = 16
+FONT_SIZE = 11
+CHAR_WIDTH = 6.5  # average glyph width of FONT_SIZE monospace text
+MARGIN = 10
+HEADER = 40
+
+UNRESOLVED = re.compile(r"^(.+)\+0x([0-9a-fA-F]+)$")
+
+
+class Node:
+    def __init__(self, name):
+        self.name = name
+        self.total = 0
+        self.children = collections.OrderedDict()
+
+    def child(self, name):
+        node = self.children.get(name)
+        if node is None:
+            node = self.children[name] = Node(name)
+        return node
+
+
+def read_folded(paths):
+    stacks = collections.Counter()
+    for path in paths:
+        with open(path, "r", encoding="utf-8", errors="replace") as file:
+            for number, line in enumerate(file, 1):
+                line = line.rstrip("\n")
+                if not line:
+                    continue
+                # Names can contain spaces, the count is after the last one
+                stack, _, count = line.rpartition(" ")
+                if not stack or not count.isdigit():
+                    raise ValueError("%s:%d: expected 'frame;frame;... count'" % (path, number))
+                stacks[stack] += int(count)
+    return stacks
+
+
+def resolve_addresses(stacks):
+    """Names module+offset frames with addr2line, one call per module."""
+    offsets = collections.defaultdict(set)
+    for stack in stacks:
+        for frame in stack.split(";"):
+            match = UNRESOLVED.match(frame)
+            if match:
+                offsets[match.group(1)].add(match.group(2))
+
+    names = {}
+    for module, module_offsets in offsets.items():
+        # linux-vdso.so.1 and friends have no file
+        if not os.path.isfile(module):
+            continue
+        ordered = sorted(module_offsets)
+        try:
+            result = subprocess.run(
+                ["addr2line", "-f", "-C", "-e", module] + ["0x" + offset for offset in ordered],
+                capture_output=True,
+                text=True,
+                check=True,
+            )
+        except (OSError, subprocess.CalledProcessError) as error:
+            print("addr2line failed for %s: %s" % (module, error), file=sys.stderr)
+            continue
+        # Two lines per address: function, then file:line
+        lines = result.stdout.splitlines()
+        for index, offset in enumerate(ordered):
+            function = lines[index * 2] if index * 2 < len(lines) else "??"
+            if function != "??":
+                names["%s+0x%s" % (module, offset)] = function
+
+    resolved = collections.Counter()
+    for stack, count in stacks.items():
+        resolved[";".join(names.get(frame, frame) for frame in stack.split(";"))] += count
+    return resolved
+
+
+def build_tree(stacks, thread, zone):
+    root = Node("all")
+    for stack, count in stacks.items():
+        frames = stack.split(";")
+        if thread and frames[0] != thread:
+            continue
+        if zone:
+            # Only the samples taken inside the zone, rooted at the zone
+            if zone not in frames[1:]:
+                continue
+            frames = frames[frames.index(zone, 1) :]
+        root.total += count
+        node = root
+        for frame in frames:
+            node = node.child(frame)
+            node.total += count
+    return root
+
+
+def is_zone(name):
+    # Zones are "Group/Name", native frames are function names or module+offset
+    return "/" in name and not UNRESOLVED.match(name) and "::" not in name and "(" not in name
+
+
+def frame_color(name, depth):
+    if depth == 0:
+        return "rgb(190,190,190)"
+    if is_zone(name):
+        # Instrumented zones in blue so they stand out from the sampled code
+        shade = sum(ord(c) for c in name) % 60
+        return "rgb(%d,%d,235)" % (80 + shade, 140 + shade)
+    # Classic flame colors, stable per function
+    seed = sum(ord(c) for c in name)
+    return "rgb(%d,%d,%d)" % (205 + seed % 50, 80 + (seed * 7) % 130, 40 + (seed * 13) % 40)
+
+
+def max_depth(node, depth=0):
+    return max([depth] + [max_depth(child, depth + 1) for child in node.children.values()])
+
+
+def render_svg(root, width, min_width, title):
+    depth = max_depth(root)
+    height = HEADER + (depth + 1) * FRAME_HEIGHT + MARGIN * 2
+    scale = (width - MARGIN * 2) / float(root.total) if root.total else 0.0
+
+    out = [
+        '<?xml version="1.0" standalone="no"?>',
+        '<svg version="1.1" width="%d" height="%d" xmlns="http://www.w3.org/2000/svg">' % (width, height),
+        '<rect x="0" y="0" width="%d" height="%d" fill="rgb(250,250,245)"/>' % (width, height),
+        '<text x="%d" y="24" font-size="16" font-family="Verdana" text-anchor="middle">%s</text>'
+        % (width // 2, html.escape(title)),
+        '<g font-family="monospace" font-size="%d">' % FONT_SIZE,
+    ]
+
+    def emit(node, x, level):
+        node_width = node.total * scale
+        if node_width < min_width:
+            return
+        y = height - MARGIN - (level + 1) * FRAME_HEIGHT
+        percent = 100.0 * node.total / root.total
+        label = "%s (%d samples, %.2f%%)" % (node.name, node.total, percent)
+        out.append("<g><title>%s</title>" % html.escape(label))
+        out.append(
+            '<rect x="%.1f" y="%d" width="%.1f" height="%d" fill="%s" rx="2"/>'
+            % (x, y, max(node_width - 0.5, 0.1), FRAME_HEIGHT - 1, frame_color(node.name, level - 1))
+        )
+        chars = int((node_width - 6) / CHAR_WIDTH)
+        if chars >= 3:
+            text = node.name if len(node.name) <= chars else node.name[: chars - 2] + ".."
+            out.append('<text x="%.1f" y="%d">%s</text>' % (x + 3, y + FRAME_HEIGHT - 4, html.escape(text)))
+        out.append("</g>")
+
+        child_x = x
+        for child in sorted(node.children.values(), key=lambda child: child.name):
+            emit(child, child_x, level + 1)
+            child_x += child.total * scale
+
+    emit(root, MARGIN, 0)
+    out.append("</g>")
+    out.append("</svg>")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Renders dumpProfileSamples .folded files as SVG flame graphs")
+    parser.add_argument("inputs", nargs="+", help=".folded files, samples of all of them are added up")
+    parser.add_argument("-o", "--output", help="SVG file to write, stdout when not given")
+    parser.add_argument("--addr2line", action="store_true", help="resolve module+offset frames with addr2line")
+    parser.add_argument("--thread", help="only samples of this thread")
+    parser.add_argument("--zone", help="only samples taken inside this Group/Name zone, rooted at it")
+    parser.add_argument("--width", type=int, default=1600, help="image width in pixels")
+    parser.add_argument("--min-width", type=float, default=0.1, help="omit frames narrower than this many pixels")
+    parser.add_argument("--title", default="Flame Graph", help="title drawn above the graph")
+    args = parser.parse_args()
+
+    try:
+        stacks = read_folded(args.inputs)
+    except (OSError, ValueError) as error:
+        print("Could not read samples: %s" % error, file=sys.stderr)
+        return 1
+    if args.addr2line:
+        stacks = resolve_addresses(stacks)
+
+    root = build_tree(stacks, args.thread, args.zone)
+    if not root.total:
+        print("No samples left to draw", file=sys.stderr)
+        return 1
+
+    svg = render_svg(root, args.width, args.min_width, args.title)
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as file:
+            file.write(svg)
+    else:
+        sys.stdout.write(svg)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -595,7 +595,7 @@ void platformExitReloadClient()
 
 void platformReloadClientRequestShaderRecompile()
 {
-    if (tfrg_atomic32_cas_relaxed(&gClient.mIsReloading, 0, 1) == 1)
+    if (tfrg_atomic32_cas_acq_rel(&gClient.mIsReloading, 0, 1) == 1)
     {
         // Someone has already requested a recompile so we don't need to
         return;
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2017-2024 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// ThreadSanitizer checks of the Atomics.h memory orderings. Every test hands plain (non-atomic) data between threads
+// only through the ordering under test, so a too weak ordering shows up as a data race report.
+// Standalone program, not part of any project. Build and run from the repository root on Linux or macOS:
+//
+//   cc -std=gnu11 -O1 -g -fsanitize=thread Common_3/Utilities/Benchmarks/AtomicsTest.c -o atomics_test -lpthread
+//   ./atomics_test
+//
+// Exit code is 0 when all tests pass. Run it with TSAN_OPTIONS=halt_on_error=1 to fail on the first race report too.
+// Fences (tfrg_memorybarrier_*) are not covered: ThreadSanitizer doesn't model standalone fences.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../Threading/Atomics.h"
+
+#define ATOMICS_TEST_THREAD_COUNT 4
+#define ATOMICS_TEST_ITERATIONS   100000
+#define ATOMICS_TEST_LOCK_COUNT   10000
+#define ATOMICS_TEST_ROUNDS       1000
+
+typedef void* (*AtomicsTestThreadFunc)(void*);
+
+static void runThreads(AtomicsTestThreadFunc func, void* user, uint32_t threadCount)
+{
+    pthread_t threads[ATOMICS_TEST_THREAD_COUNT];
+    for (uint32_t i = 0; i < threadCount; ++i)
+        pthread_create(&threads[i], NULL, func, user);
+    for (uint32_t i = 0; i < threadCount; ++i)
+        pthread_join(threads[i], NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Release store / acquire load message passing                            ///
+////////////////////////////////////////////////////////////////////////////////
+
+struct MessagePassing
+{
+    uint32_t         payload32;
+    uint64_t         payload64;
+    uint32_t         payloadPtr;
+    tfrg_atomic32_t  ready32;
+    tfrg_atomic64_t  ready64;
+    tfrg_atomicptr_t readyPtr;
+    uint32_t         received;
+};
+
+static void* messagePassingProducer(void* user)
+{
+    struct MessagePassing* mp = (struct MessagePassing*)user;
+    mp->payload32 = 1;
+    tfrg_atomic32_store_release(&mp->ready32, 1);
+    mp->payload64 = 2;
+    tfrg_atomic64_store_release(&mp->ready64, 1);
+    mp->payloadPtr = 3;
+    tfrg_atomicptr_store_release(&mp->readyPtr, (uintptr_t)&mp->payloadPtr);
+    return NULL;
+}
+
+static void* messagePassingConsumer(void* user)
+{
+    struct MessagePassing* mp = (struct MessagePassing*)user;
+    while (!tfrg_atomic32_load_acquire(&mp->ready32))
+        tfrg_cpu_pause();
+    uint32_t received = mp->payload32;
+    while (!tfrg_atomic64_load_acquire(&mp->ready64))
+        tfrg_cpu_pause();
+    received += (uint32_t)mp->payload64;
+    uintptr_t ptr;
+    while (!(ptr = tfrg_atomicptr_load_acquire(&mp->readyPtr)))
+        tfrg_cpu_pause();
+    received += *(const uint32_t*)ptr;
+    mp->received = received;
+    return NULL;
+}
+
+static bool testMessagePassing(void)
+{
+    for (uint32_t round = 0; round < ATOMICS_TEST_ROUNDS; ++round)
+    {
+        struct MessagePassing mp = { 0 };
+        pthread_t             producer, consumer;
+        pthread_create(&consumer, NULL, messagePassingConsumer, &mp);
+        pthread_create(&producer, NULL, messagePassingProducer, &mp);
+        pthread_join(producer, NULL);
+        pthread_join(consumer, NULL);
+        if (mp.received != 6)
+        {
+            fprintf(stderr, "message passing: received %u instead of 6\n", mp.received);
+            return false;
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Relaxed counters                                                        ///
+////////////////////////////////////////////////////////////////////////////////
+
+struct RelaxedCounters
+{
+    tfrg_atomic32_t  counter32;
+    tfrg_atomic64_t  counter64;
+    tfrg_atomicptr_t counterPtr;
+    tfrg_atomic32_t  max32;
+};
+
+static void* relaxedCountersThread(void* user)
+{
+    struct RelaxedCounters* rc = (struct RelaxedCounters*)user;
+    for (uint32_t i = 0; i < ATOMICS_TEST_ITERATIONS; ++i)
+    {
+        tfrg_atomic32_add_relaxed(&rc->counter32, 1);
+        tfrg_atomic64_add_relaxed(&rc->counter64, 2);
+        tfrg_atomicptr_add_relaxed(&rc->counterPtr, 3);
+        tfrg_atomic32_max_relaxed(&rc->max32, i);
+    }
+    return NULL;
+}
+
+static bool testRelaxedCounters(void)
+{
+    struct RelaxedCounters rc = { 0 };
+    runThreads(relaxedCountersThread, &rc, ATOMICS_TEST_THREAD_COUNT);
+
+    const uint64_t total = (uint64_t)ATOMICS_TEST_THREAD_COUNT * ATOMICS_TEST_ITERATIONS;
+    if (tfrg_atomic32_load_relaxed(&rc.counter32) != total || tfrg_atomic64_load_relaxed(&rc.counter64) != total * 2 ||
+        tfrg_atomicptr_load_relaxed(&rc.counterPtr) != total * 3 || tfrg_atomic32_load_relaxed(&rc.max32) != ATOMICS_TEST_ITERATIONS - 1)
+    {
+        fprintf(stderr, "relaxed counters: lost updates\n");
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// acq_rel add hand-off (reference count release pattern)                  ///
+////////////////////////////////////////////////////////////////////////////////
+
+struct RefCount
+{
+    uint32_t        slots[ATOMICS_TEST_THREAD_COUNT];
+    tfrg_atomic32_t next;
+    tfrg_atomic32_t done;
+    uint32_t        sum;
+};
+
+static void* refCountThread(void* user)
+{
+    struct RefCount* rc = (struct RefCount*)user;
+    uint32_t         slot = tfrg_atomic32_add_relaxed(&rc->next, 1);
+    rc->slots[slot] = slot + 1;
+    // Last thread to finish sees every slot, like the last owner freeing a shared object
+    if (tfrg_atomic32_add_acq_rel(&rc->done, 1) == ATOMICS_TEST_THREAD_COUNT - 1)
+    {
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < ATOMICS_TEST_THREAD_COUNT; ++i)
+            sum += rc->slots[i];
+        rc->sum = sum;
+    }
+    return NULL;
+}
+
+static bool testRefCount(void)
+{
+    for (uint32_t round = 0; round < ATOMICS_TEST_ROUNDS; ++round)
+    {
+        struct RefCount rc = { 0 };
+        runThreads(refCountThread, &rc, ATOMICS_TEST_THREAD_COUNT);
+        if (rc.sum != ATOMICS_TEST_THREAD_COUNT * (ATOMICS_TEST_THREAD_COUNT + 1) / 2)
+        {
+            fprintf(stderr, "acq_rel add: last owner summed %u\n", rc.sum);
+            return false;
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// acq_rel CAS loops                                                       ///
+////////////////////////////////////////////////////////////////////////////////
+
+struct CasLoop
+{
+    tfrg_atomic32_t counter32;
+    tfrg_atomic64_t counter64;
+};
+
+static void* casLoopThread(void* user)
+{
+    struct CasLoop* cl = (struct CasLoop*)user;
+    for (uint32_t i = 0; i < ATOMICS_TEST_ITERATIONS; ++i)
+    {
+        for (;;)
+        {
+            uint32_t value = tfrg_atomic32_load_relaxed(&cl->counter32);
+            if (tfrg_atomic32_cas_acq_rel(&cl->counter32, value, value + 1) == value)
+                break;
+        }
+        for (;;)
+        {
+            uint64_t value = tfrg_atomic64_load_relaxed(&cl->counter64);
+            if (tfrg_atomic64_cas_relaxed(&cl->counter64, value, value + 1) == value)
+                break;
+        }
+    }
+    return NULL;
+}
+
+static bool testCasLoop(void)
+{
+    struct CasLoop cl = { 0 };
+    runThreads(casLoopThread, &cl, ATOMICS_TEST_THREAD_COUNT);
+
+    const uint64_t total = (uint64_t)ATOMICS_TEST_THREAD_COUNT * ATOMICS_TEST_ITERATIONS;
+    if (tfrg_atomic32_load_relaxed(&cl.counter32) != total || tfrg_atomic64_load_relaxed(&cl.counter64) != total)
+    {
+        fprintf(stderr, "cas loop: lost updates\n");
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// CAS spinlock guarding plain data                                        ///
+////////////////////////////////////////////////////////////////////////////////
+
+struct SpinLock
+{
+    tfrg_atomic32_t lock;
+    uint64_t        guarded;
+};
+
+static void* spinLockThread(void* user)
+{
+    struct SpinLock* sl = (struct SpinLock*)user;
+    for (uint32_t i = 0; i < ATOMICS_TEST_LOCK_COUNT; ++i)
+    {
+        while (tfrg_atomic32_cas_acq_rel(&sl->lock, 0, 1) != 0)
+            tfrg_cpu_pause();
+        ++sl->guarded;
+        tfrg_atomic32_store_release(&sl->lock, 0);
+    }
+    return NULL;
+}
+
+static bool testSpinLock(void)
+{
+    struct SpinLock sl = { 0 };
+    runThreads(spinLockThread, &sl, ATOMICS_TEST_THREAD_COUNT);
+
+    if (sl.guarded != (uint64_t)ATOMICS_TEST_THREAD_COUNT * ATOMICS_TEST_LOCK_COUNT)
+    {
+        fprintf(stderr, "spinlock: guarded counter is %llu\n", (unsigned long long)sl.guarded);
+        return false;
+    }
+    return true;
+}
+
+int main(void)
+{
+    struct
+    {
+        const char* name;
+        bool (*func)(void);
+    } tests[] = {
+        { "release/acquire message passing", testMessagePassing },
+        { "relaxed counters", testRelaxedCounters },
+        { "acq_rel add hand-off", testRefCount },
+        { "acq_rel cas loop", testCasLoop },
+        { "cas spinlock", testSpinLock },
+    };
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        bool passed = tests[i].func();
+        fprintf(stdout, "%-32s %s\n", tests[i].name, passed ? "passed" : "FAILED");
+        failures += passed ? 0 : 1;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,1749 @@
+/*
+ * Copyright (c) 2017-2024 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "Benchmarks.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Interfaces/IFileSystem.h"
+#include "../Interfaces/ILog.h"
+#include "../Interfaces/IThread.h"
+#include "../Interfaces/ITime.h"
+#include "../Threading/Atomics.h"
+#include "../Threading/RingQueue.h"
+#include "../Threading/ThreadSystem.h"
+
+#include "../Interfaces/IMemory.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function benchmarkMemoryStream                                          ///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool benchMemoryStreamRun(const char* name, FileStream* fs, size_t totalSize, const uint8_t* src, size_t writeSize)
+{
+    int64_t startTime = getUSec(true);
+
+    for (size_t written = 0; written < totalSize; written += writeSize)
+    {
+        size_t size = totalSize - written < writeSize ? totalSize - written : writeSize;
+        if (fsWriteToStream(fs, src, size) != size)
+        {
+            LOGF(eERROR, "%s memory stream write failure", name);
+            return false;
+        }
+    }
+
+    int64_t writeTime = getUSec(true) - startTime;
+
+    // Gather chunks without flattening
+    startTime = getUSec(true);
+
+    uint64_t          checksum = 0;
+    MemoryStreamChunk chunks[64];
+    size_t            chunkCount = 1;
+    for (size_t first = 0; first < chunkCount; first += sizeof(chunks) / sizeof(chunks[0]))
+    {
+        chunkCount = fsGetMemoryStreamChunks(fs, first, sizeof(chunks) / sizeof(chunks[0]), chunks);
+        for (size_t i = first; i < chunkCount && i - first < sizeof(chunks) / sizeof(chunks[0]); ++i)
+            checksum += chunks[i - first].mSize;
+    }
+
+    int64_t gatherTime = getUSec(true) - startTime;
+
+    if (checksum != totalSize)
+    {
+        LOGF(eERROR, "%s memory stream chunks cover %llu bytes instead of %llu", name, (unsigned long long)checksum,
+             (unsigned long long)totalSize);
+        return false;
+    }
+
+    double seconds = (double)(writeTime ? writeTime : 1) / 1e6;
+
+    LOGF(eINFO, "%-10s %s in %llu byte writes: %s, %.1f MB/s. %llu chunks gathered in %s", name, humanReadableSize(totalSize).str,
+         (unsigned long long)writeSize, humanReadableTime(writeTime).str, (double)totalSize / (1024.0 * 1024.0) / seconds,
+         (unsigned long long)chunkCount, humanReadableTime(gatherTime).str);
+    return true;
+}
+
+bool benchmarkMemoryStream(size_t totalSize, size_t writeSize)
+{
+    if (totalSize == 0 || writeSize == 0)
+        return true;
+
+    uint8_t* src = (uint8_t*)tf_malloc(writeSize);
+    if (!src)
+        return false;
+
+    for (size_t i = 0; i < writeSize; ++i)
+        src[i] = (uint8_t)i;
+
+    bool success = true;
+
+    FileStream fs = { 0 };
+    fsOpenStreamFromMemory(NULL, 0, FM_READ_WRITE, true, &fs);
+    success = benchMemoryStreamRun("contiguous", &fs, totalSize, src, writeSize);
+    fsCloseStream(&fs);
+
+    if (success)
+    {
+        fsOpenChunkedMemoryStream(0, FM_READ_WRITE, &fs);
+        success = benchMemoryStreamRun("chunked", &fs, totalSize, src, writeSize);
+        fsCloseStream(&fs);
+    }
+
+    tf_free(src);
+    return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function benchmarkThreadSystem                                          ///
+////////////////////////////////////////////////////////////////////////////////
+
+static const char* const BENCH_SCHEDULER_NAMES[THREAD_SYSTEM_SCHEDULER_COUNT] = {
+    "shared-queue",
+    "work-stealing",
+    "fibers",
+};
+
+enum BenchThreadSystemBenchmarkMode
+{
+    // All tasks are added by caller
+    BENCH_THREAD_SYSTEM_EXTERNAL,
+    // One root task per thread adds the rest
+    BENCH_THREAD_SYSTEM_NESTED,
+    // Same as nested, but roots wait for their children with threadSystemWaitTask
+    BENCH_THREAD_SYSTEM_WAITING,
+    BENCH_THREAD_SYSTEM_MODE_COUNT,
+};
+
+static const char* const BENCH_THREAD_SYSTEM_MODE_NAMES[BENCH_THREAD_SYSTEM_MODE_COUNT] = {
+    "external",
+    "nested",
+    "waiting",
+};
+
+struct BenchThreadSystemBenchmark
+{
+    ThreadSystem    threadSystem;
+    int64_t         taskTime;
+    // Tasks added by each root task from worker thread, 0 if all tasks are added by caller
+    uint64_t        childCount;
+    bool            waitChildren;
+    // Time between adding and starting of every task
+    int64_t*        latencies;
+    tfrg_atomic64_t latencyCount;
+};
+
+struct BenchThreadSystemBenchmarkTask
+{
+    struct BenchThreadSystemBenchmark*     bench;
+    int64_t                                    addTime;
+    struct BenchThreadSystemBenchmarkTask* children;
+};
+
+static void benchThreadSystemBenchmarkTask(void* user, uint64_t threadId)
+{
+    (void)threadId;
+
+    struct BenchThreadSystemBenchmarkTask* task = user;
+    struct BenchThreadSystemBenchmark*     bench = task->bench;
+
+    int64_t startTime = getUSec(true);
+    bench->latencies[tfrg_atomic64_add_relaxed(&bench->latencyCount, 1)] = startTime - task->addTime;
+
+    if (task->children && bench->waitChildren)
+    {
+        TaskHandle join = threadSystemCreateTask(bench->threadSystem, NULL, NULL);
+
+        for (uint64_t i = 0; join && i < bench->childCount; ++i)
+        {
+            TaskHandle child = threadSystemCreateTask(bench->threadSystem, benchThreadSystemBenchmarkTask, task->children + i);
+            if (!child)
+                continue;
+
+            task->children[i].addTime = getUSec(true);
+            threadSystemAddTaskDependency(join, child);
+            threadSystemSubmitTask(child);
+            threadSystemReleaseTask(child);
+        }
+
+        if (join)
+        {
+            threadSystemSubmitTask(join);
+            threadSystemWaitTask(bench->threadSystem, join);
+            threadSystemReleaseTask(join);
+        }
+    }
+
+    for (uint64_t i = 0; task->children && !bench->waitChildren && i < bench->childCount; ++i)
+    {
+        task->children[i].addTime = getUSec(true);
+        threadSystemAddTask(bench->threadSystem, benchThreadSystemBenchmarkTask, task->children + i);
+    }
+
+    while (getUSec(true) - startTime < bench->taskTime)
+        ;
+}
+
+static int benchLatencyCmp(const void* v1, const void* v2)
+{
+    int64_t l1 = *(const int64_t*)v1;
+    int64_t l2 = *(const int64_t*)v2;
+    return l1 < l2 ? -1 : l1 > l2 ? 1 : 0;
+}
+
+static void benchLogThreadSystemInfo(ThreadSystem ts)
+{
+    struct ThreadSystemInfo info;
+    threadSystemGetInfo(ts, &info);
+
+    uint64_t taskCount = info.taskCount ? info.taskCount : 1;
+    LOGF(eINFO, "    instrumented: %llu tasks, latency avg %lluus max %lluus, run avg %lluus, peak queue depth %llu",
+         (unsigned long long)info.taskCount, (unsigned long long)(info.latencyTotalUSec / taskCount),
+         (unsigned long long)info.latencyMaxUSec, (unsigned long long)(info.runTotalUSec / taskCount),
+         (unsigned long long)info.peakQueueDepth);
+
+    for (uint64_t ti = 0; ti < info.threadCount && ti < THREAD_SYSTEM_INFO_MAX_THREADS; ++ti)
+    {
+        const struct ThreadSystemThreadInfo* thread = info.threads + ti;
+        uint64_t                             lifetime = thread->busyUSec + thread->idleUSec;
+        LOGF(eINFO, "    thread %2llu: %6llu tasks, busy %5.1f%%", (unsigned long long)ti, (unsigned long long)thread->taskCount,
+             100.0 * (double)thread->busyUSec / (double)(lifetime ? lifetime : 1));
+    }
+}
+
+// Instrumented run also reports ThreadSystemInfo statistics
+static bool benchThreadSystemRun(enum ThreadSystemScheduler scheduler, uint64_t threadCount, enum BenchThreadSystemBenchmarkMode mode,
+                                 int64_t taskTime, uint64_t taskCount, struct BenchThreadSystemBenchmarkTask* tasks, int64_t* latencies,
+                                 bool instrumentation)
+{
+    bool nested = mode != BENCH_THREAD_SYSTEM_EXTERNAL;
+
+    struct BenchThreadSystemBenchmark bench = { 0 };
+    bench.taskTime = taskTime;
+    bench.waitChildren = mode == BENCH_THREAD_SYSTEM_WAITING;
+    bench.latencies = latencies;
+
+    struct ThreadSystemInitDesc tsInfo = { 0 };
+    tsInfo.threadCount = threadCount;
+    tsInfo.threadName = "Benchmark";
+    tsInfo.scheduler = scheduler;
+    tsInfo.instrumentation = instrumentation;
+
+    if (!threadSystemInit(&bench.threadSystem, &tsInfo))
+    {
+        LOGF(eERROR, "Failed to initialize thread system");
+        return false;
+    }
+
+    // Let threads start before measuring
+    threadSystemWaitIdle(bench.threadSystem);
+
+    // Nested: one root per thread, the rest is added by roots
+    uint64_t rootCount = nested ? threadCount : taskCount;
+    bench.childCount = nested ? taskCount / rootCount - 1 : 0;
+    taskCount = rootCount * (bench.childCount + 1);
+
+    for (uint64_t i = 0; i < taskCount; ++i)
+    {
+        tasks[i].bench = &bench;
+        tasks[i].children = NULL;
+    }
+    for (uint64_t i = 0; nested && i < rootCount; ++i)
+        tasks[i].children = tasks + rootCount + i * bench.childCount;
+
+    int64_t startTime = getUSec(true);
+
+    for (uint64_t i = 0; i < rootCount; ++i)
+    {
+        tasks[i].addTime = getUSec(true);
+        threadSystemAddTask(bench.threadSystem, benchThreadSystemBenchmarkTask, tasks + i);
+    }
+
+    threadSystemWaitIdle(bench.threadSystem);
+
+    int64_t totalTime = getUSec(true) - startTime;
+
+    if (instrumentation)
+        benchLogThreadSystemInfo(bench.threadSystem);
+
+    threadSystemExit(&bench.threadSystem, &gThreadSystemExitDescDefault);
+
+    uint64_t count = tfrg_atomic64_load_relaxed(&bench.latencyCount);
+    if (count != taskCount)
+    {
+        LOGF(eERROR, "Thread system benchmark executed %llu tasks instead of %llu", (unsigned long long)count,
+             (unsigned long long)taskCount);
+        return false;
+    }
+
+    qsort(latencies, count, sizeof *latencies, benchLatencyCmp);
+
+    LOGF(eINFO, "%-13s %-8s %4lluus %2llu threads%s: %10.0f tasks/s, latency p50 %lluus p99 %lluus p99.9 %lluus max %lluus",
+         BENCH_SCHEDULER_NAMES[scheduler], BENCH_THREAD_SYSTEM_MODE_NAMES[mode],
+         (unsigned long long)taskTime, (unsigned long long)threadCount, instrumentation ? " instrumented" : "",
+         (double)taskCount * 1e6 / (double)(totalTime ? totalTime : 1),
+         (unsigned long long)latencies[count / 2], (unsigned long long)latencies[count * 99 / 100],
+         (unsigned long long)latencies[count * 999 / 1000], (unsigned long long)latencies[count - 1]);
+    return true;
+}
+
+bool benchmarkThreadSystem(uint64_t taskCount, uint64_t maxThreadCount)
+{
+    if (taskCount == 0)
+        return true;
+
+    uint64_t cpuCount = getNumCPUCores();
+    if (maxThreadCount > cpuCount)
+    {
+        LOGF(eINFO, "Thread count is limited to %llu CPU cores", (unsigned long long)cpuCount);
+        maxThreadCount = cpuCount;
+    }
+
+    struct BenchThreadSystemBenchmarkTask* tasks = tf_malloc(taskCount * sizeof *tasks);
+    int64_t*                                   latencies = tf_malloc(taskCount * sizeof *latencies);
+
+    bool success = tasks && latencies;
+
+    static const int64_t taskTimes[] = { 1, 10, 100 };
+
+    for (size_t ti = 0; success && ti < sizeof(taskTimes) / sizeof(taskTimes[0]); ++ti)
+    {
+        for (uint64_t threadCount = 1; success && threadCount <= maxThreadCount; threadCount *= 2)
+        {
+            for (int mode = 0; success && mode < BENCH_THREAD_SYSTEM_MODE_COUNT; ++mode)
+            {
+                // Nested modes need at least one child per root
+                if (mode != BENCH_THREAD_SYSTEM_EXTERNAL && taskCount < threadCount * 2)
+                    continue;
+
+                for (int scheduler = 0; success && scheduler < THREAD_SYSTEM_SCHEDULER_COUNT; ++scheduler)
+                {
+                    success = benchThreadSystemRun((enum ThreadSystemScheduler)scheduler, threadCount,
+                                                   (enum BenchThreadSystemBenchmarkMode)mode, taskTimes[ti], taskCount, tasks, latencies,
+                                                   false);
+                }
+            }
+        }
+    }
+
+    // Instrumentation overhead and utilization of the largest pool
+    for (int scheduler = 0; success && scheduler < THREAD_SYSTEM_SCHEDULER_COUNT; ++scheduler)
+    {
+        success = benchThreadSystemRun((enum ThreadSystemScheduler)scheduler, maxThreadCount, BENCH_THREAD_SYSTEM_EXTERNAL, taskTimes[1],
+                                       taskCount, tasks, latencies, true);
+    }
+
+    tf_free(latencies);
+    tf_free(tasks);
+    return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function benchmarkParallelFor                                           ///
+////////////////////////////////////////////////////////////////////////////////
+
+enum BenchParallelForWorkload
+{
+    BENCH_PARALLEL_FOR_UNIFORM,
+    // cost grows linearly with iteration index
+    BENCH_PARALLEL_FOR_RAMP,
+    // first eighth of iterations is 16 times heavier
+    BENCH_PARALLEL_FOR_FRONT_HEAVY,
+    BENCH_PARALLEL_FOR_WORKLOAD_COUNT,
+};
+
+static const char* const BENCH_PARALLEL_FOR_WORKLOAD_NAMES[BENCH_PARALLEL_FOR_WORKLOAD_COUNT] = {
+    "uniform",
+    "ramp",
+    "front-heavy",
+};
+
+struct BenchParallelForBenchmark
+{
+    enum BenchParallelForWorkload workload;
+    uint64_t                          iterationCount;
+    tfrg_atomic64_t                   checksum;
+};
+
+struct BenchParallelForChunk
+{
+    struct BenchParallelForBenchmark* bench;
+    uint64_t                              begin;
+    uint64_t                              end;
+};
+
+static void benchParallelForIterations(void* user, uint64_t begin, uint64_t end, uint64_t threadId)
+{
+    (void)threadId;
+
+    struct BenchParallelForBenchmark* bench = user;
+
+    uint64_t sum = 0;
+    for (uint64_t i = begin; i < end; ++i)
+    {
+        uint64_t cost = 1;
+        switch (bench->workload)
+        {
+        case BENCH_PARALLEL_FOR_RAMP:
+            cost = 1 + i * 16 / bench->iterationCount;
+            break;
+        case BENCH_PARALLEL_FOR_FRONT_HEAVY:
+            cost = i < bench->iterationCount / 8 ? 16 : 1;
+            break;
+        default:
+            break;
+        }
+
+        // ~100ns per cost unit
+        uint64_t x = i + 1;
+        for (uint64_t k = 0; k < cost * 64; ++k)
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        sum += x;
+    }
+
+    tfrg_atomic64_add_relaxed(&bench->checksum, sum);
+}
+
+static void benchParallelForChunkTask(void* user, uint64_t threadId)
+{
+    struct BenchParallelForChunk* chunk = user;
+    benchParallelForIterations(chunk->bench, chunk->begin, chunk->end, threadId);
+}
+
+bool benchmarkParallelFor(uint64_t iterationCount, uint64_t maxThreadCount)
+{
+    if (iterationCount == 0)
+        return true;
+
+    uint64_t cpuCount = getNumCPUCores();
+    if (maxThreadCount > cpuCount)
+    {
+        LOGF(eINFO, "Thread count is limited to %llu CPU cores", (unsigned long long)cpuCount);
+        maxThreadCount = cpuCount;
+    }
+
+    struct BenchParallelForChunk* chunks = tf_malloc(maxThreadCount * sizeof *chunks);
+    if (!chunks)
+        return false;
+
+    bool success = true;
+
+    for (int workload = 0; success && workload < BENCH_PARALLEL_FOR_WORKLOAD_COUNT; ++workload)
+    {
+        struct BenchParallelForBenchmark bench = { 0 };
+        bench.workload = (enum BenchParallelForWorkload)workload;
+        bench.iterationCount = iterationCount;
+
+        // Reference result
+        benchParallelForIterations(&bench, 0, iterationCount, 0);
+        uint64_t checksum = bench.checksum;
+
+        for (uint64_t threadCount = 1; success && threadCount <= maxThreadCount; threadCount *= 2)
+        {
+            for (int scheduler = 0; success && scheduler < THREAD_SYSTEM_SCHEDULER_COUNT; ++scheduler)
+            {
+                struct ThreadSystemInitDesc tsInfo = { 0 };
+                tsInfo.threadCount = threadCount;
+                tsInfo.threadName = "Benchmark";
+                tsInfo.scheduler = (enum ThreadSystemScheduler)scheduler;
+
+                ThreadSystem ts;
+                if (!threadSystemInit(&ts, &tsInfo))
+                {
+                    LOGF(eERROR, "Failed to initialize thread system");
+                    success = false;
+                    break;
+                }
+
+                threadSystemWaitIdle(ts);
+
+                // Manual chunking: one equal chunk per thread
+                bench.checksum = 0;
+                int64_t startTime = getUSec(true);
+
+                for (uint64_t ci = 0; ci < threadCount; ++ci)
+                {
+                    chunks[ci].bench = &bench;
+                    chunks[ci].begin = iterationCount * ci / threadCount;
+                    chunks[ci].end = iterationCount * (ci + 1) / threadCount;
+                }
+                threadSystemAddTaskGroup(ts, benchParallelForChunkTask, threadCount, chunks);
+                threadSystemWaitIdle(ts);
+
+                int64_t chunkedTime = getUSec(true) - startTime;
+                success = bench.checksum == checksum;
+
+                // Adaptive splitting
+                bench.checksum = 0;
+                startTime = getUSec(true);
+
+                threadSystemParallelFor(ts, 0, iterationCount, 0, benchParallelForIterations, &bench);
+
+                int64_t parallelForTime = getUSec(true) - startTime;
+                success = success && bench.checksum == checksum;
+
+                threadSystemExit(&ts, &gThreadSystemExitDescDefault);
+
+                if (!success)
+                {
+                    LOGF(eERROR, "Parallel for benchmark produced wrong result");
+                    break;
+                }
+
+                LOGF(eINFO, "%-11s %-13s %2llu threads: chunked %s, parallel for %s (x%.2f)",
+                     BENCH_PARALLEL_FOR_WORKLOAD_NAMES[workload],
+                     BENCH_SCHEDULER_NAMES[scheduler], (unsigned long long)threadCount,
+                     humanReadableTime(chunkedTime).str, humanReadableTime(parallelForTime).str,
+                     (double)chunkedTime / (double)(parallelForTime ? parallelForTime : 1));
+            }
+        }
+    }
+
+    tf_free(chunks);
+    return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function benchmarkAtomics                                               ///
+////////////////////////////////////////////////////////////////////////////////
+
+enum BenchAtomicsOp
+{
+    // every thread increments one shared counter
+    BENCH_ATOMICS_ADD_RELAXED,
+    BENCH_ATOMICS_ADD_ACQ_REL,
+    BENCH_ATOMICS_CAS_LOOP,
+    // every thread increments its own cache line
+    BENCH_ATOMICS_PADDED_RELAXED,
+    BENCH_ATOMICS_OP_COUNT,
+};
+
+static const char* const BENCH_ATOMICS_OP_NAMES[BENCH_ATOMICS_OP_COUNT] = {
+    "add relaxed",
+    "add acq_rel",
+    "cas loop",
+    "padded relaxed",
+};
+
+struct BenchAtomicsCounter
+{
+    tfrg_atomic64_t value;
+    uint8_t         padding[64 - sizeof(tfrg_atomic64_t)];
+};
+
+struct BenchAtomicsBenchmark
+{
+    enum BenchAtomicsOp         op;
+    uint64_t                        opCount;
+    tfrg_atomic32_t                 startedCount;
+    uint32_t                        threadCount;
+    struct BenchAtomicsCounter* counters;
+};
+
+struct BenchAtomicsThread
+{
+    struct BenchAtomicsBenchmark* bench;
+    uint64_t                          index;
+};
+
+static void benchAtomicsTask(void* user, uint64_t threadId)
+{
+    (void)threadId;
+
+    struct BenchAtomicsThread*    thread = user;
+    struct BenchAtomicsBenchmark* bench = thread->bench;
+    const uint64_t                    index = thread->index;
+    struct BenchAtomicsCounter*   counters = bench->counters;
+    const uint64_t                    opCount = bench->opCount;
+
+    // Start hammering only once every thread is here, otherwise early threads run uncontended
+    tfrg_atomic32_add_relaxed(&bench->startedCount, 1);
+    while (tfrg_atomic32_load_relaxed(&bench->startedCount) < bench->threadCount)
+        threadSleep(0);
+
+    switch (bench->op)
+    {
+    case BENCH_ATOMICS_ADD_RELAXED:
+        for (uint64_t i = 0; i < opCount; ++i)
+            tfrg_atomic64_add_relaxed(&counters[0].value, 1);
+        break;
+    case BENCH_ATOMICS_ADD_ACQ_REL:
+        for (uint64_t i = 0; i < opCount; ++i)
+            tfrg_atomic64_add_acq_rel(&counters[0].value, 1);
+        break;
+    case BENCH_ATOMICS_CAS_LOOP:
+        for (uint64_t i = 0; i < opCount; ++i)
+        {
+            uint64_t value = tfrg_atomic64_load_relaxed(&counters[0].value);
+            uint64_t prev;
+            while ((prev = tfrg_atomic64_cas_acq_rel(&counters[0].value, value, value + 1)) != value)
+                value = prev;
+        }
+        break;
+    case BENCH_ATOMICS_PADDED_RELAXED:
+        for (uint64_t i = 0; i < opCount; ++i)
+            tfrg_atomic64_add_relaxed(&counters[index].value, 1);
+        break;
+    default:
+        break;
+    }
+}
+
+bool benchmarkAtomics(uint64_t opCount, uint64_t maxThreadCount)
+{
+    if (opCount == 0)
+        return true;
+
+    uint64_t cpuCount = getNumCPUCores();
+    if (maxThreadCount > cpuCount)
+    {
+        LOGF(eINFO, "Thread count is limited to %llu CPU cores", (unsigned long long)cpuCount);
+        maxThreadCount = cpuCount;
+    }
+
+    struct BenchAtomicsCounter* counters = tf_memalign(64, maxThreadCount * sizeof *counters);
+    struct BenchAtomicsThread*  threads = tf_malloc(maxThreadCount * sizeof *threads);
+    if (!counters || !threads)
+    {
+        tf_free(counters);
+        tf_free(threads);
+        return false;
+    }
+
+    bool success = true;
+
+    for (int op = 0; success && op < BENCH_ATOMICS_OP_COUNT; ++op)
+    {
+        for (uint64_t threadCount = 1; success && threadCount <= maxThreadCount; threadCount *= 2)
+        {
+            struct ThreadSystemInitDesc tsInfo = { 0 };
+            tsInfo.threadCount = threadCount;
+            tsInfo.threadName = "Benchmark";
+
+            ThreadSystem ts;
+            if (!threadSystemInit(&ts, &tsInfo))
+            {
+                LOGF(eERROR, "Failed to initialize thread system");
+                success = false;
+                break;
+            }
+
+            threadSystemWaitIdle(ts);
+
+            memset(counters, 0, maxThreadCount * sizeof *counters);
+
+            struct BenchAtomicsBenchmark bench = { 0 };
+            bench.op = (enum BenchAtomicsOp)op;
+            bench.opCount = opCount;
+            bench.threadCount = (uint32_t)threadCount;
+            bench.counters = counters;
+
+            for (uint64_t ti = 0; ti < threadCount; ++ti)
+            {
+                threads[ti].bench = &bench;
+                threads[ti].index = ti;
+            }
+
+            int64_t startTime = getUSec(true);
+
+            threadSystemAddTaskGroup(ts, benchAtomicsTask, threadCount, threads);
+            threadSystemWaitIdle(ts);
+
+            int64_t time = getUSec(true) - startTime;
+
+            threadSystemExit(&ts, &gThreadSystemExitDescDefault);
+
+            uint64_t total = 0;
+            for (uint64_t ti = 0; ti < threadCount; ++ti)
+                total += counters[ti].value;
+
+            if (total != opCount * threadCount)
+            {
+                LOGF(eERROR, "Atomics benchmark lost increments: %llu of %llu", (unsigned long long)total,
+                     (unsigned long long)(opCount * threadCount));
+                success = false;
+                break;
+            }
+
+            LOGF(eINFO, "%-14s %2llu threads: %s, %.2f ns/op, %.1f Mops/s", BENCH_ATOMICS_OP_NAMES[op],
+                 (unsigned long long)threadCount, humanReadableTime(time).str, (double)time * 1000.0 / (double)opCount,
+                 (double)total / (double)(time ? time : 1));
+        }
+    }
+
+    tf_free(threads);
+    tf_free(counters);
+    return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function benchmarkQueues                                                ///
+////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_QUEUE_CAPACITY 1024
+// Latency pass pushes with pauses, so it measures handoff to a waiting consumer rather than queueing
+#define BENCH_QUEUE_LATENCY_ITEMS 10000
+#define BENCH_QUEUE_LATENCY_PAUSE 20
+
+enum BenchQueueType
+{
+    BENCH_QUEUE_SPSC,
+    BENCH_QUEUE_MPMC,
+    // mutex and condition variables around a ring, like handoffs this is meant to replace
+    BENCH_QUEUE_MUTEX,
+    BENCH_QUEUE_TYPE_COUNT,
+};
+
+static const char* const BENCH_QUEUE_TYPE_NAMES[BENCH_QUEUE_TYPE_COUNT] = {
+    "spsc",
+    "mpmc",
+    "mutex",
+};
+
+struct BenchQueueItem
+{
+    uint64_t value;
+    int64_t  pushTime;
+};
+
+struct BenchMutexQueue
+{
+    Mutex                      mutex;
+    ConditionVariable          notEmpty;
+    ConditionVariable          notFull;
+    struct BenchQueueItem* items;
+    uint32_t                   head;
+    uint32_t                   count;
+};
+
+struct BenchQueueBenchmark
+{
+    enum BenchQueueType    type;
+    SpscQueue                  spsc;
+    MpmcQueue                  mpmc;
+    struct BenchMutexQueue mutexQueue;
+
+    uint64_t        itemsPerProducer;
+    bool            paced;
+    tfrg_atomic64_t checksum;
+    int64_t*        latencies;
+    tfrg_atomic64_t latencyCount;
+};
+
+struct BenchQueueThread
+{
+    struct BenchQueueBenchmark* bench;
+    // items to pop, 0 for producers
+    uint64_t                        popCount;
+};
+
+static void benchQueuePush(struct BenchQueueBenchmark* bench, const struct BenchQueueItem* item)
+{
+    switch (bench->type)
+    {
+    case BENCH_QUEUE_SPSC:
+        spscQueuePush(&bench->spsc, item, TIMEOUT_INFINITE);
+        break;
+    case BENCH_QUEUE_MPMC:
+        mpmcQueuePush(&bench->mpmc, item, TIMEOUT_INFINITE);
+        break;
+    default:
+    {
+        struct BenchMutexQueue* q = &bench->mutexQueue;
+        acquireMutex(&q->mutex);
+        while (q->count == BENCH_QUEUE_CAPACITY)
+            waitConditionVariable(&q->notFull, &q->mutex, TIMEOUT_INFINITE);
+        q->items[(q->head + q->count++) % BENCH_QUEUE_CAPACITY] = *item;
+        wakeOneConditionVariable(&q->notEmpty);
+        releaseMutex(&q->mutex);
+        break;
+    }
+    }
+}
+
+static void benchQueuePop(struct BenchQueueBenchmark* bench, struct BenchQueueItem* item)
+{
+    switch (bench->type)
+    {
+    case BENCH_QUEUE_SPSC:
+        spscQueuePop(&bench->spsc, item, TIMEOUT_INFINITE);
+        break;
+    case BENCH_QUEUE_MPMC:
+        mpmcQueuePop(&bench->mpmc, item, TIMEOUT_INFINITE);
+        break;
+    default:
+    {
+        struct BenchMutexQueue* q = &bench->mutexQueue;
+        acquireMutex(&q->mutex);
+        while (q->count == 0)
+            waitConditionVariable(&q->notEmpty, &q->mutex, TIMEOUT_INFINITE);
+        *item = q->items[q->head];
+        q->head = (q->head + 1) % BENCH_QUEUE_CAPACITY;
+        --q->count;
+        wakeOneConditionVariable(&q->notFull);
+        releaseMutex(&q->mutex);
+        break;
+    }
+    }
+}
+
+static void benchQueueThreadFunc(void* user)
+{
+    struct BenchQueueThread*    thread = user;
+    struct BenchQueueBenchmark* bench = thread->bench;
+
+    if (thread->popCount == 0)
+    {
+        for (uint64_t i = 1; i <= bench->itemsPerProducer; ++i)
+        {
+            struct BenchQueueItem item = { i, bench->paced ? getUSec(true) : 0 };
+            benchQueuePush(bench, &item);
+
+            if (bench->paced)
+            {
+                int64_t resumeTime = item.pushTime + BENCH_QUEUE_LATENCY_PAUSE;
+                while (getUSec(true) < resumeTime)
+                    tfrg_cpu_pause();
+            }
+        }
+        return;
+    }
+
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < thread->popCount; ++i)
+    {
+        struct BenchQueueItem item;
+        benchQueuePop(bench, &item);
+        sum += item.value;
+
+        if (bench->paced)
+            bench->latencies[tfrg_atomic64_add_relaxed(&bench->latencyCount, 1)] = getUSec(true) - item.pushTime;
+    }
+    tfrg_atomic64_add_relaxed(&bench->checksum, sum);
+}
+
+// Returns run time in us, or -1 on failure
+static int64_t benchQueueRun(struct BenchQueueBenchmark* bench, uint64_t producerCount, uint64_t consumerCount)
+{
+    struct BenchQueueThread threads[128];
+    ThreadHandle                handles[128];
+    uint64_t                    threadCount = producerCount + consumerCount;
+    uint64_t                    totalCount = producerCount * bench->itemsPerProducer;
+
+    bench->checksum = 0;
+    bench->latencyCount = 0;
+
+    int64_t  startTime = getUSec(true);
+    uint64_t started = 0;
+    for (; started < threadCount; ++started)
+    {
+        uint64_t ci = started - producerCount;
+        threads[started].bench = bench;
+        threads[started].popCount = started < producerCount ? 0 : totalCount * (ci + 1) / consumerCount - totalCount * ci / consumerCount;
+
+        struct ThreadDesc threadInfo = { 0 };
+        threadInfo.pFunc = benchQueueThreadFunc;
+        threadInfo.pData = threads + started;
+        snprintf(threadInfo.mThreadName, sizeof threadInfo.mThreadName, "BenchQueue %llu", (unsigned long long)started);
+
+        if (!initThread(&threadInfo, handles + started))
+            break;
+    }
+
+    // Can't unblock remaining threads, hang is better than crash here
+    for (uint64_t i = 0; i < started; ++i)
+        joinThread(handles[i]);
+
+    int64_t time = getUSec(true) - startTime;
+
+    if (started != threadCount)
+    {
+        LOGF(eERROR, "Failed to create queue benchmark thread");
+        return -1;
+    }
+
+    uint64_t expected = producerCount * (bench->itemsPerProducer * (bench->itemsPerProducer + 1) / 2);
+    if (tfrg_atomic64_load_relaxed(&bench->checksum) != expected)
+    {
+        LOGF(eERROR, "Queue benchmark lost or duplicated items");
+        return -1;
+    }
+    return time;
+}
+
+bool benchmarkQueues(uint64_t itemCount, uint64_t maxThreadCount)
+{
+    if (itemCount == 0)
+        return true;
+
+    uint64_t cpuCount = getNumCPUCores();
+    if (maxThreadCount > cpuCount)
+    {
+        LOGF(eINFO, "Thread count is limited to %llu CPU cores", (unsigned long long)cpuCount);
+        maxThreadCount = cpuCount;
+    }
+    // at least one producer and one consumer
+    if (maxThreadCount < 2)
+        maxThreadCount = 2;
+
+    uint64_t latencyItems = itemCount < BENCH_QUEUE_LATENCY_ITEMS ? itemCount : BENCH_QUEUE_LATENCY_ITEMS;
+
+    struct BenchQueueBenchmark bench = { 0 };
+    bench.latencies = tf_malloc(latencyItems * maxThreadCount * sizeof *bench.latencies);
+    bench.mutexQueue.items = tf_malloc(BENCH_QUEUE_CAPACITY * sizeof *bench.mutexQueue.items);
+
+    bool success = bench.latencies && bench.mutexQueue.items;
+    success = success && spscQueueInit(&bench.spsc, BENCH_QUEUE_CAPACITY, sizeof(struct BenchQueueItem));
+    success = success && mpmcQueueInit(&bench.mpmc, BENCH_QUEUE_CAPACITY, sizeof(struct BenchQueueItem));
+    success = success && initMutex(&bench.mutexQueue.mutex);
+    success = success && initConditionVariable(&bench.mutexQueue.notEmpty);
+    success = success && initConditionVariable(&bench.mutexQueue.notFull);
+
+    for (uint64_t producerCount = 1; success && producerCount < maxThreadCount; producerCount *= 2)
+    {
+        for (uint64_t consumerCount = 1; success && producerCount + consumerCount <= maxThreadCount; consumerCount *= 2)
+        {
+            for (int type = 0; success && type < BENCH_QUEUE_TYPE_COUNT; ++type)
+            {
+                if (type == BENCH_QUEUE_SPSC && (producerCount != 1 || consumerCount != 1))
+                    continue;
+
+                bench.type = (enum BenchQueueType)type;
+
+                bench.itemsPerProducer = itemCount;
+                bench.paced = false;
+                int64_t time = benchQueueRun(&bench, producerCount, consumerCount);
+                success = time >= 0;
+                if (!success)
+                    break;
+
+                bench.itemsPerProducer = latencyItems;
+                bench.paced = true;
+                success = benchQueueRun(&bench, producerCount, consumerCount) >= 0;
+                if (!success)
+                    break;
+
+                int64_t* latencies = bench.latencies;
+                uint64_t count = producerCount * latencyItems;
+                qsort(latencies, count, sizeof *latencies, benchLatencyCmp);
+
+                LOGF(eINFO, "%-5s %2llu producers %2llu consumers: %10.0f items/s, latency p50 %lluus p99 %lluus max %lluus",
+                     BENCH_QUEUE_TYPE_NAMES[type], (unsigned long long)producerCount, (unsigned long long)consumerCount,
+                     (double)(producerCount * itemCount) * 1e6 / (double)(time ? time : 1), (unsigned long long)latencies[count / 2],
+                     (unsigned long long)latencies[count * 99 / 100], (unsigned long long)latencies[count - 1]);
+            }
+        }
+    }
+
+    exitConditionVariable(&bench.mutexQueue.notFull);
+    exitConditionVariable(&bench.mutexQueue.notEmpty);
+    exitMutex(&bench.mutexQueue.mutex);
+    mpmcQueueExit(&bench.mpmc);
+    spscQueueExit(&bench.spsc);
+    tf_free(bench.mutexQueue.items);
+    tf_free(bench.latencies);
+    return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function benchmarkMutex                                                 ///
+////////////////////////////////////////////////////////////////////////////////
+
+enum BenchMutexType
+{
+    BENCH_MUTEX_OS,
+    BENCH_MUTEX_FUTEX,
+    BENCH_MUTEX_TYPE_COUNT,
+};
+
+static const char* const BENCH_MUTEX_TYPE_NAMES[BENCH_MUTEX_TYPE_COUNT] = {
+    "os",
+    "futex",
+};
+
+struct BenchMutexBenchmark
+{
+    Mutex             mutex;
+    ConditionVariable condition;
+    uint64_t          opCount;
+    // protected by mutex
+    uint64_t          counter;
+    uint64_t          turn;
+};
+
+struct BenchMutexThread
+{
+    struct BenchMutexBenchmark* bench;
+    uint64_t                        index;
+};
+
+static void benchMutexLockThread(void* user)
+{
+    struct BenchMutexThread*    thread = user;
+    struct BenchMutexBenchmark* bench = thread->bench;
+
+    for (uint64_t i = 0; i < bench->opCount; ++i)
+    {
+        acquireMutex(&bench->mutex);
+        // Short critical section, like updating a token or a counter
+        bench->counter = bench->counter * 6364136223846793005ull + 1;
+        ++bench->turn;
+        releaseMutex(&bench->mutex);
+    }
+}
+
+// Two threads take turns, every handoff goes through the condition variable
+static void benchMutexPingPongThread(void* user)
+{
+    struct BenchMutexThread*    thread = user;
+    struct BenchMutexBenchmark* bench = thread->bench;
+
+    acquireMutex(&bench->mutex);
+    for (uint64_t i = 0; i < bench->opCount; ++i)
+    {
+        while (bench->turn % 2 != thread->index)
+            waitConditionVariable(&bench->condition, &bench->mutex, TIMEOUT_INFINITE);
+        ++bench->turn;
+        wakeOneConditionVariable(&bench->condition);
+    }
+    releaseMutex(&bench->mutex);
+}
+
+static int64_t benchMutexRun(struct BenchMutexBenchmark* bench, ThreadFunction func, uint64_t threadCount)
+{
+    struct BenchMutexThread threads[64];
+    ThreadHandle                handles[64];
+
+    bench->counter = 0;
+    bench->turn = 0;
+
+    int64_t  startTime = getUSec(true);
+    uint64_t started = 0;
+    for (; started < threadCount; ++started)
+    {
+        threads[started].bench = bench;
+        threads[started].index = started;
+
+        struct ThreadDesc threadInfo = { 0 };
+        threadInfo.pFunc = func;
+        threadInfo.pData = threads + started;
+        snprintf(threadInfo.mThreadName, sizeof threadInfo.mThreadName, "BenchMutex %llu", (unsigned long long)started);
+
+        if (!initThread(&threadInfo, handles + started))
+            break;
+    }
+
+    for (uint64_t i = 0; i < started; ++i)
+        joinThread(handles[i]);
+
+    int64_t time = getUSec(true) - startTime;
+
+    if (started != threadCount)
+    {
+        LOGF(eERROR, "Failed to create mutex benchmark thread");
+        return -1;
+    }
+
+    if (bench->turn != bench->opCount * threadCount)
+    {
+        LOGF(eERROR, "Mutex benchmark lost updates: %llu of %llu", (unsigned long long)bench->turn,
+             (unsigned long long)(bench->opCount * threadCount));
+        return -1;
+    }
+    return time;
+}
+
+bool benchmarkMutex(uint64_t opCount, uint64_t maxThreadCount)
+{
+    if (opCount == 0)
+        return true;
+
+    uint64_t cpuCount = getNumCPUCores();
+    if (maxThreadCount > cpuCount)
+    {
+        LOGF(eINFO, "Thread count is limited to %llu CPU cores", (unsigned long long)cpuCount);
+        maxThreadCount = cpuCount;
+    }
+
+    bool success = true;
+
+    for (int type = 0; success && type < BENCH_MUTEX_TYPE_COUNT; ++type)
+    {
+        struct BenchMutexBenchmark bench = { 0 };
+        bench.opCount = opCount;
+
+        MutexDesc mutexDesc = { 0 };
+        mutexDesc.futex = type == BENCH_MUTEX_FUTEX;
+        ConditionVariableDesc conditionDesc = { 0 };
+        conditionDesc.futex = type == BENCH_MUTEX_FUTEX;
+
+        if (!initMutexDesc(&bench.mutex, &mutexDesc) || !initConditionVariableDesc(&bench.condition, &conditionDesc))
+        {
+            LOGF(eERROR, "Failed to initialize mutex");
+            return false;
+        }
+
+        // Uncontended: lock and unlock on the calling thread
+        int64_t startTime = getUSec(true);
+        for (uint64_t i = 0; i < opCount; ++i)
+        {
+            acquireMutex(&bench.mutex);
+            ++bench.counter;
+            releaseMutex(&bench.mutex);
+        }
+        int64_t time = getUSec(true) - startTime;
+
+        LOGF(eINFO, "%-5s uncontended:         %s, %.2f ns/lock", BENCH_MUTEX_TYPE_NAMES[type], humanReadableTime(time).str,
+             (double)time * 1000.0 / (double)opCount);
+
+        for (uint64_t threadCount = 2; success && threadCount <= (maxThreadCount > 2 ? maxThreadCount : 2); threadCount *= 2)
+        {
+            time = benchMutexRun(&bench, benchMutexLockThread, threadCount);
+            success = time >= 0;
+            if (!success)
+                break;
+
+            LOGF(eINFO, "%-5s contended %2llu threads: %s, %.2f ns/lock", BENCH_MUTEX_TYPE_NAMES[type], (unsigned long long)threadCount,
+                 humanReadableTime(time).str, (double)time * 1000.0 / (double)(opCount * threadCount));
+        }
+
+        if (success)
+        {
+            time = benchMutexRun(&bench, benchMutexPingPongThread, 2);
+            success = time >= 0;
+            if (success)
+            {
+                LOGF(eINFO, "%-5s condition ping-pong:  %s, %.2f us/handoff", BENCH_MUTEX_TYPE_NAMES[type], humanReadableTime(time).str,
+                     (double)time / (double)(opCount * 2));
+            }
+        }
+
+        exitConditionVariable(&bench.condition);
+        exitMutex(&bench.mutex);
+    }
+
+    return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function benchmarkLanes                                                 ///
+////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_LANES_FRAME_TASK_COUNT         16
+#define BENCH_LANES_FRAME_TASK_TIME          20
+#define BENCH_LANES_BACKGROUND_TASK_TIME     500
+// Background tasks in flight per thread, keeps the pool saturated
+#define BENCH_LANES_BACKGROUND_TASKS_PER_THREAD 4
+
+enum BenchLanesMode
+{
+    // Frame and background tasks share normal lane
+    BENCH_LANES_SINGLE,
+    BENCH_LANES_STRICT,
+    BENCH_LANES_WEIGHTED,
+    // Strict lanes, background runs on its own thread only
+    BENCH_LANES_GROUPS,
+    BENCH_LANES_MODE_COUNT,
+};
+
+static const char* const BENCH_LANES_MODE_NAMES[BENCH_LANES_MODE_COUNT] = {
+    "single lane",
+    "strict",
+    "weighted",
+    "groups",
+};
+
+struct BenchLanesBenchmark
+{
+    ThreadSystem              threadSystem;
+    enum ThreadSystemPriority backgroundPriority;
+    tfrg_atomic32_t           stop;
+    tfrg_atomic64_t           backgroundCount;
+
+    Mutex             mutex;
+    ConditionVariable condition;
+    // protected by mutex
+    uint64_t          frameTasksLeft;
+
+    int64_t*        latencies;
+    tfrg_atomic64_t latencyCount;
+};
+
+struct BenchLanesFrameTask
+{
+    struct BenchLanesBenchmark* bench;
+    int64_t                         addTime;
+};
+
+static void benchLanesSpin(int64_t time)
+{
+    int64_t startTime = getUSec(true);
+    while (getUSec(true) - startTime < time)
+        ;
+}
+
+static void benchLanesBackgroundTask(void* user, uint64_t threadId)
+{
+    (void)threadId;
+    struct BenchLanesBenchmark* bench = user;
+
+    benchLanesSpin(BENCH_LANES_BACKGROUND_TASK_TIME);
+    tfrg_atomic64_add_relaxed(&bench->backgroundCount, 1);
+
+    if (!tfrg_atomic32_load_relaxed(&bench->stop))
+        threadSystemAddTaskPriority(bench->threadSystem, bench->backgroundPriority, benchLanesBackgroundTask, bench);
+}
+
+static void benchLanesFrameTask(void* user, uint64_t threadId)
+{
+    (void)threadId;
+    struct BenchLanesFrameTask* task = user;
+    struct BenchLanesBenchmark* bench = task->bench;
+
+    bench->latencies[tfrg_atomic64_add_relaxed(&bench->latencyCount, 1)] = getUSec(true) - task->addTime;
+    benchLanesSpin(BENCH_LANES_FRAME_TASK_TIME);
+
+    acquireMutex(&bench->mutex);
+    if (--bench->frameTasksLeft == 0)
+        wakeOneConditionVariable(&bench->condition);
+    releaseMutex(&bench->mutex);
+}
+
+static bool benchLanesRun(enum BenchLanesMode mode, uint64_t frameCount, uint64_t threadCount, int64_t* latencies)
+{
+    struct BenchLanesBenchmark bench = { 0 };
+    bench.latencies = latencies;
+    bench.backgroundPriority = mode == BENCH_LANES_SINGLE ? THREAD_SYSTEM_PRIORITY_NORMAL : THREAD_SYSTEM_PRIORITY_BACKGROUND;
+
+    enum ThreadSystemPriority framePriority = mode == BENCH_LANES_SINGLE ? THREAD_SYSTEM_PRIORITY_NORMAL : THREAD_SYSTEM_PRIORITY_HIGH;
+
+    struct ThreadSystemGroupDesc groups[2] = { { 0 } };
+    groups[0].threadCount = threadCount > 1 ? threadCount - 1 : 1;
+    groups[0].laneMask = THREAD_SYSTEM_LANE_MASK(THREAD_SYSTEM_PRIORITY_HIGH) | THREAD_SYSTEM_LANE_MASK(THREAD_SYSTEM_PRIORITY_NORMAL);
+    groups[1].threadCount = 1;
+    groups[1].laneMask = THREAD_SYSTEM_LANE_MASK(THREAD_SYSTEM_PRIORITY_BACKGROUND);
+
+    struct ThreadSystemInitDesc tsInfo = gThreadSystemInitDescDefault;
+    tsInfo.threadCount = threadCount;
+    tsInfo.threadName = "Benchmark";
+    tsInfo.scheduler = THREAD_SYSTEM_SCHEDULER_WORK_STEALING;
+    tsInfo.weightedLanes = mode == BENCH_LANES_WEIGHTED;
+    if (mode == BENCH_LANES_GROUPS)
+    {
+        tsInfo.pGroups = groups;
+        tsInfo.groupCount = 2;
+    }
+
+    if (!initMutex(&bench.mutex) || !initConditionVariable(&bench.condition))
+    {
+        LOGF(eERROR, "Failed to initialize mutex");
+        return false;
+    }
+
+    if (!threadSystemInit(&bench.threadSystem, &tsInfo))
+    {
+        LOGF(eERROR, "Failed to initialize thread system");
+        exitConditionVariable(&bench.condition);
+        exitMutex(&bench.mutex);
+        return false;
+    }
+
+    for (uint64_t i = 0; i < threadCount * BENCH_LANES_BACKGROUND_TASKS_PER_THREAD; ++i)
+        threadSystemAddTaskPriority(bench.threadSystem, bench.backgroundPriority, benchLanesBackgroundTask, &bench);
+
+    struct BenchLanesFrameTask frameTasks[BENCH_LANES_FRAME_TASK_COUNT];
+
+    int64_t startTime = getUSec(true);
+
+    for (uint64_t frame = 0; frame < frameCount; ++frame)
+    {
+        bench.frameTasksLeft = BENCH_LANES_FRAME_TASK_COUNT;
+
+        int64_t addTime = getUSec(true);
+        for (uint64_t i = 0; i < BENCH_LANES_FRAME_TASK_COUNT; ++i)
+            frameTasks[i] = (struct BenchLanesFrameTask){ &bench, addTime };
+
+        threadSystemAddTasksPriority(bench.threadSystem, framePriority, benchLanesFrameTask, BENCH_LANES_FRAME_TASK_COUNT,
+                                     sizeof *frameTasks, frameTasks);
+
+        acquireMutex(&bench.mutex);
+        while (bench.frameTasksLeft)
+            waitConditionVariable(&bench.condition, &bench.mutex, TIMEOUT_INFINITE);
+        releaseMutex(&bench.mutex);
+    }
+
+    int64_t  totalTime = getUSec(true) - startTime;
+    uint64_t backgroundCount = tfrg_atomic64_load_relaxed(&bench.backgroundCount);
+
+    tfrg_atomic32_store_relaxed(&bench.stop, 1);
+    threadSystemWaitIdle(bench.threadSystem);
+    threadSystemExit(&bench.threadSystem, &gThreadSystemExitDescDefault);
+    exitConditionVariable(&bench.condition);
+    exitMutex(&bench.mutex);
+
+    uint64_t count = tfrg_atomic64_load_relaxed(&bench.latencyCount);
+    qsort(latencies, count, sizeof *latencies, benchLatencyCmp);
+
+    LOGF(eINFO, "%-11s %2llu threads: frame latency p50 %lluus p99 %lluus max %lluus, %.1f frames/s, %.0f background tasks/s",
+         BENCH_LANES_MODE_NAMES[mode], (unsigned long long)threadCount, (unsigned long long)latencies[count / 2],
+         (unsigned long long)latencies[count * 99 / 100], (unsigned long long)latencies[count - 1],
+         (double)frameCount * 1e6 / (double)(totalTime ? totalTime : 1),
+         (double)backgroundCount * 1e6 / (double)(totalTime ? totalTime : 1));
+    return true;
+}
+
+bool benchmarkLanes(uint64_t frameCount, uint64_t maxThreadCount)
+{
+    if (frameCount == 0)
+        return true;
+
+    uint64_t cpuCount = getNumCPUCores();
+    if (maxThreadCount > cpuCount)
+    {
+        LOGF(eINFO, "Thread count is limited to %llu CPU cores", (unsigned long long)cpuCount);
+        maxThreadCount = cpuCount;
+    }
+
+    int64_t* latencies = tf_malloc(frameCount * BENCH_LANES_FRAME_TASK_COUNT * sizeof *latencies);
+    if (!latencies)
+        return false;
+
+    LOGF(eINFO, "%d frame tasks of %dus per frame, background tasks of %dus", BENCH_LANES_FRAME_TASK_COUNT,
+         BENCH_LANES_FRAME_TASK_TIME, BENCH_LANES_BACKGROUND_TASK_TIME);
+
+    bool success = true;
+    for (int mode = 0; success && mode < BENCH_LANES_MODE_COUNT; ++mode)
+        success = benchLanesRun((enum BenchLanesMode)mode, frameCount, maxThreadCount, latencies);
+
+    tf_free(latencies);
+    return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function benchmarkAlloc                                                 ///
+////////////////////////////////////////////////////////////////////////////////
+
+// Blocks every thread keeps alive, each allocation replaces the oldest one
+#define BENCH_ALLOC_LIVE_COUNT 256
+#define BENCH_ALLOC_MIN_SIZE   16
+#define BENCH_ALLOC_MAX_SIZE   1024
+// Arrays of the growth pattern double until this size, like stb_ds arrays and bstrlib strings
+#define BENCH_ALLOC_GROWTH_MAX 4096
+#define BENCH_ALLOC_QUEUE_SIZE 1024
+
+enum BenchAllocPattern
+{
+    // Random sizes allocated and freed on the same thread, like loader request structs
+    BENCH_ALLOC_CHURN,
+    // Arrays grown with tf_realloc and freed
+    BENCH_ALLOC_GROWTH,
+    // Blocks freed by whichever thread picks them from a shared queue, like thread system task data
+    BENCH_ALLOC_HANDOFF,
+    BENCH_ALLOC_PATTERN_COUNT,
+};
+
+static const char* const BENCH_ALLOC_PATTERN_NAMES[BENCH_ALLOC_PATTERN_COUNT] = {
+    "churn",
+    "growth",
+    "handoff",
+};
+
+struct BenchAllocBenchmark
+{
+    enum BenchAllocPattern pattern;
+    uint64_t                   opCount;
+    MpmcQueue                  queue;
+};
+
+struct BenchAllocThread
+{
+    struct BenchAllocBenchmark* bench;
+    uint64_t                        seed;
+};
+
+static size_t benchAllocSize(uint64_t* seed)
+{
+    *seed = *seed * 6364136223846793005ull + 1442695040888963407ull;
+    size_t size = BENCH_ALLOC_MIN_SIZE + (size_t)((*seed >> 33) % (BENCH_ALLOC_MAX_SIZE - BENCH_ALLOC_MIN_SIZE));
+    // Small sizes are more common, like in real workloads
+    if (*seed & (1ull << 20))
+        size = BENCH_ALLOC_MIN_SIZE + size % 128;
+    return size;
+}
+
+static void benchAllocThread(void* user)
+{
+    struct BenchAllocThread*    thread = user;
+    struct BenchAllocBenchmark* bench = thread->bench;
+    void*                           live[BENCH_ALLOC_LIVE_COUNT] = { 0 };
+    uint64_t                        seed = thread->seed;
+
+    switch (bench->pattern)
+    {
+    case BENCH_ALLOC_CHURN:
+        for (uint64_t i = 0; i < bench->opCount; ++i)
+        {
+            void** slot = live + i % BENCH_ALLOC_LIVE_COUNT;
+            tf_free(*slot);
+            *slot = tf_malloc(benchAllocSize(&seed));
+            // Touch the block, so that the benchmark doesn't measure unused memory
+            *(volatile uint8_t*)*slot = (uint8_t)i;
+        }
+        break;
+    case BENCH_ALLOC_GROWTH:
+        for (uint64_t i = 0; i < bench->opCount;)
+        {
+            void** slot = live + i % BENCH_ALLOC_LIVE_COUNT;
+            tf_free(*slot);
+            *slot = NULL;
+            // Every growth step counts as one operation
+            for (size_t size = 8 + (size_t)(i % 8) * 4; size <= BENCH_ALLOC_GROWTH_MAX && i < bench->opCount; size *= 2, ++i)
+            {
+                *slot = tf_realloc(*slot, size);
+                ((volatile uint8_t*)*slot)[size - 1] = (uint8_t)i;
+            }
+        }
+        break;
+    case BENCH_ALLOC_HANDOFF:
+        for (uint64_t i = 0; i < bench->opCount; ++i)
+        {
+            void* ptr = tf_malloc(benchAllocSize(&seed));
+            *(volatile uint8_t*)ptr = (uint8_t)i;
+            if (!mpmcQueueTryPush(&bench->queue, &ptr))
+                tf_free(ptr);
+            if (mpmcQueueTryPop(&bench->queue, &ptr))
+                tf_free(ptr);
+        }
+        break;
+    default:
+        break;
+    }
+
+    for (int i = 0; i < BENCH_ALLOC_LIVE_COUNT; ++i)
+        tf_free(live[i]);
+}
+
+static int64_t benchAllocRun(struct BenchAllocBenchmark* bench, uint64_t threadCount)
+{
+    struct BenchAllocThread threads[64];
+    ThreadHandle                handles[64];
+
+    int64_t  startTime = getUSec(true);
+    uint64_t started = 0;
+    for (; started < threadCount; ++started)
+    {
+        threads[started].bench = bench;
+        threads[started].seed = started + 1;
+
+        struct ThreadDesc threadInfo = { 0 };
+        threadInfo.pFunc = benchAllocThread;
+        threadInfo.pData = threads + started;
+        snprintf(threadInfo.mThreadName, sizeof threadInfo.mThreadName, "BenchAlloc %llu", (unsigned long long)started);
+
+        if (!initThread(&threadInfo, handles + started))
+            break;
+    }
+
+    for (uint64_t i = 0; i < started; ++i)
+        joinThread(handles[i]);
+
+    int64_t time = getUSec(true) - startTime;
+
+    void* ptr;
+    while (mpmcQueueTryPop(&bench->queue, &ptr))
+        tf_free(ptr);
+
+    if (started != threadCount)
+    {
+        LOGF(eERROR, "Failed to create alloc benchmark thread");
+        return -1;
+    }
+    return time;
+}
+
+// Resident set size of the process, 0 when the platform doesn't report it
+static uint64_t benchResidentBytes(void)
+{
+    uint64_t residentBytes = 0;
+#if defined(__linux__)
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file)
+    {
+        unsigned long long totalPages = 0, residentPages = 0;
+        if (fscanf(file, "%llu %llu", &totalPages, &residentPages) == 2)
+            residentBytes = residentPages * 4096;
+        fclose(file);
+    }
+#endif
+    return residentBytes;
+}
+
+bool benchmarkAlloc(uint64_t opCount, uint64_t maxThreadCount)
+{
+    if (opCount == 0)
+        return true;
+
+    uint64_t cpuCount = getNumCPUCores();
+    if (maxThreadCount > cpuCount)
+    {
+        LOGF(eINFO, "Thread count is limited to %llu CPU cores", (unsigned long long)cpuCount);
+        maxThreadCount = cpuCount;
+    }
+    if (maxThreadCount < 1)
+        maxThreadCount = 1;
+
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+    // Counters only, then counters with sampling
+    static const uint32_t sampleRates[] = { 0, 1024 };
+    const char*           trackingName = "callsite";
+#elif defined(ENABLE_MEMORY_TRACKING)
+    static const uint32_t sampleRates[] = { 0 };
+    const char*           trackingName = "mmgr";
+#else
+    static const uint32_t sampleRates[] = { 0 };
+    const char*           trackingName = "untracked";
+#endif
+
+#if defined(ENABLE_SMALL_ALLOCATOR)
+    const char* allocatorName = "small allocator";
+#else
+    const char* allocatorName = "system allocator";
+#endif
+
+    LOGF(eINFO, "%s %s, %d to %d byte blocks, %d live blocks per thread", trackingName, allocatorName, BENCH_ALLOC_MIN_SIZE,
+         BENCH_ALLOC_MAX_SIZE, BENCH_ALLOC_LIVE_COUNT);
+
+    struct BenchAllocBenchmark bench = { 0 };
+    bench.opCount = opCount;
+    if (!mpmcQueueInit(&bench.queue, BENCH_ALLOC_QUEUE_SIZE, sizeof(void*)))
+    {
+        LOGF(eERROR, "Failed to initialize alloc benchmark queue");
+        return false;
+    }
+
+    bool success = true;
+    for (size_t rate = 0; success && rate < sizeof sampleRates / sizeof *sampleRates; ++rate)
+    {
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+        memSetSampleRate(sampleRates[rate]);
+#endif
+        for (int pattern = 0; success && pattern < BENCH_ALLOC_PATTERN_COUNT; ++pattern)
+        {
+            bench.pattern = (enum BenchAllocPattern)pattern;
+            for (uint64_t threadCount = 1; success && threadCount <= maxThreadCount; threadCount *= 2)
+            {
+                int64_t time = benchAllocRun(&bench, threadCount);
+                success = time >= 0;
+                if (!success)
+                    break;
+
+                LOGF(eINFO, "sample rate %4u, %-7s %2llu threads: %s, %.1f ns per op, %.1f M ops/s, resident %lluKB", sampleRates[rate],
+                     BENCH_ALLOC_PATTERN_NAMES[pattern], (unsigned long long)threadCount, humanReadableTime(time).str,
+                     (double)time * 1000.0 / (double)opCount, (double)(opCount * threadCount) / (double)(time ? time : 1),
+                     (unsigned long long)(benchResidentBytes() / 1024));
+            }
+        }
+    }
+
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+    memSetSampleRate(0);
+#endif
+    mpmcQueueExit(&bench.queue);
+    return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Function benchmarkLog                                                   ///
+////////////////////////////////////////////////////////////////////////////////
+
+// Caller latency is sampled, so that long runs don't need a timestamp per message
+#define BENCH_LOG_LATENCY_SAMPLES 16384
+
+struct BenchLogBenchmark
+{
+    uint64_t opCount;
+    uint64_t sampleStride;
+    uint64_t sampleCount;
+    int64_t* latencies;
+};
+
+struct BenchLogThread
+{
+    struct BenchLogBenchmark* bench;
+    uint64_t                      index;
+    // Time spent inside LOGF calls of this thread
+    int64_t                       callTime;
+};
+
+// Log files opened by addLogFile live in RD_LOG, tools only have their own directory
+static void benchLogFileWrite(void* user, const char* message) { fsWriteToStream(user, message, strlen(message)); }
+
+static void benchLogFileClose(void* user)
+{
+    fsCloseStream(user);
+    tf_free(user);
+}
+
+static void benchLogFileFlush(void* user) { fsFlushStream(user); }
+
+static void benchLogThread(void* user)
+{
+    struct BenchLogThread*    thread = user;
+    struct BenchLogBenchmark* bench = thread->bench;
+    int64_t*                      latencies = bench->latencies + thread->index * bench->sampleCount;
+    uint64_t                      sampleCount = 0;
+
+    int64_t startTime = getUSec(true);
+    for (uint64_t i = 0; i < bench->opCount; ++i)
+    {
+        if (i % bench->sampleStride || sampleCount == bench->sampleCount)
+        {
+            LOGF(eINFO, "Log benchmark thread %llu message %llu value %f", (unsigned long long)thread->index, (unsigned long long)i,
+                 (double)i * 0.5);
+            continue;
+        }
+
+        int64_t callTime = getUSec(true);
+        LOGF(eINFO, "Log benchmark thread %llu message %llu value %f", (unsigned long long)thread->index, (unsigned long long)i,
+             (double)i * 0.5);
+        latencies[sampleCount++] = getUSec(true) - callTime;
+    }
+    thread->callTime = getUSec(true) - startTime;
+}
+
+static int64_t benchLogRun(struct BenchLogBenchmark* bench, uint64_t threadCount, int64_t* callTime)
+{
+    struct BenchLogThread threads[64];
+    ThreadHandle              handles[64];
+
+    int64_t  startTime = getUSec(true);
+    uint64_t started = 0;
+    for (; started < threadCount; ++started)
+    {
+        threads[started].bench = bench;
+        threads[started].index = started;
+        threads[started].callTime = 0;
+
+        struct ThreadDesc threadInfo = { 0 };
+        threadInfo.pFunc = benchLogThread;
+        threadInfo.pData = threads + started;
+        snprintf(threadInfo.mThreadName, sizeof threadInfo.mThreadName, "BenchLog %llu", (unsigned long long)started);
+
+        if (!initThread(&threadInfo, handles + started))
+            break;
+    }
+
+    for (uint64_t i = 0; i < started; ++i)
+        joinThread(handles[i]);
+
+    // Throughput counts messages once they reached the log file
+    flushLog();
+    int64_t time = getUSec(true) - startTime;
+
+    *callTime = 0;
+    for (uint64_t i = 0; i < started; ++i)
+        *callTime += threads[i].callTime;
+
+    if (started != threadCount)
+    {
+        LOGF(eERROR, "Failed to create log benchmark thread");
+        return -1;
+    }
+    return time;
+}
+
+bool benchmarkLog(ResourceDirectory rd, const char* logPath, uint64_t opCount, uint64_t maxThreadCount)
+{
+    if (opCount == 0)
+        return true;
+
+    FileStream* logFile = tf_calloc(1, sizeof *logFile);
+    if (!logFile || !fsOpenStreamFromPath(rd, logPath, FM_WRITE, logFile))
+    {
+        LOGF(eERROR, "Failed to open log benchmark file '%s'", logPath);
+        tf_free(logFile);
+        return false;
+    }
+    // Log owns the stream from here, it is closed by removeLogCallback
+    addLogCallback(logPath, eALL, logFile, benchLogFileWrite, benchLogFileClose, benchLogFileFlush);
+
+    // Threads wait on the log, not on each other, so more threads than cores is still a valid contention test
+    if (maxThreadCount > 32)
+        maxThreadCount = 32;
+    if (maxThreadCount < 1)
+        maxThreadCount = 1;
+
+    struct BenchLogBenchmark bench = { 0 };
+    bench.opCount = opCount;
+    bench.sampleStride = (opCount + BENCH_LOG_LATENCY_SAMPLES - 1) / BENCH_LOG_LATENCY_SAMPLES;
+    bench.sampleCount = (opCount + bench.sampleStride - 1) / bench.sampleStride;
+    bench.latencies = tf_malloc(maxThreadCount * bench.sampleCount * sizeof *bench.latencies);
+    if (!bench.latencies)
+    {
+        LOGF(eERROR, "Failed to allocate log benchmark latencies");
+        return false;
+    }
+
+    LOGF(eINFO, "%llu messages per thread, written to %s, console output is off while measuring", (unsigned long long)opCount, logPath);
+
+    static const char* const modeNames[] = { "sync", "async" };
+
+    bool success = true;
+    for (int async = 0; success && async < 2; ++async)
+    {
+        enableAsyncLog(async != 0);
+        for (uint64_t threadCount = 1; success && threadCount <= maxThreadCount; threadCount *= 2)
+        {
+            int64_t callTime = 0;
+            // Results of the previous run are still queued in async mode
+            flushLog();
+            setLogConsoleOutput(false);
+            int64_t time = benchLogRun(&bench, threadCount, &callTime);
+            setLogConsoleOutput(true);
+            success = time >= 0;
+            if (!success)
+                break;
+
+            int64_t* latencies = bench.latencies;
+            uint64_t count = threadCount * bench.sampleCount;
+            qsort(latencies, count, sizeof *latencies, benchLatencyCmp);
+
+            LOGF(eINFO, "%-5s %2llu threads: %10.0f messages/s, caller avg %.0f ns, latency p50 %lluus p99 %lluus max %lluus",
+                 modeNames[async], (unsigned long long)threadCount, (double)(threadCount * opCount) * 1e6 / (double)(time ? time : 1),
+                 (double)callTime * 1000.0 / (double)(threadCount * opCount), (unsigned long long)latencies[count / 2],
+                 (unsigned long long)latencies[count * 99 / 100], (unsigned long long)latencies[count - 1]);
+        }
+    }
+
+#if defined(ENABLE_ASYNC_LOG)
+    enableAsyncLog(true);
+#else
+    enableAsyncLog(false);
+#endif
+    removeLogCallback(logPath);
+    tf_free(bench.latencies);
+    return success;
+}
@@ -0,0 +1,80 @@
+#pragma once
+/*
+ * Copyright (c) 2017-2024 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "../../Application/Config.h"
+
+#include "../Interfaces/IFileSystem.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#else
+#include <stdbool.h>
+#endif
+
+    // Throughput and latency benchmarks of the memory stream, threading, allocator and log utilities.
+    // Results are reported with LOGF(eINFO), functions return false if a run could not be set up.
+
+    // Sequential write throughput of contiguous and chunked memory streams
+    bool benchmarkMemoryStream(size_t totalSize, size_t writeSize);
+
+    // Tasks/s and add-to-start latency of thread system schedulers
+    // for 1us, 10us and 100us tasks at 1, 2, 4... 'maxThreadCount' threads.
+    // Tasks are added either one by one by caller, or by one root task per thread,
+    // which optionally waits for its children.
+    bool benchmarkThreadSystem(uint64_t taskCount, uint64_t maxThreadCount);
+
+    // threadSystemParallelFor against one equal chunk per thread on uniform and uneven workloads
+    bool benchmarkParallelFor(uint64_t iterationCount, uint64_t maxThreadCount);
+
+    // 'opCount' increments per thread of one shared counter with relaxed add, acq_rel add and CAS loop,
+    // and of per-thread cache line padded counters, at 1, 2, 4... 'maxThreadCount' threads
+    // AtomicsTest.c checks the same orderings under ThreadSanitizer.
+    bool benchmarkAtomics(uint64_t opCount, uint64_t maxThreadCount);
+
+    // Items/s and push-to-pop latency of SPSC and MPMC ring queues against mutex + condition variable queue,
+    // for 1, 2, 4... producers and consumers up to 'maxThreadCount' threads in total.
+    // Every producer pushes 'itemCount' items.
+    bool benchmarkQueues(uint64_t itemCount, uint64_t maxThreadCount);
+
+    // OS and futex Mutex: 'opCount' uncontended lock/unlock pairs, 'opCount' locks per thread at 2, 4... 'maxThreadCount' threads,
+    // and 'opCount' condition variable handoffs between two threads
+    bool benchmarkMutex(uint64_t opCount, uint64_t maxThreadCount);
+
+    // Add-to-start latency of 'frameCount' frames of short frame tasks while long background tasks keep the pool saturated.
+    // Frame and background tasks share one lane, use strict and weighted priority lanes, and separate worker groups.
+    bool benchmarkLanes(uint64_t frameCount, uint64_t maxThreadCount);
+
+    // 'opCount' operations per thread on small blocks at 1, 2, 4... 'maxThreadCount' threads: same thread alloc/free churn,
+    // tf_realloc growth and cross-thread frees through a queue. Measures the allocator and memory tracking mode the caller is built with.
+    bool benchmarkAlloc(uint64_t opCount, uint64_t maxThreadCount);
+
+    // 'opCount' LOGF calls per thread at 1, 2, 4... 'maxThreadCount' threads (at most 32), with synchronous and async log.
+    // Messages go to 'logPath' (overwritten) only. Reports messages per second until they reach the file and caller-side latency.
+    bool benchmarkLog(ResourceDirectory rd, const char* logPath, uint64_t opCount, uint64_t maxThreadCount);
+
+#ifdef __cplusplus
+}
+#endif
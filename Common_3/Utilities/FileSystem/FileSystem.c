@@ -26,17 +26,40 @@
 
 #include "../ThirdParty/OpenSource/bstrlib/bstrlib.h"
 
+// Before IMemory.h, intrinsics headers use malloc
+#if defined(ARCH_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BUNYAR_SWISS_SSE2
+#elif defined(ARCH_ARM64)
+#include <arm_neon.h>
+#define BUNYAR_SWISS_NEON
+#endif
+
+// Archive prefetch hints
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define BUNYAR_PREFETCH_MADVISE
+#if !defined(__APPLE__)
+#define BUNYAR_PREFETCH_FADVISE
+#endif
+#endif
+
 #include "../../Utilities/Interfaces/IFileSystem.h"
 #include "../../Utilities/Interfaces/ILog.h"
 #include "../../Utilities/Interfaces/IThread.h"
 #include "../../Utilities/Interfaces/ITime.h"
 
+#include "../../Utilities/Threading/Atomics.h"
+
 #include "../../Utilities/Interfaces/IMemory.h"
 
 // This macro enables custom ZSTD allocator features
 #define ZSTD_STATIC_LINKING_ONLY
 #include "../../Utilities/ThirdParty/OpenSource/lz4/lz4.h"
 #include "../../Utilities/ThirdParty/OpenSource/zstd/zstd.h"
+#include "../../Utilities/ThirdParty/OpenSource/zstd/common/xxhash.h"
 
 /************************************************************************/
 // MARK: - Filesystem
@@ -249,6 +272,11 @@ static size_t ioMemoryStreamWrite(FileStream* fs, const void* src, size_t size)
     {
         size_t newCapacity = stream->mCursor + size;
 
+        // Grow geometrically, so sequential writes are amortized O(1) in copies
+        size_t grownCapacity = stream->mCapacity + stream->mCapacity / 2;
+        if (newCapacity < grownCapacity)
+            newCapacity = grownCapacity;
+
         newCapacity =
             MEMORY_STREAM_GROW_SIZE * (newCapacity / MEMORY_STREAM_GROW_SIZE + (newCapacity % MEMORY_STREAM_GROW_SIZE == 0 ? 0 : 1));
 
@@ -364,12 +392,212 @@ static IFileSystem gMemoryFileIO = {
     NULL,
 };
 
+/************************************************************************/
+// Chunked Memory Stream Functions
+/************************************************************************/
+
+// Data is stored in a list of fixed size chunks.
+// Growing allocates new chunk, written data is never moved.
+struct ChunkedMemoryStream
+{
+    uint8_t** ppChunks;
+    uintptr_t mChunkCount;
+    uintptr_t mChunkCapacity;
+    uintptr_t mChunkSize;
+    uintptr_t mCursor;
+    uintptr_t mSize;
+};
+
+COMPILE_ASSERT(sizeof(struct ChunkedMemoryStream) <= sizeof(struct FileStreamUserData));
+
+#define CHUNKSD(name, fs) struct ChunkedMemoryStream* name = (struct ChunkedMemoryStream*)(fs)->mUser.data
+
+static bool ioChunkedMemoryStreamClose(FileStream* fs)
+{
+    CHUNKSD(stream, fs);
+
+    for (size_t i = 0; i < stream->mChunkCount; ++i)
+        tf_free(stream->ppChunks[i]);
+    tf_free(stream->ppChunks);
+    return true;
+}
+
+static size_t ioChunkedMemoryStreamRead(FileStream* fs, void* dst, size_t size)
+{
+    if (!(fs->mMode & FM_READ))
+    {
+        LOGF(eWARNING, "Attempting to read from stream that doesn't have FM_READ flag.");
+        return 0;
+    }
+
+    CHUNKSD(stream, fs);
+
+    if (stream->mCursor >= stream->mSize)
+        return 0;
+
+    if (size > stream->mSize - stream->mCursor)
+        size = stream->mSize - stream->mCursor;
+
+    for (size_t done = 0; done < size;)
+    {
+        size_t offset = stream->mCursor % stream->mChunkSize;
+        size_t part = stream->mChunkSize - offset;
+        if (part > size - done)
+            part = size - done;
+
+        memcpy((uint8_t*)dst + done, stream->ppChunks[stream->mCursor / stream->mChunkSize] + offset, part);
+
+        done += part;
+        stream->mCursor += part;
+    }
+
+    return size;
+}
+
+static size_t ioChunkedMemoryStreamWrite(FileStream* fs, const void* src, size_t size)
+{
+    if (!(fs->mMode & FM_WRITE))
+    {
+        LOGF(eWARNING, "Attempting to write to stream that doesn't have FM_WRITE flag.");
+        return 0;
+    }
+
+    CHUNKSD(stream, fs);
+
+    if (stream->mCursor > stream->mSize)
+    {
+        LOGF(eWARNING, "Creating discontinuity in initialized memory in memory stream.");
+    }
+
+    size_t requiredChunks = (stream->mCursor + size + stream->mChunkSize - 1) / stream->mChunkSize;
+
+    if (requiredChunks > stream->mChunkCapacity)
+    {
+        size_t newCapacity = stream->mChunkCapacity ? stream->mChunkCapacity * 2 : 16;
+        if (newCapacity < requiredChunks)
+            newCapacity = requiredChunks;
+
+        uint8_t** newChunks = (uint8_t**)tf_realloc(stream->ppChunks, newCapacity * sizeof(*newChunks));
+        if (!newChunks)
+        {
+            LOGF(eERROR, "Failed to reallocate chunked memory stream chunk list with new capacity %llu.",
+                 (unsigned long long)newCapacity);
+            return 0;
+        }
+
+        stream->ppChunks = newChunks;
+        stream->mChunkCapacity = newCapacity;
+    }
+
+    for (; stream->mChunkCount < requiredChunks; ++stream->mChunkCount)
+    {
+        stream->ppChunks[stream->mChunkCount] = (uint8_t*)tf_malloc(stream->mChunkSize);
+        if (!stream->ppChunks[stream->mChunkCount])
+        {
+            LOGF(eERROR, "Failed to allocate memory stream chunk of size %llu.", (unsigned long long)stream->mChunkSize);
+            return 0;
+        }
+    }
+
+    for (size_t done = 0; done < size;)
+    {
+        size_t offset = stream->mCursor % stream->mChunkSize;
+        size_t part = stream->mChunkSize - offset;
+        if (part > size - done)
+            part = size - done;
+
+        memcpy(stream->ppChunks[stream->mCursor / stream->mChunkSize] + offset, (const uint8_t*)src + done, part);
+
+        done += part;
+        stream->mCursor += part;
+    }
+
+    stream->mSize = stream->mSize > stream->mCursor ? stream->mSize : stream->mCursor;
+    return size;
+}
+
+static bool ioChunkedMemoryStreamSeek(FileStream* fs, SeekBaseOffset baseOffset, ssize_t seekOffset)
+{
+    CHUNKSD(stream, fs);
+
+    ssize_t newPosition = seekOffset;
+    switch (baseOffset)
+    {
+    case SBO_START_OF_FILE:
+        break;
+    case SBO_CURRENT_POSITION:
+        newPosition += (ssize_t)stream->mCursor;
+        break;
+    case SBO_END_OF_FILE:
+        newPosition += (ssize_t)stream->mSize;
+        break;
+    }
+
+    if (newPosition < 0 || newPosition > (ssize_t)stream->mSize)
+        return false;
+
+    stream->mCursor = (uintptr_t)newPosition;
+    return true;
+}
+
+static ssize_t ioChunkedMemoryStreamGetPosition(FileStream* fs)
+{
+    CHUNKSD(stream, fs);
+    return (ssize_t)stream->mCursor;
+}
+
+static ssize_t ioChunkedMemoryStreamGetSize(FileStream* fs)
+{
+    CHUNKSD(stream, fs);
+    return (ssize_t)stream->mSize;
+}
+
+static bool ioChunkedMemoryStreamIsAtEnd(FileStream* fs)
+{
+    CHUNKSD(stream, fs);
+    return stream->mCursor == stream->mSize;
+}
+
+static bool ioChunkedMemoryStreamMemoryMap(FileStream* fs, size_t* outSize, void const** outData)
+{
+    if (fs->mMode & FM_WRITE)
+        return false;
+
+    CHUNKSD(stream, fs);
+
+    // Only contiguous data can be mapped, use fsGetMemoryStreamChunks otherwise
+    if (stream->mChunkCount > 1)
+        return false;
+
+    *outSize = stream->mSize;
+    *outData = stream->mChunkCount ? stream->ppChunks[0] : NULL;
+    return true;
+}
+
+static IFileSystem gChunkedMemoryFileIO = {
+    NULL,
+    ioChunkedMemoryStreamClose,
+    ioChunkedMemoryStreamRead,
+    ioChunkedMemoryStreamWrite,
+    ioChunkedMemoryStreamSeek,
+    ioChunkedMemoryStreamGetPosition,
+    ioChunkedMemoryStreamGetSize,
+    ioMemoryStreamFlush,
+    ioChunkedMemoryStreamIsAtEnd,
+    NULL,
+    NULL,
+    ioChunkedMemoryStreamMemoryMap,
+    NULL,
+};
+
 /************************************************************************/
 // File IO
 /************************************************************************/
 
 bool fsIsMemoryStream(FileStream* pStream) { return pStream->pIO == &gMemoryFileIO; }
 
+bool fsIsChunkedMemoryStream(FileStream* pStream) { return pStream->pIO == &gChunkedMemoryFileIO; }
+
 bool fsIsSystemFileStream(FileStream* pStream) { return pStream->pIO == pSystemFileIO; }
 
 bool fsOpenStreamFromMemory(const void* buffer, size_t bufferSize, FileMode mode, bool owner, FileStream* fs)
@@ -408,6 +636,71 @@ bool fsOpenStreamFromMemory(const void* buffer, size_t bufferSize, FileMode mode
     return true;
 }
 
+bool fsOpenChunkedMemoryStream(size_t chunkSize, FileMode mode, FileStream* fs)
+{
+    memset(fs, 0, sizeof *fs);
+
+    fs->pIO = &gChunkedMemoryFileIO;
+    fs->mMode = mode;
+
+    CHUNKSD(stream, fs);
+    stream->mChunkSize = chunkSize ? chunkSize : MEMORY_STREAM_CHUNK_SIZE_DEFAULT;
+    return true;
+}
+
+size_t fsGetMemoryStreamChunks(FileStream* fs, size_t firstChunk, size_t maxChunks, MemoryStreamChunk* pOutChunks)
+{
+    if (fsIsMemoryStream(fs))
+    {
+        MEMSD(stream, fs);
+        if (firstChunk == 0 && maxChunks)
+        {
+            pOutChunks[0].pData = stream->pBuffer;
+            pOutChunks[0].mSize = (size_t)stream->mSize;
+        }
+        return 1;
+    }
+
+    if (!fsIsChunkedMemoryStream(fs))
+        return 0;
+
+    CHUNKSD(stream, fs);
+
+    // Chunks past the end of written data are not reported
+    size_t chunkCount = (stream->mSize + stream->mChunkSize - 1) / stream->mChunkSize;
+
+    for (size_t i = firstChunk; i < chunkCount && i - firstChunk < maxChunks; ++i)
+    {
+        size_t chunkEnd = (i + 1) * stream->mChunkSize;
+
+        pOutChunks[i - firstChunk].pData = stream->ppChunks[i];
+        pOutChunks[i - firstChunk].mSize = chunkEnd > stream->mSize ? stream->mSize - i * stream->mChunkSize : stream->mChunkSize;
+    }
+
+    return chunkCount;
+}
+
+size_t fsWriteMemoryStreamToStream(FileStream* src, FileStream* dst)
+{
+    size_t written = 0;
+
+    MemoryStreamChunk chunks[16];
+    for (size_t first = 0, count = 1; first < count; first += sizeof(chunks) / sizeof(chunks[0]))
+    {
+        count = fsGetMemoryStreamChunks(src, first, sizeof(chunks) / sizeof(chunks[0]), chunks);
+
+        for (size_t i = first; i < count && i - first < sizeof(chunks) / sizeof(chunks[0]); ++i)
+        {
+            size_t size = fsWriteToStream(dst, chunks[i - first].pData, chunks[i - first].mSize);
+            written += size;
+            if (size != chunks[i - first].mSize)
+                return written;
+        }
+    }
+
+    return written;
+}
+
 /// Opens the file at `filePath` using the mode `mode`, returning a new FileStream that can be used
 /// to read from or modify the file. May return NULL if the file could not be opened.
 bool fsOpenStreamFromPath(ResourceDirectory resourceDir, const char* fileName, FileMode mode, FileStream* pOut)
@@ -707,7 +1000,7 @@ struct BucketPointer
 
 static int uint64Cmp(const void* v0, const void* v1) { return memcmp(v0, v1, 8); }
 
-struct BunyArHashTable* bunyArHashTableConstruct(uint64_t nodeCount, const struct BunyArNode* nodes, const char* nodeNames)
+static struct BunyArHashTable* bunyArPerfectHashTableConstruct(uint64_t nodeCount, const struct BunyArNode* nodes, const char* nodeNames)
 {
     // More size -> faster computing
     // Values less then 1.5 won't work
@@ -861,8 +1154,8 @@ struct BunyArHashTable* bunyArHashTableConstruct(uint64_t nodeCount, const struc
     return ht;
 }
 
-uint64_t bunyArHashTableLookup(const struct BunyArHashTable* ht, const char* name, uint64_t nodeCount, const struct BunyArNode* nodes,
-                               const char* nodeNames)
+static uint64_t bunyArPerfectHashTableLookup(const struct BunyArHashTable* ht, const char* name, uint64_t nodeCount,
+                                             const struct BunyArNode* nodes, const char* nodeNames)
 {
     size_t pathLen = strlen(name);
 
@@ -884,6 +1177,190 @@ uint64_t bunyArHashTableLookup(const struct BunyArHashTable* ht, const char* nam
     return index;
 }
 
+/************************************************************************/
+// MARK: - Swiss hash table
+/************************************************************************/
+
+#define BUNYAR_SWISS_EMPTY 0x80
+
+// XXH64 processes 32 bytes per round with 4 independent lanes,
+// so it stays fast for long archive paths
+static inline uint64_t archiveHashPath64(const char* key, size_t len, uint64_t seed) { return XXH64(key, len, seed); }
+
+// Bit per slot of the group, ordered by slot index
+typedef uint32_t SwissMask;
+
+static inline SwissMask swissGroupMatch(const uint8_t* group, uint8_t value)
+{
+#if defined(BUNYAR_SWISS_SSE2)
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (SwissMask)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)value)));
+#elif defined(BUNYAR_SWISS_NEON)
+    static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+
+    uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(group), vdupq_n_u8(value)), vld1q_u8(bits));
+    return (SwissMask)vaddv_u8(vget_low_u8(eq)) | ((SwissMask)vaddv_u8(vget_high_u8(eq)) << 8);
+#else
+    SwissMask mask = 0;
+    for (uint32_t i = 0; i < BUNYAR_HASH_TABLE_SWISS_GROUP_SIZE; ++i)
+        mask |= (SwissMask)(group[i] == value) << i;
+    return mask;
+#endif
+}
+
+static inline uint32_t swissMaskNext(SwissMask* mask)
+{
+    uint32_t index;
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward(&bit, *mask);
+    index = (uint32_t)bit;
+#else
+    index = (uint32_t)__builtin_ctz(*mask);
+#endif
+    *mask &= *mask - 1;
+    return index;
+}
+
+// Low 7 bits go to control byte, the rest selects the group.
+// Groups are probed by triangular numbers which visit every group for power of 2 group count.
+static inline uint64_t swissGroupIndex(uint64_t hash, uint64_t groupMask, uint64_t probe)
+{
+    return ((hash >> 7) + probe * (probe + 1) / 2) & groupMask;
+}
+
+static struct BunyArHashTable* bunyArSwissHashTableConstruct(uint64_t nodeCount, const struct BunyArNode* nodes, const char* nodeNames)
+{
+    if (nodeCount > UINT32_MAX)
+        return NULL;
+
+    // Keep load factor under 7/8
+    uint64_t groupCount = 1;
+    while (groupCount * BUNYAR_HASH_TABLE_SWISS_GROUP_SIZE * 7 < nodeCount * 8)
+        groupCount *= 2;
+
+    uint64_t const slotCount = groupCount * BUNYAR_HASH_TABLE_SWISS_GROUP_SIZE;
+
+    struct BunyArHashTable* ht = tf_malloc(sizeof(*ht) + slotCount * (1 + sizeof(uint32_t)));
+    if (!ht)
+        return NULL;
+
+    ht->type = BUNYAR_HASH_TABLE_TYPE_SWISS;
+    ht->seed = 0;
+    ht->tableSlotCount = slotCount;
+
+    uint8_t*  control = (uint8_t*)(ht + 1);
+    uint32_t* table = (uint32_t*)(control + slotCount);
+
+    memset(control, BUNYAR_SWISS_EMPTY, slotCount);
+    memset(table, 0xff, slotCount * sizeof(*table));
+
+    for (uint64_t ni = 0; ni < nodeCount; ++ni)
+    {
+        const struct BunyArNode* node = nodes + ni;
+
+        uint64_t hash = archiveHashPath64(nodeNames + node->namePointer.offset, node->namePointer.size, ht->seed);
+
+        for (uint64_t probe = 0;; ++probe)
+        {
+            uint8_t*  group = control + swissGroupIndex(hash, groupCount - 1, probe) * BUNYAR_HASH_TABLE_SWISS_GROUP_SIZE;
+            SwissMask empty = swissGroupMatch(group, BUNYAR_SWISS_EMPTY);
+            if (!empty)
+                continue;
+
+            uint32_t slot = swissMaskNext(&empty);
+            group[slot] = (uint8_t)(hash & 0x7f);
+            table[group - control + slot] = (uint32_t)ni;
+            break;
+        }
+    }
+
+    return ht;
+}
+
+static uint64_t bunyArSwissHashTableLookup(const struct BunyArHashTable* ht, const char* name, uint64_t nodeCount,
+                                           const struct BunyArNode* nodes, const char* nodeNames)
+{
+    size_t pathLen = strlen(name);
+
+    const uint8_t*  control = (const uint8_t*)(ht + 1);
+    const uint32_t* table = (const uint32_t*)(control + ht->tableSlotCount);
+
+    uint64_t const groupMask = ht->tableSlotCount / BUNYAR_HASH_TABLE_SWISS_GROUP_SIZE - 1;
+
+    uint64_t hash = archiveHashPath64(name, pathLen, ht->seed);
+
+    for (uint64_t probe = 0; probe <= groupMask; ++probe)
+    {
+        const uint8_t* group = control + swissGroupIndex(hash, groupMask, probe) * BUNYAR_HASH_TABLE_SWISS_GROUP_SIZE;
+
+        for (SwissMask match = swissGroupMatch(group, (uint8_t)(hash & 0x7f)); match;)
+        {
+            uint64_t index = table[group - control + swissMaskNext(&match)];
+            if (index < nodeCount && nodes[index].namePointer.size == pathLen &&
+                memcmp(nodeNames + nodes[index].namePointer.offset, name, pathLen) == 0)
+                return index;
+        }
+
+        // Slots are never removed, so the first group with empty slot ends the chain
+        if (swissGroupMatch(group, BUNYAR_SWISS_EMPTY))
+            break;
+    }
+
+    return UINT64_MAX;
+}
+
+/************************************************************************/
+// MARK: - Archive hash table
+/************************************************************************/
+
+struct BunyArHashTable* bunyArHashTableConstruct(uint64_t nodeCount, const struct BunyArNode* nodes, const char* nodeNames)
+{
+    return bunyArHashTableConstructType(BUNYAR_HASH_TABLE_TYPE_PERFECT, nodeCount, nodes, nodeNames);
+}
+
+struct BunyArHashTable* bunyArHashTableConstructType(enum BunyArHashTableType type, uint64_t nodeCount, const struct BunyArNode* nodes,
+                                                     const char* nodeNames)
+{
+    switch (type)
+    {
+    case BUNYAR_HASH_TABLE_TYPE_PERFECT:
+        return bunyArPerfectHashTableConstruct(nodeCount, nodes, nodeNames);
+    case BUNYAR_HASH_TABLE_TYPE_SWISS:
+        return bunyArSwissHashTableConstruct(nodeCount, nodes, nodeNames);
+    default:
+        ASSERT(false);
+        return NULL;
+    }
+}
+
+uint64_t bunyArHashTableLookup(const struct BunyArHashTable* ht, const char* name, uint64_t nodeCount, const struct BunyArNode* nodes,
+                               const char* nodeNames)
+{
+    switch (ht->type)
+    {
+    case BUNYAR_HASH_TABLE_TYPE_PERFECT:
+        return bunyArPerfectHashTableLookup(ht, name, nodeCount, nodes, nodeNames);
+    case BUNYAR_HASH_TABLE_TYPE_SWISS:
+        return bunyArSwissHashTableLookup(ht, name, nodeCount, nodes, nodeNames);
+    default:
+        return UINT64_MAX;
+    }
+}
+
+const char* bunyArHashTableTypeName(enum BunyArHashTableType type)
+{
+    switch (type)
+    {
+    case BUNYAR_HASH_TABLE_TYPE_PERFECT:
+        return "perfect";
+    case BUNYAR_HASH_TABLE_TYPE_SWISS:
+        return "swiss";
+    default:
+        return "unknown";
+    }
+}
+
 const char* bunyArFormatName(enum BunyArFileFormat format)
 {
     switch (format)
@@ -894,6 +1371,8 @@ const char* bunyArFormatName(enum BunyArFileFormat format)
         return "LZ4";
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
         return "zstd";
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
+        return "zstd+dict";
     default:
         return "unknown";
     }
@@ -928,16 +1407,26 @@ struct BunyArMetadata
     struct BunyArNode*      nodes;
     char*                   nodeNames;
     struct BunyArHashTable* hashTable;
+    ZSTD_DDict*             zstdDictionary;
+    uint64_t                zstdDictionarySize;
 
     const uint8_t* memoryBeg;
     const uint8_t* memoryEnd;
 
-    FileStream  ownedStream;
-    FileStream* archiveStream;
-    uint64_t    virtualStreamCount; // only for validation
+    FileStream      ownedStream;
+    FileStream*     archiveStream;
+    tfrg_atomic64_t virtualStreamCount; // only for validation
 
     bool  archiveStreamLocking;
     Mutex mutex;
+
+    // Access recording, see fsArchiveBeginAccessRecording
+    tfrg_atomic32_t            recording;
+    bool                       recordingMutexInitialized;
+    Mutex                      recordingMutex;
+    struct BunyArAccessRecord* records;
+    uint64_t                   recordCount;
+    uint64_t                   recordCapacity;
 };
 
 struct BunyArNodeSearchCtx
@@ -970,6 +1459,7 @@ static int bunyArNameNodeCmp(const void* v1, const void* v2)
 }
 
 static void initBunyArFsInterface(IFileSystem*, struct BunyArMetadata*);
+static void bunyArRecordAccess(struct BunyArMetadata* archive, uint64_t nodeId, uint64_t offset, uint64_t size);
 
 static inline struct BunyArMetadata* getFsArchive(IFileSystem* fs) { return (struct BunyArMetadata*)fs->pUser; }
 
@@ -1025,6 +1515,10 @@ static inline bool bunyArReadLocation(struct BunyArMetadata* a,
 
 static const struct ArchiveOpenDesc BUNYAR_OPEN_DESC_DEFAULT = { 0 };
 
+// Size of BunyArHeader before extensions were added.
+// Extensions are read only if corresponding flags are set.
+static const size_t BUNYAR_HEADER_BASE_SIZE = offsetof(struct BunyArHeader, zstdDictionaryPointer);
+
 static bool bunyArchiveOpen(FileStream* stream, uint64_t memorySize, const void* memory, const struct ArchiveOpenDesc* desc,
                             IFileSystem* out)
 {
@@ -1039,18 +1533,32 @@ static bool bunyArchiveOpen(FileStream* stream, uint64_t memorySize, const void*
     ////////////////////////
     // Read and check header
 
-    struct BunyArHeader header;
+    struct BunyArHeader header = { 0 };
 
     bool headerReaded = false;
 
     if (streamMode)
     {
-        headerReaded = fsSeekStream(stream, SBO_START_OF_FILE, 0) && fsReadFromStream(stream, &header, sizeof header) == sizeof header;
+        headerReaded = fsSeekStream(stream, SBO_START_OF_FILE, 0) &&
+                       fsReadFromStream(stream, &header, BUNYAR_HEADER_BASE_SIZE) == BUNYAR_HEADER_BASE_SIZE;
+
+        if (headerReaded && (header.flags & BUNYAR_HEADER_FLAG_ZSTD_DICTIONARY))
+        {
+            size_t extensionSize = sizeof header - BUNYAR_HEADER_BASE_SIZE;
+            headerReaded = fsReadFromStream(stream, (uint8_t*)&header + BUNYAR_HEADER_BASE_SIZE, extensionSize) == extensionSize;
+        }
     }
-    else if (memorySize >= sizeof header)
+    else if (memorySize >= BUNYAR_HEADER_BASE_SIZE)
     {
-        memcpy(&header, memory, sizeof header);
+        memcpy(&header, memory, BUNYAR_HEADER_BASE_SIZE);
         headerReaded = true;
+
+        if (header.flags & BUNYAR_HEADER_FLAG_ZSTD_DICTIONARY)
+        {
+            headerReaded = memorySize >= sizeof header;
+            if (headerReaded)
+                memcpy(&header, memory, sizeof header);
+        }
     }
 
     if (!headerReaded)
@@ -1160,6 +1668,39 @@ static bool bunyArchiveOpen(FileStream* stream, uint64_t memorySize, const void*
             tf_free(archive->hashTable);
             archive->hashTable = NULL;
         }
+        else if (header.hashTablePointer.size < sizeof(struct BunyArHashTable) ||
+                 bunyArHashTableSize(archive->hashTable) != header.hashTablePointer.size)
+        {
+            LOGF(eERROR, "Archive hash table is abandoned because its type is unknown or size is wrong");
+            tf_free(archive->hashTable);
+            archive->hashTable = NULL;
+        }
+    }
+
+    ///////////////////////////////////
+    // Read and preload zstd dictionary
+
+    if ((header.flags & BUNYAR_HEADER_FLAG_ZSTD_DICTIONARY) && header.zstdDictionaryPointer.size)
+    {
+        void* dictionary = tf_malloc(header.zstdDictionaryPointer.size);
+
+        if (dictionary && bunyArReadLocation(archive, header.zstdDictionaryPointer, dictionary))
+        {
+            // Dictionary is digested once here,
+            // so file streams only reference it
+            archive->zstdDictionary = ZSTD_createDDict_advanced(dictionary, header.zstdDictionaryPointer.size, ZSTD_dlm_byCopy,
+                                                                ZSTD_dct_rawContent, ZSTD_MEMORY_ALLOCATOR);
+            archive->zstdDictionarySize = header.zstdDictionaryPointer.size;
+        }
+
+        tf_free(dictionary);
+
+        if (!archive->zstdDictionary)
+        {
+            LOGF(eERROR, "Failed to open archive: failed to load zstd dictionary");
+            tf_free(archive->hashTable);
+            goto CANCEL;
+        }
     }
 
     //////////////////////////
@@ -1335,7 +1876,7 @@ FORGE_API bool fsArchiveClose(IFileSystem* fs)
 
     struct BunyArMetadata* archive = getFsArchive(fs);
 
-    if (archive->virtualStreamCount > 0)
+    if (tfrg_atomic64_load_relaxed(&archive->virtualStreamCount) > 0)
     {
         LOGF(eERROR, "Archive closed while some files are still opened");
     }
@@ -1350,6 +1891,13 @@ FORGE_API bool fsArchiveClose(IFileSystem* fs)
         exitMutex(&archive->mutex);
     }
 
+    if (archive->recordingMutexInitialized)
+    {
+        exitMutex(&archive->recordingMutex);
+    }
+
+    tf_free(archive->records);
+    ZSTD_freeDDict(archive->zstdDictionary);
     tf_free(archive->hashTable);
     tf_free(archive);
     return true;
@@ -1423,7 +1971,15 @@ static bool ioArchiveOpenByUid(IFileSystem* inFs, uint64_t index, FileMode mode,
     }
     case BUNYAR_FILE_FORMAT_LZ4_BLOCKS:
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
     {
+        // Empty files have no blocks, writer leaves the dictionary out when all dictionary files are empty
+        if (node->format == BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS && !archive->zstdDictionary && node->originalFileSize)
+        {
+            LOGF(eERROR, "Archive file '%s' requires zstd dictionary, but archive has none", archive->nodeNames + node->namePointer.offset);
+            return false;
+        }
+
         if (node->filePointer.size < sizeof(blocksHeader))
         {
             LOGF(eERROR, "Currupted archive file '%s'", archive->nodeNames + node->namePointer.offset);
@@ -1477,6 +2033,7 @@ static bool ioArchiveOpenByUid(IFileSystem* inFs, uint64_t index, FileMode mode,
     switch (node->format)
     {
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
     {
         fs->zstd_ctx = ZSTD_createDCtx_advanced(ZSTD_MEMORY_ALLOCATOR);
         if (!fs->zstd_ctx)
@@ -1484,6 +2041,15 @@ static bool ioArchiveOpenByUid(IFileSystem* inFs, uint64_t index, FileMode mode,
             LOGF(eERROR, "Failed to create ZSTD decompression context");
             goto CANCEL;
         }
+
+        // Referenced dictionary is already digested,
+        // so there is no per-block dictionary loading cost
+        if (node->format == BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS && ZSTD_isError(ZSTD_DCtx_refDDict(fs->zstd_ctx, archive->zstdDictionary)))
+        {
+            LOGF(eERROR, "Failed to reference ZSTD dictionary");
+            ZSTD_freeDCtx(fs->zstd_ctx);
+            goto CANCEL;
+        }
     }
     }
 
@@ -1492,7 +2058,11 @@ static bool ioArchiveOpenByUid(IFileSystem* inFs, uint64_t index, FileMode mode,
 
     pOutStream->mUser.data[0] = (uintptr_t)fs;
 
-    ++archive->virtualStreamCount;
+    tfrg_atomic64_add_relaxed(&archive->virtualStreamCount, 1);
+
+    // Empty record, so that prefetch includes block table of opened file
+    if (tfrg_atomic32_load_relaxed(&archive->recording))
+        bunyArRecordAccess(archive, index, 0, 0);
 
     return true;
 }
@@ -1513,8 +2083,8 @@ static bool ioArchiveFsClose(FileStream* fs)
     ASSERT(fs->mUser.data[0]);
 
     struct BunyArMetadata* archive = getFsArchive(fs->pIO);
-    ASSERT(archive->virtualStreamCount != 0);
-    --archive->virtualStreamCount;
+    ASSERT(tfrg_atomic64_load_relaxed(&archive->virtualStreamCount) != 0);
+    tfrg_atomic64_add_relaxed(&archive->virtualStreamCount, -1);
 
     struct BunyArFileStream* stream = getFsBunyArStream(fs);
     ZSTD_freeDCtx(stream->zstd_ctx);
@@ -1580,6 +2150,7 @@ static bool bunyArReadBlockToBuffer(struct BunyArMetadata* archive, struct BunyA
     }
     break;
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
     {
         size_t decompressedSize = ZSTD_decompressDCtx(fs->zstd_ctx, dst->memory, dst->memorySize, srcMemory, srcSize);
 
@@ -1619,7 +2190,7 @@ static bool bunyArReadBlockToStagingBuffer(struct BunyArMetadata* archive, struc
     return false;
 }
 
-static size_t ioArchiveFsRead(FileStream* pFile, void* outputBuffer, size_t outputSize)
+static size_t bunyArFileRead(FileStream* pFile, void* outputBuffer, size_t outputSize)
 {
     struct BunyArFileStream* fs = getFsBunyArStream(pFile);
     struct BunyArMetadata*   archive = getFsArchive(pFile->pIO);
@@ -1639,6 +2210,7 @@ static size_t ioArchiveFsRead(FileStream* pFile, void* outputBuffer, size_t outp
     }
     case BUNYAR_FILE_FORMAT_LZ4_BLOCKS:
     case BUNYAR_FILE_FORMAT_ZSTD_BLOCKS:
+    case BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS:
     {
         uint8_t* dstMemory = (uint8_t*)outputBuffer;
         size_t   sizeToWrite = outputSize;
@@ -1730,6 +2302,20 @@ static size_t ioArchiveFsRead(FileStream* pFile, void* outputBuffer, size_t outp
     }
 }
 
+static size_t ioArchiveFsRead(FileStream* pFile, void* outputBuffer, size_t outputSize)
+{
+    struct BunyArFileStream* fs = getFsBunyArStream(pFile);
+    struct BunyArMetadata*   archive = getFsArchive(pFile->pIO);
+
+    size_t position = fs->position;
+    size_t readSize = bunyArFileRead(pFile, outputBuffer, outputSize);
+
+    if (readSize && tfrg_atomic32_load_relaxed(&archive->recording))
+        bunyArRecordAccess(archive, (uint64_t)(fs->node - archive->nodes), position, readSize);
+
+    return readSize;
+}
+
 static bool ioArchiveFsSeek(FileStream* pFile, SeekBaseOffset baseOffset, ssize_t seekOffset)
 {
     struct BunyArFileStream* stream = getFsBunyArStream(pFile);
@@ -1789,6 +2375,11 @@ static bool ioArchiveMemoryMap(FileStream* fs, size_t* outSize, void const** out
 
     *outSize = node->filePointer.size;
     *outData = archive->memoryBeg + node->filePointer.offset;
+
+    // Mapped file can be read in any order, record it as a whole
+    if (tfrg_atomic32_load_relaxed(&archive->recording))
+        bunyArRecordAccess(archive, (uint64_t)(node - archive->nodes), 0, node->originalFileSize);
+
     return true;
 }
 
@@ -1824,6 +2415,7 @@ void fsArchiveGetDescription(IFileSystem* fs, struct BunyArDescription* outInfo)
 
     outInfo->nodeCount = archive->nodeCount;
     outInfo->hashTable = archive->hashTable;
+    outInfo->zstdDictionarySize = archive->zstdDictionarySize;
 }
 
 bool fsArchiveGetNodeDescription(IFileSystem* fs, uint64_t nodeId, struct BunyArNodeDescription* outInfo)
@@ -1857,5 +2449,535 @@ bool fsArchiveGetFileBlockMetadata(FileStream* pFile, struct BunyArBlockFormatHe
     return *outBlockPtrs != NULL;
 }
 
+/************************************************************************/
+// MARK: - Archive access recording
+/************************************************************************/
+
+static const uint8_t BUNYAR_ACCESS_RECORDING_MAGIC[8] = { 'B', 'u', 'n', 'y', 'A', 'c', 'c', 's' };
+
+#define BUNYAR_ACCESS_RECORDING_VERSION 1
+
+// File layout:
+//   BunyArAccessRecordingHeader
+//   nameCount x (uint32_t size, char name[size])
+//   recordCount x BunyArAccessRecordingEntry
+struct BunyArAccessRecordingHeader
+{
+    uint8_t  magic[sizeof BUNYAR_ACCESS_RECORDING_MAGIC];
+    uint32_t version;
+    uint32_t nameCount;
+    uint64_t recordCount;
+};
+
+struct BunyArAccessRecordingEntry
+{
+    uint32_t nameIndex;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+static void bunyArRecordAccess(struct BunyArMetadata* archive, uint64_t nodeId, uint64_t offset, uint64_t size)
+{
+    acquireMutex(&archive->recordingMutex);
+
+    struct BunyArAccessRecord* last = archive->recordCount ? archive->records + archive->recordCount - 1 : NULL;
+
+    // Sequential reads of the same file are stored as one record
+    if (last && last->nodeId == nodeId && last->offset + last->size == offset)
+    {
+        last->size += size;
+    }
+    else
+    {
+        if (archive->recordCount == archive->recordCapacity)
+        {
+            uint64_t                   capacity = archive->recordCapacity ? archive->recordCapacity * 2 : 256;
+            struct BunyArAccessRecord* records =
+                (struct BunyArAccessRecord*)tf_realloc(archive->records, capacity * sizeof(struct BunyArAccessRecord));
+            if (!records)
+            {
+                releaseMutex(&archive->recordingMutex);
+                return;
+            }
+            archive->records = records;
+            archive->recordCapacity = capacity;
+        }
+
+        archive->records[archive->recordCount++] = (struct BunyArAccessRecord){ nodeId, offset, size };
+    }
+
+    releaseMutex(&archive->recordingMutex);
+}
+
+bool fsArchiveBeginAccessRecording(IFileSystem* fs)
+{
+    struct BunyArMetadata* archive = getFsArchive(fs);
+
+    if (!archive->recordingMutexInitialized)
+    {
+        if (!initMutex(&archive->recordingMutex))
+            return false;
+        archive->recordingMutexInitialized = true;
+    }
+
+    acquireMutex(&archive->recordingMutex);
+    archive->recordCount = 0;
+    releaseMutex(&archive->recordingMutex);
+
+    tfrg_atomic32_store_release(&archive->recording, 1);
+    return true;
+}
+
+void fsArchiveEndAccessRecording(IFileSystem* fs)
+{
+    struct BunyArMetadata* archive = getFsArchive(fs);
+    tfrg_atomic32_store_release(&archive->recording, 0);
+}
+
+uint64_t fsArchiveGetAccessRecords(IFileSystem* fs, const struct BunyArAccessRecord** outRecords)
+{
+    struct BunyArMetadata* archive = getFsArchive(fs);
+    *outRecords = archive->records;
+    return archive->recordCount;
+}
+
+bool fsArchiveWriteAccessRecording(IFileSystem* fs, FileStream* dst)
+{
+    struct BunyArMetadata* archive = getFsArchive(fs);
+
+    uint32_t* nameIndices = (uint32_t*)tf_malloc(archive->nodeCount * sizeof(uint32_t) + 1);
+    if (!nameIndices)
+        return false;
+    memset(nameIndices, 0xff, archive->nodeCount * sizeof(uint32_t));
+
+    // Names are stored once, in order of the first access
+    struct BunyArAccessRecordingHeader header = { 0 };
+    memcpy(header.magic, BUNYAR_ACCESS_RECORDING_MAGIC, sizeof header.magic);
+    header.version = BUNYAR_ACCESS_RECORDING_VERSION;
+
+    for (uint64_t i = 0; i < archive->recordCount; ++i)
+    {
+        uint64_t nodeId = archive->records[i].nodeId;
+        if (nameIndices[nodeId] == UINT32_MAX)
+            nameIndices[nodeId] = header.nameCount++;
+    }
+    header.recordCount = archive->recordCount;
+
+    bool success = fsWriteToStream(dst, &header, sizeof header) == sizeof header;
+
+    uint32_t namesWritten = 0;
+    for (uint64_t i = 0; success && i < archive->recordCount; ++i)
+    {
+        uint64_t nodeId = archive->records[i].nodeId;
+        if (nameIndices[nodeId] != namesWritten)
+            continue;
+
+        const struct BunyArNode* node = archive->nodes + nodeId;
+        uint32_t                 nameSize = node->namePointer.size;
+
+        success = fsWriteToStream(dst, &nameSize, sizeof nameSize) == sizeof nameSize &&
+                  fsWriteToStream(dst, archive->nodeNames + node->namePointer.offset, nameSize) == nameSize;
+        ++namesWritten;
+    }
+
+    for (uint64_t i = 0; success && i < archive->recordCount; ++i)
+    {
+        const struct BunyArAccessRecord*  record = archive->records + i;
+        struct BunyArAccessRecordingEntry entry = { nameIndices[record->nodeId], 0, record->offset, record->size };
+        success = fsWriteToStream(dst, &entry, sizeof entry) == sizeof entry;
+    }
+
+    tf_free(nameIndices);
+
+    if (!success)
+        LOGF(eERROR, "Failed to write archive access recording");
+    return success;
+}
+
+/************************************************************************/
+// MARK: - Archive prefetching
+/************************************************************************/
+
+// Unread gaps smaller than this are prefetched too, one seek costs more
+#define BUNYAR_PREFETCH_MERGE_GAP   (64 * 1024)
+// Read size for streams without OS hints
+#define BUNYAR_PREFETCH_SCRATCH_SIZE (1024 * 1024)
+
+struct BunyArPrefetchRanges
+{
+    struct BunyArPointer64* ranges;
+    uint64_t                count;
+    uint64_t                capacity;
+};
+
+static bool bunyArPrefetchRangeAdd(struct BunyArPrefetchRanges* r, uint64_t offset, uint64_t size)
+{
+    if (!size)
+        return true;
+
+    if (r->count == r->capacity)
+    {
+        uint64_t                capacity = r->capacity ? r->capacity * 2 : 256;
+        struct BunyArPointer64* ranges = (struct BunyArPointer64*)tf_realloc(r->ranges, capacity * sizeof(struct BunyArPointer64));
+        if (!ranges)
+            return false;
+        r->ranges = ranges;
+        r->capacity = capacity;
+    }
+
+    r->ranges[r->count++] = (struct BunyArPointer64){ offset, size };
+    return true;
+}
+
+static int bunyArPrefetchRangeCmp(const void* v1, const void* v2)
+{
+    const struct BunyArPointer64* r1 = v1;
+    const struct BunyArPointer64* r2 = v2;
+    return r1->offset < r2->offset ? -1 : r1->offset > r2->offset ? 1 : 0;
+}
+
+// Record with archive offset of its node, used for sorting
+struct BunyArPrefetchRecord
+{
+    struct BunyArAccessRecord record;
+    uint64_t                  archiveOffset;
+};
+
+static int bunyArPrefetchRecordCmp(const void* v1, const void* v2)
+{
+    const struct BunyArPrefetchRecord* r1 = v1;
+    const struct BunyArPrefetchRecord* r2 = v2;
+    if (r1->archiveOffset != r2->archiveOffset)
+        return r1->archiveOffset < r2->archiveOffset ? -1 : 1;
+    return r1->record.offset < r2->record.offset ? -1 : r1->record.offset > r2->record.offset ? 1 : 0;
+}
+
+// Adds archive ranges of all records of one node.
+// Records are sorted by file offset.
+static bool bunyArPrefetchNodeRanges(struct BunyArMetadata* archive, struct BunyArNode* node, uint64_t recordCount,
+                                     const struct BunyArPrefetchRecord* records, BunyArBlockPointer** pBlocks, uint64_t* pBlocksCapacity,
+                                     struct BunyArPrefetchRanges* out)
+{
+    if (node->format == BUNYAR_FILE_FORMAT_RAW)
+    {
+        for (uint64_t i = 0; i < recordCount; ++i)
+        {
+            const struct BunyArAccessRecord* record = &records[i].record;
+            if (record->offset >= node->filePointer.size)
+                continue;
+
+            uint64_t size = node->filePointer.size - record->offset;
+            if (size > record->size)
+                size = record->size;
+
+            if (!bunyArPrefetchRangeAdd(out, node->filePointer.offset + record->offset, size))
+                return false;
+        }
+        return true;
+    }
+
+    // Whole compressed file is needed, block table can be skipped
+    uint64_t coveredEnd = 0;
+    for (uint64_t i = 0; i < recordCount && records[i].record.offset <= coveredEnd; ++i)
+    {
+        uint64_t end = records[i].record.offset + records[i].record.size;
+        if (end > coveredEnd)
+            coveredEnd = end;
+    }
+    if (coveredEnd >= node->originalFileSize)
+        return bunyArPrefetchRangeAdd(out, node->filePointer.offset, node->filePointer.size);
+
+    struct BunyArBlockFormatHeader header;
+    if (node->filePointer.size < sizeof header ||
+        bunyArStreamRead(archive, node->filePointer.offset, sizeof header, &header) != sizeof header || header.blockSize == 0 ||
+        header.blockCount * sizeof(BunyArBlockPointer) > node->filePointer.size - sizeof header)
+    {
+        // Corrupted node, opening will report it
+        return true;
+    }
+
+    uint64_t tableSize = header.blockCount * sizeof(BunyArBlockPointer);
+
+    if (!bunyArPrefetchRangeAdd(out, node->filePointer.offset, sizeof header + tableSize))
+        return false;
+
+    if (header.blockCount > *pBlocksCapacity)
+    {
+        BunyArBlockPointer* blocks = (BunyArBlockPointer*)tf_realloc(*pBlocks, tableSize);
+        if (!blocks)
+            return false;
+        *pBlocks = blocks;
+        *pBlocksCapacity = header.blockCount;
+    }
+
+    if (bunyArStreamRead(archive, node->filePointer.offset + sizeof header, tableSize, *pBlocks) != tableSize)
+        return true;
+
+    uint64_t nextBlock = 0;
+
+    for (uint64_t i = 0; i < recordCount; ++i)
+    {
+        const struct BunyArAccessRecord* record = &records[i].record;
+        if (!record->size)
+            continue;
+
+        uint64_t firstBlock = record->offset / header.blockSize;
+        uint64_t lastBlock = (record->offset + record->size - 1) / header.blockSize;
+
+        if (firstBlock < nextBlock)
+            firstBlock = nextBlock;
+        if (lastBlock >= header.blockCount)
+            lastBlock = header.blockCount - 1;
+
+        for (uint64_t bi = firstBlock; bi <= lastBlock && bi < header.blockCount; ++bi)
+        {
+            struct BunyArBlockInfo info = bunyArDecodeBlockPointer((*pBlocks)[bi]);
+            struct BunyArPointer64 location = bunyArDecodeBlockPointerInfo(node, &header, &info);
+
+            if (!bunyArPrefetchRangeAdd(out, location.offset, location.size))
+                return false;
+        }
+
+        if (lastBlock + 1 > nextBlock)
+            nextBlock = lastBlock + 1;
+    }
+
+    return true;
+}
+
+static void bunyArPrefetchArchiveRange(struct BunyArMetadata* archive, struct BunyArPointer64 range, uint8_t** pScratch)
+{
+    if (archive->memoryBeg)
+    {
+        const uint8_t* beg;
+        uint64_t       size;
+        bunyArMemoryReadPrepare(archive, range, &beg, &size);
+        if (!size)
+            return;
+
+#if defined(BUNYAR_PREFETCH_MADVISE)
+        uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t pageBeg = (uintptr_t)beg & ~(pageSize - 1);
+        madvise((void*)pageBeg, (uintptr_t)beg + size - pageBeg, MADV_WILLNEED);
+#else
+        // Fault pages in archive order
+        volatile uint8_t sink = 0;
+        for (uint64_t offset = 0; offset < size; offset += 4096)
+            sink ^= beg[offset];
+        sink ^= beg[size - 1];
+        (void)sink;
+#endif
+        return;
+    }
+
+#if defined(BUNYAR_PREFETCH_FADVISE)
+    if (fsIsSystemFileStream(archive->archiveStream))
+    {
+        int fd = (int)(ssize_t)fsGetSystemHandle(archive->archiveStream);
+        if (posix_fadvise(fd, (off_t)range.offset, (off_t)range.size, POSIX_FADV_WILLNEED) == 0)
+            return;
+    }
+#endif
+
+    // No OS hint is available, read range to warm the file cache
+    if (!*pScratch)
+    {
+        *pScratch = (uint8_t*)tf_malloc(BUNYAR_PREFETCH_SCRATCH_SIZE);
+        if (!*pScratch)
+            return;
+    }
+
+    while (range.size)
+    {
+        uint64_t size = range.size > BUNYAR_PREFETCH_SCRATCH_SIZE ? BUNYAR_PREFETCH_SCRATCH_SIZE : range.size;
+        if (bunyArStreamRead(archive, range.offset, size, *pScratch) != size)
+            break;
+        range.offset += size;
+        range.size -= size;
+    }
+}
+
+bool fsArchivePrefetch(IFileSystem* fs, uint64_t recordCount, const struct BunyArAccessRecord* pRecords, struct BunyArPrefetchStats* outStats)
+{
+    struct BunyArPrefetchStats stats = { 0 };
+    if (outStats)
+        *outStats = stats;
+
+    if (!recordCount)
+        return true;
+
+    struct BunyArMetadata* archive = getFsArchive(fs);
+
+    struct BunyArPrefetchRecord* records = (struct BunyArPrefetchRecord*)tf_malloc(recordCount * sizeof(struct BunyArPrefetchRecord));
+    if (!records)
+        return false;
+
+    uint64_t validCount = 0;
+    for (uint64_t i = 0; i < recordCount; ++i)
+    {
+        if (pRecords[i].nodeId >= archive->nodeCount)
+        {
+            ++stats.recordsSkipped;
+            continue;
+        }
+
+        records[validCount].record = pRecords[i];
+        records[validCount].archiveOffset = archive->nodes[pRecords[i].nodeId].filePointer.offset;
+        ++validCount;
+    }
+
+    // Nodes are visited in archive order, so block tables are read sequentially too
+    qsort(records, validCount, sizeof *records, bunyArPrefetchRecordCmp);
+
+    struct BunyArPrefetchRanges ranges = { 0 };
+    BunyArBlockPointer*         blocks = NULL;
+    uint64_t                    blocksCapacity = 0;
+    bool                        success = true;
+
+    for (uint64_t beg = 0, end = 0; success && beg < validCount; beg = end)
+    {
+        uint64_t nodeId = records[beg].record.nodeId;
+        for (end = beg + 1; end < validCount && records[end].record.nodeId == nodeId; ++end)
+            ;
+
+        success = bunyArPrefetchNodeRanges(archive, archive->nodes + nodeId, end - beg, records + beg, &blocks, &blocksCapacity, &ranges);
+    }
+
+    tf_free(blocks);
+    tf_free(records);
+
+    if (!success)
+    {
+        tf_free(ranges.ranges);
+        LOGF(eERROR, "Failed to prepare archive prefetch ranges: out of memory");
+        return false;
+    }
+
+    // Sort and merge ranges, so that I/O is done in as few sequential passes as possible
+    qsort(ranges.ranges, ranges.count, sizeof *ranges.ranges, bunyArPrefetchRangeCmp);
+
+    uint64_t mergedCount = 0;
+    for (uint64_t i = 0; i < ranges.count; ++i)
+    {
+        struct BunyArPointer64  range = ranges.ranges[i];
+        struct BunyArPointer64* last = mergedCount ? ranges.ranges + mergedCount - 1 : NULL;
+
+        if (last && range.offset <= last->offset + last->size + BUNYAR_PREFETCH_MERGE_GAP)
+        {
+            uint64_t end = range.offset + range.size;
+            if (end > last->offset + last->size)
+                last->size = end - last->offset;
+        }
+        else
+        {
+            ranges.ranges[mergedCount++] = range;
+        }
+    }
+
+    uint8_t* scratch = NULL;
+    for (uint64_t i = 0; i < mergedCount; ++i)
+    {
+        bunyArPrefetchArchiveRange(archive, ranges.ranges[i], &scratch);
+        stats.byteCount += ranges.ranges[i].size;
+    }
+    stats.rangeCount = mergedCount;
+
+    tf_free(scratch);
+    tf_free(ranges.ranges);
+
+    if (outStats)
+        *outStats = stats;
+    return true;
+}
+
+bool fsArchivePrefetchFromStream(IFileSystem* fs, FileStream* src, struct BunyArPrefetchStats* outStats)
+{
+    if (outStats)
+        memset(outStats, 0, sizeof *outStats);
+
+    struct BunyArAccessRecordingHeader header;
+    if (fsReadFromStream(src, &header, sizeof header) != sizeof header ||
+        memcmp(header.magic, BUNYAR_ACCESS_RECORDING_MAGIC, sizeof header.magic) != 0)
+    {
+        LOGF(eERROR, "Failed to read archive access recording: wrong magic value");
+        return false;
+    }
+
+    if (header.version != BUNYAR_ACCESS_RECORDING_VERSION)
+    {
+        LOGF(eERROR, "Archive access recording version %u is not supported, expected %u", header.version, BUNYAR_ACCESS_RECORDING_VERSION);
+        return false;
+    }
+
+    // Protects from huge allocations on corrupted files.
+    // Every name takes at least its size field, every record its entry.
+    ssize_t streamSize = fsGetStreamFileSize(src);
+    if (streamSize >= 0)
+    {
+        uint64_t remaining = (uint64_t)streamSize > sizeof header ? (uint64_t)streamSize - sizeof header : 0;
+        uint64_t namesMinSize = (uint64_t)header.nameCount * sizeof(uint32_t);
+        if (namesMinSize > remaining || header.recordCount > (remaining - namesMinSize) / sizeof(struct BunyArAccessRecordingEntry))
+        {
+            LOGF(eERROR, "Archive access recording is corrupted: name count %u, record count %llu", header.nameCount,
+                 (unsigned long long)header.recordCount);
+            return false;
+        }
+    }
+
+    uint64_t* nodeIds = (uint64_t*)tf_malloc(header.nameCount * sizeof(uint64_t) + 1);
+
+    struct BunyArAccessRecord* records =
+        (struct BunyArAccessRecord*)tf_malloc(header.recordCount * sizeof(struct BunyArAccessRecord) + 1);
+
+    bool     success = nodeIds && records;
+    uint64_t recordCount = 0;
+    uint64_t skipped = 0;
+
+    for (uint32_t i = 0; success && i < header.nameCount; ++i)
+    {
+        char     name[BUNYAR_FILE_NAME_LENGTH_MAX + 1];
+        uint32_t nameSize = 0;
+
+        success = fsReadFromStream(src, &nameSize, sizeof nameSize) == sizeof nameSize && nameSize <= BUNYAR_FILE_NAME_LENGTH_MAX &&
+                  fsReadFromStream(src, name, nameSize) == nameSize;
+        if (!success)
+            break;
+
+        name[nameSize] = 0;
+        if (!fsArchiveGetNodeId(fs, name, nodeIds + i))
+            nodeIds[i] = UINT64_MAX;
+    }
+
+    for (uint64_t i = 0; success && i < header.recordCount; ++i)
+    {
+        struct BunyArAccessRecordingEntry entry;
+        success = fsReadFromStream(src, &entry, sizeof entry) == sizeof entry;
+
+        if (!success)
+            break;
+
+        if (entry.nameIndex >= header.nameCount || nodeIds[entry.nameIndex] == UINT64_MAX)
+        {
+            ++skipped;
+            continue;
+        }
+
+        records[recordCount++] = (struct BunyArAccessRecord){ nodeIds[entry.nameIndex], entry.offset, entry.size };
+    }
+
+    if (success)
+        success = fsArchivePrefetch(fs, recordCount, records, outStats);
+    else
+        LOGF(eERROR, "Failed to read archive access recording");
+
+    if (success && outStats)
+        outStats->recordsSkipped += skipped;
+
+    tf_free(records);
+    tf_free(nodeIds);
+    return success;
+}
+
 /************************************************************************/
 /************************************************************************/
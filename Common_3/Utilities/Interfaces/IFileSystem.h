@@ -328,6 +328,33 @@ extern "C"
     FORGE_API bool fsIsSystemFileStream(FileStream* fs);
     /// Checks if stream is a memory stream
     FORGE_API bool fsIsMemoryStream(FileStream* fs);
+    /// Checks if stream is a chunked memory stream
+    FORGE_API bool fsIsChunkedMemoryStream(FileStream* fs);
+
+#define MEMORY_STREAM_CHUNK_SIZE_DEFAULT (64 * 1024)
+
+    /// Opens empty memory stream which stores data in a list of 'chunkSize' blocks.
+    /// Unlike fsOpenStreamFromMemory, growing never copies written data.
+    /// 0 'chunkSize' uses MEMORY_STREAM_CHUNK_SIZE_DEFAULT.
+    /// Can only be memory mapped while it fits into a single chunk, use fsGetMemoryStreamChunks instead.
+    FORGE_API bool fsOpenChunkedMemoryStream(size_t chunkSize, FileMode mode, FileStream* pOut);
+
+    typedef struct MemoryStreamChunk
+    {
+        const void* pData;
+        size_t      mSize;
+    } MemoryStreamChunk;
+
+    /// Zero-copy access to memory stream data (scatter/gather).
+    /// Works for both memory stream kinds, fsOpenStreamFromMemory stream is a single chunk.
+    /// Fills up to 'maxChunks' of 'pOutChunks' starting from 'firstChunk'.
+    /// Returns total chunk count, 0 if stream is not a memory stream.
+    /// Chunks are valid until next write or close.
+    FORGE_API size_t fsGetMemoryStreamChunks(FileStream* fs, size_t firstChunk, size_t maxChunks, MemoryStreamChunk* pOutChunks);
+
+    /// Writes all memory stream chunks to 'dst' without flattening them.
+    /// Cursor of 'src' is not affected. Returns number of bytes written.
+    FORGE_API size_t fsWriteMemoryStreamToStream(FileStream* src, FileStream* dst);
 
     /// symbolsCount can be SIZE_MAX, then reads until the end of file
     /// appends '\0' to the end of string
@@ -452,6 +479,11 @@ extern "C"
         // is large enough for compression to be effective.
         BUNYAR_FILE_FORMAT_LZ4_BLOCKS = 3,
         BUNYAR_FILE_FORMAT_ZSTD_BLOCKS = 5,
+        // Same as BUNYAR_FILE_FORMAT_ZSTD_BLOCKS, but every block is compressed
+        // using archive-wide dictionary. Dictionary is located by
+        // BunyArHeader::zstdDictionaryPointer.
+        // Effective for large amount of small similar files (shaders, materials, scripts).
+        BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS = 6,
     };
 
     static const uint8_t BUNYAR_MAGIC[16] = {
@@ -487,6 +519,9 @@ extern "C"
         uint32_t actual;     // archive version
     };
 
+// BunyArHeader::zstdDictionaryPointer is valid
+#define BUNYAR_HEADER_FLAG_ZSTD_DICTIONARY ((uint64_t)1 << 0)
+
     struct BunyArHeader
     {
         // ARCHIVE_MAGIC
@@ -494,7 +529,7 @@ extern "C"
 
         struct BunyArVersion version;
 
-        // 0, reserved
+        // BUNYAR_HEADER_FLAG_*
         uint64_t flags;
 
         // nodeCount = nodesPointer.size / sizeof(BunyArNode)
@@ -509,6 +544,12 @@ extern "C"
         struct BunyArPointer64 hashTablePointer;
 
         // header can be extended in the future by new variables or pointers
+        // Extensions are only valid if the corresponding flag is set,
+        // because older archives have no space reserved for them.
+
+        // Raw content zstd dictionary shared by BUNYAR_FILE_FORMAT_ZSTD_DICT_BLOCKS nodes.
+        // Valid if BUNYAR_HEADER_FLAG_ZSTD_DICTIONARY is set.
+        struct BunyArPointer64 zstdDictionaryPointer;
     };
 
     struct BunyArNode
@@ -587,24 +628,63 @@ extern "C"
         return true;
     }
 
+    enum BunyArHashTableType
+    {
+        // Perfect hash function with per-bucket salts.
+        // Slow to construct, lookup is at most 2 slot reads.
+        BUNYAR_HASH_TABLE_TYPE_PERFECT = 0,
+        // Open addressing with groups of 16 control bytes (7 bits of hash each),
+        // groups are probed using SSE2/NEON. Fast to construct.
+        BUNYAR_HASH_TABLE_TYPE_SWISS = 1,
+        BUNYAR_HASH_TABLE_TYPE_COUNT,
+    };
+
+#define BUNYAR_HASH_TABLE_SWISS_GROUP_SIZE 16
+
     struct BunyArHashTable
     {
-        uint64_t reserved; // 0 "magic" for later
+        uint64_t type; // enum BunyArHashTableType
         uint64_t seed;
         uint64_t tableSlotCount;
 
         // table is located after header
-        // uint64_t table[tableSlotCount];
+        // BUNYAR_HASH_TABLE_TYPE_PERFECT:
+        //   uint64_t table[tableSlotCount];
+        // BUNYAR_HASH_TABLE_TYPE_SWISS (tableSlotCount is power of 2 multiple of group size):
+        //   uint8_t  control[tableSlotCount];
+        //   uint32_t table[tableSlotCount];
     };
 
     // user must deallocate returned pointer using tf_free
     FORGE_API struct BunyArHashTable* bunyArHashTableConstruct(uint64_t nodeCount, const struct BunyArNode* nodes, const char* nodeNames);
 
+    FORGE_API struct BunyArHashTable* bunyArHashTableConstructType(enum BunyArHashTableType type, uint64_t nodeCount,
+                                                                   const struct BunyArNode* nodes, const char* nodeNames);
+
     // In case value >= nodeCount is returned, node by that name is not found
     FORGE_API uint64_t bunyArHashTableLookup(const struct BunyArHashTable* ht, const char* name, uint64_t nodeCount,
                                              const struct BunyArNode* nodes, const char* nodeNames);
 
-    static inline uint64_t bunyArHashTableSize(const struct BunyArHashTable* ht) { return ht ? ht->tableSlotCount * 8 + sizeof(*ht) : 0; }
+    FORGE_API const char* bunyArHashTableTypeName(enum BunyArHashTableType type);
+
+    // 0 for unknown or malformed table
+    static inline uint64_t bunyArHashTableSize(const struct BunyArHashTable* ht)
+    {
+        if (!ht)
+            return 0;
+
+        switch (ht->type)
+        {
+        case BUNYAR_HASH_TABLE_TYPE_PERFECT:
+            return ht->tableSlotCount * 8 + sizeof(*ht);
+        case BUNYAR_HASH_TABLE_TYPE_SWISS:
+            if (ht->tableSlotCount < BUNYAR_HASH_TABLE_SWISS_GROUP_SIZE || (ht->tableSlotCount & (ht->tableSlotCount - 1)))
+                return 0;
+            return ht->tableSlotCount * (1 + sizeof(uint32_t)) + sizeof(*ht);
+        default:
+            return 0;
+        }
+    }
 
     /************************************************************************/
     // MARK: - Advanced Buny Archive file system IO
@@ -614,6 +694,8 @@ extern "C"
     {
         uint64_t                      nodeCount;
         const struct BunyArHashTable* hashTable;
+        // 0 if archive has no zstd dictionary
+        uint64_t                      zstdDictionarySize;
     };
 
     struct BunyArNodeDescription
@@ -638,6 +720,56 @@ extern "C"
     FORGE_API bool fsArchiveGetFileBlockMetadata(FileStream* pFile, struct BunyArBlockFormatHeader* outHeader,
                                                  const BunyArBlockPointer** outBlockPtrs);
 
+    /************************************************************************/
+    // MARK: - Buny Archive access recording and prefetching
+    /************************************************************************/
+
+    // Read of uncompressed file range
+    struct BunyArAccessRecord
+    {
+        uint64_t nodeId;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct BunyArPrefetchStats
+    {
+        // Archive ranges passed to the OS (or read) after sorting and merging
+        uint64_t rangeCount;
+        uint64_t byteCount;
+        // Records which don't match archive nodes
+        uint64_t recordsSkipped;
+    };
+
+    // Starts logging of file reads (node, offset, size) in the order they happen.
+    // Previously recorded accesses are discarded.
+    // Must not be called while archive files are being read by other threads.
+    FORGE_API bool fsArchiveBeginAccessRecording(IFileSystem* pArchive);
+    FORGE_API void fsArchiveEndAccessRecording(IFileSystem* pArchive);
+
+    // Returned records are valid until the next fsArchiveBeginAccessRecording or fsArchiveClose.
+    // Don't call it while recording is active.
+    FORGE_API uint64_t fsArchiveGetAccessRecords(IFileSystem* pArchive, const struct BunyArAccessRecord** outRecords);
+
+    // Recording refers to nodes by name, so it stays usable after the archive is rebuilt.
+    FORGE_API bool fsArchiveWriteAccessRecording(IFileSystem* pArchive, FileStream* pDst);
+
+    // Converts records to compressed archive ranges, sorts them by archive offset and merges
+    // neighbours, so that cold loads turn into mostly sequential I/O.
+    // Memory archives are hinted with madvise, system file streams with posix_fadvise.
+    // Elsewhere ranges are read through the archive stream to warm the OS file cache.
+    //
+    // Can run on a worker thread concurrently with file reads
+    // if archive is in memory mode or ArchiveOpenDesc::protectStreamCriticalSection is set.
+    //
+    // 'outStats' can be NULL
+    FORGE_API bool fsArchivePrefetch(IFileSystem* pArchive, uint64_t recordCount, const struct BunyArAccessRecord* pRecords,
+                                     struct BunyArPrefetchStats* outStats);
+
+    // Reads recording written by fsArchiveWriteAccessRecording and prefetches it.
+    // Names which are missing in the archive are skipped.
+    FORGE_API bool fsArchivePrefetchFromStream(IFileSystem* pArchive, FileStream* pRecording, struct BunyArPrefetchStats* outStats);
+
     /************************************************************************/
     /************************************************************************/
 
@@ -129,6 +129,15 @@ extern "C"
 #define RAW_LOGF_IF(log_level, condition, ...) \
     ((condition) ? writeRawLog((log_level), false, __VA_ARGS__) : (void)sizeof(condition)) //-V568
 
+// Usage: LOGB(LogLevel::eDEBUG, "Streamed %u bytes of %s", size, name)
+// Writes to the binary log (see initBinaryLog), formatting happens offline. Format has to be a string literal, %s arguments are copied
+#define LOGB(log_level, ...)                                                               \
+    do                                                                                     \
+    {                                                                                      \
+        static uint32_t binaryLogFormatId = 0;                                             \
+        writeBinaryLog(&binaryLogFormatId, (log_level), __FILE__, __LINE__, __VA_ARGS__); \
+    } while (0)
+
 #if defined(FORGE_DEBUG)
 
 // Usage: DLOGF(LogLevel::eINFO | LogLevel::eDEBUG, "Whatever string %s, this is an int %d", "This is a string", 1)
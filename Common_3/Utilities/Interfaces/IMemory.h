@@ -61,6 +61,89 @@ typedef struct MemoryStatistics
 } MemoryStatistics;
 #endif
 
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+// Allocations and frees of one tf_malloc callsite, summed over all threads
+typedef struct MemoryCallsite
+{
+    const char* file;
+    const char* function;
+    uint32_t    line;
+    uint64_t    allocCount;
+    uint64_t    freeCount;
+    // Bytes of blocks which are still alive
+    uint64_t    currentBytes;
+    // Bytes allocated since start
+    uint64_t    totalBytes;
+} MemoryCallsite;
+
+// Live block picked by sampling, see memSetSampleRate
+typedef struct MemorySample
+{
+    const void* ptr;
+    uint64_t    size;
+    // Order in which samples were taken, higher is newer
+    uint64_t    sequence;
+    // Index into MemorySnapshot::pCallsites
+    uint32_t    callsite;
+} MemorySample;
+
+typedef struct MemorySnapshot
+{
+    MemoryCallsite* pCallsites;
+    uint32_t        callsiteCount;
+    MemorySample*   pSamples;
+    uint32_t        sampleCount;
+    uint64_t        allocCount;
+    uint64_t        freeCount;
+    uint64_t        currentBytes;
+    uint64_t        totalBytes;
+} MemorySnapshot;
+#endif
+
+// Frame arena: per-thread linear allocator for transient data which is only used until the end of the frame.
+// Allocations are never freed one by one, tf_frame_arena_end_frame releases all of them at once.
+// Each thread lazily resets its own arena on its first allocation in a new frame,
+// so pointers stay valid until the allocating thread allocates again after the frame ended.
+typedef struct FrameArenaStatistics
+{
+    // Number of tf_frame_arena_end_frame calls
+    uint64_t frameIndex;
+    // Threads which allocated from a frame arena
+    uint32_t arenaCount;
+    // Bytes used by the calling thread in current frame
+    uint64_t threadUsed;
+    // High-water mark, most bytes a single thread used in a single frame
+    uint64_t peakUsed;
+    // Bytes currently held by all arenas
+    uint64_t reserved;
+    // Allocations which did not fit and went to an extra block
+    uint64_t overflowCount;
+} FrameArenaStatistics;
+
+// Memory tags: allocations are counted under the tag on top of the calling thread's tag stack,
+// frees are counted under the tag the block was allocated with. See MEMORY_TAG_SCOPE.
+typedef enum MemoryTag
+{
+    MEMORY_TAG_UNTAGGED = 0,
+    MEMORY_TAG_RESOURCE_LOADER,
+    MEMORY_TAG_UI,
+    MEMORY_TAG_FONTS,
+    // memTagRegister hands out tags from here on
+    MEMORY_TAG_BUILTIN_COUNT,
+    MEMORY_TAG_MAX_COUNT = 64,
+} MemoryTag;
+
+typedef struct MemoryTagStatistics
+{
+    const char* pName;
+    uint64_t    liveBytes;
+    uint64_t    peakBytes;
+    uint64_t    liveCount;
+    uint64_t    allocCount;
+    // 0 if the tag has no budget
+    uint64_t    budgetBytes;
+} MemoryTagStatistics;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -68,11 +151,21 @@ extern "C"
     // appName is used to create dump file, pass NULL to avoid it
     FORGE_API bool initMemAlloc(const char* appName);
     FORGE_API void exitMemAlloc(void);
+    // Releases per-thread caches of the calling thread, called by the thread wrapper of initThread when a thread function returns
+    FORGE_API void exitMemAllocThread(void);
 
 #ifdef ENABLE_MEMORY_TRACKING
     FORGE_API MemoryStatistics memGetStatistics(void);
 #endif
 
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+    // Samples every Nth allocation of each thread, 0 disables sampling
+    FORGE_API void memSetSampleRate(uint32_t rate);
+    // Counters are read while other threads keep allocating, totals are only exact when they are idle
+    FORGE_API bool memTakeSnapshot(MemorySnapshot* pSnapshot);
+    FORGE_API void memFreeSnapshot(MemorySnapshot* pSnapshot);
+#endif
+
     FORGE_API void* tf_malloc_internal(size_t size, const char* f, int l, const char* sf);
     FORGE_API void* tf_memalign_internal(size_t align, size_t size, const char* f, int l, const char* sf);
     FORGE_API void* tf_calloc_internal(size_t count, size_t size, const char* f, int l, const char* sf);
@@ -80,6 +173,26 @@ extern "C"
     FORGE_API void* tf_realloc_internal(void* ptr, size_t size, const char* f, int l, const char* sf);
     FORGE_API void  tf_free_internal(void* ptr, const char* f, int l, const char* sf);
 
+    FORGE_API void* tf_frame_memalign_internal(size_t align, size_t size, const char* f, int l, const char* sf);
+    FORGE_API void* tf_frame_calloc_memalign_internal(size_t count, size_t align, size_t size, const char* f, int l, const char* sf);
+    // Called once per frame, after all users of previous frame allocations are done
+    FORGE_API void  tf_frame_arena_end_frame(void);
+    // Releases arena of the calling thread right away, for threads which exit or go idle for a long time
+    FORGE_API void  tf_frame_arena_exit_thread(void);
+    FORGE_API FrameArenaStatistics tf_frame_arena_get_statistics(void);
+
+#if defined(ENABLE_MEMORY_TAGS)
+    // Returns the tag which was registered with the same name before, name has to outlive the tag
+    FORGE_API uint32_t memTagRegister(const char* name);
+    // Soft budget, logs a warning (and asserts if requested) when live bytes of the tag go over it. 0 removes the budget.
+    FORGE_API void     memTagSetBudget(uint32_t tag, uint64_t budgetBytes, bool assertOverBudget);
+    FORGE_API void     memTagPush(uint32_t tag);
+    FORGE_API void     memTagPop(void);
+    FORGE_API uint32_t memTagCount(void);
+    // Other threads publish their changes in batches, their most recent allocations may not show up yet
+    FORGE_API MemoryTagStatistics memTagGetStatistics(uint32_t tag);
+#endif
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -109,6 +222,26 @@ static void tf_delete_internal(T* ptr, const char* f, int l, const char* sf)
 }
 #endif
 
+#define MEMORY_TAG_PASTE_INTERNAL(a, b) a##b
+#define MEMORY_TAG_PASTE(a, b)          MEMORY_TAG_PASTE_INTERNAL(a, b)
+
+#if defined(ENABLE_MEMORY_TAGS)
+#define MEMORY_TAG_PUSH(tag) memTagPush(tag)
+#define MEMORY_TAG_POP()     memTagPop()
+#ifdef __cplusplus
+struct MemoryTagScope
+{
+    MemoryTagScope(uint32_t tag) { memTagPush(tag); }
+    ~MemoryTagScope() { memTagPop(); }
+};
+#define MEMORY_TAG_SCOPE(tag) MemoryTagScope MEMORY_TAG_PASTE(memoryTagScope, __LINE__)(tag)
+#endif
+#else
+#define MEMORY_TAG_PUSH(tag)
+#define MEMORY_TAG_POP()
+#define MEMORY_TAG_SCOPE(tag)
+#endif
+
 #ifndef tf_malloc
 #define tf_malloc(size) tf_malloc_internal(size, __FILE__, __LINE__, __FUNCTION__)
 #endif
@@ -128,6 +261,16 @@ static void tf_delete_internal(T* ptr, const char* f, int l, const char* sf)
 #define tf_free(ptr) tf_free_internal(ptr, __FILE__, __LINE__, __FUNCTION__)
 #endif
 
+#ifndef tf_frame_malloc
+#define tf_frame_malloc(size) tf_frame_memalign_internal(0, size, __FILE__, __LINE__, __FUNCTION__)
+#endif
+#ifndef tf_frame_memalign
+#define tf_frame_memalign(align, size) tf_frame_memalign_internal(align, size, __FILE__, __LINE__, __FUNCTION__)
+#endif
+#ifndef tf_frame_calloc
+#define tf_frame_calloc(count, size) tf_frame_calloc_memalign_internal(count, 0, size, __FILE__, __LINE__, __FUNCTION__)
+#endif
+
 #ifdef __cplusplus
 #ifndef tf_new
 #define tf_new(ObjectType, ...) tf_new_internal<ObjectType>(__FILE__, __LINE__, __FUNCTION__, ##__VA_ARGS__)
@@ -92,12 +92,33 @@ extern "C"
 #else
     pthread_mutex_t pHandle;
     uint32_t        mSpinCount;
+#if defined(__linux__) && !defined(__ANDROID__)
+    // Futex lock state: 0 unlocked, 1 locked, 2 locked and somebody may sleep
+    volatile uint32_t mFutex;
+    volatile uint32_t mOwner;
+    uint32_t          mRecursion;
+    bool              mFutexMutex;
+#endif
 #endif
     } Mutex;
 
-#define MUTEX_DEFAULT_SPIN_COUNT 1500
+#define MUTEX_DEFAULT_SPIN_COUNT       1500
+#define MUTEX_FUTEX_DEFAULT_SPIN_COUNT 100
 
+    typedef struct MutexDesc
+    {
+        // Attempts to take the lock before sleeping, 0 for default
+        uint32_t spinCount;
+        // Linux only, ignored elsewhere.
+        // Lock word in user space: uncontended acquire/release is a single atomic each,
+        // contended acquire spins with cpu pause and then sleeps on futex.
+        // Meant for short critical sections where sleeping in kernel costs more than the protected work.
+        bool     futex;
+    } MutexDesc;
+
+    // Same as initMutexDesc with default desc
     FORGE_API bool initMutex(Mutex* pMutex);
+    FORGE_API bool initMutexDesc(Mutex* pMutex, const MutexDesc* pDesc);
     FORGE_API void exitMutex(Mutex* pMutex);
 
     FORGE_API void acquireMutex(Mutex* pMutex);
@@ -112,16 +133,44 @@ extern "C"
     ConditionVariableTypeNX mCondPlatformNX;
 #else
     pthread_cond_t  pHandle;
+#if defined(__linux__) && !defined(__ANDROID__)
+    // Futex condition: incremented by every wake
+    volatile uint32_t mSequence;
+    volatile uint32_t mWaiterCount;
+    bool              mFutexCondition;
+#endif
 #endif
     } ConditionVariable;
 
+    typedef struct ConditionVariableDesc
+    {
+        // Linux only, ignored elsewhere.
+        // Sleeps on futex, wakes are free when nobody waits and timed waits are precise.
+        // Works with any Mutex, while OS condition variable can't be used with futex Mutex.
+        bool futex;
+    } ConditionVariableDesc;
+
     FORGE_API bool initConditionVariable(ConditionVariable* cv);
+    FORGE_API bool initConditionVariableDesc(ConditionVariable* cv, const ConditionVariableDesc* pDesc);
     FORGE_API void exitConditionVariable(ConditionVariable* cv);
 
     FORGE_API void waitConditionVariable(ConditionVariable* cv, Mutex* pMutex, uint32_t msTimeout);
     FORGE_API void wakeOneConditionVariable(ConditionVariable* cv);
     FORGE_API void wakeAllConditionVariable(ConditionVariable* cv);
 
+    /*
+     * Brief:
+     *   Futex style wait on 32 bit value: blocks while *address == expected,
+     *   until one of wake*Address(address) is called or msTimeout is elapsed.
+     * Notes:
+     *   Returns immediately if value is already different. Spurious wakeups are possible,
+     *   so callers must recheck their condition in a loop.
+     *   Waker has to change the value before waking, otherwise the wakeup can be lost.
+     */
+    FORGE_API void waitAddress(volatile uint32_t* address, uint32_t expected, uint32_t msTimeout);
+    FORGE_API void wakeOneAddress(volatile uint32_t* address);
+    FORGE_API void wakeAllAddress(volatile uint32_t* address);
+
     typedef void (*ThreadFunction)(void*);
 
     /// Work queue item.
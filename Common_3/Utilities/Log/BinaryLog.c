@@ -0,0 +1,627 @@
+/*
+ * Copyright (c) 2017-2024 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "Log.h"
+
+#include "../../Application/Config.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef ENABLE_LOGGING
+#include "../../Utilities/Interfaces/IFileSystem.h"
+#include "../../Utilities/Interfaces/ILog.h"
+#include "../../Utilities/Interfaces/IThread.h"
+#include "../../Utilities/Interfaces/ITime.h"
+#include "../../Utilities/Threading/Atomics.h"
+
+#include "../../Utilities/Interfaces/IMemory.h"
+
+// Binary log file layout, all values little endian. Decoded by Common_3/Tools/BinaryLogDecoder/binary_log_decoder.py
+//
+// Header:  char magic[8] "TFBLOG\0\0", uint32 version, uint32 reserved, int64 start getUSec, int64 start time_t
+// Chunk:   uint32 type, uint32 size, 'size' bytes of payload
+//   BINARY_LOG_CHUNK_FORMAT:  uint16 id, uint16 level, uint32 line, uint16 file length, uint16 format length, uint8 arg count,
+//                             uint8 arg types[arg count], file name, format string
+//   BINARY_LOG_CHUNK_RECORDS: uint64 thread id, char thread name[32], records until the end of the chunk
+// Record:  int64 getUSec, uint16 format id, uint16 level, arguments packed by type, strings as uint16 length + characters
+#define BINARY_LOG_MAGIC   "TFBLOG\0\0"
+#define BINARY_LOG_VERSION 1
+
+// Records a thread buffers before they are written to the file
+#ifndef BINARY_LOG_BUFFER_SIZE
+#define BINARY_LOG_BUFFER_SIZE (16 * 1024)
+#endif
+// Call sites which can log to the binary log, later ones fall back to the text log
+#ifndef BINARY_LOG_MAX_FORMATS
+#define BINARY_LOG_MAX_FORMATS 1024
+#endif
+#define BINARY_LOG_MAX_ARGS        16
+// Longer %s arguments are truncated
+#define BINARY_LOG_MAX_STRING      255
+#define BINARY_LOG_RECORD_HEADER   12
+#define BINARY_LOG_THREAD_NAME     32
+// Format id of call sites which didn't fit the format table
+#define BINARY_LOG_FORMAT_OVERFLOW UINT32_MAX
+
+typedef enum BinaryLogChunkType
+{
+    BINARY_LOG_CHUNK_FORMAT = 1,
+    BINARY_LOG_CHUNK_RECORDS = 2,
+} BinaryLogChunkType;
+
+typedef enum BinaryLogArgType
+{
+    BINARY_LOG_ARG_INT32 = 1,
+    BINARY_LOG_ARG_INT64 = 2,
+    BINARY_LOG_ARG_DOUBLE = 3,
+    BINARY_LOG_ARG_POINTER = 4,
+    BINARY_LOG_ARG_STRING = 5,
+} BinaryLogArgType;
+
+typedef struct BinaryLogFormat
+{
+    const char* pFormat;
+    const char* pFile;
+    uint32_t    mLine;
+    uint32_t    mLevel;
+    // Largest record this format can produce
+    uint32_t    mMaxRecordSize;
+    uint8_t     mArgCount;
+    // Format uses conversions which can't be stored, call site logs as text instead
+    bool        mText;
+    uint8_t     mArgTypes[BINARY_LOG_MAX_ARGS];
+} BinaryLogFormat;
+
+typedef struct BinaryLogBuffer
+{
+    // Buffers are never freed while the binary log is open, buffers of exited threads are reused by new ones
+    struct BinaryLogBuffer* pNext;
+    tfrg_atomic32_t         mOwned;
+    // Held by the owner while it adds a record, and by flushBinaryLog
+    tfrg_atomic32_t         mLock;
+    uint64_t                mThreadId;
+    char                    mThreadName[BINARY_LOG_THREAD_NAME];
+    uint32_t                mSize;
+    uint8_t                 mData[BINARY_LOG_BUFFER_SIZE];
+} BinaryLogBuffer;
+
+typedef struct BinaryLog
+{
+    FileStream       mFile;
+    // Mask of LogLevel bits, 0 while the binary log is closed
+    tfrg_atomic32_t  mLevel;
+    // Protects the file and format registration
+    Mutex            mMutex;
+    tfrg_atomicptr_t pBuffers;
+    // Changes when buffers are freed, buffer pointers of threads from before are stale
+    tfrg_atomic32_t  mEpoch;
+    // Calls using the buffers or the file, exitBinaryLog frees them once none is left
+    tfrg_atomic32_t  mInFlight;
+    // Formats stay registered between sessions, call sites keep their ids
+    uint32_t         mFormatCount;
+    BinaryLogFormat  mFormats[BINARY_LOG_MAX_FORMATS];
+} BinaryLog;
+
+static BinaryLog gBinaryLog;
+
+static THREAD_LOCAL BinaryLogBuffer* pThreadBinaryLogBuffer = NULL;
+static THREAD_LOCAL uint32_t         gThreadBinaryLogEpoch = 0;
+
+static const char* getBinaryLogFilename(const char* path)
+{
+    for (const char* ptr = path; *ptr != '\0'; ++ptr)
+    {
+        if (*ptr == '/' || *ptr == '\\')
+            path = ptr + 1;
+    }
+    return path;
+}
+
+static uint32_t binaryLogArgSize(uint8_t type)
+{
+    switch (type)
+    {
+    case BINARY_LOG_ARG_INT32:
+        return 4;
+    case BINARY_LOG_ARG_STRING:
+        return 2 + BINARY_LOG_MAX_STRING;
+    default:
+        return 8;
+    }
+}
+
+// Finds the argument type of every conversion, returns false for conversions the decoder can't reproduce
+static bool parseBinaryLogFormat(const char* format, BinaryLogFormat* pOut)
+{
+    pOut->mArgCount = 0;
+    for (const char* c = format; *c; ++c)
+    {
+        if (*c != '%')
+            continue;
+        if (*++c == '%')
+            continue;
+
+        while (*c == '-' || *c == '+' || *c == ' ' || *c == '#' || *c == '0')
+            ++c;
+
+        // Width and precision given as arguments are ints
+        uint32_t starCount = 0;
+        if (*c == '*')
+        {
+            ++starCount;
+            ++c;
+        }
+        while (*c >= '0' && *c <= '9')
+            ++c;
+        if (*c == '.')
+        {
+            ++c;
+            if (*c == '*')
+            {
+                ++starCount;
+                ++c;
+            }
+            while (*c >= '0' && *c <= '9')
+                ++c;
+        }
+
+        const char* length = c;
+        size_t      intSize = sizeof(int);
+        bool        longDouble = false;
+        if (c[0] == 'h')
+            c += c[1] == 'h' ? 2 : 1;
+        else if (c[0] == 'l' && c[1] == 'l')
+        {
+            intSize = sizeof(long long);
+            c += 2;
+        }
+        else if (c[0] == 'l')
+        {
+            intSize = sizeof(long);
+            ++c;
+        }
+        else if (c[0] == 'j' || c[0] == 'q')
+        {
+            intSize = sizeof(long long);
+            ++c;
+        }
+        else if (c[0] == 'z' || c[0] == 't')
+        {
+            intSize = sizeof(size_t);
+            ++c;
+        }
+        else if (c[0] == 'I' && c[1] == '6' && c[2] == '4')
+        {
+            intSize = sizeof(long long);
+            c += 3;
+        }
+        else if (c[0] == 'L')
+        {
+            longDouble = true;
+            ++c;
+        }
+
+        uint8_t type = 0;
+        switch (*c)
+        {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            type = intSize > 4 ? BINARY_LOG_ARG_INT64 : BINARY_LOG_ARG_INT32;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+            // %a has no Python % conversion, those call sites stay text
+            type = longDouble ? 0 : BINARY_LOG_ARG_DOUBLE;
+            break;
+        case 'p':
+            type = BINARY_LOG_ARG_POINTER;
+            break;
+        case 's':
+            // Wide strings are not supported
+            type = c == length ? BINARY_LOG_ARG_STRING : 0;
+            break;
+        default:
+            break;
+        }
+
+        if (!type || pOut->mArgCount + starCount + 1 > BINARY_LOG_MAX_ARGS)
+            return false;
+
+        for (uint32_t i = 0; i < starCount; ++i)
+            pOut->mArgTypes[pOut->mArgCount++] = BINARY_LOG_ARG_INT32;
+        pOut->mArgTypes[pOut->mArgCount++] = type;
+    }
+
+    pOut->mMaxRecordSize = BINARY_LOG_RECORD_HEADER;
+    for (uint32_t i = 0; i < pOut->mArgCount; ++i)
+        pOut->mMaxRecordSize += binaryLogArgSize(pOut->mArgTypes[i]);
+    return true;
+}
+
+// Called with mMutex held. A chunk is its type and size, followed by the parts back to back
+static void writeBinaryLogChunk(uint32_t type, uint32_t partCount, const void* const* ppParts, const uint32_t* pPartSizes)
+{
+    uint32_t chunk[2] = { type, 0 };
+    for (uint32_t i = 0; i < partCount; ++i)
+        chunk[1] += pPartSizes[i];
+
+    fsWriteToStream(&gBinaryLog.mFile, chunk, sizeof(chunk));
+    for (uint32_t i = 0; i < partCount; ++i)
+    {
+        if (pPartSizes[i])
+            fsWriteToStream(&gBinaryLog.mFile, ppParts[i], pPartSizes[i]);
+    }
+}
+
+// Called with mMutex held
+static void writeBinaryLogFormat(uint32_t id)
+{
+    const BinaryLogFormat* format = gBinaryLog.mFormats + id;
+    if (format->mText)
+        return;
+
+    // id, level, line, file length, format length, arg count, arg types
+    uint8_t  header[13 + BINARY_LOG_MAX_ARGS];
+    uint16_t fileLength = (uint16_t)strlen(format->pFile);
+    uint16_t formatLength = (uint16_t)strlen(format->pFormat);
+    uint16_t id16 = (uint16_t)id;
+    uint16_t level16 = (uint16_t)format->mLevel;
+    memcpy(header + 0, &id16, 2);
+    memcpy(header + 2, &level16, 2);
+    memcpy(header + 4, &format->mLine, 4);
+    memcpy(header + 8, &fileLength, 2);
+    memcpy(header + 10, &formatLength, 2);
+    header[12] = format->mArgCount;
+    memcpy(header + 13, format->mArgTypes, format->mArgCount);
+
+    const void*    parts[] = { header, format->pFile, format->pFormat };
+    const uint32_t partSizes[] = { 13u + format->mArgCount, fileLength, formatLength };
+    writeBinaryLogChunk(BINARY_LOG_CHUNK_FORMAT, 3, parts, partSizes);
+}
+
+static uint32_t registerBinaryLogFormat(uint32_t* pFormatId, uint32_t level, const char* filename, int line_number, const char* message)
+{
+    acquireMutex(&gBinaryLog.mMutex);
+
+    // Another thread could have registered the call site meanwhile
+    uint32_t id = tfrg_atomic32_load_relaxed((tfrg_atomic32_t*)pFormatId);
+    if (!id)
+    {
+        if (gBinaryLog.mFormatCount < BINARY_LOG_MAX_FORMATS)
+        {
+            BinaryLogFormat* format = gBinaryLog.mFormats + gBinaryLog.mFormatCount;
+            memset(format, 0, sizeof(*format));
+            format->pFormat = message;
+            format->pFile = getBinaryLogFilename(filename);
+            format->mLine = (uint32_t)line_number;
+            format->mLevel = level;
+            format->mText = !parseBinaryLogFormat(message, format);
+
+            writeBinaryLogFormat(gBinaryLog.mFormatCount);
+            id = ++gBinaryLog.mFormatCount;
+        }
+        else
+        {
+            id = BINARY_LOG_FORMAT_OVERFLOW;
+        }
+        tfrg_atomic32_store_release((tfrg_atomic32_t*)pFormatId, id);
+    }
+
+    releaseMutex(&gBinaryLog.mMutex);
+    return id;
+}
+
+static void lockBinaryLogBuffer(BinaryLogBuffer* buffer)
+{
+    // Only contended while flushBinaryLog writes the buffer out
+    while (tfrg_atomic32_cas_acq_rel(&buffer->mLock, 0, 1) != 0)
+        threadSleep(0);
+}
+
+static void unlockBinaryLogBuffer(BinaryLogBuffer* buffer) { tfrg_atomic32_store_release(&buffer->mLock, 0); }
+
+// Called with the buffer locked
+static void flushBinaryLogBuffer(BinaryLogBuffer* buffer)
+{
+    if (!buffer->mSize)
+        return;
+
+    uint8_t header[8 + BINARY_LOG_THREAD_NAME];
+    memcpy(header, &buffer->mThreadId, 8);
+    memcpy(header + 8, buffer->mThreadName, BINARY_LOG_THREAD_NAME);
+
+    acquireMutex(&gBinaryLog.mMutex);
+    const void*    parts[] = { header, buffer->mData };
+    const uint32_t partSizes[] = { sizeof(header), buffer->mSize };
+    writeBinaryLogChunk(BINARY_LOG_CHUNK_RECORDS, 2, parts, partSizes);
+    releaseMutex(&gBinaryLog.mMutex);
+    buffer->mSize = 0;
+}
+
+static BinaryLogBuffer* getThreadBinaryLogBuffer(void)
+{
+    BinaryLogBuffer* buffer = pThreadBinaryLogBuffer;
+    uint32_t         epoch = tfrg_atomic32_load_relaxed(&gBinaryLog.mEpoch);
+    if (buffer && gThreadBinaryLogEpoch == epoch)
+        return buffer;
+
+    gThreadBinaryLogEpoch = epoch;
+    for (buffer = (BinaryLogBuffer*)tfrg_atomicptr_load_acquire(&gBinaryLog.pBuffers); buffer; buffer = buffer->pNext)
+    {
+        if (!tfrg_atomic32_load_relaxed(&buffer->mOwned) && tfrg_atomic32_cas_acq_rel(&buffer->mOwned, 0, 1) == 0)
+            break;
+    }
+
+    if (!buffer)
+    {
+        buffer = (BinaryLogBuffer*)tf_calloc(1, sizeof(BinaryLogBuffer));
+        if (!buffer)
+            return NULL;
+        buffer->mOwned = 1;
+
+        uintptr_t head = tfrg_atomicptr_load_relaxed(&gBinaryLog.pBuffers);
+        for (;;)
+        {
+            buffer->pNext = (BinaryLogBuffer*)head;
+            uintptr_t prev = tfrg_atomicptr_cas_acq_rel(&gBinaryLog.pBuffers, head, (uintptr_t)buffer);
+            if (prev == head)
+                break;
+            head = prev;
+        }
+    }
+
+    // Records of the previous owner were written out when it exited
+    buffer->mThreadId = (uint64_t)getCurrentThreadID();
+    memset(buffer->mThreadName, 0, BINARY_LOG_THREAD_NAME);
+    getCurrentThreadName(buffer->mThreadName, BINARY_LOG_THREAD_NAME);
+    pThreadBinaryLogBuffer = buffer;
+    return buffer;
+}
+
+static void writeBinaryLogRecord(uint32_t id, uint32_t level, const BinaryLogFormat* format, va_list args)
+{
+    BinaryLogBuffer* buffer = getThreadBinaryLogBuffer();
+    if (!buffer)
+        return;
+
+    lockBinaryLogBuffer(buffer);
+    if (BINARY_LOG_BUFFER_SIZE - buffer->mSize < format->mMaxRecordSize)
+        flushBinaryLogBuffer(buffer);
+
+    uint8_t* dst = buffer->mData + buffer->mSize;
+    int64_t  time = getUSec(false);
+    uint16_t id16 = (uint16_t)id;
+    uint16_t level16 = (uint16_t)level;
+    memcpy(dst, &time, 8);
+    memcpy(dst + 8, &id16, 2);
+    memcpy(dst + 10, &level16, 2);
+    dst += BINARY_LOG_RECORD_HEADER;
+
+    for (uint32_t i = 0; i < format->mArgCount; ++i)
+    {
+        switch (format->mArgTypes[i])
+        {
+        case BINARY_LOG_ARG_INT32:
+        {
+            int value = va_arg(args, int);
+            memcpy(dst, &value, 4);
+            dst += 4;
+            break;
+        }
+        case BINARY_LOG_ARG_INT64:
+        {
+            long long value = va_arg(args, long long);
+            memcpy(dst, &value, 8);
+            dst += 8;
+            break;
+        }
+        case BINARY_LOG_ARG_DOUBLE:
+        {
+            double value = va_arg(args, double);
+            memcpy(dst, &value, 8);
+            dst += 8;
+            break;
+        }
+        case BINARY_LOG_ARG_POINTER:
+        {
+            uint64_t value = (uint64_t)(uintptr_t)va_arg(args, void*);
+            memcpy(dst, &value, 8);
+            dst += 8;
+            break;
+        }
+        case BINARY_LOG_ARG_STRING:
+        {
+            const char* value = va_arg(args, const char*);
+            if (!value)
+                value = "(null)";
+            uint16_t length = 0;
+            while (length < BINARY_LOG_MAX_STRING && value[length])
+                ++length;
+            memcpy(dst, &length, 2);
+            memcpy(dst + 2, value, length);
+            dst += 2 + length;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    buffer->mSize = (uint32_t)(dst - buffer->mData);
+    unlockBinaryLogBuffer(buffer);
+}
+
+// Returns false once the binary log is closed, otherwise leaveBinaryLog has to follow
+static bool enterBinaryLog(void)
+{
+    tfrg_atomic32_add_relaxed(&gBinaryLog.mInFlight, 1);
+    // Pairs with the barrier in exitBinaryLog, either exit sees this call or this call sees the log closed
+    tfrg_memorybarrier_full();
+    if (tfrg_atomic32_load_relaxed(&gBinaryLog.mLevel))
+        return true;
+    tfrg_atomic32_add_relaxed(&gBinaryLog.mInFlight, -1);
+    return false;
+}
+
+static void leaveBinaryLog(void) { tfrg_atomic32_add_acq_rel(&gBinaryLog.mInFlight, -1); }
+
+bool initBinaryLog(const char* filename, uint32_t level)
+{
+    ASSERT(filename);
+    if (tfrg_atomic32_load_relaxed(&gBinaryLog.mLevel))
+        exitBinaryLog();
+
+    if (!fsOpenStreamFromPath(RD_LOG, filename, FM_WRITE, &gBinaryLog.mFile))
+    {
+        LOGF(eERROR, "Failed to open binary log file %s", filename);
+        return false;
+    }
+
+    initMutex(&gBinaryLog.mMutex);
+
+    char     magic[8] = BINARY_LOG_MAGIC;
+    uint32_t version[2] = { BINARY_LOG_VERSION, 0 };
+    // Records store getUSec, the decoder turns them into dates with the start time
+    int64_t  start[2] = { getUSec(false), (int64_t)time(NULL) };
+    fsWriteToStream(&gBinaryLog.mFile, magic, sizeof(magic));
+    fsWriteToStream(&gBinaryLog.mFile, version, sizeof(version));
+    fsWriteToStream(&gBinaryLog.mFile, start, sizeof(start));
+
+    // Call sites registered in a previous session keep their ids
+    for (uint32_t id = 0; id < gBinaryLog.mFormatCount; ++id)
+        writeBinaryLogFormat(id);
+    fsFlushStream(&gBinaryLog.mFile);
+
+    tfrg_atomic32_store_release(&gBinaryLog.mLevel, level);
+    LOGF(eINFO, "Opened binary log file %s", filename);
+    return true;
+}
+
+static void flushBinaryLogBuffers(void)
+{
+    for (BinaryLogBuffer* buffer = (BinaryLogBuffer*)tfrg_atomicptr_load_acquire(&gBinaryLog.pBuffers); buffer; buffer = buffer->pNext)
+    {
+        lockBinaryLogBuffer(buffer);
+        flushBinaryLogBuffer(buffer);
+        unlockBinaryLogBuffer(buffer);
+    }
+
+    acquireMutex(&gBinaryLog.mMutex);
+    fsFlushStream(&gBinaryLog.mFile);
+    releaseMutex(&gBinaryLog.mMutex);
+}
+
+void exitBinaryLog(void)
+{
+    if (!tfrg_atomic32_load_relaxed(&gBinaryLog.mLevel))
+        return;
+
+    tfrg_atomic32_store_release(&gBinaryLog.mLevel, 0);
+    tfrg_memorybarrier_full();
+    // Threads which saw the log open are still writing to their buffers
+    while (tfrg_atomic32_load_acquire(&gBinaryLog.mInFlight))
+        threadSleep(0);
+    flushBinaryLogBuffers();
+
+    BinaryLogBuffer* buffer = (BinaryLogBuffer*)tfrg_atomicptr_store_relaxed(&gBinaryLog.pBuffers, 0);
+    while (buffer)
+    {
+        BinaryLogBuffer* next = buffer->pNext;
+        tf_free(buffer);
+        buffer = next;
+    }
+    pThreadBinaryLogBuffer = NULL;
+    tfrg_atomic32_add_relaxed(&gBinaryLog.mEpoch, 1);
+
+    fsCloseStream(&gBinaryLog.mFile);
+    exitMutex(&gBinaryLog.mMutex);
+}
+
+void flushBinaryLog(void)
+{
+    if (!enterBinaryLog())
+        return;
+    flushBinaryLogBuffers();
+    leaveBinaryLog();
+}
+
+// Called from exitLogThread
+void exitBinaryLogThread(void)
+{
+    BinaryLogBuffer* buffer = pThreadBinaryLogBuffer;
+    if (!buffer || !enterBinaryLog())
+        return;
+    if (gThreadBinaryLogEpoch != tfrg_atomic32_load_relaxed(&gBinaryLog.mEpoch))
+    {
+        leaveBinaryLog();
+        return;
+    }
+
+    lockBinaryLogBuffer(buffer);
+    flushBinaryLogBuffer(buffer);
+    unlockBinaryLogBuffer(buffer);
+
+    pThreadBinaryLogBuffer = NULL;
+    tfrg_atomic32_store_release(&buffer->mOwned, 0);
+    leaveBinaryLog();
+}
+
+void writeBinaryLog(uint32_t* pFormatId, uint32_t level, const char* filename, int line_number, const char* message, ...)
+{
+    // Filtered messages cost a load and a branch
+    if (!(level & tfrg_atomic32_load_relaxed(&gBinaryLog.mLevel)) || !enterBinaryLog())
+        return;
+
+    uint32_t id = tfrg_atomic32_load_acquire((tfrg_atomic32_t*)pFormatId);
+    if (!id)
+        id = registerBinaryLogFormat(pFormatId, level, filename, line_number, message);
+
+    va_list args;
+    va_start(args, message);
+    if (id == BINARY_LOG_FORMAT_OVERFLOW || gBinaryLog.mFormats[id - 1].mText)
+        writeLogVaList(level, filename, line_number, message, args);
+    else
+        writeBinaryLogRecord(id - 1, level, gBinaryLog.mFormats + id - 1, args);
+    va_end(args);
+    leaveBinaryLog();
+}
+
+#else
+bool initBinaryLog(const char* filename, uint32_t level) { return false; }
+void exitBinaryLog(void) {}
+void flushBinaryLog(void) {}
+void exitBinaryLogThread(void) {}
+void writeBinaryLog(uint32_t* pFormatId, uint32_t level, const char* filename, int line_number, const char* message, ...) {}
+#endif
@@ -27,18 +27,31 @@
 #include "../../Application/Config.h"
 
 #include <stdarg.h>
+#include <stddef.h>
 
 #ifdef ENABLE_LOGGING
 #include "../../Utilities/Interfaces/IFileSystem.h"
 #include "../../Utilities/Interfaces/ILog.h"
 #include "../../Utilities/Interfaces/IThread.h"
 #include "../../Utilities/Interfaces/ITime.h"
+#include "../../Utilities/Threading/Atomics.h"
 
 #include "../../Utilities/Interfaces/IMemory.h"
 
 #define LOG_CALLBACK_MAX_ID FS_MAX_PATH
 #define LOG_MAX_BUFFER      1024
 
+// Bytes of formatted messages each thread can have queued in async mode, logging waits for the writer when it is full
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE (64 * 1024)
+#endif
+// Writer thread wakes up on its own this often, earlier when a ring gets half full or an error is logged.
+// Log files are flushed at most this often too.
+#define LOG_WRITER_INTERVAL_MS 10
+// How long flushLog waits for messages which are still being queued, a thread could have died while queueing one
+#define LOG_FLUSH_TIMEOUT_MS   100
+#define LOG_RECORD_ALIGNMENT   16
+
 typedef struct LogCallback
 {
     char          mID[LOG_CALLBACK_MAX_ID];
@@ -62,6 +75,33 @@ static void initLogCallback(LogCallback* pLogCallback, const char* id, void* pUs
     pLogCallback->mLevel = level;
 }
 
+// Message queued in a LogRing, text follows the header
+typedef struct LogRecord
+{
+    uint64_t mSequence;
+    uint32_t mLevel;
+    // Text size including terminator
+    uint16_t mSize;
+    uint8_t  mError;
+    // Rest of the ring up to its end is unused
+    uint8_t  mPadding;
+} LogRecord;
+
+// Single producer single consumer byte ring of a thread. Rings are never freed while async mode is on,
+// rings of exited threads are reused by new ones.
+typedef struct LogRing
+{
+    struct LogRing* pNext;
+    tfrg_atomic32_t mOwned;
+    // Written by the owning thread
+    tfrg_atomic64_t mHead;
+    uint8_t         mHeadPadding[64 - sizeof(tfrg_atomic64_t)];
+    // Written by the writer
+    tfrg_atomic64_t mTail;
+    uint8_t         mTailPadding[64 - sizeof(tfrg_atomic64_t)];
+    uint8_t         mData[LOG_RING_SIZE];
+} LogRing;
+
 typedef struct Log
 {
     LogCallback* pCallbacks;
@@ -69,13 +109,41 @@ typedef struct Log
     Mutex        mLogMutex;
     uint32_t     mLogLevel;
     uint32_t     mIndentation;
+
+    // Async mode
+    tfrg_atomic32_t   mAsync;
+    tfrg_atomicptr_t  pRings;
+    // Changes when rings are freed, ring pointers of threads from before are stale
+    tfrg_atomic32_t   mRingEpoch;
+    // Calls using the rings, enableAsyncLog(false) frees them once none is left
+    tfrg_atomic32_t   mRingUsers;
+    // Messages are written in the order they got their sequence
+    tfrg_atomic64_t   mSequence;
+    // Held while draining rings, by the writer thread or flushLog
+    Mutex             mDrainMutex;
+    uint64_t          mNextSequence;
+    ThreadHandle      mWriterThread;
+    Mutex             mWriterMutex;
+    ConditionVariable mWriterCondition;
+    // Protected by mWriterMutex
+    bool              mWriterWake;
+    bool              mWriterExit;
+    // Messages were written since callbacks were last flushed
+    tfrg_atomic32_t   mUnflushed;
 } Log;
 
 static bool gIsLoggerInitialized = false;
 static Log  gLogger;
 
-static THREAD_LOCAL char gLogBuffer[LOG_MAX_BUFFER + 2];
-static bool              gConsoleLogging = true;
+// BinaryLog.c
+void exitBinaryLogThread(void);
+
+static THREAD_LOCAL char     gLogBuffer[LOG_MAX_BUFFER + 2];
+static THREAD_LOCAL LogRing* pThreadLogRing = NULL;
+static THREAD_LOCAL uint32_t gThreadLogRingEpoch = 0;
+// Writer thread writes its own messages directly, it can't wait for itself
+static THREAD_LOCAL bool     gIsLogWriterThread = false;
+static bool                  gConsoleLogging = true;
 
 #define LOG_PREAMBLE_SIZE  (56 + MAX_THREAD_NAME_LENGTH + FILENAME_NAME_LENGTH_LOG)
 #define LOG_LEVEL_SIZE     6
@@ -107,7 +175,9 @@ static void defaultCallback(void* user_data, const char* message)
     ASSERT(fh);
 
     fsWriteToStream(fh, message, strlen(message));
-    fsFlushStream(fh);
+    // Writer thread flushes once per batch
+    if (!tfrg_atomic32_load_relaxed(&gLogger.mAsync))
+        fsFlushStream(fh);
 }
 
 // Close callback
@@ -128,13 +198,282 @@ static void defaultFlush(void* user_data)
     fsFlushStream(fh);
 }
 
+// Writes message to console and callbacks right away
+static void writeLogMessage(uint32_t level, bool error, const char* message)
+{
+    if (gConsoleLogging)
+    {
+        _PrintUnicode(message, error);
+    }
+
+    acquireMutex(&gLogger.mLogMutex);
+    {
+        for (LogCallback* pCallback = gLogger.pCallbacks; pCallback != gLogger.pCallbacks + gLogger.mCallbacksSize; ++pCallback)
+        {
+            if (pCallback->mLevel & level)
+                pCallback->mCallback(pCallback->mUserData, message);
+        }
+    }
+    releaseMutex(&gLogger.mLogMutex);
+}
+
+static void flushLogCallbacks(void)
+{
+    acquireMutex(&gLogger.mLogMutex);
+    for (LogCallback* pCallback = gLogger.pCallbacks; pCallback != gLogger.pCallbacks + gLogger.mCallbacksSize; ++pCallback)
+    {
+        if (pCallback->mFlush)
+            pCallback->mFlush(pCallback->mUserData);
+    }
+    tfrg_atomic32_store_relaxed(&gLogger.mUnflushed, 0);
+    releaseMutex(&gLogger.mLogMutex);
+}
+
+static void wakeLogWriter(void)
+{
+    acquireMutex(&gLogger.mWriterMutex);
+    gLogger.mWriterWake = true;
+    wakeOneConditionVariable(&gLogger.mWriterCondition);
+    releaseMutex(&gLogger.mWriterMutex);
+}
+
+static LogRing* getThreadLogRing(void)
+{
+    LogRing* ring = pThreadLogRing;
+    uint32_t epoch = tfrg_atomic32_load_relaxed(&gLogger.mRingEpoch);
+    if (ring && gThreadLogRingEpoch == epoch)
+        return ring;
+
+    gThreadLogRingEpoch = epoch;
+    for (ring = (LogRing*)tfrg_atomicptr_load_acquire(&gLogger.pRings); ring; ring = ring->pNext)
+    {
+        if (!tfrg_atomic32_load_relaxed(&ring->mOwned) && tfrg_atomic32_cas_acq_rel(&ring->mOwned, 0, 1) == 0)
+        {
+            pThreadLogRing = ring;
+            return ring;
+        }
+    }
+
+    ring = (LogRing*)tf_memalign(64, sizeof(LogRing));
+    if (!ring)
+        return NULL;
+    memset(ring, 0, offsetof(LogRing, mData));
+    ring->mOwned = 1;
+
+    uintptr_t head = tfrg_atomicptr_load_relaxed(&gLogger.pRings);
+    for (;;)
+    {
+        ring->pNext = (LogRing*)head;
+        uintptr_t prev = tfrg_atomicptr_cas_acq_rel(&gLogger.pRings, head, (uintptr_t)ring);
+        if (prev == head)
+            break;
+        head = prev;
+    }
+
+    pThreadLogRing = ring;
+    return ring;
+}
+
+// Writes queued messages in sequence order until the next one is still being queued.
+// Returns true if anything was written.
+static bool drainLogRings(void)
+{
+    bool written = false;
+    bool progress = true;
+
+    acquireMutex(&gLogger.mLogMutex);
+    while (progress)
+    {
+        progress = false;
+        for (LogRing* ring = (LogRing*)tfrg_atomicptr_load_acquire(&gLogger.pRings); ring; ring = ring->pNext)
+        {
+            uint64_t tail = tfrg_atomic64_load_relaxed(&ring->mTail);
+            uint64_t head = tfrg_atomic64_load_acquire(&ring->mHead);
+            while (tail != head)
+            {
+                uint32_t   offset = (uint32_t)(tail % LOG_RING_SIZE);
+                LogRecord* record = (LogRecord*)(ring->mData + offset);
+                if (record->mPadding)
+                {
+                    tail += LOG_RING_SIZE - offset;
+                    continue;
+                }
+                if (record->mSequence != gLogger.mNextSequence)
+                    break;
+
+                const char* message = (const char*)(record + 1);
+                if (gConsoleLogging)
+                    _PrintUnicode(message, record->mError);
+                for (LogCallback* pCallback = gLogger.pCallbacks; pCallback != gLogger.pCallbacks + gLogger.mCallbacksSize; ++pCallback)
+                {
+                    if (pCallback->mLevel & record->mLevel)
+                        pCallback->mCallback(pCallback->mUserData, message);
+                }
+
+                tail += (sizeof(LogRecord) + record->mSize + LOG_RECORD_ALIGNMENT - 1) & ~(size_t)(LOG_RECORD_ALIGNMENT - 1);
+                ++gLogger.mNextSequence;
+                progress = true;
+            }
+            tfrg_atomic64_store_release(&ring->mTail, tail);
+        }
+        written |= progress;
+    }
+
+    if (written)
+        tfrg_atomic32_store_relaxed(&gLogger.mUnflushed, 1);
+    releaseMutex(&gLogger.mLogMutex);
+
+    return written;
+}
+
+// Returns false once async mode is off, otherwise leaveLogRings has to follow
+static bool enterLogRings(void)
+{
+    tfrg_atomic32_add_relaxed(&gLogger.mRingUsers, 1);
+    // Pairs with the barrier in enableAsyncLog, either it sees this call or this call sees async mode off
+    tfrg_memorybarrier_full();
+    if (tfrg_atomic32_load_relaxed(&gLogger.mAsync))
+        return true;
+    tfrg_atomic32_add_relaxed(&gLogger.mRingUsers, -1);
+    return false;
+}
+
+static void leaveLogRings(void) { tfrg_atomic32_add_acq_rel(&gLogger.mRingUsers, -1); }
+
+// Queues message for the writer thread, returns false if it has to be written right away
+static bool pushLogMessage(uint32_t level, bool error, const char* message)
+{
+    if (!enterLogRings())
+        return false;
+
+    LogRing* ring = getThreadLogRing();
+    if (!ring)
+    {
+        leaveLogRings();
+        return false;
+    }
+
+    size_t textSize = strlen(message) + 1;
+    ASSERT(textSize <= UINT16_MAX);
+    uint32_t recordSize = (uint32_t)((sizeof(LogRecord) + textSize + LOG_RECORD_ALIGNMENT - 1) & ~(size_t)(LOG_RECORD_ALIGNMENT - 1));
+
+    uint64_t head = tfrg_atomic64_load_relaxed(&ring->mHead);
+    uint32_t offset = (uint32_t)(head % LOG_RING_SIZE);
+    uint32_t contiguous = LOG_RING_SIZE - offset;
+    uint32_t needed = recordSize + (contiguous < recordSize ? contiguous : 0);
+
+    uint64_t tail = tfrg_atomic64_load_acquire(&ring->mTail);
+    if (LOG_RING_SIZE - (head - tail) < needed)
+    {
+        // Ring is full, write queued messages on this thread. Blocking on the drain mutex instead of spinning
+        // leaves the CPU to whoever drains, nothing of this thread is pending yet so draining can't wait for itself.
+        while (LOG_RING_SIZE - (head - tfrg_atomic64_load_acquire(&ring->mTail)) < needed)
+        {
+            acquireMutex(&gLogger.mDrainMutex);
+            bool progress = LOG_RING_SIZE - (head - tfrg_atomic64_load_acquire(&ring->mTail)) >= needed || drainLogRings();
+            releaseMutex(&gLogger.mDrainMutex);
+            // Next message is still being queued by another thread
+            if (!progress)
+                threadSleep(0);
+        }
+    }
+
+    if (contiguous < recordSize)
+    {
+        LogRecord* padding = (LogRecord*)(ring->mData + offset);
+        memset(padding, 0, sizeof(LogRecord));
+        padding->mPadding = 1;
+        head += contiguous;
+        offset = 0;
+    }
+
+    LogRecord* record = (LogRecord*)(ring->mData + offset);
+    record->mLevel = level;
+    record->mSize = (uint16_t)textSize;
+    record->mError = error ? 1 : 0;
+    record->mPadding = 0;
+    memcpy(record + 1, message, textSize);
+    // Space is reserved before the sequence is taken, so that the writer never waits for a full ring
+    record->mSequence = tfrg_atomic64_add_relaxed(&gLogger.mSequence, 1);
+    tfrg_atomic64_store_release(&ring->mHead, head + recordSize);
+
+    // Wake the writer once when the ring goes over half full, not on every message after that
+    uint64_t halfMark = tail + LOG_RING_SIZE / 2;
+    if ((level & eERROR) || (head + recordSize > halfMark && head <= halfMark))
+        wakeLogWriter();
+    leaveLogRings();
+    return true;
+}
+
+static void logWriterThread(void* pData)
+{
+    UNREF_PARAM(pData);
+    gIsLogWriterThread = true;
+    int64_t lastFlushTime = getUSec(false);
+
+    for (;;)
+    {
+        acquireMutex(&gLogger.mWriterMutex);
+        if (!gLogger.mWriterWake && !gLogger.mWriterExit)
+            waitConditionVariable(&gLogger.mWriterCondition, &gLogger.mWriterMutex, LOG_WRITER_INTERVAL_MS);
+        bool exit = gLogger.mWriterExit;
+        gLogger.mWriterWake = false;
+        releaseMutex(&gLogger.mWriterMutex);
+
+        if (exit)
+            break;
+
+        acquireMutex(&gLogger.mDrainMutex);
+        drainLogRings();
+        releaseMutex(&gLogger.mDrainMutex);
+
+        // Flushing log files syncs them to disk, so it's done once per interval instead of once per message
+        int64_t time = getUSec(false);
+        if (tfrg_atomic32_load_relaxed(&gLogger.mUnflushed) && time - lastFlushTime >= LOG_WRITER_INTERVAL_MS * 1000)
+        {
+            flushLogCallbacks();
+            lastFlushTime = time;
+        }
+    }
+}
+
+// Waits until all messages queued before the call are written
+static void flushLogRings(void)
+{
+    uint64_t target = tfrg_atomic64_load_acquire(&gLogger.mSequence);
+    int64_t  startTime = getUSec(false);
+
+    acquireMutex(&gLogger.mDrainMutex);
+    for (;;)
+    {
+        drainLogRings();
+        if (gLogger.mNextSequence >= target)
+            break;
+        if (getUSec(false) - startTime > LOG_FLUSH_TIMEOUT_MS * 1000)
+        {
+            // Message which never got queued holds back everything after it
+            _OutputDebugString("Log flush timed out, skipping %llu queued messages\n",
+                               (unsigned long long)(target - gLogger.mNextSequence));
+            gLogger.mNextSequence = target;
+            drainLogRings();
+            break;
+        }
+        threadSleep(0);
+    }
+    releaseMutex(&gLogger.mDrainMutex);
+
+    flushLogCallbacks();
+}
+
 void initLog(const char* appName, LogLevel level /* = eALL */)
 {
     if (!gIsLoggerInitialized)
     {
         gLogger.pCallbacks = NULL;
         gLogger.mCallbacksSize = 0;
-        initMutex(&gLogger.mLogMutex);
+        MutexDesc mutexDesc = { 0 };
+        mutexDesc.futex = true;
+        initMutexDesc(&gLogger.mLogMutex, &mutexDesc);
         gLogger.mLogLevel = level;
         gLogger.mIndentation = 0;
 
@@ -145,6 +484,10 @@ void initLog(const char* appName, LogLevel level /* = eALL */)
             addInitialLogFile(appName);
 
         gIsLoggerInitialized = true;
+
+#if defined(ENABLE_ASYNC_LOG)
+        enableAsyncLog(true);
+#endif
     }
 }
 
@@ -152,6 +495,9 @@ void exitLog(void)
 {
     LOGF(eINFO, "Shutting down log system.");
 
+    exitBinaryLog();
+    enableAsyncLog(false);
+
     for (LogCallback* pCallback = gLogger.pCallbacks; pCallback != gLogger.pCallbacks + gLogger.mCallbacksSize; ++pCallback)
     {
         if (pCallback->mClose)
@@ -163,6 +509,102 @@ void exitLog(void)
     gIsLoggerInitialized = false;
 }
 
+void enableAsyncLog(bool enable)
+{
+    if (!gIsLoggerInitialized || enable == (tfrg_atomic32_load_relaxed(&gLogger.mAsync) != 0))
+        return;
+
+    if (enable)
+    {
+        MutexDesc mutexDesc = { 0 };
+        mutexDesc.futex = true;
+        ConditionVariableDesc conditionDesc = { 0 };
+        conditionDesc.futex = true;
+        initMutexDesc(&gLogger.mDrainMutex, &mutexDesc);
+        initMutexDesc(&gLogger.mWriterMutex, &mutexDesc);
+        initConditionVariableDesc(&gLogger.mWriterCondition, &conditionDesc);
+        gLogger.mWriterWake = false;
+        gLogger.mWriterExit = false;
+        gLogger.mNextSequence = tfrg_atomic64_load_relaxed(&gLogger.mSequence);
+
+        ThreadDesc threadDesc = { 0 };
+        threadDesc.pFunc = logWriterThread;
+        strncpy(threadDesc.mThreadName, "LogWriter", sizeof(threadDesc.mThreadName) - 1);
+        if (!initThread(&threadDesc, &gLogger.mWriterThread))
+        {
+            exitConditionVariable(&gLogger.mWriterCondition);
+            exitMutex(&gLogger.mWriterMutex);
+            exitMutex(&gLogger.mDrainMutex);
+            LOGF(eWARNING, "Failed to start log writer thread, logging stays synchronous");
+            return;
+        }
+
+        tfrg_atomic32_store_release(&gLogger.mAsync, 1);
+        return;
+    }
+
+    tfrg_atomic32_store_release(&gLogger.mAsync, 0);
+    tfrg_memorybarrier_full();
+    // Threads which saw async mode on are still queueing, a full ring is drained by its own thread
+    while (tfrg_atomic32_load_acquire(&gLogger.mRingUsers))
+        threadSleep(0);
+
+    acquireMutex(&gLogger.mWriterMutex);
+    gLogger.mWriterExit = true;
+    wakeOneConditionVariable(&gLogger.mWriterCondition);
+    releaseMutex(&gLogger.mWriterMutex);
+    joinThread(gLogger.mWriterThread);
+
+    flushLogRings();
+
+    LogRing* ring = (LogRing*)tfrg_atomicptr_store_relaxed(&gLogger.pRings, 0);
+    while (ring)
+    {
+        LogRing* next = ring->pNext;
+        tf_free(ring);
+        ring = next;
+    }
+    pThreadLogRing = NULL;
+    tfrg_atomic32_add_relaxed(&gLogger.mRingEpoch, 1);
+
+    exitConditionVariable(&gLogger.mWriterCondition);
+    exitMutex(&gLogger.mWriterMutex);
+    exitMutex(&gLogger.mDrainMutex);
+}
+
+void flushLog(void)
+{
+    flushBinaryLog();
+    if (!gIsLoggerInitialized)
+        return;
+
+    if (tfrg_atomic32_load_acquire(&gLogger.mAsync) && !gIsLogWriterThread && enterLogRings())
+    {
+        flushLogRings();
+        leaveLogRings();
+        return;
+    }
+
+    flushLogCallbacks();
+}
+
+void exitLogThread(void)
+{
+    exitBinaryLogThread();
+
+    LogRing* ring = pThreadLogRing;
+    if (!ring || !enterLogRings())
+        return;
+
+    // Queued messages stay in the ring until the writer gets to them
+    if (gThreadLogRingEpoch == tfrg_atomic32_load_relaxed(&gLogger.mRingEpoch))
+        tfrg_atomic32_store_release(&ring->mOwned, 0);
+    pThreadLogRing = NULL;
+    leaveLogRings();
+}
+
+void setLogConsoleOutput(bool enable) { gConsoleLogging = enable; }
+
 void addLogFile(const char* filename, FileMode file_mode, LogLevel log_level)
 {
     if (filename == NULL)
@@ -219,6 +661,32 @@ void addLogCallback(const char* id, uint32_t log_level, void* user_data, LogCall
     releaseMutex(&gLogger.mLogMutex);
 }
 
+void removeLogCallback(const char* id)
+{
+    // Messages logged so far still reach the callback
+    flushLog();
+
+    acquireMutex(&gLogger.mLogMutex);
+    for (uint32_t i = 0; i < gLogger.mCallbacksSize; ++i)
+    {
+        LogCallback* pCallback = gLogger.pCallbacks + i;
+        if (strcmp(id, pCallback->mID) != 0)
+            continue;
+
+        if (pCallback->mClose)
+            pCallback->mClose(pCallback->mUserData);
+        memmove(pCallback, pCallback + 1, sizeof(LogCallback) * (gLogger.mCallbacksSize - i - 1));
+        gLogger.mCallbacksSize = gLogger.mCallbacksSize - 1;
+        if (!gLogger.mCallbacksSize)
+        {
+            tf_free(gLogger.pCallbacks);
+            gLogger.pCallbacks = NULL;
+        }
+        break;
+    }
+    releaseMutex(&gLogger.mLogMutex);
+}
+
 typedef char LogStr[LOG_LEVEL_SIZE + 1];
 
 void writeLogVaList(uint32_t level, const char* filename, int line_number, const char* message, va_list args)
@@ -245,6 +713,10 @@ void writeLogVaList(uint32_t level, const char* filename, int line_number, const
         }
     }
 
+    // Filtered out, skip formatting
+    if (!log_level_count)
+        return;
+
     uint32_t preable_end = writeLogPreamble(gLogBuffer, LOG_PREAMBLE_SIZE, filename, line_number);
 
     // Prepare indentation
@@ -258,25 +730,15 @@ void writeLogVaList(uint32_t level, const char* filename, int line_number, const
     gLogBuffer[offset] = '\n';
     gLogBuffer[offset + 1] = 0;
 
+    bool async = tfrg_atomic32_load_acquire(&gLogger.mAsync) && !gIsLogWriterThread;
+
     // Log for each flag
     for (uint32_t i = 0; i < log_level_count; ++i)
     {
         strncpy(gLogBuffer + preable_end, logLevelPrefixes[log_levels[i]].second, LOG_LEVEL_SIZE);
 
-        if (gConsoleLogging)
-        {
-            _PrintUnicode(gLogBuffer, level & eERROR);
-        }
-
-        acquireMutex(&gLogger.mLogMutex);
-        {
-            for (LogCallback* pCallback = gLogger.pCallbacks; pCallback != gLogger.pCallbacks + gLogger.mCallbacksSize; ++pCallback)
-            {
-                if (pCallback->mLevel & logLevelPrefixes[log_levels[i]].first)
-                    pCallback->mCallback(pCallback->mUserData, gLogBuffer);
-            }
-        }
-        releaseMutex(&gLogger.mLogMutex);
+        if (!async || !pushLogMessage(logLevelPrefixes[log_levels[i]].first, level & eERROR, gLogBuffer))
+            writeLogMessage(logLevelPrefixes[log_levels[i]].first, level & eERROR, gLogBuffer);
     }
 }
 
@@ -295,20 +757,9 @@ void writeRawLog(uint32_t level, bool error, const char* message, ...)
     vsnprintf(gLogBuffer, LOG_MAX_BUFFER, message, args);
     va_end(args);
 
-    if (gConsoleLogging)
-    {
-        _PrintUnicode(gLogBuffer, error);
-    }
-
-    acquireMutex(&gLogger.mLogMutex);
-    {
-        for (LogCallback* pCallback = gLogger.pCallbacks; pCallback != gLogger.pCallbacks + gLogger.mCallbacksSize; ++pCallback)
-        {
-            if (pCallback->mLevel & level)
-                pCallback->mCallback(pCallback->mUserData, gLogBuffer);
-        }
-    }
-    releaseMutex(&gLogger.mLogMutex);
+    bool async = tfrg_atomic32_load_acquire(&gLogger.mAsync) && !gIsLogWriterThread;
+    if (!async || !pushLogMessage(level, error, gLogBuffer))
+        writeLogMessage(level, error, gLogBuffer);
 }
 
 void _FailedAssert(const char* file, int line, const char* statement, const char* msgFmt, ...)
@@ -339,6 +790,8 @@ void _FailedAssert(const char* file, int line, const char* statement, const char
             writeLog(eERROR, file, line, "Assert failed: %s\nAssert message: %s", statement, usrMsgBuf);
         else
             writeLog(eERROR, file, line, "Assert failed: %s", statement);
+        // Debugger or crash handler comes next, queued messages have to be out before that
+        flushLog();
     }
 
     _FailedAssertImpl(file, line, statement, usrMsgBuf[0] ? usrMsgBuf : NULL);
@@ -421,8 +874,14 @@ static bool isLogCallback(const char* id)
 void initLog(const char* appName, LogLevel level) {}
 void exitLog(void) {}
 
+void enableAsyncLog(bool enable) {}
+void flushLog(void) {}
+void exitLogThread(void) {}
+void setLogConsoleOutput(bool enable) {}
+
 void addLogFile(const char* filename, FileMode file_mode, LogLevel log_level) {}
 void addLogCallback(const char* id, uint32_t log_level, void* user_data, LogCallbackFn callback, LogCloseFn close, LogFlushFn flush) {}
+void removeLogCallback(const char* id) {}
 
 void writeLog(uint32_t level, const char* filename, int line_number, const char* message, va_list args) {}
 void writeLog(uint32_t level, const char* filename, int line_number, const char* message, ...) {}
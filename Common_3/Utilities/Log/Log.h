@@ -74,10 +74,32 @@ extern "C"
     // level     mask of LogLevel bits. Log is ignored if its level is missing in mask. Use eALL to enable full log
     FORGE_API void initLog(const char* appName, LogLevel level);
     FORGE_API void exitLog(void);
+    // Async mode: threads queue formatted messages in their own ring, a writer thread writes them to console, files and callbacks
+    // in the order they were logged. On by default with ENABLE_ASYNC_LOG.
+    FORGE_API void enableAsyncLog(bool enable);
+    // Writes out everything logged so far and flushes log files. Called on failed asserts, call it before crashing on purpose
+    FORGE_API void flushLog(void);
+    // Called by initThread wrappers when a thread exits, lets new threads reuse its async log ring
+    FORGE_API void exitLogThread(void);
+    FORGE_API void setLogConsoleOutput(bool enable);
 
     FORGE_API void addLogFile(const char* filename, FileMode file_mode, LogLevel log_level);
     FORGE_API void addLogCallback(const char* id, uint32_t log_level, void* user_data, LogCallbackFn callback, LogCloseFn close,
                                   LogFlushFn flush);
+    // Closes callback added with 'id' after everything logged so far reached it
+    FORGE_API void removeLogCallback(const char* id);
+
+    // Binary log: LOGB messages are stored as format id and raw arguments in per-thread buffers, without formatting them.
+    // Files are turned into text with Common_3/Tools/BinaryLogDecoder/binary_log_decoder.py
+    // filename  opened in RD_LOG, overwritten
+    // level     mask of LogLevel bits written to the binary log, LOGB with other levels returns right away
+    FORGE_API bool initBinaryLog(const char* filename, uint32_t level);
+    // Called by exitLog. Thread unsafe, other threads must not log to the binary log anymore
+    FORGE_API void exitBinaryLog(void);
+    // Writes buffered records of all threads to the file. Called by flushLog
+    FORGE_API void flushBinaryLog(void);
+    //+V576, function:writeBinaryLog, format_arg:5, ellipsis_arg:6
+    FORGE_API void writeBinaryLog(uint32_t* pFormatId, uint32_t level, const char* filename, int line_number, const char* message, ...);
 
     FORGE_API void writeLogVaList(uint32_t level, const char* filename, int line_number, const char* message, va_list args);
     //+V576, function:writeLog, format_arg:4, ellipsis_arg:5
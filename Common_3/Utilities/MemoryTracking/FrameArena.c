@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2017-2024 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "../../Application/Config.h"
+
+#include <string.h>
+
+#include "../Interfaces/ILog.h"
+#include "../Interfaces/IThread.h"
+#include "../Threading/Atomics.h"
+
+#include "../Interfaces/IMemory.h"
+
+// Initial size of the block every thread bumps through, grows to fit the largest frame
+#ifndef FRAME_ARENA_BLOCK_SIZE
+#define FRAME_ARENA_BLOCK_SIZE (256 * TF_KB)
+#endif
+
+// Same guarantee tf_malloc gives for SIMD types
+#define FRAME_ARENA_MIN_ALIGNMENT 16
+
+#define FRAME_ARENA_POISON        0xDD
+
+typedef struct FrameArenaBlock
+{
+    struct FrameArenaBlock* pNext;
+    size_t                  size;
+} FrameArenaBlock;
+
+typedef struct FrameArena
+{
+    // Arenas are never removed from the list, released ones are reused by new threads
+    struct FrameArena* pNext;
+    tfrg_atomic32_t    owned;
+
+    uint64_t frame;
+    // Block which is kept between frames, allocated on first use
+    FrameArenaBlock* pBlock;
+    size_t           blockSize;
+    // Blocks which were added after the main one overflowed, freed on reset
+    FrameArenaBlock* pOverflow;
+
+    uint8_t* pCurrent;
+    uint8_t* pEnd;
+    // Bytes handed out in current frame, including alignment padding
+    size_t   used;
+} FrameArena;
+
+static tfrg_atomicptr_t gFrameArenas = 0;
+static tfrg_atomic64_t  gFrameArenaFrame = 0;
+static tfrg_atomic32_t  gFrameArenaCount = 0;
+static tfrg_atomic64_t  gFrameArenaPeakUsed = 0;
+static tfrg_atomic64_t  gFrameArenaReserved = 0;
+static tfrg_atomic64_t  gFrameArenaOverflowCount = 0;
+
+static THREAD_LOCAL FrameArena* pThreadFrameArena = NULL;
+
+static inline uint8_t* blockData(FrameArenaBlock* block) { return (uint8_t*)(block + 1); }
+
+static inline uint8_t* alignPointer(uint8_t* ptr, size_t align) { return (uint8_t*)(((uintptr_t)ptr + align - 1) & ~(uintptr_t)(align - 1)); }
+
+static void freeBlock(FrameArenaBlock* block)
+{
+    tfrg_atomic64_add_relaxed(&gFrameArenaReserved, -(int64_t)block->size);
+    tf_free(block);
+}
+
+static void resetFrameArena(FrameArena* arena)
+{
+    tfrg_atomic64_max_relaxed(&gFrameArenaPeakUsed, arena->used);
+
+#if defined(ENABLE_FRAME_ARENA_POISON)
+    // Anything still pointing into the previous frame reads garbage instead of valid looking data
+    if (arena->pBlock)
+    {
+        uint8_t* data = blockData(arena->pBlock);
+        memset(data, FRAME_ARENA_POISON, arena->pOverflow ? arena->pBlock->size : (size_t)(arena->pCurrent - data));
+    }
+#endif
+
+    if (arena->pOverflow)
+    {
+        while (arena->pOverflow)
+        {
+            FrameArenaBlock* next = arena->pOverflow->pNext;
+            freeBlock(arena->pOverflow);
+            arena->pOverflow = next;
+        }
+
+        // Grow main block, so that frames of the same size fit without overflowing
+        while (arena->blockSize < arena->used)
+            arena->blockSize *= 2;
+
+        LOGF(eDEBUG, "Frame arena overflowed with %llu bytes, block grows to %llu bytes", (unsigned long long)arena->used,
+             (unsigned long long)arena->blockSize);
+
+        freeBlock(arena->pBlock);
+        arena->pBlock = NULL;
+    }
+
+    arena->pCurrent = arena->pBlock ? blockData(arena->pBlock) : NULL;
+    arena->pEnd = arena->pBlock ? arena->pCurrent + arena->pBlock->size : NULL;
+    arena->used = 0;
+}
+
+static void releaseFrameArena(FrameArena* arena)
+{
+    tfrg_atomic64_max_relaxed(&gFrameArenaPeakUsed, arena->used);
+
+    while (arena->pOverflow)
+    {
+        FrameArenaBlock* next = arena->pOverflow->pNext;
+        freeBlock(arena->pOverflow);
+        arena->pOverflow = next;
+    }
+
+    if (arena->pBlock)
+        freeBlock(arena->pBlock);
+    arena->pBlock = NULL;
+    arena->pCurrent = NULL;
+    arena->pEnd = NULL;
+    arena->used = 0;
+}
+
+static FrameArena* claimFrameArena(void)
+{
+    for (FrameArena* arena = (FrameArena*)tfrg_atomicptr_load_acquire(&gFrameArenas); arena; arena = arena->pNext)
+    {
+        if (!tfrg_atomic32_load_relaxed(&arena->owned) && tfrg_atomic32_cas_acq_rel(&arena->owned, 0, 1) == 0)
+            return arena;
+    }
+
+    FrameArena* arena = (FrameArena*)tf_calloc(1, sizeof(FrameArena));
+    if (!arena)
+        return NULL;
+
+    arena->owned = 1;
+    arena->blockSize = FRAME_ARENA_BLOCK_SIZE;
+
+    uintptr_t head = tfrg_atomicptr_load_relaxed(&gFrameArenas);
+    for (;;)
+    {
+        arena->pNext = (FrameArena*)head;
+        uintptr_t prev = tfrg_atomicptr_cas_acq_rel(&gFrameArenas, head, (uintptr_t)arena);
+        if (prev == head)
+            break;
+        head = prev;
+    }
+
+    tfrg_atomic32_add_relaxed(&gFrameArenaCount, 1);
+    return arena;
+}
+
+static FrameArena* getFrameArena(void)
+{
+    FrameArena* arena = pThreadFrameArena;
+    uint64_t    frame = tfrg_atomic64_load_relaxed(&gFrameArenaFrame);
+
+    if (!arena)
+    {
+        arena = claimFrameArena();
+        if (!arena)
+            return NULL;
+        arena->frame = frame;
+        pThreadFrameArena = arena;
+    }
+
+    if (arena->frame != frame)
+    {
+        resetFrameArena(arena);
+        arena->frame = frame;
+    }
+
+    return arena;
+}
+
+// Adds a block big enough for 'size'. Requests bigger than a regular block get a block of their own,
+// otherwise the new block becomes current one.
+static uint8_t* allocateSlow(FrameArena* arena, size_t align, size_t size, const char* f, int l, const char* sf)
+{
+    bool   overflow = arena->pBlock != NULL;
+    size_t blockSize = overflow ? FRAME_ARENA_BLOCK_SIZE : arena->blockSize;
+    bool   dedicated = overflow && size + align > blockSize;
+    if (blockSize < size + align)
+        blockSize = size + align;
+
+    FrameArenaBlock* block =
+        (FrameArenaBlock*)tf_memalign_internal(FRAME_ARENA_MIN_ALIGNMENT, sizeof(FrameArenaBlock) + blockSize, f, l, sf);
+    if (!block)
+        return NULL;
+
+    block->pNext = NULL;
+    block->size = blockSize;
+    tfrg_atomic64_add_relaxed(&gFrameArenaReserved, blockSize);
+
+    if (overflow)
+    {
+        block->pNext = arena->pOverflow;
+        arena->pOverflow = block;
+        tfrg_atomic64_add_relaxed(&gFrameArenaOverflowCount, 1);
+    }
+    else
+    {
+        arena->pBlock = block;
+    }
+
+    uint8_t* result = alignPointer(blockData(block), align);
+    arena->used += (size_t)(result + size - blockData(block));
+
+    // Rest of the previous block stays unused until reset
+    if (!dedicated)
+    {
+        arena->pCurrent = result + size;
+        arena->pEnd = blockData(block) + blockSize;
+    }
+
+    return result;
+}
+
+void* tf_frame_memalign_internal(size_t align, size_t size, const char* f, int l, const char* sf)
+{
+    if (align < FRAME_ARENA_MIN_ALIGNMENT)
+        align = FRAME_ARENA_MIN_ALIGNMENT;
+    ASSERT((align & (align - 1)) == 0);
+
+    FrameArena* arena = getFrameArena();
+    if (!arena)
+        return NULL;
+
+    uint8_t* result = arena->pCurrent ? alignPointer(arena->pCurrent, align) : NULL;
+    if (!result || size > (size_t)(arena->pEnd - result))
+        return allocateSlow(arena, align, size, f, l, sf);
+
+    arena->used += (size_t)(result + size - arena->pCurrent);
+    arena->pCurrent = result + size;
+    return result;
+}
+
+void* tf_frame_calloc_memalign_internal(size_t count, size_t align, size_t size, const char* f, int l, const char* sf)
+{
+    if (size && count > SIZE_MAX / size)
+        return NULL;
+
+    void* result = tf_frame_memalign_internal(align, count * size, f, l, sf);
+    if (result)
+        memset(result, 0, count * size);
+    return result;
+}
+
+void tf_frame_arena_end_frame(void) { tfrg_atomic64_add_relaxed(&gFrameArenaFrame, 1); }
+
+void tf_frame_arena_exit_thread(void)
+{
+    FrameArena* arena = pThreadFrameArena;
+    if (!arena)
+        return;
+
+    releaseFrameArena(arena);
+    pThreadFrameArena = NULL;
+    tfrg_atomic32_store_release(&arena->owned, 0);
+}
+
+FrameArenaStatistics tf_frame_arena_get_statistics(void)
+{
+    FrameArenaStatistics stats = { 0 };
+    stats.frameIndex = tfrg_atomic64_load_relaxed(&gFrameArenaFrame);
+    stats.arenaCount = tfrg_atomic32_load_relaxed(&gFrameArenaCount);
+    stats.reserved = tfrg_atomic64_load_relaxed(&gFrameArenaReserved);
+    stats.overflowCount = tfrg_atomic64_load_relaxed(&gFrameArenaOverflowCount);
+
+    FrameArena* arena = pThreadFrameArena;
+    if (arena && arena->frame == stats.frameIndex)
+        stats.threadUsed = arena->used;
+
+    stats.peakUsed = tfrg_atomic64_load_relaxed(&gFrameArenaPeakUsed);
+    if (stats.peakUsed < stats.threadUsed)
+        stats.peakUsed = stats.threadUsed;
+    return stats;
+}
+
+// Called from exitMemAlloc, all threads which used frame arenas are expected to be gone by then
+void exitFrameArenas(void)
+{
+    FrameArena* arena = (FrameArena*)tfrg_atomicptr_store_relaxed(&gFrameArenas, 0);
+    while (arena)
+    {
+        FrameArena* next = arena->pNext;
+        releaseFrameArena(arena);
+        tf_free(arena);
+        arena = next;
+    }
+
+    pThreadFrameArena = NULL;
+    tfrg_atomic32_store_relaxed(&gFrameArenaCount, 0);
+}
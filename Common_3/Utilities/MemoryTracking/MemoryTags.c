@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2017-2024 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "../../Application/Config.h"
+
+#if defined(ENABLE_MEMORY_TAGS)
+
+#include <string.h>
+
+#include "../Interfaces/ILog.h"
+#include "../Threading/Atomics.h"
+
+#include "../Interfaces/IMemory.h"
+
+// Threads collect changes of a tag locally and publish them once they add up to this many bytes or operations,
+// so that allocations of different threads don't fight over the same counters
+#ifndef MEMORY_TAG_FLUSH_BYTES
+#define MEMORY_TAG_FLUSH_BYTES (64 * TF_KB)
+#endif
+#ifndef MEMORY_TAG_FLUSH_COUNT
+#define MEMORY_TAG_FLUSH_COUNT 256
+#endif
+
+#define MEMORY_TAG_STACK_SIZE 16
+
+typedef struct MemoryTagCounters
+{
+    tfrg_atomic64_t liveBytes;
+    tfrg_atomic64_t peakBytes;
+    tfrg_atomic64_t allocCount;
+    tfrg_atomic64_t freeCount;
+    tfrg_atomic64_t budgetBytes;
+    // Set once live bytes went over budget, cleared when they are back under it
+    tfrg_atomic32_t overBudget;
+    tfrg_atomic32_t assertOverBudget;
+    const char*     name;
+    uint8_t         padding[64 - 5 * sizeof(tfrg_atomic64_t) - 2 * sizeof(tfrg_atomic32_t) - sizeof(const char*)];
+} MemoryTagCounters;
+
+typedef struct ThreadMemoryTags
+{
+    uint16_t stack[MEMORY_TAG_STACK_SIZE];
+    uint32_t depth;
+    // Tag + 1 which went over budget in the last flush, reported outside of the allocator
+    uint32_t overBudgetTag;
+    int64_t  bytes[MEMORY_TAG_MAX_COUNT];
+    int32_t  allocCount[MEMORY_TAG_MAX_COUNT];
+    int32_t  freeCount[MEMORY_TAG_MAX_COUNT];
+} ThreadMemoryTags;
+
+static MemoryTagCounters gMemoryTags[MEMORY_TAG_MAX_COUNT] = {
+    [MEMORY_TAG_UNTAGGED] = { .name = "Untagged" },
+    [MEMORY_TAG_RESOURCE_LOADER] = { .name = "ResourceLoader" },
+    [MEMORY_TAG_UI] = { .name = "UI" },
+    [MEMORY_TAG_FONTS] = { .name = "Fonts" },
+};
+static tfrg_atomic32_t gMemoryTagCount = MEMORY_TAG_BUILTIN_COUNT;
+
+static THREAD_LOCAL ThreadMemoryTags gThreadMemoryTags;
+
+static void flushMemoryTag(ThreadMemoryTags* thread, uint32_t tag)
+{
+    MemoryTagCounters* counters = gMemoryTags + tag;
+    int64_t            liveBytes = tfrg_atomic64_add_relaxed(&counters->liveBytes, thread->bytes[tag]) + thread->bytes[tag];
+    tfrg_atomic64_add_relaxed(&counters->allocCount, thread->allocCount[tag]);
+    tfrg_atomic64_add_relaxed(&counters->freeCount, thread->freeCount[tag]);
+    thread->bytes[tag] = 0;
+    thread->allocCount[tag] = 0;
+    thread->freeCount[tag] = 0;
+
+    // Frees flushed by other threads first can take the sum below zero for a moment
+    if (liveBytes <= 0)
+        return;
+
+    tfrg_atomic64_max_relaxed(&counters->peakBytes, (uint64_t)liveBytes);
+
+    uint64_t budgetBytes = tfrg_atomic64_load_relaxed(&counters->budgetBytes);
+    if (!budgetBytes)
+        return;
+
+    if ((uint64_t)liveBytes > budgetBytes)
+    {
+        if (!tfrg_atomic32_load_relaxed(&counters->overBudget) && !tfrg_atomic32_store_relaxed(&counters->overBudget, 1))
+            thread->overBudgetTag = tag + 1;
+    }
+    else if (tfrg_atomic32_load_relaxed(&counters->overBudget))
+    {
+        tfrg_atomic32_store_relaxed(&counters->overBudget, 0);
+    }
+}
+
+uint32_t memTagCurrent(void)
+{
+    ThreadMemoryTags* thread = &gThreadMemoryTags;
+    uint32_t          depth = thread->depth < MEMORY_TAG_STACK_SIZE ? thread->depth : MEMORY_TAG_STACK_SIZE;
+    return depth ? thread->stack[depth - 1] : MEMORY_TAG_UNTAGGED;
+}
+
+// Called by the allocator for every block, may run while allocator locks are held so it never logs
+void memTagOnAlloc(uint32_t tag, size_t size)
+{
+    ThreadMemoryTags* thread = &gThreadMemoryTags;
+    thread->bytes[tag] += (int64_t)size;
+    if (++thread->allocCount[tag] + thread->freeCount[tag] >= MEMORY_TAG_FLUSH_COUNT || thread->bytes[tag] >= MEMORY_TAG_FLUSH_BYTES)
+        flushMemoryTag(thread, tag);
+}
+
+void memTagOnFree(uint32_t tag, size_t size)
+{
+    ThreadMemoryTags* thread = &gThreadMemoryTags;
+    thread->bytes[tag] -= (int64_t)size;
+    if (thread->allocCount[tag] + ++thread->freeCount[tag] >= MEMORY_TAG_FLUSH_COUNT || -thread->bytes[tag] >= MEMORY_TAG_FLUSH_BYTES)
+        flushMemoryTag(thread, tag);
+}
+
+// Called by the allocator after the allocation is done and its locks are released
+void memTagCheckBudget(void)
+{
+    ThreadMemoryTags* thread = &gThreadMemoryTags;
+    if (!thread->overBudgetTag)
+        return;
+
+    // Logging allocates too, so the pending report is cleared first
+    MemoryTagCounters* counters = gMemoryTags + thread->overBudgetTag - 1;
+    thread->overBudgetTag = 0;
+
+    LOGF(eWARNING, "Memory tag '%s' is over budget: %llu bytes live, budget %llu bytes", counters->name,
+         (unsigned long long)tfrg_atomic64_load_relaxed(&counters->liveBytes),
+         (unsigned long long)tfrg_atomic64_load_relaxed(&counters->budgetBytes));
+    if (tfrg_atomic32_load_relaxed(&counters->assertOverBudget))
+    {
+        ASSERTFAIL("Memory tag '%s' is over budget", counters->name);
+    }
+}
+
+void memTagFlushThread(void)
+{
+    ThreadMemoryTags* thread = &gThreadMemoryTags;
+    uint32_t          tagCount = tfrg_atomic32_load_relaxed(&gMemoryTagCount);
+    for (uint32_t tag = 0; tag < tagCount; ++tag)
+    {
+        if (thread->bytes[tag] || thread->allocCount[tag] || thread->freeCount[tag])
+            flushMemoryTag(thread, tag);
+    }
+}
+
+uint32_t memTagRegister(const char* name)
+{
+    ASSERT(name);
+
+    uint32_t tagCount = tfrg_atomic32_load_acquire(&gMemoryTagCount);
+    for (uint32_t tag = 0; tag < tagCount; ++tag)
+    {
+        if (gMemoryTags[tag].name && !strcmp(gMemoryTags[tag].name, name))
+            return tag;
+    }
+
+    uint32_t tag = tfrg_atomic32_add_relaxed(&gMemoryTagCount, 1);
+    if (tag >= MEMORY_TAG_MAX_COUNT)
+    {
+        tfrg_atomic32_add_relaxed(&gMemoryTagCount, -1);
+        LOGF(eWARNING, "Too many memory tags, '%s' is counted as untagged", name);
+        return MEMORY_TAG_UNTAGGED;
+    }
+
+    // Caller keeps the name alive, usually a string literal
+    gMemoryTags[tag].name = name;
+    return tag;
+}
+
+void memTagSetBudget(uint32_t tag, uint64_t budgetBytes, bool assertOverBudget)
+{
+    ASSERT(tag < MEMORY_TAG_MAX_COUNT);
+    tfrg_atomic32_store_relaxed(&gMemoryTags[tag].assertOverBudget, assertOverBudget ? 1 : 0);
+    tfrg_atomic64_store_relaxed(&gMemoryTags[tag].budgetBytes, budgetBytes);
+    tfrg_atomic32_store_relaxed(&gMemoryTags[tag].overBudget, 0);
+}
+
+void memTagPush(uint32_t tag)
+{
+    ASSERT(tag < MEMORY_TAG_MAX_COUNT);
+    ThreadMemoryTags* thread = &gThreadMemoryTags;
+    // Deeper scopes keep the tag of the deepest one which fits, pops still have to match
+    ASSERT(thread->depth < MEMORY_TAG_STACK_SIZE && "Memory tag scopes are nested too deep");
+    if (thread->depth < MEMORY_TAG_STACK_SIZE)
+        thread->stack[thread->depth] = (uint16_t)tag;
+    ++thread->depth;
+}
+
+void memTagPop(void)
+{
+    ThreadMemoryTags* thread = &gThreadMemoryTags;
+    ASSERT(thread->depth);
+    if (thread->depth)
+        --thread->depth;
+}
+
+uint32_t memTagCount(void) { return tfrg_atomic32_load_acquire(&gMemoryTagCount); }
+
+MemoryTagStatistics memTagGetStatistics(uint32_t tag)
+{
+    MemoryTagStatistics stats = { 0 };
+    if (tag >= memTagCount())
+        return stats;
+
+    // Changes of other threads show up once they are flushed
+    ThreadMemoryTags* thread = &gThreadMemoryTags;
+    if (thread->bytes[tag] || thread->allocCount[tag] || thread->freeCount[tag])
+        flushMemoryTag(thread, tag);
+
+    const MemoryTagCounters* counters = gMemoryTags + tag;
+    int64_t                  liveBytes = (int64_t)tfrg_atomic64_load_relaxed(&counters->liveBytes);
+    stats.pName = counters->name;
+    stats.liveBytes = liveBytes > 0 ? (uint64_t)liveBytes : 0;
+    stats.peakBytes = tfrg_atomic64_load_relaxed(&counters->peakBytes);
+    stats.allocCount = tfrg_atomic64_load_relaxed(&counters->allocCount);
+    stats.liveCount = stats.allocCount - tfrg_atomic64_load_relaxed(&counters->freeCount);
+    stats.budgetBytes = tfrg_atomic64_load_relaxed(&counters->budgetBytes);
+    return stats;
+}
+
+#endif // defined(ENABLE_MEMORY_TAGS)
@@ -51,6 +51,19 @@
 
 #define MIN_ALLOC_ALIGNMENT MEM_MAX(VECTORMATH_MIN_ALIGN, PLATFORM_MIN_MALLOC_ALIGNMENT)
 
+// FrameArena.c
+extern void exitFrameArenas(void);
+extern void tf_frame_arena_exit_thread(void);
+
+#if defined(ENABLE_MEMORY_TAGS)
+// MemoryTags.c
+extern uint32_t memTagCurrent(void);
+extern void     memTagOnAlloc(uint32_t tag, size_t size);
+extern void     memTagOnFree(uint32_t tag, size_t size);
+extern void     memTagCheckBudget(void);
+extern void     memTagFlushThread(void);
+#endif
+
 #if defined(ENABLE_MEMORY_TRACKING)
 
 #define _CRT_SECURE_NO_WARNINGS 1
@@ -86,6 +99,9 @@ void* tf_calloc_internal(size_t count, size_t size, const char* f, int l, const
 void* tf_memalign_internal(size_t align, size_t size, const char* f, int l, const char* sf)
 {
     void* pMemAlign = mmgrAllocator(f, l, sf, m_alloc_malloc, align, size);
+#if defined(ENABLE_MEMORY_TAGS)
+    memTagCheckBudget();
+#endif
 
     // Return handle to allocated memory.
     return pMemAlign;
@@ -96,6 +112,9 @@ void* tf_calloc_memalign_internal(size_t count, size_t align, size_t size, const
     size = ALIGN_TO(size, align);
 
     void* pMemAlign = mmgrAllocator(f, l, sf, m_alloc_calloc, align, size * count);
+#if defined(ENABLE_MEMORY_TAGS)
+    memTagCheckBudget();
+#endif
 
     // Return handle to allocated memory.
     return pMemAlign;
@@ -104,6 +123,9 @@ void* tf_calloc_memalign_internal(size_t count, size_t align, size_t size, const
 void* tf_realloc_internal(void* ptr, size_t size, const char* f, int l, const char* sf)
 {
     void* pRealloc = mmgrReallocator(f, l, sf, m_alloc_realloc, size, ptr);
+#if defined(ENABLE_MEMORY_TAGS)
+    memTagCheckBudget();
+#endif
 
     // Return handle to reallocated memory.
     return pRealloc;
@@ -111,10 +133,32 @@ void* tf_realloc_internal(void* ptr, size_t size, const char* f, int l, const ch
 
 void tf_free_internal(void* ptr, const char* f, int l, const char* sf) { mmgrDeallocator(f, l, sf, m_alloc_free, ptr); }
 
+void exitMemAllocThread(void)
+{
+    tf_frame_arena_exit_thread();
+#if defined(ENABLE_MEMORY_TAGS)
+    memTagFlushThread();
+#endif
+}
+
 #else // defined(ENABLE_MEMORY_TRACKING)
 
 #include "stdbool.h"
 
+#if defined(ENABLE_SMALL_ALLOCATOR)
+// SmallAllocator.c
+extern bool   smallAllocOwns(const void* ptr);
+extern size_t smallAllocSize(const void* ptr);
+extern void*  smallAlloc(size_t size);
+extern void*  smallAllocAligned(size_t align, size_t size);
+extern void   smallFree(void* ptr);
+extern void   smallAllocExitThread(void);
+#endif
+
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+static void dumpCallsiteLeaks(void);
+#endif
+
 bool initMemAlloc(const char* appName)
 {
     UNREF_PARAM(appName);
@@ -124,11 +168,32 @@ bool initMemAlloc(const char* appName)
 
 void exitMemAlloc(void)
 {
+    exitFrameArenas();
     // Return all allocated memory to the OS. Analyze memory usage, dump memory leaks, ...
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+    dumpCallsiteLeaks();
+#endif
+}
+
+void exitMemAllocThread(void)
+{
+    tf_frame_arena_exit_thread();
+#if defined(ENABLE_SMALL_ALLOCATOR)
+    smallAllocExitThread();
+#endif
+#if defined(ENABLE_MEMORY_TAGS)
+    memTagFlushThread();
+#endif
 }
 
 void* tf_malloc(size_t size)
 {
+#if defined(ENABLE_SMALL_ALLOCATOR)
+    void* smallPtr = smallAlloc(size);
+    if (smallPtr)
+        return smallPtr;
+#endif
+
 #ifdef _MSC_VER
     void* ptr = _aligned_malloc(size, MIN_ALLOC_ALIGNMENT);
 #else
@@ -140,6 +205,19 @@ void* tf_malloc(size_t size)
 
 void* tf_calloc(size_t count, size_t size)
 {
+    // calloc fails on overflow, small allocator would get the wrapped size
+    if (size && count > SIZE_MAX / size)
+        return NULL;
+
+#if defined(ENABLE_SMALL_ALLOCATOR)
+    void* smallPtr = smallAlloc(count * size);
+    if (smallPtr)
+    {
+        memset(smallPtr, 0, count * size);
+        return smallPtr;
+    }
+#endif
+
 #ifdef _MSC_VER
     size_t sz = count * size;
     void*  ptr = tf_malloc(sz);
@@ -153,6 +231,12 @@ void* tf_calloc(size_t count, size_t size)
 
 void* tf_memalign(size_t alignment, size_t size)
 {
+#if defined(ENABLE_SMALL_ALLOCATOR)
+    void* smallPtr = smallAllocAligned(alignment, size);
+    if (smallPtr)
+        return smallPtr;
+#endif
+
 #ifdef _MSC_VER
     void* ptr = _aligned_malloc(size, alignment);
 #else
@@ -180,6 +264,27 @@ void* tf_calloc_memalign(size_t count, size_t alignment, size_t size)
 
 void* tf_realloc(void* ptr, size_t size)
 {
+#if defined(ENABLE_SMALL_ALLOCATOR)
+    if (!ptr)
+        return tf_malloc(size);
+
+    if (smallAllocOwns(ptr))
+    {
+        size_t oldSize = smallAllocSize(ptr);
+        // Shrinking keeps the block, stb_ds and bstrlib rarely shrink
+        if (size <= oldSize)
+            return ptr;
+
+        void* reallocPtr = tf_malloc(size);
+        if (reallocPtr)
+        {
+            memcpy(reallocPtr, ptr, oldSize);
+            smallFree(ptr);
+        }
+        return reallocPtr;
+    }
+#endif
+
 #ifdef _MSC_VER
     void* reallocPtr = _aligned_realloc(ptr, size, MIN_ALLOC_ALIGNMENT);
 #else
@@ -191,6 +296,14 @@ void* tf_realloc(void* ptr, size_t size)
 
 void tf_free(void* ptr)
 {
+#if defined(ENABLE_SMALL_ALLOCATOR)
+    if (smallAllocOwns(ptr))
+    {
+        smallFree(ptr);
+        return;
+    }
+#endif
+
 #ifdef _MSC_VER
     _aligned_free(ptr);
 #else
@@ -198,6 +311,554 @@ void tf_free(void* ptr)
 #endif
 }
 
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING) || defined(ENABLE_MEMORY_TAGS)
+
+// Callsite tracking: every block gets a small header with its size, callsite and memory tag.
+// Each thread counts allocations and frees per callsite in its own counters, snapshots add them up.
+// No locks, the only shared writes are claiming a new callsite and sampled block slots.
+// Memory tags alone use the same header, only without the callsite counters.
+
+// Raw allocator calls, IMemory.h below turns tf_malloc and friends into tracked calls
+static inline void* callsiteSystemAlloc(size_t align, size_t size)
+{
+    return align <= MIN_ALLOC_ALIGNMENT ? tf_malloc(size) : tf_memalign(align, size);
+}
+static inline void* callsiteSystemRealloc(void* ptr, size_t size) { return tf_realloc(ptr, size); }
+static inline void  callsiteSystemFree(void* ptr) { tf_free(ptr); }
+
+#define IMEMORY_FROM_HEADER
+#include "../Interfaces/IMemory.h"
+
+#include "../Interfaces/ILog.h"
+#include "../Threading/Atomics.h"
+
+#include <string.h>
+
+typedef struct CallsiteBlockHeader
+{
+    uint64_t size : 48;
+    // Sample slot + 1, 0 if the block is not sampled
+    uint64_t sampleSlot : 16;
+    uint32_t callsite : 16;
+    // Tag which was current when the block was allocated, kept through realloc
+    uint32_t tag : 16;
+    // From start of system allocation to user pointer
+    uint32_t offset;
+} CallsiteBlockHeader;
+
+static inline uint32_t currentBlockTag(void)
+{
+#if defined(ENABLE_MEMORY_TAGS)
+    return memTagCurrent();
+#else
+    return 0;
+#endif
+}
+
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+
+// Distinct allocation callsites, the rest are counted under a single "unknown" entry
+#ifndef MEMORY_CALLSITE_MAX_COUNT
+#define MEMORY_CALLSITE_MAX_COUNT 4096
+#endif
+// Sampled blocks which can be alive at the same time
+#ifndef MEMORY_SAMPLE_SLOT_COUNT
+#define MEMORY_SAMPLE_SLOT_COUNT 16384
+#endif
+// Every Nth allocation of a thread is sampled, 0 disables sampling. Can be changed with memSetSampleRate
+#ifndef MEMORY_SAMPLE_RATE
+#define MEMORY_SAMPLE_RATE 0
+#endif
+
+#define MEMORY_CALLSITE_HASH_SIZE  (MEMORY_CALLSITE_MAX_COUNT * 2)
+// Counters of a thread are allocated in pages of callsites, so that threads pay only for callsites they use
+#define MEMORY_CALLSITE_PAGE_SIZE  64
+#define MEMORY_CALLSITE_PAGE_COUNT (MEMORY_CALLSITE_MAX_COUNT / MEMORY_CALLSITE_PAGE_SIZE)
+// Sampled block slots a free-slot search looks at before giving up
+#define MEMORY_SAMPLE_PROBE_COUNT  64
+
+COMPILE_ASSERT(MEMORY_CALLSITE_MAX_COUNT <= 65536 && MEMORY_SAMPLE_SLOT_COUNT < 65536);
+
+// Counters have a single writer, plain store avoids a locked instruction per allocation
+#if defined(_MSC_VER) && !defined(NX64)
+#define callsiteCounterStore(dst, val) __iso_volatile_store64((volatile __int64*)(dst), (__int64)(val))
+#else
+#define callsiteCounterStore(dst, val) __atomic_store_n((volatile uint64_t*)(dst), (uint64_t)(val), __ATOMIC_RELAXED)
+#endif
+
+typedef struct CallsiteInfo
+{
+    const char* file;
+    const char* function;
+    uint32_t    line;
+} CallsiteInfo;
+
+typedef struct CallsiteHashEntry
+{
+    tfrg_atomic64_t key;
+    // Callsite index + 1, 0 while owner of the entry is still filling it
+    tfrg_atomic32_t index;
+} CallsiteHashEntry;
+
+typedef struct CallsiteCounters
+{
+    tfrg_atomic64_t allocCount;
+    tfrg_atomic64_t freeCount;
+    tfrg_atomic64_t allocBytes;
+    tfrg_atomic64_t freeBytes;
+} CallsiteCounters;
+
+typedef struct ThreadCallsiteCounters
+{
+    // Counters of exited threads are kept, blocks they allocated may still be freed by others
+    struct ThreadCallsiteCounters* pNext;
+    tfrg_atomicptr_t               pages[MEMORY_CALLSITE_PAGE_COUNT];
+    uint32_t                       sampleCountdown;
+    uint32_t                       sampleHint;
+} ThreadCallsiteCounters;
+
+typedef struct MemorySampleSlot
+{
+    // 0 free, 1 being filled, block pointer otherwise
+    tfrg_atomicptr_t ptr;
+    uint64_t         size;
+    uint64_t         sequence;
+    uint32_t         callsite;
+} MemorySampleSlot;
+
+static CallsiteHashEntry gCallsiteHash[MEMORY_CALLSITE_HASH_SIZE];
+static CallsiteInfo      gCallsites[MEMORY_CALLSITE_MAX_COUNT];
+// Index 0 collects callsites which didn't fit into the table
+static tfrg_atomic32_t   gCallsiteCount = 1;
+
+static tfrg_atomicptr_t gThreadCallsiteCounters = 0;
+static THREAD_LOCAL ThreadCallsiteCounters* pThreadCallsiteCounters = NULL;
+
+static MemorySampleSlot gSampleSlots[MEMORY_SAMPLE_SLOT_COUNT];
+static tfrg_atomic32_t  gSampleRate = MEMORY_SAMPLE_RATE;
+static tfrg_atomic64_t  gSampleSequence = 0;
+
+static uint32_t getCallsite(const char* f, int l, const char* sf)
+{
+    // Same __FILE__ literal can have different addresses in different translation units,
+    // such callsites are merged when the snapshot is taken
+    uint64_t key = ((uint64_t)(uintptr_t)f * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)(uint32_t)l << 1) ^ 1;
+    uint32_t hash = (uint32_t)(key >> 40);
+
+    for (uint32_t probe = 0; probe < MEMORY_CALLSITE_HASH_SIZE; ++probe)
+    {
+        CallsiteHashEntry* entry = gCallsiteHash + (hash + probe) % MEMORY_CALLSITE_HASH_SIZE;
+        uint64_t           entryKey = tfrg_atomic64_load_acquire(&entry->key);
+
+        if (entryKey == 0)
+        {
+            entryKey = tfrg_atomic64_cas_acq_rel(&entry->key, 0, key);
+            if (entryKey == 0)
+            {
+                uint32_t index = tfrg_atomic32_add_relaxed(&gCallsiteCount, 1);
+                if (index >= MEMORY_CALLSITE_MAX_COUNT)
+                    index = 0;
+                else
+                    gCallsites[index] = (CallsiteInfo){ f, sf, (uint32_t)l };
+                tfrg_atomic32_store_release(&entry->index, index + 1);
+                return index;
+            }
+        }
+
+        if (entryKey != key)
+            continue;
+
+        uint32_t index;
+        while ((index = tfrg_atomic32_load_acquire(&entry->index)) == 0)
+            tfrg_cpu_pause();
+        return index - 1;
+    }
+
+    return 0;
+}
+
+static ThreadCallsiteCounters* getThreadCallsiteCounters(void)
+{
+    ThreadCallsiteCounters* counters = pThreadCallsiteCounters;
+    if (counters)
+        return counters;
+
+    counters = (ThreadCallsiteCounters*)callsiteSystemAlloc(MIN_ALLOC_ALIGNMENT, sizeof(ThreadCallsiteCounters));
+    if (!counters)
+        return NULL;
+    memset(counters, 0, sizeof(ThreadCallsiteCounters));
+    counters->sampleCountdown = tfrg_atomic32_load_relaxed(&gSampleRate);
+    counters->sampleHint = (uint32_t)(((uintptr_t)counters >> 4) * 2654435761u);
+
+    uintptr_t head = tfrg_atomicptr_load_relaxed(&gThreadCallsiteCounters);
+    for (;;)
+    {
+        counters->pNext = (ThreadCallsiteCounters*)head;
+        uintptr_t prev = tfrg_atomicptr_cas_acq_rel(&gThreadCallsiteCounters, head, (uintptr_t)counters);
+        if (prev == head)
+            break;
+        head = prev;
+    }
+
+    pThreadCallsiteCounters = counters;
+    return counters;
+}
+
+static CallsiteCounters* getCallsiteCounters(ThreadCallsiteCounters* counters, uint32_t callsite)
+{
+    tfrg_atomicptr_t* page = counters->pages + callsite / MEMORY_CALLSITE_PAGE_SIZE;
+    CallsiteCounters* result = (CallsiteCounters*)tfrg_atomicptr_load_relaxed(page);
+
+    if (!result)
+    {
+        result = (CallsiteCounters*)callsiteSystemAlloc(MIN_ALLOC_ALIGNMENT, sizeof(CallsiteCounters) * MEMORY_CALLSITE_PAGE_SIZE);
+        if (!result)
+            return NULL;
+        memset(result, 0, sizeof(CallsiteCounters) * MEMORY_CALLSITE_PAGE_SIZE);
+        // Snapshot may read the page right away
+        tfrg_atomicptr_store_release(page, (uintptr_t)result);
+    }
+
+    return result + callsite % MEMORY_CALLSITE_PAGE_SIZE;
+}
+
+static inline void counterAdd(tfrg_atomic64_t* counter, uint64_t value)
+{
+    callsiteCounterStore(counter, tfrg_atomic64_load_relaxed(counter) + value);
+}
+
+static uint32_t sampleBlock(ThreadCallsiteCounters* counters, void* ptr, uint64_t size, uint32_t callsite)
+{
+    uint32_t rate = tfrg_atomic32_load_relaxed(&gSampleRate);
+    if (!rate)
+        return 0;
+
+    // Rate could have been changed since the countdown started
+    if (!counters->sampleCountdown || counters->sampleCountdown > rate)
+        counters->sampleCountdown = rate;
+    if (--counters->sampleCountdown)
+        return 0;
+    counters->sampleCountdown = rate;
+
+    for (uint32_t probe = 0; probe < MEMORY_SAMPLE_PROBE_COUNT; ++probe)
+    {
+        uint32_t          slotIndex = counters->sampleHint++ % MEMORY_SAMPLE_SLOT_COUNT;
+        MemorySampleSlot* slot = gSampleSlots + slotIndex;
+
+        if (tfrg_atomicptr_load_relaxed(&slot->ptr) || tfrg_atomicptr_cas_relaxed(&slot->ptr, 0, 1) != 0)
+            continue;
+
+        slot->size = size;
+        slot->callsite = callsite;
+        slot->sequence = tfrg_atomic64_add_relaxed(&gSampleSequence, 1);
+        tfrg_atomicptr_store_release(&slot->ptr, (uintptr_t)ptr);
+        return slotIndex + 1;
+    }
+
+    return 0;
+}
+
+#endif // defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+
+static void* trackAlloc(uint8_t* base, size_t offset, size_t size, uint32_t tag, const char* f, int l, const char* sf)
+{
+    UNREF_PARAM(f);
+    UNREF_PARAM(l);
+    UNREF_PARAM(sf);
+
+    if (!base)
+        return NULL;
+
+    uint8_t*             ptr = base + offset;
+    CallsiteBlockHeader* header = (CallsiteBlockHeader*)ptr - 1;
+    header->size = size;
+    header->sampleSlot = 0;
+    header->callsite = 0;
+    header->tag = tag;
+    header->offset = (uint32_t)offset;
+
+#if defined(ENABLE_MEMORY_TAGS)
+    memTagOnAlloc(tag, size);
+#endif
+
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+    ThreadCallsiteCounters* counters = getThreadCallsiteCounters();
+    if (counters)
+    {
+        header->callsite = getCallsite(f, l, sf);
+
+        CallsiteCounters* callsite = getCallsiteCounters(counters, header->callsite);
+        if (callsite)
+        {
+            counterAdd(&callsite->allocCount, 1);
+            counterAdd(&callsite->allocBytes, size);
+        }
+
+        header->sampleSlot = sampleBlock(counters, ptr, size, header->callsite);
+    }
+#endif
+
+#if defined(ENABLE_MEMORY_TAGS)
+    memTagCheckBudget();
+#endif
+    return ptr;
+}
+
+static void trackFree(CallsiteBlockHeader* header)
+{
+#if defined(ENABLE_MEMORY_TAGS)
+    memTagOnFree(header->tag, header->size);
+#endif
+
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+    if (header->sampleSlot)
+        tfrg_atomicptr_store_release(&gSampleSlots[header->sampleSlot - 1].ptr, 0);
+
+    ThreadCallsiteCounters* counters = getThreadCallsiteCounters();
+    if (!counters)
+        return;
+
+    // Freeing thread counts the free, per callsite totals only make sense summed over all threads
+    CallsiteCounters* callsite = getCallsiteCounters(counters, header->callsite);
+    if (callsite)
+    {
+        counterAdd(&callsite->freeCount, 1);
+        counterAdd(&callsite->freeBytes, header->size);
+    }
+#endif
+}
+
+static inline size_t callsiteHeaderOffset(size_t align) { return ALIGN_TO(sizeof(CallsiteBlockHeader), align); }
+
+void* tf_malloc_internal(size_t size, const char* f, int l, const char* sf)
+{
+    size_t offset = callsiteHeaderOffset(MIN_ALLOC_ALIGNMENT);
+    return trackAlloc((uint8_t*)callsiteSystemAlloc(MIN_ALLOC_ALIGNMENT, offset + size), offset, size, currentBlockTag(), f, l, sf);
+}
+
+void* tf_memalign_internal(size_t align, size_t size, const char* f, int l, const char* sf)
+{
+    align = MEM_MAX(align, MIN_ALLOC_ALIGNMENT);
+    size_t offset = callsiteHeaderOffset(align);
+    return trackAlloc((uint8_t*)callsiteSystemAlloc(align, offset + size), offset, size, currentBlockTag(), f, l, sf);
+}
+
+void* tf_calloc_internal(size_t count, size_t size, const char* f, int l, const char* sf)
+{
+    return tf_calloc_memalign_internal(count, MIN_ALLOC_ALIGNMENT, size, f, l, sf);
+}
+
+void* tf_calloc_memalign_internal(size_t count, size_t align, size_t size, const char* f, int l, const char* sf)
+{
+    align = MEM_MAX(align, MIN_ALLOC_ALIGNMENT);
+    size_t totalBytes = count * ALIGN_TO(size, align);
+    void*  ptr = tf_memalign_internal(align, totalBytes, f, l, sf);
+    if (ptr)
+        memset(ptr, 0, totalBytes);
+    return ptr;
+}
+
+void* tf_realloc_internal(void* ptr, size_t size, const char* f, int l, const char* sf)
+{
+    if (!ptr)
+        return tf_malloc_internal(size, f, l, sf);
+
+    CallsiteBlockHeader* header = (CallsiteBlockHeader*)ptr - 1;
+    size_t               offset = header->offset;
+
+    // Blocks with bigger alignment can't go through system realloc
+    if (offset != callsiteHeaderOffset(MIN_ALLOC_ALIGNMENT))
+    {
+        void* result = tf_malloc_internal(size, f, l, sf);
+        if (result)
+        {
+            memcpy(result, ptr, header->size < size ? (size_t)header->size : size);
+            tf_free_internal(ptr, f, l, sf);
+        }
+        return result;
+    }
+
+    // Header is gone after realloc, old block is counted as freed once the new one exists
+    CallsiteBlockHeader oldHeader = *header;
+
+    uint8_t* base = (uint8_t*)callsiteSystemRealloc((uint8_t*)ptr - offset, offset + size);
+    if (!base)
+    {
+        // Old block is still alive
+        return NULL;
+    }
+
+    trackFree(&oldHeader);
+    return trackAlloc(base, offset, size, oldHeader.tag, f, l, sf);
+}
+
+void tf_free_internal(void* ptr, const char* f, int l, const char* sf)
+{
+    UNREF_PARAM(f);
+    UNREF_PARAM(l);
+    UNREF_PARAM(sf);
+
+    if (!ptr)
+        return;
+
+    CallsiteBlockHeader* header = (CallsiteBlockHeader*)ptr - 1;
+    trackFree(header);
+    callsiteSystemFree((uint8_t*)ptr - header->offset);
+}
+
+#if defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+
+void memSetSampleRate(uint32_t rate) { tfrg_atomic32_store_relaxed(&gSampleRate, rate); }
+
+static int callsiteCompare(const CallsiteInfo* a, const CallsiteInfo* b)
+{
+    if (a->line != b->line)
+        return a->line < b->line ? -1 : 1;
+    if (a->file == b->file)
+        return 0;
+    return strcmp(a->file ? a->file : "", b->file ? b->file : "");
+}
+
+bool memTakeSnapshot(MemorySnapshot* pSnapshot)
+{
+    ASSERT(pSnapshot);
+    memset(pSnapshot, 0, sizeof(MemorySnapshot));
+
+    uint32_t callsiteCount = tfrg_atomic32_load_acquire(&gCallsiteCount);
+    if (callsiteCount > MEMORY_CALLSITE_MAX_COUNT)
+        callsiteCount = MEMORY_CALLSITE_MAX_COUNT;
+
+    // Snapshot arrays are allocated untracked, they would show up in the next snapshot otherwise
+    MemoryCallsite* callsites = (MemoryCallsite*)callsiteSystemAlloc(MIN_ALLOC_ALIGNMENT, sizeof(MemoryCallsite) * callsiteCount);
+    uint32_t*       remap = (uint32_t*)callsiteSystemAlloc(MIN_ALLOC_ALIGNMENT, sizeof(uint32_t) * callsiteCount);
+    MemorySample*   samples = (MemorySample*)callsiteSystemAlloc(MIN_ALLOC_ALIGNMENT, sizeof(MemorySample) * MEMORY_SAMPLE_SLOT_COUNT);
+    if (!callsites || !remap || !samples)
+    {
+        callsiteSystemFree(callsites);
+        callsiteSystemFree(remap);
+        callsiteSystemFree(samples);
+        return false;
+    }
+
+    // Merge callsites which only differ by __FILE__ literal address.
+    // Entries of callsites which are still being claimed may be empty, they are merged into index 0.
+    uint32_t count = 0;
+    for (uint32_t ci = 0; ci < callsiteCount; ++ci)
+    {
+        CallsiteInfo info = gCallsites[ci];
+        uint32_t     mi = 0;
+        if (ci && info.file)
+        {
+            for (mi = 1; mi < count; ++mi)
+            {
+                CallsiteInfo merged = { callsites[mi].file, callsites[mi].function, callsites[mi].line };
+                if (!callsiteCompare(&info, &merged))
+                    break;
+            }
+        }
+        if (mi == count || (!ci && !count))
+        {
+            memset(callsites + count, 0, sizeof(MemoryCallsite));
+            callsites[count].file = ci ? info.file : "unknown";
+            callsites[count].function = ci ? info.function : "";
+            callsites[count].line = info.line;
+            mi = count++;
+        }
+        remap[ci] = mi;
+    }
+
+    for (ThreadCallsiteCounters* counters = (ThreadCallsiteCounters*)tfrg_atomicptr_load_acquire(&gThreadCallsiteCounters); counters;
+         counters = counters->pNext)
+    {
+        for (uint32_t pi = 0; pi * MEMORY_CALLSITE_PAGE_SIZE < callsiteCount; ++pi)
+        {
+            CallsiteCounters* page = (CallsiteCounters*)tfrg_atomicptr_load_acquire(&counters->pages[pi]);
+            if (!page)
+                continue;
+
+            for (uint32_t i = 0; i < MEMORY_CALLSITE_PAGE_SIZE && pi * MEMORY_CALLSITE_PAGE_SIZE + i < callsiteCount; ++i)
+            {
+                MemoryCallsite* callsite = callsites + remap[pi * MEMORY_CALLSITE_PAGE_SIZE + i];
+                uint64_t        allocBytes = tfrg_atomic64_load_relaxed(&page[i].allocBytes);
+                uint64_t        freeBytes = tfrg_atomic64_load_relaxed(&page[i].freeBytes);
+                callsite->allocCount += tfrg_atomic64_load_relaxed(&page[i].allocCount);
+                callsite->freeCount += tfrg_atomic64_load_relaxed(&page[i].freeCount);
+                callsite->totalBytes += allocBytes;
+                // Wraps while summing when other threads freed blocks of this one, total comes out right
+                callsite->currentBytes += allocBytes - freeBytes;
+            }
+        }
+    }
+
+    for (uint32_t ci = 0; ci < count; ++ci)
+    {
+        pSnapshot->allocCount += callsites[ci].allocCount;
+        pSnapshot->freeCount += callsites[ci].freeCount;
+        pSnapshot->currentBytes += callsites[ci].currentBytes;
+        pSnapshot->totalBytes += callsites[ci].totalBytes;
+    }
+
+    uint32_t sampleCount = 0;
+    for (uint32_t si = 0; si < MEMORY_SAMPLE_SLOT_COUNT; ++si)
+    {
+        MemorySampleSlot* slot = gSampleSlots + si;
+        uintptr_t         ptr = tfrg_atomicptr_load_acquire(&slot->ptr);
+        if (ptr <= 1)
+            continue;
+
+        MemorySample sample = { (const void*)ptr, slot->size, slot->sequence, remap[slot->callsite < callsiteCount ? slot->callsite : 0] };
+        // Slot could be reused while reading it
+        tfrg_memorybarrier_acquire();
+        if (tfrg_atomicptr_load_relaxed(&slot->ptr) == ptr)
+            samples[sampleCount++] = sample;
+    }
+
+    callsiteSystemFree(remap);
+
+    pSnapshot->pCallsites = callsites;
+    pSnapshot->callsiteCount = count;
+    pSnapshot->pSamples = samples;
+    pSnapshot->sampleCount = sampleCount;
+    return true;
+}
+
+void memFreeSnapshot(MemorySnapshot* pSnapshot)
+{
+    if (!pSnapshot)
+        return;
+    callsiteSystemFree(pSnapshot->pCallsites);
+    callsiteSystemFree(pSnapshot->pSamples);
+    memset(pSnapshot, 0, sizeof(MemorySnapshot));
+}
+
+static void dumpCallsiteLeaks(void)
+{
+    MemorySnapshot snapshot;
+    if (!memTakeSnapshot(&snapshot))
+        return;
+
+    uint64_t leakCount = snapshot.allocCount - snapshot.freeCount;
+    if (leakCount)
+    {
+        _OutputDebugString("%llu memory leak%s found, %llu bytes:\n", (unsigned long long)leakCount, leakCount == 1 ? "" : "s",
+                           (unsigned long long)snapshot.currentBytes);
+
+        for (uint32_t ci = 0; ci < snapshot.callsiteCount; ++ci)
+        {
+            const MemoryCallsite* callsite = snapshot.pCallsites + ci;
+            if (callsite->allocCount != callsite->freeCount)
+                _OutputDebugString("    %s:%u %s: %llu blocks, %llu bytes\n", callsite->file, callsite->line, callsite->function,
+                                   (unsigned long long)(callsite->allocCount - callsite->freeCount), (unsigned long long)callsite->currentBytes);
+        }
+    }
+
+    memFreeSnapshot(&snapshot);
+}
+
+#endif // defined(ENABLE_CALLSITE_MEMORY_TRACKING)
+
+#else // defined(ENABLE_CALLSITE_MEMORY_TRACKING) || defined(ENABLE_MEMORY_TAGS)
+
 void* tf_malloc_internal(size_t size, const char* f, int l, const char* sf)
 {
     UNREF_PARAM(f);
@@ -246,4 +907,6 @@ void tf_free_internal(void* ptr, const char* f, int l, const char* sf)
     tf_free(ptr);
 }
 
+#endif // defined(ENABLE_CALLSITE_MEMORY_TRACKING) || defined(ENABLE_MEMORY_TAGS)
+
 #endif // defined(ENABLE_MEMORY_TRACKING)
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2017-2024 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "../../Application/Config.h"
+
+#if defined(ENABLE_SMALL_ALLOCATOR)
+
+#if defined(_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "../Interfaces/IThread.h"
+#include "../Threading/Atomics.h"
+
+// Size-class allocator for blocks up to SMALL_ALLOC_MAX_SIZE.
+// Every thread keeps a free list per size class and only goes to the central pool of the class
+// when its list runs empty or grows too long, blocks move between the two in batches.
+// Blocks live in spans of one reserved address range, so ownership and size of any pointer
+// are found without a block header.
+
+#define SMALL_ALLOC_MAX_SIZE    1024
+#define SMALL_ALLOC_GRANULARITY 16
+#define SMALL_ALLOC_SPAN_SIZE   (64 * 1024)
+#define SMALL_ALLOC_CLASS_COUNT 20
+
+// Address space only, pages are committed when spans are used
+#ifndef SMALL_ALLOC_REGION_SIZE
+#if PTR_SIZE == 8
+#define SMALL_ALLOC_REGION_SIZE (1024ull * 1024 * 1024)
+#else
+#define SMALL_ALLOC_REGION_SIZE (128u * 1024 * 1024)
+#endif
+#endif
+
+#define SMALL_ALLOC_SPAN_COUNT (SMALL_ALLOC_REGION_SIZE / SMALL_ALLOC_SPAN_SIZE)
+
+enum
+{
+    SMALL_ALLOC_UNINITIALIZED,
+    SMALL_ALLOC_INITIALIZING,
+    SMALL_ALLOC_READY,
+    SMALL_ALLOC_FAILED,
+};
+
+static const uint32_t gClassSizes[SMALL_ALLOC_CLASS_COUNT] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896, 1024,
+};
+
+// Blocks moved to or from the central pool at once, about 8 KB and at least 8 blocks
+static const uint32_t gBatchCounts[SMALL_ALLOC_CLASS_COUNT] = {
+    64, 64, 64, 64, 64, 64, 64, 64, 51, 42, 36, 32, 25, 21, 18, 16, 12, 10, 9, 8,
+};
+
+// Size class of every multiple of SMALL_ALLOC_GRANULARITY
+static const uint8_t gSizeToClass[SMALL_ALLOC_MAX_SIZE / SMALL_ALLOC_GRANULARITY + 1] = {
+    0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11,
+    11, 12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15,
+    15, 16, 16, 16, 16, 16, 16, 16, 16, 17, 17, 17, 17, 17, 17, 17,
+    17, 18, 18, 18, 18, 18, 18, 18, 18, 19, 19, 19, 19, 19, 19, 19,
+    19,
+};
+
+// Free blocks are linked through their first pointer, first block of a batch links the next batch through its second one
+typedef struct SmallAllocBlock
+{
+    struct SmallAllocBlock* pNext;
+    struct SmallAllocBlock* pNextBatch;
+} SmallAllocBlock;
+
+typedef struct SmallAllocCentral
+{
+    tfrg_atomic32_t lock;
+    uint32_t        looseCount;
+    // Full batches returned by threads
+    SmallAllocBlock* pBatches;
+    // Leftovers of exited threads
+    SmallAllocBlock* pLoose;
+    // Rest of the span which is being carved
+    uint8_t*         pCursor;
+    uint8_t*         pEnd;
+    uint8_t          padding[64 - 2 * sizeof(uint32_t) - 4 * sizeof(void*)];
+} SmallAllocCentral;
+
+typedef struct SmallAllocCache
+{
+    SmallAllocBlock* pHead;
+    uint32_t         count;
+} SmallAllocCache;
+
+static tfrg_atomic32_t   gSmallAllocState = SMALL_ALLOC_UNINITIALIZED;
+static uint8_t*          pSmallAllocBase = NULL;
+static uint8_t*          pSmallAllocEnd = NULL;
+static tfrg_atomic32_t   gSmallAllocSpanCount = 0;
+static uint8_t           gSpanClasses[SMALL_ALLOC_SPAN_COUNT];
+static SmallAllocCentral gCentral[SMALL_ALLOC_CLASS_COUNT];
+
+static THREAD_LOCAL SmallAllocCache gThreadCaches[SMALL_ALLOC_CLASS_COUNT];
+
+static void lockCentral(SmallAllocCentral* central)
+{
+    for (uint32_t spin = 0; tfrg_atomic32_load_relaxed(&central->lock) || tfrg_atomic32_cas_acq_rel(&central->lock, 0, 1) != 0; ++spin)
+    {
+        // Lock is only held for a few pointer writes, sleeping helps when the holder got preempted
+        if (spin < 64)
+            tfrg_cpu_pause();
+        else
+            threadSleep(0);
+    }
+}
+
+static void unlockCentral(SmallAllocCentral* central) { tfrg_atomic32_store_release(&central->lock, 0); }
+
+static bool reserveRegion(void)
+{
+#if defined(_WINDOWS)
+    pSmallAllocBase = (uint8_t*)VirtualAlloc(NULL, SMALL_ALLOC_REGION_SIZE, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void* base = mmap(NULL, SMALL_ALLOC_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    pSmallAllocBase = base == MAP_FAILED ? NULL : (uint8_t*)base;
+#endif
+    if (!pSmallAllocBase)
+        return false;
+
+    // Spans are aligned to their size, so that power of two classes are aligned to their size too
+    uint8_t* alignedBase = (uint8_t*)(((uintptr_t)pSmallAllocBase + SMALL_ALLOC_SPAN_SIZE - 1) & ~(uintptr_t)(SMALL_ALLOC_SPAN_SIZE - 1));
+    pSmallAllocEnd = pSmallAllocBase + SMALL_ALLOC_REGION_SIZE;
+    pSmallAllocBase = alignedBase;
+    return true;
+}
+
+static bool initSmallAlloc(void)
+{
+    uint32_t state = tfrg_atomic32_load_acquire(&gSmallAllocState);
+    if (state == SMALL_ALLOC_UNINITIALIZED && tfrg_atomic32_cas_relaxed(&gSmallAllocState, SMALL_ALLOC_UNINITIALIZED, SMALL_ALLOC_INITIALIZING) ==
+                                                 SMALL_ALLOC_UNINITIALIZED)
+    {
+        state = reserveRegion() ? SMALL_ALLOC_READY : SMALL_ALLOC_FAILED;
+        tfrg_atomic32_store_release(&gSmallAllocState, state);
+    }
+
+    while (state == SMALL_ALLOC_INITIALIZING || state == SMALL_ALLOC_UNINITIALIZED)
+    {
+        tfrg_cpu_pause();
+        state = tfrg_atomic32_load_acquire(&gSmallAllocState);
+    }
+
+    return state == SMALL_ALLOC_READY;
+}
+
+static uint8_t* claimSpan(uint32_t classIndex)
+{
+    uint32_t spanIndex = tfrg_atomic32_add_relaxed(&gSmallAllocSpanCount, 1);
+    uint8_t* span = pSmallAllocBase + (size_t)spanIndex * SMALL_ALLOC_SPAN_SIZE;
+    if (span + SMALL_ALLOC_SPAN_SIZE > pSmallAllocEnd)
+        return NULL;
+
+#if defined(_WINDOWS)
+    if (!VirtualAlloc(span, SMALL_ALLOC_SPAN_SIZE, MEM_COMMIT, PAGE_READWRITE))
+        return NULL;
+#endif
+
+    // Blocks of the span only reach other threads through synchronized handoffs, which publish this too
+    gSpanClasses[spanIndex] = (uint8_t)classIndex;
+    return span;
+}
+
+// Fills the empty cache of the calling thread with one batch of blocks
+static bool refillCache(SmallAllocCache* cache, uint32_t classIndex)
+{
+    SmallAllocCentral* central = gCentral + classIndex;
+    uint32_t           batch = gBatchCounts[classIndex];
+    uint32_t           blockSize = gClassSizes[classIndex];
+
+    lockCentral(central);
+
+    if (central->pBatches)
+    {
+        cache->pHead = central->pBatches;
+        cache->count = batch;
+        central->pBatches = central->pBatches->pNextBatch;
+    }
+    else if (central->pLoose)
+    {
+        SmallAllocBlock* last = central->pLoose;
+        uint32_t         count = 1;
+        for (; count < batch && last->pNext; ++count)
+            last = last->pNext;
+
+        cache->pHead = central->pLoose;
+        cache->count = count;
+        central->pLoose = last->pNext;
+        central->looseCount -= count;
+        last->pNext = NULL;
+    }
+    else
+    {
+        if (central->pCursor + blockSize > central->pEnd)
+        {
+            uint8_t* span = claimSpan(classIndex);
+            if (!span)
+            {
+                unlockCentral(central);
+                return false;
+            }
+            central->pCursor = span;
+            central->pEnd = span + SMALL_ALLOC_SPAN_SIZE;
+        }
+
+        // Carve a batch at a time, so that untouched pages of the span stay uncommitted
+        uint32_t count = (uint32_t)((central->pEnd - central->pCursor) / blockSize);
+        if (count > batch)
+            count = batch;
+
+        SmallAllocBlock* head = (SmallAllocBlock*)central->pCursor;
+        for (uint32_t i = 0; i < count; ++i)
+            ((SmallAllocBlock*)(central->pCursor + i * blockSize))->pNext =
+                i + 1 < count ? (SmallAllocBlock*)(central->pCursor + (i + 1) * blockSize) : NULL;
+        central->pCursor += (size_t)count * blockSize;
+
+        cache->pHead = head;
+        cache->count = count;
+    }
+
+    unlockCentral(central);
+    return true;
+}
+
+// Moves one full batch from the cache of the calling thread to the central pool
+static void flushCache(SmallAllocCache* cache, uint32_t classIndex)
+{
+    SmallAllocCentral* central = gCentral + classIndex;
+    uint32_t           batch = gBatchCounts[classIndex];
+
+    SmallAllocBlock* head = cache->pHead;
+    SmallAllocBlock* last = head;
+    for (uint32_t i = 1; i < batch; ++i)
+        last = last->pNext;
+
+    cache->pHead = last->pNext;
+    cache->count -= batch;
+    last->pNext = NULL;
+
+    lockCentral(central);
+    head->pNextBatch = central->pBatches;
+    central->pBatches = head;
+    unlockCentral(central);
+}
+
+bool smallAllocOwns(const void* ptr)
+{
+    // Region bounds are only valid after the state is published
+    return tfrg_atomic32_load_acquire(&gSmallAllocState) == SMALL_ALLOC_READY && (const uint8_t*)ptr >= pSmallAllocBase &&
+           (const uint8_t*)ptr < pSmallAllocEnd;
+}
+
+size_t smallAllocSize(const void* ptr)
+{
+    return gClassSizes[gSpanClasses[((const uint8_t*)ptr - pSmallAllocBase) / SMALL_ALLOC_SPAN_SIZE]];
+}
+
+// Returns NULL when the request can't be served from a size class, caller falls back to the system allocator
+void* smallAllocAligned(size_t align, size_t size)
+{
+    if (size > SMALL_ALLOC_MAX_SIZE || align > SMALL_ALLOC_MAX_SIZE)
+        return NULL;
+
+    uint32_t classIndex = gSizeToClass[(size + SMALL_ALLOC_GRANULARITY - 1) / SMALL_ALLOC_GRANULARITY];
+    // Blocks are placed at multiples of their size from a span aligned start
+    if (align > SMALL_ALLOC_GRANULARITY)
+    {
+        while (classIndex < SMALL_ALLOC_CLASS_COUNT && gClassSizes[classIndex] % align)
+            ++classIndex;
+        if (classIndex == SMALL_ALLOC_CLASS_COUNT)
+            return NULL;
+    }
+
+    SmallAllocCache* cache = gThreadCaches + classIndex;
+    if (!cache->pHead)
+    {
+        if (!initSmallAlloc() || !refillCache(cache, classIndex))
+            return NULL;
+    }
+
+    SmallAllocBlock* block = cache->pHead;
+    cache->pHead = block->pNext;
+    --cache->count;
+    return block;
+}
+
+void* smallAlloc(size_t size) { return smallAllocAligned(SMALL_ALLOC_GRANULARITY, size); }
+
+void smallFree(void* ptr)
+{
+    uint32_t         classIndex = gSpanClasses[((uint8_t*)ptr - pSmallAllocBase) / SMALL_ALLOC_SPAN_SIZE];
+    SmallAllocCache* cache = gThreadCaches + classIndex;
+
+    SmallAllocBlock* block = (SmallAllocBlock*)ptr;
+    block->pNext = cache->pHead;
+    cache->pHead = block;
+
+    if (++cache->count >= 2 * gBatchCounts[classIndex])
+        flushCache(cache, classIndex);
+}
+
+// Returns all cached blocks of the calling thread to the central pools
+void smallAllocExitThread(void)
+{
+    for (uint32_t classIndex = 0; classIndex < SMALL_ALLOC_CLASS_COUNT; ++classIndex)
+    {
+        SmallAllocCache* cache = gThreadCaches + classIndex;
+        while (cache->count >= gBatchCounts[classIndex])
+            flushCache(cache, classIndex);
+
+        if (!cache->pHead)
+            continue;
+
+        SmallAllocCentral* central = gCentral + classIndex;
+        SmallAllocBlock*   last = cache->pHead;
+        while (last->pNext)
+            last = last->pNext;
+
+        lockCentral(central);
+        last->pNext = central->pLoose;
+        central->pLoose = cache->pHead;
+        central->looseCount += cache->count;
+        unlockCentral(central);
+
+        cache->pHead = NULL;
+        cache->count = 0;
+    }
+}
+
+#endif // defined(ENABLE_SMALL_ALLOCATOR)
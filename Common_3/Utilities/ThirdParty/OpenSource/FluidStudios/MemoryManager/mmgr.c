@@ -863,6 +863,7 @@ bool initMemAlloc(const char* appName)
 
 void exitMemAlloc(void)
 {
+    exitFrameArenas();
     dumpLeakReport();
 
 #if MMGR_BACKTRACE
@@ -1167,6 +1168,9 @@ void* mmgrAllocator(const char* sourceFile, const unsigned int sourceLine, const
         au->allocationType = allocationType;
         au->sourceLine = sourceLine;
         au->allocationNumber = currentAllocationCount;
+#if defined(ENABLE_MEMORY_TAGS)
+        au->tag = memTagCurrent();
+#endif
 
         // Make sure the address we return to user is aligned to the specified alignment
         size_t offset = ((size_t)au->reportedAddress) % alignment;
@@ -1242,6 +1246,9 @@ void* mmgrAllocator(const char* sourceFile, const unsigned int sourceLine, const
         stats.totalReportedMemory += (unsigned int)(au->reportedSize);
         stats.totalActualMemory += (unsigned int)(au->actualSize);
         stats.totalAllocUnitCount++;
+#if defined(ENABLE_MEMORY_TAGS)
+        memTagOnAlloc(au->tag, au->reportedSize);
+#endif
         if (stats.totalReportedMemory > stats.peakReportedMemory)
             stats.peakReportedMemory = stats.totalReportedMemory;
         if (stats.totalActualMemory > stats.peakActualMemory)
@@ -1421,6 +1428,9 @@ void* mmgrReallocator(const char* sourceFile, const unsigned int sourceLine, con
 
         stats.totalReportedMemory -= (unsigned int)(au->reportedSize);
         stats.totalActualMemory -= (unsigned int)(au->actualSize);
+#if defined(ENABLE_MEMORY_TAGS)
+        memTagOnFree(au->tag, au->reportedSize);
+#endif
 
         // Update the allocation with the new information
 
@@ -1516,6 +1526,9 @@ void* mmgrReallocator(const char* sourceFile, const unsigned int sourceLine, con
 
         stats.totalReportedMemory += (unsigned int)(au->reportedSize);
         stats.totalActualMemory += (unsigned int)(au->actualSize);
+#if defined(ENABLE_MEMORY_TAGS)
+        memTagOnAlloc(au->tag, au->reportedSize);
+#endif
         if (stats.totalReportedMemory > stats.peakReportedMemory)
             stats.peakReportedMemory = stats.totalReportedMemory;
         if (stats.totalActualMemory > stats.peakActualMemory)
@@ -1660,6 +1673,9 @@ void mmgrDeallocator(const char* sourceFile, const unsigned int sourceLine, cons
         stats.totalReportedMemory -= (unsigned int)(au->reportedSize);
         stats.totalActualMemory -= (unsigned int)(au->actualSize);
         stats.totalAllocUnitCount--;
+#if defined(ENABLE_MEMORY_TAGS)
+        memTagOnFree(au->tag, au->reportedSize);
+#endif
 
         // Add this allocation unit to the front of our reservoir of unused allocation units
 
@@ -79,6 +79,9 @@ typedef struct tag_au
 	bool           breakOnDealloc;
 	bool           breakOnRealloc;
 	unsigned int   allocationNumber;
+#if defined(ENABLE_MEMORY_TAGS)
+	unsigned int   tag;
+#endif
 	struct tag_au* next;
 	struct tag_au* prev;
 } sAllocUnit;
@@ -26,6 +26,19 @@
 
 #include "../../Application/Config.h"
 
+// Atomic variables are plain integers, so they can be shared between C and C++ code and initialized statically,
+// but they must be accessed only through functions below.
+//
+// Memory ordering follows C11 / C++11 memory model:
+//   relaxed - atomicity only, no ordering of surrounding memory accesses
+//   acquire - accesses after it can't be moved before it, pairs with release
+//   release - accesses before it can't be moved after it
+//   acq_rel - both, use it for reference counts and other counters which hand over data
+//
+// store_* return previous value (exchange), cas_* return value read before exchange.
+//
+// tfrg_cpu_pause() is a spin-wait hint, put it in busy loops polling an atomic.
+
 typedef volatile ALIGNAS(4) uint32_t tfrg_atomic32_t;
 typedef volatile ALIGNAS(8) uint64_t tfrg_atomic64_t;
 typedef volatile ALIGNAS(PTR_SIZE) uintptr_t tfrg_atomicptr_t;
@@ -34,37 +47,40 @@ typedef volatile ALIGNAS(PTR_SIZE) uintptr_t tfrg_atomicptr_t;
 #include <intrin.h>
 #include <windows.h>
 
-#define tfrg_memorybarrier_acquire()                     _ReadWriteBarrier()
-#define tfrg_memorybarrier_release()                     _ReadWriteBarrier()
+#if defined(_M_ARM64) || defined(_M_ARM)
+#define tfrg_memorybarrier_acquire() __dmb(_ARM64_BARRIER_ISH)
+#define tfrg_memorybarrier_release() __dmb(_ARM64_BARRIER_ISH)
+#else
+// x86 and x64 don't reorder loads with loads and stores with stores
+#define tfrg_memorybarrier_acquire() _ReadWriteBarrier()
+#define tfrg_memorybarrier_release() _ReadWriteBarrier()
+#endif
+#define tfrg_memorybarrier_full()                        MemoryBarrier()
 
-#define tfrg_atomic32_load_relaxed(pVar)                 (*(pVar))
-#define tfrg_atomic32_store_relaxed(dst, val)            (uint32_t) InterlockedExchange((volatile long*)(dst), val)
-#define tfrg_atomic32_add_relaxed(dst, val)              (uint32_t) InterlockedExchangeAdd((volatile long*)(dst), (val))
-#define tfrg_atomic32_cas_relaxed(dst, cmp_val, new_val) (uint32_t) InterlockedCompareExchange((volatile long*)(dst), (new_val), (cmp_val))
+#if defined(_M_ARM64) || defined(_M_ARM)
+#define tfrg_cpu_pause() __yield()
+#else
+#define tfrg_cpu_pause() _mm_pause()
+#endif
 
-#define tfrg_atomic64_load_relaxed(pVar)                 (*(pVar))
-#define tfrg_atomic64_store_relaxed(dst, val)            (uint64_t) InterlockedExchange64((volatile LONG64*)(dst), val)
-#define tfrg_atomic64_add_relaxed(dst, val)              (uint64_t) InterlockedExchangeAdd64((volatile LONG64*)(dst), (val))
+#define tfrg_atomic32_load_relaxed(pVar)                 (uint32_t) __iso_volatile_load32((const volatile __int32*)(pVar))
+#define tfrg_atomic32_store_relaxed(dst, val)            (uint32_t) InterlockedExchangeNoFence((volatile long*)(dst), (val))
+#define tfrg_atomic32_add_relaxed(dst, val)              (uint32_t) InterlockedExchangeAddNoFence((volatile long*)(dst), (val))
+#define tfrg_atomic32_add_acq_rel(dst, val)              (uint32_t) InterlockedExchangeAdd((volatile long*)(dst), (val))
+#define tfrg_atomic32_cas_relaxed(dst, cmp_val, new_val) \
+    (uint32_t) InterlockedCompareExchangeNoFence((volatile long*)(dst), (new_val), (cmp_val))
+#define tfrg_atomic32_cas_acq_rel(dst, cmp_val, new_val) (uint32_t) InterlockedCompareExchange((volatile long*)(dst), (new_val), (cmp_val))
+
+#define tfrg_atomic64_load_relaxed(pVar)                 (uint64_t) __iso_volatile_load64((const volatile __int64*)(pVar))
+#define tfrg_atomic64_store_relaxed(dst, val)            (uint64_t) InterlockedExchangeNoFence64((volatile LONG64*)(dst), (val))
+#define tfrg_atomic64_add_relaxed(dst, val)              (uint64_t) InterlockedExchangeAddNoFence64((volatile LONG64*)(dst), (val))
+#define tfrg_atomic64_add_acq_rel(dst, val)              (uint64_t) InterlockedExchangeAdd64((volatile LONG64*)(dst), (val))
 #define tfrg_atomic64_cas_relaxed(dst, cmp_val, new_val) \
+    (uint64_t) InterlockedCompareExchangeNoFence64((volatile LONG64*)(dst), (new_val), (cmp_val))
+#define tfrg_atomic64_cas_acq_rel(dst, cmp_val, new_val) \
     (uint64_t) InterlockedCompareExchange64((volatile LONG64*)(dst), (new_val), (cmp_val))
 
-#else
-#define tfrg_memorybarrier_acquire()                     __asm__ __volatile__("" : : : "memory")
-#define tfrg_memorybarrier_release()                     __asm__ __volatile__("" : : : "memory")
-
-#define tfrg_atomic32_load_relaxed(pVar)                 (*(pVar))
-#define tfrg_atomic32_store_relaxed(dst, val)            __sync_lock_test_and_set((volatile int32_t*)(dst), val)
-#define tfrg_atomic32_add_relaxed(dst, val)              __sync_fetch_and_add((volatile int32_t*)(dst), (val))
-#define tfrg_atomic32_cas_relaxed(dst, cmp_val, new_val) __sync_val_compare_and_swap((volatile int32_t*)(dst), (cmp_val), (new_val))
-
-#define tfrg_atomic64_load_relaxed(pVar)                 (*(pVar))
-#define tfrg_atomic64_store_relaxed(dst, val)            __sync_lock_test_and_set((volatile int64_t*)(dst), val)
-#define tfrg_atomic64_add_relaxed(dst, val)              __sync_fetch_and_add((volatile int64_t*)(dst), (val))
-#define tfrg_atomic64_cas_relaxed(dst, cmp_val, new_val) __sync_val_compare_and_swap((volatile int64_t*)(dst), (cmp_val), (new_val))
-
-#endif
-
-static inline uint32_t tfrg_atomic32_load_acquire(tfrg_atomic32_t* pVar)
+static inline uint32_t tfrg_atomic32_load_acquire(const tfrg_atomic32_t* pVar)
 {
     uint32_t value = tfrg_atomic32_load_relaxed(pVar);
     tfrg_memorybarrier_acquire();
@@ -77,17 +93,7 @@ static inline uint32_t tfrg_atomic32_store_release(tfrg_atomic32_t* pVar, uint32
     return tfrg_atomic32_store_relaxed(pVar, val);
 }
 
-static inline uint32_t tfrg_atomic32_max_relaxed(tfrg_atomic32_t* dst, uint32_t val)
-{
-    uint32_t prev_val = val;
-    do
-    {
-        prev_val = tfrg_atomic32_cas_relaxed(dst, prev_val, val);
-    } while (prev_val < val);
-    return prev_val;
-}
-
-static inline uint64_t tfrg_atomic64_load_acquire(tfrg_atomic64_t* pVar)
+static inline uint64_t tfrg_atomic64_load_acquire(const tfrg_atomic64_t* pVar)
 {
     uint64_t value = tfrg_atomic64_load_relaxed(pVar);
     tfrg_memorybarrier_acquire();
@@ -100,6 +106,76 @@ static inline uint64_t tfrg_atomic64_store_release(tfrg_atomic64_t* pVar, uint64
     return tfrg_atomic64_store_relaxed(pVar, val);
 }
 
+#else
+// Same builtins <stdatomic.h> and std::atomic are implemented with,
+// but they work on plain integers in both C and C++
+#define tfrg_memorybarrier_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define tfrg_memorybarrier_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define tfrg_memorybarrier_full()    __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#if defined(__i386__) || defined(__x86_64__)
+#define tfrg_cpu_pause() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define tfrg_cpu_pause() __asm__ __volatile__("yield")
+#else
+#define tfrg_cpu_pause() ((void)0)
+#endif
+
+#define tfrg_atomic32_load_relaxed(pVar)                 __atomic_load_n((const volatile uint32_t*)(pVar), __ATOMIC_RELAXED)
+#define tfrg_atomic32_load_acquire(pVar)                 __atomic_load_n((const volatile uint32_t*)(pVar), __ATOMIC_ACQUIRE)
+#define tfrg_atomic32_store_relaxed(dst, val)            __atomic_exchange_n((volatile uint32_t*)(dst), (uint32_t)(val), __ATOMIC_RELAXED)
+#define tfrg_atomic32_store_release(dst, val)            __atomic_exchange_n((volatile uint32_t*)(dst), (uint32_t)(val), __ATOMIC_RELEASE)
+#define tfrg_atomic32_add_relaxed(dst, val)              __atomic_fetch_add((volatile uint32_t*)(dst), (uint32_t)(val), __ATOMIC_RELAXED)
+#define tfrg_atomic32_add_acq_rel(dst, val)              __atomic_fetch_add((volatile uint32_t*)(dst), (uint32_t)(val), __ATOMIC_ACQ_REL)
+#define tfrg_atomic32_cas_relaxed(dst, cmp_val, new_val) tfrg_atomic32_cas_relaxed_impl((volatile uint32_t*)(dst), (cmp_val), (new_val))
+#define tfrg_atomic32_cas_acq_rel(dst, cmp_val, new_val) tfrg_atomic32_cas_acq_rel_impl((volatile uint32_t*)(dst), (cmp_val), (new_val))
+
+#define tfrg_atomic64_load_relaxed(pVar)                 __atomic_load_n((const volatile uint64_t*)(pVar), __ATOMIC_RELAXED)
+#define tfrg_atomic64_load_acquire(pVar)                 __atomic_load_n((const volatile uint64_t*)(pVar), __ATOMIC_ACQUIRE)
+#define tfrg_atomic64_store_relaxed(dst, val)            __atomic_exchange_n((volatile uint64_t*)(dst), (uint64_t)(val), __ATOMIC_RELAXED)
+#define tfrg_atomic64_store_release(dst, val)            __atomic_exchange_n((volatile uint64_t*)(dst), (uint64_t)(val), __ATOMIC_RELEASE)
+#define tfrg_atomic64_add_relaxed(dst, val)              __atomic_fetch_add((volatile uint64_t*)(dst), (uint64_t)(val), __ATOMIC_RELAXED)
+#define tfrg_atomic64_add_acq_rel(dst, val)              __atomic_fetch_add((volatile uint64_t*)(dst), (uint64_t)(val), __ATOMIC_ACQ_REL)
+#define tfrg_atomic64_cas_relaxed(dst, cmp_val, new_val) tfrg_atomic64_cas_relaxed_impl((volatile uint64_t*)(dst), (cmp_val), (new_val))
+#define tfrg_atomic64_cas_acq_rel(dst, cmp_val, new_val) tfrg_atomic64_cas_acq_rel_impl((volatile uint64_t*)(dst), (cmp_val), (new_val))
+
+// On failure compare value receives current value, so it is the previous value either way
+static inline uint32_t tfrg_atomic32_cas_relaxed_impl(volatile uint32_t* dst, uint32_t cmp_val, uint32_t new_val)
+{
+    __atomic_compare_exchange_n(dst, &cmp_val, new_val, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return cmp_val;
+}
+
+static inline uint32_t tfrg_atomic32_cas_acq_rel_impl(volatile uint32_t* dst, uint32_t cmp_val, uint32_t new_val)
+{
+    __atomic_compare_exchange_n(dst, &cmp_val, new_val, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return cmp_val;
+}
+
+static inline uint64_t tfrg_atomic64_cas_relaxed_impl(volatile uint64_t* dst, uint64_t cmp_val, uint64_t new_val)
+{
+    __atomic_compare_exchange_n(dst, &cmp_val, new_val, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return cmp_val;
+}
+
+static inline uint64_t tfrg_atomic64_cas_acq_rel_impl(volatile uint64_t* dst, uint64_t cmp_val, uint64_t new_val)
+{
+    __atomic_compare_exchange_n(dst, &cmp_val, new_val, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return cmp_val;
+}
+
+#endif
+
+static inline uint32_t tfrg_atomic32_max_relaxed(tfrg_atomic32_t* dst, uint32_t val)
+{
+    uint32_t prev_val = val;
+    do
+    {
+        prev_val = tfrg_atomic32_cas_relaxed(dst, prev_val, val);
+    } while (prev_val < val);
+    return prev_val;
+}
+
 static inline uint64_t tfrg_atomic64_max_relaxed(tfrg_atomic64_t* dst, uint64_t val)
 {
     uint64_t prev_val = val;
@@ -116,7 +192,9 @@ static inline uint64_t tfrg_atomic64_max_relaxed(tfrg_atomic64_t* dst, uint64_t
 #define tfrg_atomicptr_store_relaxed tfrg_atomic32_store_relaxed
 #define tfrg_atomicptr_store_release tfrg_atomic32_store_release
 #define tfrg_atomicptr_add_relaxed   tfrg_atomic32_add_relaxed
+#define tfrg_atomicptr_add_acq_rel   tfrg_atomic32_add_acq_rel
 #define tfrg_atomicptr_cas_relaxed   tfrg_atomic32_cas_relaxed
+#define tfrg_atomicptr_cas_acq_rel   tfrg_atomic32_cas_acq_rel
 #define tfrg_atomicptr_max_relaxed   tfrg_atomic32_max_relaxed
 #elif PTR_SIZE == 8
 #define tfrg_atomicptr_load_relaxed  tfrg_atomic64_load_relaxed
@@ -124,6 +202,8 @@ static inline uint64_t tfrg_atomic64_max_relaxed(tfrg_atomic64_t* dst, uint64_t
 #define tfrg_atomicptr_store_relaxed tfrg_atomic64_store_relaxed
 #define tfrg_atomicptr_store_release tfrg_atomic64_store_release
 #define tfrg_atomicptr_add_relaxed   tfrg_atomic64_add_relaxed
+#define tfrg_atomicptr_add_acq_rel   tfrg_atomic64_add_acq_rel
 #define tfrg_atomicptr_cas_relaxed   tfrg_atomic64_cas_relaxed
+#define tfrg_atomicptr_cas_acq_rel   tfrg_atomic64_cas_acq_rel
 #define tfrg_atomicptr_max_relaxed   tfrg_atomic64_max_relaxed
 #endif
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2017-2024 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "RingQueue.h"
+
+#include "../Interfaces/ILog.h"
+#include "../Interfaces/IThread.h"
+#include "../Interfaces/ITime.h"
+
+#include "../Interfaces/IMemory.h"
+
+// Polls before going to sleep, handoff between busy threads usually completes within this window
+#define RING_QUEUE_SPIN_COUNT 256
+
+typedef bool (*RingQueueTryFunc)(void* queue, void* element);
+
+// Spinning only steals time from the other side on single core
+static uint32_t ringQueueSpinCount(void)
+{
+    static tfrg_atomic32_t spinCount = UINT32_MAX;
+    uint32_t               result = tfrg_atomic32_load_relaxed(&spinCount);
+    if (result == UINT32_MAX)
+    {
+        result = getNumCPUCores() > 1 ? RING_QUEUE_SPIN_COUNT : 0;
+        tfrg_atomic32_store_relaxed(&spinCount, result);
+    }
+    return result;
+}
+
+static uint32_t ringQueueCapacity(uint32_t capacity)
+{
+    ASSERT(capacity > 0 && capacity <= RING_QUEUE_MAX_CAPACITY);
+    uint32_t result = 1;
+    while (result < capacity)
+        result <<= 1;
+    return result;
+}
+
+// Called by the side which made progress, after publishing it
+static inline void ringQueueNotify(RingQueueSignal* signal)
+{
+    // Pairs with the fence in ringQueueWait: either we see the waiter, or the waiter sees our progress
+    tfrg_memorybarrier_full();
+    if (tfrg_atomic32_load_relaxed(&signal->waiting) == 0)
+        return;
+
+    // Wake everybody and clear the flag, so following calls don't make syscalls
+    // until somebody goes to sleep again. Waiters which still can't progress set it back.
+    if (tfrg_atomic32_store_relaxed(&signal->waiting, 0) == 0)
+        return;
+    tfrg_atomic32_add_acq_rel(&signal->signal, 1);
+    wakeAllAddress(&signal->signal);
+}
+
+static bool ringQueueWait(void* queue, void* element, RingQueueTryFunc tryFunc, RingQueueSignal* signal, uint32_t msTimeout)
+{
+    int64_t deadline = 0;
+    if (msTimeout != TIMEOUT_INFINITE)
+        deadline = getUSec(false) + (int64_t)msTimeout * 1000;
+
+    const uint32_t spinCount = ringQueueSpinCount();
+
+    for (uint32_t spin = 0;; ++spin)
+    {
+        if (tryFunc(queue, element))
+            return true;
+
+        if (spin < spinCount)
+        {
+            tfrg_cpu_pause();
+            continue;
+        }
+
+        uint32_t ms = TIMEOUT_INFINITE;
+        if (msTimeout != TIMEOUT_INFINITE)
+        {
+            int64_t timeLeft = deadline - getUSec(false);
+            if (timeLeft <= 0)
+                return false;
+            ms = (uint32_t)((timeLeft + 999) / 1000);
+        }
+
+        tfrg_atomic32_store_relaxed(&signal->waiting, 1);
+        uint32_t observed = tfrg_atomic32_load_acquire(&signal->signal);
+        tfrg_memorybarrier_full();
+
+        // Recheck after announcing ourselves, otherwise progress made just before that is never signaled
+        if (tryFunc(queue, element))
+            return true;
+
+        waitAddress(&signal->signal, observed, ms);
+    }
+}
+
+/************************************************************************/
+// SPSC
+/************************************************************************/
+
+bool spscQueueInit(SpscQueue* queue, uint32_t capacity, uint32_t elementSize)
+{
+    ASSERT(queue && elementSize > 0);
+    memset(queue, 0, sizeof *queue);
+
+    capacity = ringQueueCapacity(capacity);
+    queue->buffer = (uint8_t*)tf_malloc((size_t)capacity * elementSize);
+    if (!queue->buffer)
+        return false;
+
+    queue->mask = capacity - 1;
+    queue->elementSize = elementSize;
+    return true;
+}
+
+void spscQueueExit(SpscQueue* queue)
+{
+    if (!queue)
+        return;
+    tf_free(queue->buffer);
+    memset(queue, 0, sizeof *queue);
+}
+
+bool spscQueueTryPush(SpscQueue* queue, const void* element)
+{
+    uint32_t tail = tfrg_atomic32_load_relaxed(&queue->tail);
+    if (tail - queue->cachedHead > queue->mask)
+    {
+        queue->cachedHead = tfrg_atomic32_load_acquire(&queue->head);
+        if (tail - queue->cachedHead > queue->mask)
+            return false;
+    }
+
+    memcpy(queue->buffer + (size_t)(tail & queue->mask) * queue->elementSize, element, queue->elementSize);
+    tfrg_atomic32_store_release(&queue->tail, tail + 1);
+
+    ringQueueNotify(&queue->notEmpty);
+    return true;
+}
+
+bool spscQueueTryPop(SpscQueue* queue, void* element)
+{
+    uint32_t head = tfrg_atomic32_load_relaxed(&queue->head);
+    if (head == queue->cachedTail)
+    {
+        queue->cachedTail = tfrg_atomic32_load_acquire(&queue->tail);
+        if (head == queue->cachedTail)
+            return false;
+    }
+
+    memcpy(element, queue->buffer + (size_t)(head & queue->mask) * queue->elementSize, queue->elementSize);
+    tfrg_atomic32_store_release(&queue->head, head + 1);
+
+    ringQueueNotify(&queue->notFull);
+    return true;
+}
+
+static bool spscQueueTryPushFunc(void* queue, void* element) { return spscQueueTryPush((SpscQueue*)queue, element); }
+
+static bool spscQueueTryPopFunc(void* queue, void* element) { return spscQueueTryPop((SpscQueue*)queue, element); }
+
+bool spscQueuePush(SpscQueue* queue, const void* element, uint32_t msTimeout)
+{
+    return ringQueueWait(queue, (void*)element, spscQueueTryPushFunc, &queue->notFull, msTimeout);
+}
+
+bool spscQueuePop(SpscQueue* queue, void* element, uint32_t msTimeout)
+{
+    return ringQueueWait(queue, element, spscQueueTryPopFunc, &queue->notEmpty, msTimeout);
+}
+
+/************************************************************************/
+// MPMC
+/************************************************************************/
+
+// Cell is sequence number followed by element, element starts at 8 bytes alignment
+#define MPMC_CELL_HEADER_SIZE 8
+
+static inline tfrg_atomic32_t* mpmcCellSequence(MpmcQueue* queue, uint32_t pos)
+{
+    return (tfrg_atomic32_t*)(queue->cells + (size_t)(pos & queue->mask) * queue->cellSize);
+}
+
+static inline uint8_t* mpmcCellData(MpmcQueue* queue, uint32_t pos)
+{
+    return queue->cells + (size_t)(pos & queue->mask) * queue->cellSize + MPMC_CELL_HEADER_SIZE;
+}
+
+bool mpmcQueueInit(MpmcQueue* queue, uint32_t capacity, uint32_t elementSize)
+{
+    ASSERT(queue && elementSize > 0);
+    memset(queue, 0, sizeof *queue);
+
+    capacity = ringQueueCapacity(capacity);
+    queue->cellSize = MPMC_CELL_HEADER_SIZE + ((elementSize + 7) & ~7u);
+    queue->cells = (uint8_t*)tf_memalign(64, (size_t)capacity * queue->cellSize);
+    if (!queue->cells)
+        return false;
+
+    queue->mask = capacity - 1;
+    queue->elementSize = elementSize;
+
+    // Cell 'i' is free for the producer at position 'i'
+    for (uint32_t i = 0; i < capacity; ++i)
+        tfrg_atomic32_store_relaxed(mpmcCellSequence(queue, i), i);
+    tfrg_memorybarrier_release();
+    return true;
+}
+
+void mpmcQueueExit(MpmcQueue* queue)
+{
+    if (!queue)
+        return;
+    tf_free(queue->cells);
+    memset(queue, 0, sizeof *queue);
+}
+
+bool mpmcQueueTryPush(MpmcQueue* queue, const void* element)
+{
+    uint32_t pos = tfrg_atomic32_load_relaxed(&queue->enqueuePos);
+    for (;;)
+    {
+        uint32_t sequence = tfrg_atomic32_load_acquire(mpmcCellSequence(queue, pos));
+        int32_t  diff = (int32_t)(sequence - pos);
+        if (diff == 0)
+        {
+            uint32_t prev = tfrg_atomic32_cas_relaxed(&queue->enqueuePos, pos, pos + 1);
+            if (prev == pos)
+                break;
+            pos = prev;
+        }
+        else if (diff < 0)
+        {
+            // Cell still holds element from previous lap
+            return false;
+        }
+        else
+        {
+            pos = tfrg_atomic32_load_relaxed(&queue->enqueuePos);
+        }
+    }
+
+    memcpy(mpmcCellData(queue, pos), element, queue->elementSize);
+    tfrg_atomic32_store_release(mpmcCellSequence(queue, pos), pos + 1);
+
+    ringQueueNotify(&queue->notEmpty);
+    return true;
+}
+
+bool mpmcQueueTryPop(MpmcQueue* queue, void* element)
+{
+    uint32_t pos = tfrg_atomic32_load_relaxed(&queue->dequeuePos);
+    for (;;)
+    {
+        uint32_t sequence = tfrg_atomic32_load_acquire(mpmcCellSequence(queue, pos));
+        int32_t  diff = (int32_t)(sequence - (pos + 1));
+        if (diff == 0)
+        {
+            uint32_t prev = tfrg_atomic32_cas_relaxed(&queue->dequeuePos, pos, pos + 1);
+            if (prev == pos)
+                break;
+            pos = prev;
+        }
+        else if (diff < 0)
+        {
+            // Cell isn't written yet
+            return false;
+        }
+        else
+        {
+            pos = tfrg_atomic32_load_relaxed(&queue->dequeuePos);
+        }
+    }
+
+    memcpy(element, mpmcCellData(queue, pos), queue->elementSize);
+    // Free the cell for the producer of the next lap
+    tfrg_atomic32_store_release(mpmcCellSequence(queue, pos), pos + queue->mask + 1);
+
+    ringQueueNotify(&queue->notFull);
+    return true;
+}
+
+static bool mpmcQueueTryPushFunc(void* queue, void* element) { return mpmcQueueTryPush((MpmcQueue*)queue, element); }
+
+static bool mpmcQueueTryPopFunc(void* queue, void* element) { return mpmcQueueTryPop((MpmcQueue*)queue, element); }
+
+bool mpmcQueuePush(MpmcQueue* queue, const void* element, uint32_t msTimeout)
+{
+    return ringQueueWait(queue, (void*)element, mpmcQueueTryPushFunc, &queue->notFull, msTimeout);
+}
+
+bool mpmcQueuePop(MpmcQueue* queue, void* element, uint32_t msTimeout)
+{
+    return ringQueueWait(queue, element, mpmcQueueTryPopFunc, &queue->notEmpty, msTimeout);
+}
@@ -0,0 +1,123 @@
+#pragma once
+/*
+ * Copyright (c) 2017-2024 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "../../Application/Config.h"
+
+#include "Atomics.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#else
+#include <stdbool.h>
+#endif
+
+    // Bounded lock-free ring queues of fixed size elements, copied in and out with memcpy.
+    //
+    // Try* functions never block and return false when queue is full/empty.
+    // Push/Pop spin for a short while and then sleep in waitAddress (futex on Linux)
+    // until there is room/an element, or 'msTimeout' is elapsed (returns false).
+    // While nobody sleeps, waking costs one fence and one load on the other side.
+    //
+    // Capacity is rounded up to power of two, max RING_QUEUE_MAX_CAPACITY.
+
+#define RING_QUEUE_MAX_CAPACITY (1u << 30)
+
+    typedef struct RingQueueSignal
+    {
+        // futex word, incremented before waking
+        tfrg_atomic32_t signal;
+        // set by threads going to sleep, cleared by the thread waking them
+        tfrg_atomic32_t waiting;
+    } RingQueueSignal;
+
+    // Single producer, single consumer.
+    // Each side caches last seen position of the other side, so it touches shared cache line
+    // only when cached value says queue is full/empty.
+    typedef struct SpscQueue
+    {
+        // written by producer
+        tfrg_atomic32_t tail;
+        uint32_t        cachedHead;
+        uint8_t         padding0[64 - 2 * sizeof(uint32_t)];
+
+        // written by consumer
+        tfrg_atomic32_t head;
+        uint32_t        cachedTail;
+        uint8_t         padding1[64 - 2 * sizeof(uint32_t)];
+
+        RingQueueSignal notEmpty;
+        RingQueueSignal notFull;
+        uint8_t         padding2[64 - 2 * sizeof(RingQueueSignal)];
+
+        uint8_t* buffer;
+        uint32_t mask;
+        uint32_t elementSize;
+    } SpscQueue;
+
+    // Multiple producers, multiple consumers.
+    // Every cell has sequence number telling whether it is ready to be written or read for current lap,
+    // producers and consumers claim cells with CAS on their position.
+    typedef struct MpmcQueue
+    {
+        tfrg_atomic32_t enqueuePos;
+        uint8_t         padding0[64 - sizeof(uint32_t)];
+
+        tfrg_atomic32_t dequeuePos;
+        uint8_t         padding1[64 - sizeof(uint32_t)];
+
+        RingQueueSignal notEmpty;
+        RingQueueSignal notFull;
+        uint8_t         padding2[64 - 2 * sizeof(RingQueueSignal)];
+
+        uint8_t* cells;
+        uint32_t mask;
+        uint32_t cellSize;
+        uint32_t elementSize;
+    } MpmcQueue;
+
+    bool spscQueueInit(SpscQueue* queue, uint32_t capacity, uint32_t elementSize);
+    void spscQueueExit(SpscQueue* queue);
+
+    // producer thread only
+    bool spscQueueTryPush(SpscQueue* queue, const void* element);
+    bool spscQueuePush(SpscQueue* queue, const void* element, uint32_t msTimeout);
+
+    // consumer thread only
+    bool spscQueueTryPop(SpscQueue* queue, void* element);
+    bool spscQueuePop(SpscQueue* queue, void* element, uint32_t msTimeout);
+
+    bool mpmcQueueInit(MpmcQueue* queue, uint32_t capacity, uint32_t elementSize);
+    void mpmcQueueExit(MpmcQueue* queue);
+
+    bool mpmcQueueTryPush(MpmcQueue* queue, const void* element);
+    bool mpmcQueuePush(MpmcQueue* queue, const void* element, uint32_t msTimeout);
+
+    bool mpmcQueueTryPop(MpmcQueue* queue, void* element);
+    bool mpmcQueuePop(MpmcQueue* queue, void* element, uint32_t msTimeout);
+
+#ifdef __cplusplus
+}
+#endif
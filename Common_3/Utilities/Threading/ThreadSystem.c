@@ -32,12 +32,155 @@
 
 #include "Atomics.h"
 
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+// Context switching of the bundled TaskScheduler, included here so we don't have to add it to all the projects.
+// Functions are static, so this doesn't clash with TaskScheduler if it is linked too.
+#define MINICORO_IMPL
+#define MCO_API                  static
+#define MCO_ALLOC(size)          tf_calloc(1, size)
+#define MCO_DEALLOC(ptr, size)   tf_free(ptr)
+#define MCO_ASSERT(ex)           ASSERT(ex)
+#define MCO_LOG(msg)             LOGF(eERROR, msg)
+#define MCO_DEFAULT_STORAGE_SIZE 0
+#include "../ThirdParty/OpenSource/TaskScheduler/ThirdParty/minicoro/minicoro.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
 #define OPTIMAL_TASK_SLOTS_COUNT 128
 
+// Power of two. Tasks which don't fit go to the injection queue.
+#define WORK_STEALING_DEQUE_SIZE     1024
+// Max number of tasks a worker moves from the injection queue to its deque at once
+#define WORK_STEALING_INJECTION_BATCH 32
+// Every N tasks worker takes the oldest task (injection queue first, then top of own deque)
+// instead of the newest one, otherwise tasks which add tasks keep older ones waiting forever
+#define WORK_STEALING_INJECTION_INTERVAL 61
+
+#define FIBER_DEFAULT_COUNT      128
+#define FIBER_DEFAULT_STACK_SIZE (64 * 1024)
+
+static const uint32_t gDefaultLaneWeights[THREAD_SYSTEM_PRIORITY_COUNT] = { 16, 4, 1 };
+
 struct ThreadSystemTask
 {
     TaskFunc func;
     void*    user;
+    // Set only with instrumentation
+    int64_t  addTime;
+    uint32_t priority;
+};
+
+// Task queue of a priority lane, protected by mutex
+struct ThreadSystemQueue
+{
+    struct ThreadSystemTask* tasks;
+    uint64_t                 taken;
+    uint64_t                 queued;
+    // queued - taken, readable without mutex
+    tfrg_atomic64_t          count;
+};
+
+struct ThreadSystemGroup
+{
+    uint32_t          laneMask;
+    // Shared queue and fiber schedulers, threads of the group wait for tasks here
+    ConditionVariable conditionTasks;
+};
+
+// Owned by pool thread
+struct ThreadSystemThread
+{
+    struct ThreadSystemData* system;
+    uint64_t                 id;
+    uint32_t                 group;
+    uint32_t                 laneMask;
+    // Weighted scheduling, tasks to take from each lane in current round
+    uint32_t                 credits[THREAD_SYSTEM_PRIORITY_COUNT];
+};
+
+struct ThreadSystemWorker
+{
+    // Chase-Lev deque.
+    // Owner pushes and pops at the bottom, other threads steal from the top.
+    tfrg_atomic64_t         top;
+    uint8_t                 padding0[64 - sizeof(tfrg_atomic64_t)];
+    tfrg_atomic64_t         bottom;
+    uint8_t                 padding1[64 - sizeof(tfrg_atomic64_t)];
+    struct ThreadSystemTask tasks[WORK_STEALING_DEQUE_SIZE];
+
+    struct ThreadSystemData* system;
+    uint64_t                 id;
+    uint32_t                 random;
+    uint32_t                 popCount;
+
+    // Waker clears 'sleeping' and signals only this worker
+    tfrg_atomic32_t   sleeping;
+    bool              signaled; // protected by mutex
+    Mutex             mutex;
+    ConditionVariable condition;
+};
+
+struct ThreadSystemFiber
+{
+    struct ThreadSystemData* system;
+    // Created on first use
+    mco_coro*                coro;
+    struct ThreadSystemTask  task;
+    uint64_t                 threadId;
+    bool                     finished;
+
+    // Instrumentation, task run time is summed over resumes
+    bool        started;
+    const void* statsKey;
+    int64_t     runUSec;
+
+    // Set before the fiber yields to wait. Thread which resumed the fiber
+    // puts it to 'waitList' once it is switched out, unless 'waitDone' is set already.
+    // 'waitDone' is NULL if the fiber just lets other tasks run.
+    tfrg_atomic32_t*           waitDone;
+    struct ThreadSystemFiber** waitList;
+
+    // Free, ready or wait list
+    struct ThreadSystemFiber* next;
+};
+
+struct ThreadSystemTaskFuncStats
+{
+    tfrg_atomicptr_t func;
+    tfrg_atomic64_t  count;
+    tfrg_atomic64_t  runTotalUSec;
+    tfrg_atomic64_t  runMaxUSec;
+};
+
+struct ThreadSystemThreadStats
+{
+    tfrg_atomic64_t taskCount;
+    tfrg_atomic64_t busyUSec;
+    tfrg_atomic64_t startTime;
+    uint8_t         padding[64 - sizeof(tfrg_atomic64_t) * 3];
+};
+
+struct ThreadSystemStats
+{
+    tfrg_atomic64_t taskCount;
+    tfrg_atomic64_t latencyTotalUSec;
+    tfrg_atomic64_t latencyMaxUSec;
+    tfrg_atomic64_t runTotalUSec;
+    // Added, but not started tasks
+    tfrg_atomic64_t queueDepth;
+    tfrg_atomic64_t peakQueueDepth;
+
+    // Open addressing by function pointer
+    struct ThreadSystemTaskFuncStats funcs[THREAD_SYSTEM_INFO_MAX_TASK_FUNCS];
+
+    // [threadCount]
+    struct ThreadSystemThreadStats* threads;
 };
 
 struct ThreadSystemData
@@ -45,38 +188,103 @@ struct ThreadSystemData
     Mutex mutex;
 
     // const
-    const char* name;
-    uint64_t    threadCount;
+    const char*                name;
+    uint64_t                   threadCount;
+    enum ThreadSystemScheduler scheduler;
+
+    bool                       weightedLanes;
+    uint32_t                   laneWeights[THREAD_SYSTEM_PRIORITY_COUNT];
+    struct ThreadSystemGroup   groups[THREAD_SYSTEM_MAX_GROUPS];
+    uint32_t                   groupCount;
 
     // [threadCount]
-    ThreadHandle* threads;
+    ThreadHandle*              threads;
+    struct ThreadSystemThread* threadStates;
 
     // Protected by mutex
-    // TODO optimize queued task IO
-    struct ThreadSystemTask* tasks;
-    uint64_t                 tasksTaken;
-    uint64_t                 tasksQueued;
-    ConditionVariable        conditionTasks;
+    // Task queues for THREAD_SYSTEM_SCHEDULER_SHARED_QUEUE,
+    // injection queues for THREAD_SYSTEM_SCHEDULER_WORK_STEALING
+    struct ThreadSystemQueue queues[THREAD_SYSTEM_PRIORITY_COUNT];
     ConditionVariable        conditionIsIdle;
+    ConditionVariable        conditionTaskDone;
     tfrg_atomic32_t          activatedThreadCount_Atomic;
     uint32_t                 idleThreadCount;
     //
 
+    // THREAD_SYSTEM_SCHEDULER_WORK_STEALING
+    // [threadCount]
+    struct ThreadSystemWorker* workers;
+    // added, but not finished tasks
+    tfrg_atomic64_t            pendingCount;
+    tfrg_atomic32_t            sleepingCount;
+    tfrg_atomic32_t            idleWaiterCount;
+    //
+
+    // THREAD_SYSTEM_SCHEDULER_FIBERS, lists are protected by mutex
+    // [fiberCount]
+    struct ThreadSystemFiber* fibers;
+    uint32_t                  fiberCount;
+    uint32_t                  fiberStackSize;
+    struct ThreadSystemFiber* freeFibers;
+    struct ThreadSystemFiber* readyFibers;
+    struct ThreadSystemFiber* readyFibersTail;
+    // Yielded by threadSystemAssist, resumed when there is nothing else to do
+    struct ThreadSystemFiber* yieldedFibers;
+    // started, but not finished tasks, including suspended ones
+    uint32_t                  busyFiberCount;
+    //
+
+    // Optional, const
+    struct ThreadSystemStats* stats;
+    uint64_t (*pProfileEnter)(uint64_t token);
+    void (*pProfileLeave)(uint64_t token, uint64_t tick);
+    uint64_t profileToken;
+
     tfrg_atomic32_t references_Atomic;
 
-    bool stopAbandon; // stop even if tasks are scheduled
-    bool stop;
+    // Read without mutex
+    tfrg_atomic32_t stopAbandon; // stop even if tasks are scheduled
+    tfrg_atomic32_t stop;
 };
 
+// Worker of the thread system which runs current thread
+static THREAD_LOCAL struct ThreadSystemWorker* pCurrentWorker = NULL;
+// Fiber which runs on current thread
+static THREAD_LOCAL struct ThreadSystemFiber* pCurrentFiber = NULL;
+
 static void threadSystemCleanup(struct ThreadSystemData* t)
 {
     ASSERT(tfrg_atomic32_load_relaxed(&t->references_Atomic) == 0);
 
     exitMutex(&t->mutex);
-    exitConditionVariable(&t->conditionTasks);
+    for (uint32_t gi = 0; gi < t->groupCount; ++gi)
+        exitConditionVariable(&t->groups[gi].conditionTasks);
     exitConditionVariable(&t->conditionIsIdle);
+    exitConditionVariable(&t->conditionTaskDone);
+
+    if (t->workers)
+    {
+        for (uint64_t wi = 0; wi < t->threadCount; ++wi)
+        {
+            exitMutex(&t->workers[wi].mutex);
+            exitConditionVariable(&t->workers[wi].condition);
+        }
+        tf_free(t->workers);
+    }
 
-    arrfree(t->tasks);
+    if (t->fibers)
+    {
+        for (uint32_t fi = 0; fi < t->fiberCount; ++fi)
+        {
+            if (t->fibers[fi].coro)
+                mco_destroy(t->fibers[fi].coro);
+        }
+        tf_free(t->fibers);
+    }
+
+    for (uint32_t li = 0; li < THREAD_SYSTEM_PRIORITY_COUNT; ++li)
+        arrfree(t->queues[li].tasks);
+    tf_free(t->stats);
     tf_free(t);
 }
 
@@ -84,116 +292,1082 @@ static inline void acquireThreadSystemHandle(struct ThreadSystemData* t) { tfrg_
 
 static inline void releaseThreadSystemHandle(struct ThreadSystemData* t)
 {
-    uint64_t threadCount = tfrg_atomic32_add_relaxed(&t->references_Atomic, -1);
+    uint64_t threadCount = tfrg_atomic32_add_acq_rel(&t->references_Atomic, -1);
     if (threadCount == 1)
         threadSystemCleanup(t);
 }
 
+static void setTaskThreadName(struct ThreadSystemData* t, uint64_t tid)
+{
+    char buffer[MAX_THREAD_NAME_LENGTH];
+    snprintf(buffer, MAX_THREAD_NAME_LENGTH, "%s %llu", t->name, (unsigned long long)tid);
+    setCurrentThreadName(buffer);
+}
+
+// Must be called under mutex
+static void pushQueuedTasks(struct ThreadSystemData* t, uint32_t priority, TaskFunc func, uint64_t count, uint64_t userSize, void* users)
+{
+    struct ThreadSystemQueue* q = t->queues + priority;
+
+    uint64_t offset = q->queued;
+
+    q->queued += count;
+    tfrg_atomic64_store_relaxed(&q->count, q->queued - q->taken);
+
+    uint64_t len = arrlenu(q->tasks);
+
+    if (q->queued > len)
+    {
+        // Resize the task array to a multiple of OPTIMAL_TASK_SLOTS_COUNT that is large enough to contain all of the requested tasks.
+        uint64_t newTasksLength = q->queued / OPTIMAL_TASK_SLOTS_COUNT;
+        newTasksLength += (q->queued % OPTIMAL_TASK_SLOTS_COUNT) == 0 ? 0 : 1;
+        newTasksLength *= OPTIMAL_TASK_SLOTS_COUNT;
+        arrsetlen(q->tasks, newTasksLength);
+    }
+
+    int64_t addTime = t->stats ? getUSec(true) : 0;
+
+    for (uint64_t ti = 0; ti < count; ++ti)
+    {
+        q->tasks[offset + ti] = (struct ThreadSystemTask){
+            func,
+            users ? ((uint8_t*)users + ti * userSize) : NULL,
+            addTime,
+            priority,
+        };
+    }
+}
+
+// Must be called under mutex, after tasks are taken
+static void trimQueuedTasks(struct ThreadSystemQueue* q)
+{
+    uint64_t scheduledCount = q->queued - q->taken;
+    tfrg_atomic64_store_relaxed(&q->count, scheduledCount);
+
+    if (q->taken > scheduledCount * 3)
+    {
+        if (scheduledCount)
+        {
+            memcpy(q->tasks, q->tasks + q->taken, scheduledCount * sizeof(struct ThreadSystemTask)); //-V595
+        }
+
+        q->queued -= q->taken;
+        q->taken = 0;
+    }
+
+    size_t arrayLimit = arrlenu(q->tasks); //-V595
+    if (arrayLimit > OPTIMAL_TASK_SLOTS_COUNT * 2)
+        arrsetlen(q->tasks, OPTIMAL_TASK_SLOTS_COUNT);
+}
+
+// Must be called under mutex
+static inline bool queuesEmpty(struct ThreadSystemData* t)
+{
+    for (uint32_t li = 0; li < THREAD_SYSTEM_PRIORITY_COUNT; ++li)
+    {
+        if (t->queues[li].taken < t->queues[li].queued)
+            return false;
+    }
+    return true;
+}
+
+// Readable without mutex
+static inline uint64_t queuedTaskCount(struct ThreadSystemData* t)
+{
+    uint64_t count = 0;
+    for (uint32_t li = 0; li < THREAD_SYSTEM_PRIORITY_COUNT; ++li)
+        count += tfrg_atomic64_load_relaxed(&t->queues[li].count);
+    return count;
+}
+
+// Must be called under mutex
+static void wakeGroups(struct ThreadSystemData* t, uint32_t priority, uint64_t count)
+{
+    for (uint32_t gi = 0; gi < t->groupCount; ++gi)
+    {
+        struct ThreadSystemGroup* g = t->groups + gi;
+        if (!(g->laneMask & THREAD_SYSTEM_LANE_MASK(priority)))
+            continue;
+
+        if (count == 1)
+            wakeOneConditionVariable(&g->conditionTasks);
+        else
+            wakeAllConditionVariable(&g->conditionTasks);
+    }
+}
+
+/************************************************************************/
+// Priority lanes
+/************************************************************************/
+
+// Priority of the task which runs on current thread
+static THREAD_LOCAL uint32_t gTaskPriority = THREAD_SYSTEM_PRIORITY_NORMAL;
+// threadId the task which runs on current thread was called with, or got on its last resume
+static THREAD_LOCAL uint64_t gTaskThreadId = UINT64_MAX;
+
+static inline struct ThreadSystemThread* getThreadState(struct ThreadSystemData* t, uint64_t tid)
+{
+    return tid < t->threadCount ? t->threadStates + tid : NULL;
+}
+
+// Lanes in the order 'thread' should look at them, NULL for threads outside of the pool.
+// Returns number of lanes.
+static uint32_t getLaneOrder(struct ThreadSystemData* t, const struct ThreadSystemThread* thread, uint32_t order[THREAD_SYSTEM_PRIORITY_COUNT])
+{
+    uint32_t laneMask = thread ? thread->laneMask : THREAD_SYSTEM_LANE_MASK_ALL;
+    bool     weighted = thread && t->weightedLanes;
+    uint32_t count = 0;
+
+    // Lanes which have credits left in current round go first
+    for (uint32_t li = 0; weighted && li < THREAD_SYSTEM_PRIORITY_COUNT; ++li)
+    {
+        if ((laneMask & THREAD_SYSTEM_LANE_MASK(li)) && thread->credits[li])
+            order[count++] = li;
+    }
+
+    for (uint32_t li = 0; li < THREAD_SYSTEM_PRIORITY_COUNT; ++li)
+    {
+        if ((laneMask & THREAD_SYSTEM_LANE_MASK(li)) && !(weighted && thread->credits[li]))
+            order[count++] = li;
+    }
+
+    return count;
+}
+
+static inline void laneTaken(struct ThreadSystemData* t, struct ThreadSystemThread* thread, uint32_t priority)
+{
+    if (!thread || !t->weightedLanes)
+        return;
+
+    // Lanes which still have credits are empty, start next round
+    if (!thread->credits[priority])
+        memcpy(thread->credits, t->laneWeights, sizeof thread->credits);
+
+    --thread->credits[priority];
+}
+
+// Must be called under mutex
+static bool takeQueuedTask(struct ThreadSystemData* t, struct ThreadSystemThread* thread, struct ThreadSystemTask* outTask)
+{
+    uint32_t order[THREAD_SYSTEM_PRIORITY_COUNT];
+    uint32_t laneCount = getLaneOrder(t, thread, order);
+
+    for (uint32_t oi = 0; oi < laneCount; ++oi)
+    {
+        struct ThreadSystemQueue* q = t->queues + order[oi];
+        if (q->taken >= q->queued)
+            continue;
+
+        *outTask = q->tasks[q->taken++];
+        trimQueuedTasks(q);
+        laneTaken(t, thread, order[oi]);
+        return true;
+    }
+
+    return false;
+}
+
+/************************************************************************/
+// Instrumentation
+/************************************************************************/
+
+// Nested tasks run by waits inside a task are not counted as busy time twice
+static THREAD_LOCAL uint32_t gTaskRunDepth = 0;
+
+// Defined with task graph and parallel for, they are attributed to the function they call
+static const void* getTaskStatsKey(struct ThreadSystemTask task);
+
+// Skips locked operation when maximum doesn't change, which is almost always
+static inline void statsMax(tfrg_atomic64_t* max, uint64_t value)
+{
+    if (value > tfrg_atomic64_load_relaxed(max))
+        tfrg_atomic64_max_relaxed(max, value);
+}
+
+static bool initStats(struct ThreadSystemData* t)
+{
+    t->stats = tf_calloc(1, sizeof(struct ThreadSystemStats) + t->threadCount * sizeof(struct ThreadSystemThreadStats));
+    if (!t->stats)
+        return false;
+
+    t->stats->threads = (struct ThreadSystemThreadStats*)(t->stats + 1);
+    return true;
+}
+
+static inline void statsThreadStarted(struct ThreadSystemData* t, uint64_t tid)
+{
+    if (t->stats)
+        tfrg_atomic64_store_relaxed(&t->stats->threads[tid].startTime, (uint64_t)getUSec(true));
+}
+
+static inline void statsTasksAdded(struct ThreadSystemData* t, uint64_t count)
+{
+    if (!t->stats)
+        return;
+
+    uint64_t depth = tfrg_atomic64_add_relaxed(&t->stats->queueDepth, count) + count;
+    statsMax(&t->stats->peakQueueDepth, depth);
+}
+
+static void statsTaskStarted(struct ThreadSystemData* t, const struct ThreadSystemTask* task, int64_t startTime)
+{
+    struct ThreadSystemStats* stats = t->stats;
+
+    uint64_t latency = startTime > task->addTime ? (uint64_t)(startTime - task->addTime) : 0;
+    tfrg_atomic64_add_relaxed(&stats->queueDepth, -1);
+    tfrg_atomic64_add_relaxed(&stats->latencyTotalUSec, latency);
+    statsMax(&stats->latencyMaxUSec, latency);
+}
+
+static void statsTaskFinished(struct ThreadSystemData* t, const void* key, uint64_t tid, uint64_t runTime)
+{
+    struct ThreadSystemStats* stats = t->stats;
+
+    tfrg_atomic64_add_relaxed(&stats->taskCount, 1);
+    tfrg_atomic64_add_relaxed(&stats->runTotalUSec, runTime);
+
+    if (tid < t->threadCount)
+        tfrg_atomic64_add_relaxed(&stats->threads[tid].taskCount, 1);
+
+    uint64_t hash = ((uintptr_t)key >> 4) * 11400714819323198485ull;
+    for (uint32_t i = 0; i < THREAD_SYSTEM_INFO_MAX_TASK_FUNCS; ++i)
+    {
+        struct ThreadSystemTaskFuncStats* funcStats = stats->funcs + (hash + i) % THREAD_SYSTEM_INFO_MAX_TASK_FUNCS;
+
+        uintptr_t func = tfrg_atomicptr_load_relaxed(&funcStats->func);
+        if (!func)
+            func = tfrg_atomicptr_cas_relaxed(&funcStats->func, 0, (uintptr_t)key);
+        if (func && func != (uintptr_t)key)
+            continue;
+
+        tfrg_atomic64_add_relaxed(&funcStats->count, 1);
+        tfrg_atomic64_add_relaxed(&funcStats->runTotalUSec, runTime);
+        statsMax(&funcStats->runMaxUSec, runTime);
+        return;
+    }
+}
+
+static inline void statsThreadBusy(struct ThreadSystemData* t, uint64_t tid, uint64_t time)
+{
+    if (tid < t->threadCount && gTaskRunDepth == 0)
+        tfrg_atomic64_add_relaxed(&t->stats->threads[tid].busyUSec, time);
+}
+
+static void runTask(struct ThreadSystemData* t, struct ThreadSystemTask task, uint64_t tid)
+{
+    uint32_t priority = gTaskPriority;
+    uint64_t threadId = gTaskThreadId;
+    gTaskPriority = task.priority;
+    gTaskThreadId = tid;
+
+    if (!t->stats && !t->pProfileEnter)
+    {
+        task.func(task.user, tid);
+        gTaskPriority = priority;
+        gTaskThreadId = threadId;
+        return;
+    }
+
+    // Graph node or parallel for context can be freed by the task
+    const void* key = NULL;
+    int64_t     startTime = 0;
+    uint64_t    tick = 0;
+
+    if (t->stats)
+    {
+        key = getTaskStatsKey(task);
+        startTime = getUSec(true);
+        statsTaskStarted(t, &task, startTime);
+    }
+    if (t->pProfileEnter)
+        tick = t->pProfileEnter(t->profileToken);
+
+    ++gTaskRunDepth;
+    task.func(task.user, tid);
+    --gTaskRunDepth;
+
+    if (t->pProfileLeave)
+        t->pProfileLeave(t->profileToken, tick);
+    if (t->stats)
+    {
+        uint64_t runTime = (uint64_t)(getUSec(true) - startTime);
+        statsTaskFinished(t, key, tid, runTime);
+        statsThreadBusy(t, tid, runTime);
+    }
+
+    gTaskPriority = priority;
+    gTaskThreadId = threadId;
+}
+
+/************************************************************************/
+// Shared queue scheduler
+/************************************************************************/
+
 static struct ThreadSystemTask getTask(struct ThreadSystemData* t, uint64_t tid)
 {
     struct ThreadSystemTask task = { 0 };
 
-    if (t->stopAbandon)
+    if (tfrg_atomic32_load_relaxed(&t->stopAbandon))
         return task;
 
+    struct ThreadSystemThread* thread = getThreadState(t, tid);
+
     acquireMutex(&t->mutex);
 
     bool idleSet = false;
 
     for (;;)
     {
-        if (t->tasksTaken < t->tasksQueued)
-        {
-            task = t->tasks[t->tasksTaken++];
+        if (takeQueuedTask(t, thread, &task))
             break;
-        }
 
-        if (t->stop)
+        // threadSystemAssist never waits for new tasks
+        if (tfrg_atomic32_load_relaxed(&t->stop) || tid == UINT64_MAX)
             break;
 
-        if (!idleSet && tid != UINT64_MAX)
+        if (!idleSet)
         {
             idleSet = true;
             ++t->idleThreadCount;
         }
         wakeAllConditionVariable(&t->conditionIsIdle);
-        waitConditionVariable(&t->conditionTasks, &t->mutex, TIMEOUT_INFINITE);
+        waitConditionVariable(&t->groups[thread->group].conditionTasks, &t->mutex, TIMEOUT_INFINITE);
     }
 
     if (idleSet)
         --t->idleThreadCount;
 
-    uint64_t scheduledCount = t->tasksQueued - t->tasksTaken;
-    if (t->tasksTaken > scheduledCount * 3)
+    releaseMutex(&t->mutex);
+
+    return task;
+}
+
+static void taskThreadFunc(void* threadUserData)
+{
+    struct ThreadSystemThread* thread = threadUserData;
+    struct ThreadSystemData*   t = thread->system;
+    uint64_t                   tid = thread->id;
+
+    tfrg_atomic32_add_relaxed(&t->activatedThreadCount_Atomic, 1);
+
+    setTaskThreadName(t, tid);
+    statsThreadStarted(t, tid);
+
+    struct ThreadSystemTask task = { 0 };
+    while (!tfrg_atomic32_load_relaxed(&t->stopAbandon))
     {
-        if (scheduledCount)
+        if (task.func)
         {
-            memcpy(t->tasks, t->tasks + t->tasksTaken, scheduledCount * sizeof task); //-V595
+            runTask(t, task, tid);
+            memset(&task, 0, sizeof task);
         }
 
-        t->tasksQueued -= t->tasksTaken;
-        t->tasksTaken = 0;
+        task = getTask(t, tid);
+        if (tfrg_atomic32_load_relaxed(&t->stop) && !task.func)
+            break;
     }
 
-    size_t arrayLimit = arrlenu(t->tasks); //-V595
-    if (arrayLimit > OPTIMAL_TASK_SLOTS_COUNT * 2)
-        arrsetlen(t->tasks, OPTIMAL_TASK_SLOTS_COUNT);
+    releaseThreadSystemHandle(t);
+}
 
-    releaseMutex(&t->mutex);
+/************************************************************************/
+// Work stealing scheduler
+/************************************************************************/
+
+static inline uint32_t workerRandom(struct ThreadSystemWorker* w)
+{
+    // xorshift32
+    uint32_t x = w->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    w->random = x;
+    return x;
+}
+
+static inline struct ThreadSystemWorker* getCurrentWorker(struct ThreadSystemData* t)
+{
+    struct ThreadSystemWorker* w = pCurrentWorker;
+    return w && w->system == t ? w : NULL;
+}
+
+// Owner only
+static bool workerPush(struct ThreadSystemWorker* w, struct ThreadSystemTask task)
+{
+    int64_t b = (int64_t)tfrg_atomic64_load_relaxed(&w->bottom);
+    int64_t t = (int64_t)tfrg_atomic64_load_acquire(&w->top);
+
+    if (b - t >= WORK_STEALING_DEQUE_SIZE)
+        return false;
+
+    w->tasks[b & (WORK_STEALING_DEQUE_SIZE - 1)] = task;
+    tfrg_atomic64_store_release(&w->bottom, (uint64_t)(b + 1));
+    return true;
+}
+
+// Owner only
+static struct ThreadSystemTask workerPop(struct ThreadSystemWorker* w)
+{
+    struct ThreadSystemTask task = { 0 };
+
+    int64_t b = (int64_t)tfrg_atomic64_load_relaxed(&w->bottom) - 1;
+    tfrg_atomic64_store_relaxed(&w->bottom, (uint64_t)b);
+    tfrg_memorybarrier_full();
+    int64_t t = (int64_t)tfrg_atomic64_load_relaxed(&w->top);
+
+    if (t > b)
+    {
+        // empty
+        tfrg_atomic64_store_relaxed(&w->bottom, (uint64_t)(b + 1));
+        return task;
+    }
+
+    task = w->tasks[b & (WORK_STEALING_DEQUE_SIZE - 1)];
+
+    if (t == b)
+    {
+        // Last task, thieves might be taking it too
+        if ((int64_t)tfrg_atomic64_cas_acq_rel(&w->top, (uint64_t)t, (uint64_t)(t + 1)) != t)
+            memset(&task, 0, sizeof task);
+        tfrg_atomic64_store_relaxed(&w->bottom, (uint64_t)(b + 1));
+    }
 
     return task;
 }
 
-static void taskThreadFunc(void* threadUserData)
+// Any thread
+static struct ThreadSystemTask workerSteal(struct ThreadSystemWorker* w)
+{
+    struct ThreadSystemTask task = { 0 };
+
+    int64_t t = (int64_t)tfrg_atomic64_load_acquire(&w->top);
+    tfrg_memorybarrier_full();
+    int64_t b = (int64_t)tfrg_atomic64_load_acquire(&w->bottom);
+
+    if (t >= b)
+        return task;
+
+    task = w->tasks[t & (WORK_STEALING_DEQUE_SIZE - 1)];
+
+    // Task read above is discarded if other thread took it first
+    if ((int64_t)tfrg_atomic64_cas_acq_rel(&w->top, (uint64_t)t, (uint64_t)(t + 1)) != t)
+        memset(&task, 0, sizeof task);
+
+    return task;
+}
+
+// Wakes up to 'count' sleeping workers which serve 'priority' lane
+static void wakeWorkers(struct ThreadSystemData* t, uint32_t priority, uint64_t count)
+{
+    // Pairs with barrier in workStealingThreadFunc,
+    // either waker sees sleeping worker or worker sees added tasks
+    tfrg_memorybarrier_full();
+
+    for (uint64_t wi = 0; count && wi < t->threadCount && tfrg_atomic32_load_relaxed(&t->sleepingCount); ++wi)
+    {
+        struct ThreadSystemWorker* w = t->workers + wi;
+
+        if (!(t->threadStates[wi].laneMask & THREAD_SYSTEM_LANE_MASK(priority)))
+            continue;
+
+        if (!tfrg_atomic32_load_relaxed(&w->sleeping) || tfrg_atomic32_cas_relaxed(&w->sleeping, 1, 0) != 1)
+            continue;
+
+        tfrg_atomic32_add_relaxed(&t->sleepingCount, -1);
+
+        acquireMutex(&w->mutex);
+        w->signaled = true;
+        wakeOneConditionVariable(&w->condition);
+        releaseMutex(&w->mutex);
+
+        --count;
+    }
+}
+
+// Takes a task from the injection queue of 'priority' lane.
+// Worker also moves its share of normal lane to own deque, so that others can steal it.
+static struct ThreadSystemTask takeInjectedTask(struct ThreadSystemData* t, struct ThreadSystemWorker* w, uint32_t priority)
 {
-    struct ThreadSystemData* t = threadUserData;
+    struct ThreadSystemTask   task = { 0 };
+    struct ThreadSystemQueue* q = t->queues + priority;
+
+    if (!tfrg_atomic64_load_relaxed(&q->count))
+        return task;
+
+    uint64_t moved = 0;
 
-    uint64_t tid = tfrg_atomic32_add_relaxed(&t->activatedThreadCount_Atomic, 1);
+    acquireMutex(&t->mutex);
 
+    if (q->taken < q->queued)
     {
-        char buffer[MAX_THREAD_NAME_LENGTH];
-        snprintf(buffer, MAX_THREAD_NAME_LENGTH, "%s %llu", t->name, (unsigned long long)tid);
-        setCurrentThreadName(buffer);
+        task = q->tasks[q->taken++];
+
+        if (w && priority == THREAD_SYSTEM_PRIORITY_NORMAL)
+        {
+            uint64_t batch = (q->queued - q->taken) / t->threadCount;
+            if (batch > WORK_STEALING_INJECTION_BATCH)
+                batch = WORK_STEALING_INJECTION_BATCH;
+
+            for (; moved < batch && workerPush(w, q->tasks[q->taken]); ++moved)
+                ++q->taken;
+        }
+
+        trimQueuedTasks(q);
     }
 
+    releaseMutex(&t->mutex);
+
+    if (moved)
+        wakeWorkers(t, THREAD_SYSTEM_PRIORITY_NORMAL, moved);
+
+    return task;
+}
+
+// Deques hold normal lane only, high and background tasks stay in their injection queues.
+// 'w' is NULL for threads which don't belong to thread system
+static struct ThreadSystemTask findTask(struct ThreadSystemData* t, struct ThreadSystemWorker* w)
+{
     struct ThreadSystemTask task = { 0 };
-    while (!t->stopAbandon)
+
+    if (tfrg_atomic32_load_relaxed(&t->stopAbandon))
+        return task;
+
+    struct ThreadSystemThread* thread = w ? t->threadStates + w->id : NULL;
+
+    uint32_t order[THREAD_SYSTEM_PRIORITY_COUNT];
+    uint32_t laneCount = getLaneOrder(t, thread, order);
+
+    for (uint32_t oi = 0; oi < laneCount; ++oi)
     {
+        uint32_t priority = order[oi];
+
+        if (priority == THREAD_SYSTEM_PRIORITY_NORMAL && w)
+        {
+            if (++w->popCount % WORK_STEALING_INJECTION_INTERVAL == 0)
+            {
+                task = takeInjectedTask(t, w, priority);
+                if (!task.func)
+                    task = workerSteal(w);
+            }
+            if (!task.func)
+                task = workerPop(w);
+        }
+
+        if (!task.func)
+            task = takeInjectedTask(t, w, priority);
+
+        if (priority == THREAD_SYSTEM_PRIORITY_NORMAL && !task.func)
+        {
+            uint64_t first = w ? workerRandom(w) : 0;
+
+            for (uint64_t wi = 0; wi < t->threadCount && !task.func; ++wi)
+            {
+                struct ThreadSystemWorker* victim = t->workers + (first + wi) % t->threadCount;
+                if (victim != w)
+                    task = workerSteal(victim);
+            }
+        }
+
         if (task.func)
         {
-            task.func(task.user, tid);
-            memset(&task, 0, sizeof task);
+            laneTaken(t, thread, priority);
+            return task;
         }
+    }
 
-        task = getTask(t, tid);
-        if (t->stop && !task.func)
+    return task;
+}
+
+static void finishTask(struct ThreadSystemData* t)
+{
+    // Releases results of the task to threadSystemWaitIdleTimeout
+    if (tfrg_atomic64_add_acq_rel(&t->pendingCount, -1) != 1)
+        return;
+
+    // Pairs with idleWaiterCount increment in threadSystemWaitIdleTimeout
+    tfrg_memorybarrier_full();
+    if (!tfrg_atomic32_load_relaxed(&t->idleWaiterCount))
+        return;
+
+    acquireMutex(&t->mutex);
+    wakeAllConditionVariable(&t->conditionIsIdle);
+    releaseMutex(&t->mutex);
+}
+
+static void workStealingThreadFunc(void* threadUserData)
+{
+    struct ThreadSystemThread* thread = threadUserData;
+    struct ThreadSystemData*   t = thread->system;
+    struct ThreadSystemWorker* w = t->workers + thread->id;
+
+    pCurrentWorker = w;
+    tfrg_atomic32_add_relaxed(&t->activatedThreadCount_Atomic, 1);
+
+    setTaskThreadName(t, w->id);
+    statsThreadStarted(t, w->id);
+
+    while (!tfrg_atomic32_load_relaxed(&t->stopAbandon))
+    {
+        struct ThreadSystemTask task = findTask(t, w);
+
+        if (!task.func)
+        {
+            if (tfrg_atomic32_load_relaxed(&t->stop))
+                break;
+
+            // Announce sleep and look for tasks once more,
+            // so that tasks added in between are not missed.
+            tfrg_atomic32_store_relaxed(&w->sleeping, 1);
+            tfrg_atomic32_add_relaxed(&t->sleepingCount, 1);
+            tfrg_memorybarrier_full();
+
+            task = findTask(t, w);
+
+            if (!task.func && !tfrg_atomic32_load_relaxed(&t->stop))
+            {
+                acquireMutex(&w->mutex);
+                while (!w->signaled)
+                    waitConditionVariable(&w->condition, &w->mutex, TIMEOUT_INFINITE);
+                w->signaled = false;
+                releaseMutex(&w->mutex);
+                continue;
+            }
+
+            // If waker got here first, the signal is left set and next sleep returns immediately
+            if (tfrg_atomic32_cas_relaxed(&w->sleeping, 1, 0) == 1)
+                tfrg_atomic32_add_relaxed(&t->sleepingCount, -1);
+
+            if (!task.func)
+                continue;
+        }
+
+        runTask(t, task, w->id);
+        finishTask(t);
+    }
+
+    pCurrentWorker = NULL;
+    releaseThreadSystemHandle(t);
+}
+
+static bool initWorkers(struct ThreadSystemData* t)
+{
+    t->workers = tf_calloc(t->threadCount, sizeof(struct ThreadSystemWorker));
+    if (!t->workers)
+        return false;
+
+    for (uint64_t wi = 0; wi < t->threadCount; ++wi)
+    {
+        struct ThreadSystemWorker* w = t->workers + wi;
+
+        w->system = t;
+        w->id = wi;
+        w->random = (uint32_t)wi * 2654435761u + 1;
+
+        if (!initMutex(&w->mutex) || !initConditionVariable(&w->condition))
+        {
+            for (uint64_t ci = 0; ci <= wi; ++ci)
+            {
+                exitMutex(&t->workers[ci].mutex);
+                exitConditionVariable(&t->workers[ci].condition);
+            }
+            tf_free(t->workers);
+            t->workers = NULL;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/************************************************************************/
+// Fiber scheduler
+/************************************************************************/
+
+static inline struct ThreadSystemFiber* getCurrentFiber(struct ThreadSystemData* t)
+{
+    struct ThreadSystemFiber* f = pCurrentFiber;
+    return f && f->system == t ? f : NULL;
+}
+
+// Must be called under mutex
+static void pushReadyFiber(struct ThreadSystemData* t, struct ThreadSystemFiber* f)
+{
+    f->next = NULL;
+    if (t->readyFibersTail)
+        t->readyFibersTail->next = f;
+    else
+        t->readyFibers = f;
+    t->readyFibersTail = f;
+
+    wakeGroups(t, f->task.priority, 1);
+}
+
+// Must be called under mutex. Unlinks first fiber of the list which 'thread' serves lane of.
+static struct ThreadSystemFiber* takeListFiber(struct ThreadSystemFiber** list, struct ThreadSystemFiber** tail,
+                                               const struct ThreadSystemThread* thread)
+{
+    uint32_t laneMask = thread ? thread->laneMask : THREAD_SYSTEM_LANE_MASK_ALL;
+
+    struct ThreadSystemFiber* prev = NULL;
+    for (struct ThreadSystemFiber* f = *list; f; prev = f, f = f->next)
+    {
+        if (!(laneMask & THREAD_SYSTEM_LANE_MASK(f->task.priority)))
+            continue;
+
+        if (prev)
+            prev->next = f->next;
+        else
+            *list = f->next;
+        if (tail && *tail == f)
+            *tail = prev;
+        return f;
+    }
+
+    return NULL;
+}
+
+// Must be called under mutex, after the value fibers wait for is set
+static void resumeWaitingFibers(struct ThreadSystemData* t, struct ThreadSystemFiber** waitList)
+{
+    struct ThreadSystemFiber* f = *waitList;
+    *waitList = NULL;
+
+    while (f)
+    {
+        struct ThreadSystemFiber* next = f->next;
+        pushReadyFiber(t, f);
+        f = next;
+    }
+}
+
+static void fiberFunc(mco_coro* coro)
+{
+    struct ThreadSystemFiber* f = mco_get_user_data(coro);
+
+    // Fiber is reused for the next task after it yields as finished
+    for (;;)
+    {
+        f->task.func(f->task.user, f->threadId);
+        f->finished = true;
+        mco_yield(coro);
+    }
+}
+
+// Suspends task running on 'f' until '*done' is set, thread continues with other tasks meanwhile.
+// Whoever sets 'done' has to call resumeWaitingFibers for 'waitList'.
+// If 'done' is NULL, task is suspended until there are no other tasks to run.
+static void fiberWait(struct ThreadSystemFiber* f, tfrg_atomic32_t* done, struct ThreadSystemFiber** waitList)
+{
+    f->waitDone = done;
+    f->waitList = waitList;
+    mco_yield(f->coro);
+}
+
+// Must be called under mutex.
+// Returns fiber to resume, or task to run on thread stack if there are no free fibers.
+static bool takeFiberWork(struct ThreadSystemData* t, uint64_t tid, struct ThreadSystemFiber** outFiber, struct ThreadSystemTask* outTask)
+{
+    if (tfrg_atomic32_load_relaxed(&t->stopAbandon))
+        return false;
+
+    struct ThreadSystemThread* thread = getThreadState(t, tid);
+
+    struct ThreadSystemFiber* f = takeListFiber(&t->readyFibers, &t->readyFibersTail, thread);
+    if (f)
+    {
+        *outFiber = f;
+        return true;
+    }
+
+    struct ThreadSystemTask task = { 0 };
+    if (!takeQueuedTask(t, thread, &task))
+    {
+        f = takeListFiber(&t->yieldedFibers, NULL, thread);
+        if (!f)
+            return false;
+
+        *outFiber = f;
+        return true;
+    }
+
+    f = t->freeFibers;
+    if (!f)
+    {
+        *outTask = task;
+        return true;
+    }
+
+    t->freeFibers = f->next;
+    ++t->busyFiberCount;
+
+    f->task = task;
+    f->threadId = tid;
+    f->started = false;
+    *outFiber = f;
+    return true;
+}
+
+static void runFiberWork(struct ThreadSystemData* t, struct ThreadSystemFiber* f, struct ThreadSystemTask task, uint64_t tid)
+{
+    if (f && !f->coro)
+    {
+        mco_desc desc = mco_desc_init(fiberFunc, t->fiberStackSize);
+        desc.user_data = f;
+
+        if (mco_create(&f->coro, &desc) != MCO_SUCCESS)
+        {
+            f->coro = NULL;
+            task = f->task;
+
+            acquireMutex(&t->mutex);
+            f->next = t->freeFibers;
+            t->freeFibers = f;
+            --t->busyFiberCount;
+            releaseMutex(&t->mutex);
+
+            f = NULL;
+        }
+    }
+
+    if (!f)
+    {
+        runTask(t, task, tid);
+        return;
+    }
+
+    int64_t  startTime = 0;
+    uint64_t tick = 0;
+
+    if (t->stats)
+    {
+        startTime = getUSec(true);
+        if (!f->started)
+        {
+            f->started = true;
+            f->statsKey = getTaskStatsKey(f->task);
+            f->runUSec = 0;
+            statsTaskStarted(t, &f->task, startTime);
+        }
+    }
+    if (t->pProfileEnter)
+        tick = t->pProfileEnter(t->profileToken);
+
+    // Suspended task can be resumed by other thread, threadId it was started with is stale then
+    f->threadId = tid;
+
+    uint32_t priority = gTaskPriority;
+    uint64_t threadId = gTaskThreadId;
+    gTaskPriority = f->task.priority;
+    gTaskThreadId = tid;
+
+    pCurrentFiber = f;
+    mco_resume(f->coro);
+    pCurrentFiber = NULL;
+
+    gTaskPriority = priority;
+    gTaskThreadId = threadId;
+
+    if (t->pProfileLeave)
+        t->pProfileLeave(t->profileToken, tick);
+    if (t->stats)
+    {
+        uint64_t runTime = (uint64_t)(getUSec(true) - startTime);
+        f->runUSec += runTime;
+        statsThreadBusy(t, tid, runTime);
+        if (f->finished)
+            statsTaskFinished(t, f->statsKey, f->threadId, f->runUSec);
+    }
+
+    // Fiber is switched out, now it can be resumed by other threads
+    acquireMutex(&t->mutex);
+
+    if (f->finished)
+    {
+        f->finished = false;
+        f->next = t->freeFibers;
+        t->freeFibers = f;
+
+        if (--t->busyFiberCount == 0 && queuesEmpty(t))
+            wakeAllConditionVariable(&t->conditionIsIdle);
+    }
+    else if (!f->waitDone)
+    {
+        f->next = t->yieldedFibers;
+        t->yieldedFibers = f;
+    }
+    else if (tfrg_atomic32_load_acquire(f->waitDone))
+    {
+        pushReadyFiber(t, f);
+    }
+    else
+    {
+        f->next = *f->waitList;
+        *f->waitList = f;
+    }
+
+    releaseMutex(&t->mutex);
+}
+
+static void fiberThreadFunc(void* threadUserData)
+{
+    struct ThreadSystemThread* thread = threadUserData;
+    struct ThreadSystemData*   t = thread->system;
+    uint64_t                   tid = thread->id;
+
+    tfrg_atomic32_add_relaxed(&t->activatedThreadCount_Atomic, 1);
+
+    setTaskThreadName(t, tid);
+    statsThreadStarted(t, tid);
+
+    for (;;)
+    {
+        struct ThreadSystemFiber* f = NULL;
+        struct ThreadSystemTask   task = { 0 };
+        bool                      idleSet = false;
+
+        acquireMutex(&t->mutex);
+        while (!takeFiberWork(t, tid, &f, &task) && !tfrg_atomic32_load_relaxed(&t->stop))
+        {
+            if (!idleSet)
+            {
+                idleSet = true;
+                ++t->idleThreadCount;
+            }
+            wakeAllConditionVariable(&t->conditionIsIdle);
+            waitConditionVariable(&t->groups[thread->group].conditionTasks, &t->mutex, TIMEOUT_INFINITE);
+        }
+        if (idleSet)
+            --t->idleThreadCount;
+        releaseMutex(&t->mutex);
+
+        if (!f && !task.func)
             break;
+
+        runFiberWork(t, f, task, tid);
     }
 
     releaseThreadSystemHandle(t);
 }
 
+static bool initFibers(struct ThreadSystemData* t, const struct ThreadSystemInitDesc* desc)
+{
+    t->fiberCount = desc->fiberCount ? desc->fiberCount : FIBER_DEFAULT_COUNT;
+    t->fiberStackSize = desc->fiberStackSize ? desc->fiberStackSize : FIBER_DEFAULT_STACK_SIZE;
+
+    t->fibers = tf_calloc(t->fiberCount, sizeof(struct ThreadSystemFiber));
+    if (!t->fibers)
+        return false;
+
+    for (uint32_t fi = t->fiberCount; fi-- > 0;)
+    {
+        t->fibers[fi].system = t;
+        t->fibers[fi].next = t->freeFibers;
+        t->freeFibers = t->fibers + fi;
+    }
+
+    return true;
+}
+
+/************************************************************************/
+// Interface
+/************************************************************************/
+
+// Must be called after stop flags are set
+static void wakeAllThreads(struct ThreadSystemData* t)
+{
+    acquireMutex(&t->mutex);
+    for (uint32_t gi = 0; gi < t->groupCount; ++gi)
+        wakeAllConditionVariable(&t->groups[gi].conditionTasks);
+    releaseMutex(&t->mutex);
+
+    for (uint64_t wi = 0; t->workers && wi < t->threadCount; ++wi)
+    {
+        struct ThreadSystemWorker* w = t->workers + wi;
+        acquireMutex(&w->mutex);
+        w->signaled = true;
+        wakeOneConditionVariable(&w->condition);
+        releaseMutex(&w->mutex);
+    }
+}
+
 bool threadSystemInit(ThreadSystem* out, const struct ThreadSystemInitDesc* desc)
 {
     *out = NULL;
-    if (desc->threadCount == 0) // dummy run
+    if (desc->threadCount == 0 && desc->groupCount == 0) // dummy run
         return true;
 
     uint64_t cpuCount = getNumCPUCores();
-    uint64_t count = desc->threadCount;
+    if (cpuCount == 0) // something went wrong
+        return false;
+
+    // Without groups all threads serve all lanes
+    struct ThreadSystemGroupDesc defaultGroup = { 0 };
+    defaultGroup.threadCount = desc->threadCount;
+    defaultGroup.setAffinityMask = desc->setAffinityMask;
+    memcpy(defaultGroup.affinityMask, desc->affinityMask, sizeof defaultGroup.affinityMask);
+
+    const struct ThreadSystemGroupDesc* groups = desc->groupCount ? desc->pGroups : &defaultGroup;
+    uint32_t                            groupCount = desc->groupCount ? desc->groupCount : 1;
+
+    if (groupCount > THREAD_SYSTEM_MAX_GROUPS)
+    {
+        LOGF(eERROR, "Thread system supports up to %u groups, %u requested", THREAD_SYSTEM_MAX_GROUPS, groupCount);
+        return false;
+    }
+
+    uint64_t groupThreadCounts[THREAD_SYSTEM_MAX_GROUPS];
+    uint64_t count = 0;
+    uint32_t servedLanes = 0;
+
+    for (uint32_t gi = 0; gi < groupCount; ++gi)
+    {
+        uint64_t remaining = cpuCount > count ? cpuCount - count : 0;
+        uint64_t groupThreadCount = groups[gi].threadCount < remaining ? groups[gi].threadCount : remaining;
 
-    if (count > cpuCount)
-        count = cpuCount;
+        groupThreadCounts[gi] = groupThreadCount ? groupThreadCount : 1;
+        count += groupThreadCounts[gi];
+        servedLanes |= groups[gi].laneMask ? groups[gi].laneMask : THREAD_SYSTEM_LANE_MASK_ALL;
+    }
 
-    if (count == 0) // something went wrong (maybe getNumCPUCores returned 0)
+    if ((servedLanes & THREAD_SYSTEM_LANE_MASK_ALL) != THREAD_SYSTEM_LANE_MASK_ALL)
+    {
+        LOGF(eERROR, "Thread system groups don't serve all priority lanes, lane mask is %u", servedLanes);
         return false;
+    }
 
-    struct ThreadSystemData* t = tf_calloc(1, sizeof(*t) + sizeof(ThreadHandle) * count);
+    struct ThreadSystemData* t =
+        tf_calloc(1, sizeof(*t) + sizeof(ThreadHandle) * count + sizeof(struct ThreadSystemThread) * count);
     if (!t)
         return false;
 
     t->threads = (ThreadHandle*)(t + 1);
+    t->threadStates = (struct ThreadSystemThread*)(t->threads + count);
     t->name = desc->threadName ? desc->threadName : "ThreadSystem";
+    t->scheduler = desc->scheduler < THREAD_SYSTEM_SCHEDULER_COUNT ? desc->scheduler : THREAD_SYSTEM_SCHEDULER_SHARED_QUEUE;
+
+    if (desc->pProfileEnter && desc->pProfileLeave)
+    {
+        t->pProfileEnter = desc->pProfileEnter;
+        t->pProfileLeave = desc->pProfileLeave;
+        t->profileToken = desc->profileToken;
+    }
+
+    t->weightedLanes = desc->weightedLanes;
+    for (uint32_t li = 0; li < THREAD_SYSTEM_PRIORITY_COUNT; ++li)
+        t->laneWeights[li] = desc->laneWeights[li] ? desc->laneWeights[li] : gDefaultLaneWeights[li];
+
+    for (uint64_t ti = 0, gi = 0, groupEnd = groupThreadCounts[0]; ti < count; ++ti)
+    {
+        if (ti == groupEnd)
+            groupEnd += groupThreadCounts[++gi];
+
+        struct ThreadSystemThread* thread = t->threadStates + ti;
+        thread->system = t;
+        thread->id = ti;
+        thread->group = (uint32_t)gi;
+        thread->laneMask = groups[gi].laneMask ? groups[gi].laneMask : THREAD_SYSTEM_LANE_MASK_ALL;
+        memcpy(thread->credits, t->laneWeights, sizeof thread->credits);
+    }
 
     bool success = false;
 
@@ -205,11 +1379,15 @@ bool threadSystemInit(ThreadSystem* out, const struct ThreadSystemInitDesc* desc
             break;
         }
 
-        if (!initConditionVariable(&t->conditionTasks))
+        for (; t->groupCount < groupCount; ++t->groupCount)
         {
-            memset(&t->conditionTasks, 0, sizeof t->conditionTasks);
-            break;
+            struct ThreadSystemGroup* g = t->groups + t->groupCount;
+            g->laneMask = groups[t->groupCount].laneMask ? groups[t->groupCount].laneMask : THREAD_SYSTEM_LANE_MASK_ALL;
+            if (!initConditionVariable(&g->conditionTasks))
+                break;
         }
+        if (t->groupCount < groupCount)
+            break;
 
         if (!initConditionVariable(&t->conditionIsIdle))
         {
@@ -217,43 +1395,60 @@ bool threadSystemInit(ThreadSystem* out, const struct ThreadSystemInitDesc* desc
             break;
         }
 
+        if (!initConditionVariable(&t->conditionTaskDone))
+        {
+            memset(&t->conditionTaskDone, 0, sizeof t->conditionTaskDone);
+            break;
+        }
+
+        t->threadCount = count;
+
+        if (t->scheduler == THREAD_SYSTEM_SCHEDULER_WORK_STEALING && !initWorkers(t))
+            break;
+
+        if (t->scheduler == THREAD_SYSTEM_SCHEDULER_FIBERS && !initFibers(t, desc))
+            break;
+
+        if (desc->instrumentation && !initStats(t))
+            break;
+
         success = true;
     } while (false);
 
     if (!success)
     {
         threadSystemCleanup(t);
+        return false;
     }
 
     ThreadDesc threadDesc = { 0 };
 
-    threadDesc.pFunc = taskThreadFunc;
-    threadDesc.pData = t;
+    threadDesc.pFunc = t->workers ? workStealingThreadFunc : t->fibers ? fiberThreadFunc : taskThreadFunc;
 
 #if defined(_WINDOWS) // for some reason on Windows thread name won't change after creation
     strncpy(threadDesc.mThreadName, t->name, sizeof threadDesc.mThreadName);
     threadDesc.mThreadName[sizeof(threadDesc.mThreadName) - 1] = 0;
 #endif
 
-    if (desc->setAffinityMask)
-    {
-        threadDesc.setAffinityMask = true;
-        memcpy(threadDesc.affinityMask, desc->affinityMask, sizeof threadDesc.affinityMask);
-    }
-
-    arrsetlen(t->tasks, OPTIMAL_TASK_SLOTS_COUNT);
-
-    t->threadCount = count;
+    for (uint32_t li = 0; li < THREAD_SYSTEM_PRIORITY_COUNT; ++li)
+        arrsetlen(t->queues[li].tasks, OPTIMAL_TASK_SLOTS_COUNT);
 
     for (uint64_t ti = 0; ti < count; ++ti)
     {
         acquireThreadSystemHandle(t);
 
+        const struct ThreadSystemGroupDesc* group = groups + t->threadStates[ti].group;
+
+        threadDesc.pData = t->threadStates + ti;
+        threadDesc.setAffinityMask = group->setAffinityMask;
+        memcpy(threadDesc.affinityMask, group->affinityMask, sizeof threadDesc.affinityMask);
+
         if (initThread(&threadDesc, t->threads + ti))
             continue;
 
-        t->stop = true;
-        t->stopAbandon = true;
+        tfrg_atomic32_store_relaxed(&t->stop, 1);
+        tfrg_atomic32_store_relaxed(&t->stopAbandon, 1);
+        wakeAllThreads(t);
 
         releaseThreadSystemHandle(t);
         return false;
@@ -272,12 +1467,13 @@ void threadSystemExit(ThreadSystem* thandle, const struct ThreadSystemExitDesc*
     *thandle = NULL;
 
     acquireMutex(&t->mutex);
-    t->stop = true;
+    tfrg_atomic32_store_relaxed(&t->stop, 1);
     if (desc->abandonTasks)
-        t->stopAbandon = true;
-    wakeAllConditionVariable(&t->conditionTasks);
+        tfrg_atomic32_store_relaxed(&t->stopAbandon, 1);
     releaseMutex(&t->mutex);
 
+    wakeAllThreads(t);
+
     if (!desc->detachThreads)
     {
         for (uint64_t ti = 0; ti < t->threadCount; ++ti)
@@ -292,11 +1488,17 @@ void threadSystemExit(ThreadSystem* thandle, const struct ThreadSystemExitDesc*
     releaseThreadSystemHandle(t);
 }
 
-void threadSystemAddTasks(ThreadSystem thandle, TaskFunc func, uint64_t count, uint64_t userSize, void* users)
+void threadSystemAddTasks(ThreadSystem ts, TaskFunc func, uint64_t count, uint64_t userSize, void* users)
+{
+    threadSystemAddTasksPriority(ts, THREAD_SYSTEM_PRIORITY_NORMAL, func, count, userSize, users);
+}
+
+void threadSystemAddTasksPriority(ThreadSystem thandle, enum ThreadSystemPriority priority, TaskFunc func, uint64_t count, uint64_t userSize,
+                                  void* users)
 {
     if (count == 0)
         return;
-    if (!VERIFY(func))
+    if (!VERIFY(func) || !VERIFY(priority < THREAD_SYSTEM_PRIORITY_COUNT))
         return;
 
     struct ThreadSystemData* t = thandle;
@@ -308,49 +1510,96 @@ void threadSystemAddTasks(ThreadSystem thandle, TaskFunc func, uint64_t count, u
         return;
     }
 
-    acquireMutex(&t->mutex);
+    statsTasksAdded(t, count);
 
-    uint64_t offset = t->tasksQueued;
+    if (t->workers)
+    {
+        tfrg_atomic64_add_relaxed(&t->pendingCount, count);
 
-    t->tasksQueued += count;
+        // Worker keeps its normal tasks local, others steal them when idle
+        struct ThreadSystemWorker* w = getCurrentWorker(t);
+        if (w && (priority != THREAD_SYSTEM_PRIORITY_NORMAL || !(t->threadStates[w->id].laneMask & THREAD_SYSTEM_LANE_MASK(priority))))
+            w = NULL;
 
-    uint64_t len = arrlenu(t->tasks);
+        int64_t addTime = w && t->stats ? getUSec(true) : 0;
 
-    if (t->tasksQueued > len)
-    {
-        // Resize the task array to a multiple of OPTIMAL_TASK_SLOTS_COUNT that is large enough to contain all of the requested tasks.
-        uint64_t newTasksLength = t->tasksQueued / OPTIMAL_TASK_SLOTS_COUNT;
-        newTasksLength += (t->tasksQueued % OPTIMAL_TASK_SLOTS_COUNT) == 0 ? 0 : 1;
-        newTasksLength *= OPTIMAL_TASK_SLOTS_COUNT;
-        arrsetlen(t->tasks, newTasksLength);
-    }
+        uint64_t ti = 0;
+        for (; w && ti < count; ++ti)
+        {
+            struct ThreadSystemTask task = { func, users ? ((uint8_t*)users + ti * userSize) : NULL, addTime, priority };
+            if (!workerPush(w, task))
+                break;
+        }
 
-    for (uint64_t ti = 0; ti < count; ++ti)
-    {
-        t->tasks[offset + ti] = (struct ThreadSystemTask){
-            func,
-            users ? ((uint8_t*)users + ti * userSize) : NULL,
-        };
+        if (ti < count)
+        {
+            acquireMutex(&t->mutex);
+            pushQueuedTasks(t, priority, func, count - ti, userSize, users ? (uint8_t*)users + ti * userSize : NULL);
+            releaseMutex(&t->mutex);
+        }
+
+        wakeWorkers(t, priority, count);
+        return;
     }
 
-    if (count == 1)
-        wakeOneConditionVariable(&t->conditionTasks);
-    else
-        wakeAllConditionVariable(&t->conditionTasks);
+    acquireMutex(&t->mutex);
+
+    pushQueuedTasks(t, priority, func, count, userSize, users);
+    wakeGroups(t, priority, count);
 
     releaseMutex(&t->mutex);
     return;
 }
 
+uint64_t threadSystemGetTaskThreadId(void) { return gTaskThreadId; }
+
 bool threadSystemAssist(ThreadSystem thandle)
 {
     struct ThreadSystemData* t = thandle;
     if (!t)
         return false;
 
+    if (t->workers)
+    {
+        struct ThreadSystemTask task = findTask(t, getCurrentWorker(t));
+        if (!task.func)
+            return false;
+
+        runTask(t, task, UINT64_MAX);
+        finishTask(t);
+        return true;
+    }
+
+    // Task running on a fiber gives the thread to other tasks instead of calling them
+    struct ThreadSystemFiber* f = getCurrentFiber(t);
+    if (f)
+    {
+        acquireMutex(&t->mutex);
+        bool hasWork = t->readyFibers || !queuesEmpty(t);
+        releaseMutex(&t->mutex);
+
+        if (hasWork)
+            fiberWait(f, NULL, NULL);
+        return hasWork;
+    }
+
+    // Fibers are not nested, from a fiber of other thread system tasks are called on its stack below
+    if (t->fibers && !pCurrentFiber)
+    {
+        struct ThreadSystemTask task = { 0 };
+
+        acquireMutex(&t->mutex);
+        bool taken = takeFiberWork(t, UINT64_MAX, &f, &task);
+        releaseMutex(&t->mutex);
+
+        if (taken)
+            runFiberWork(t, f, task, UINT64_MAX);
+        return taken;
+    }
+
     struct ThreadSystemTask task = getTask(t, UINT64_MAX);
     if (task.func)
-        task.func(task.user, UINT64_MAX);
+        runTask(t, task, UINT64_MAX);
     return task.func;
 }
 
@@ -363,11 +1612,23 @@ bool threadSystemWaitIdleTimeout(ThreadSystem thandle, uint32_t timeout_ms)
     Timer timer;
     initTimer(&timer);
 
+    // Workers take the mutex only when somebody waits
+    if (t->workers)
+    {
+        tfrg_atomic32_add_relaxed(&t->idleWaiterCount, 1);
+        tfrg_memorybarrier_full();
+    }
+
     bool idle = false;
     acquireMutex(&t->mutex);
     for (;;)
     {
-        idle = (t->tasksTaken >= t->tasksQueued) && (t->idleThreadCount >= tfrg_atomic32_load_relaxed(&t->references_Atomic) - 1);
+        if (t->workers)
+            idle = tfrg_atomic64_load_acquire(&t->pendingCount) == 0;
+        else
+            idle = queuesEmpty(t) && t->busyFiberCount == 0 &&
+                   (t->idleThreadCount >= tfrg_atomic32_load_relaxed(&t->references_Atomic) - 1);
+
         if (idle || timeout_ms == 0)
             break;
 
@@ -384,6 +1645,10 @@ bool threadSystemWaitIdleTimeout(ThreadSystem thandle, uint32_t timeout_ms)
         }
     }
     releaseMutex(&t->mutex);
+
+    if (t->workers)
+        tfrg_atomic32_add_relaxed(&t->idleWaiterCount, -1);
+
     return idle;
 }
 
@@ -399,4 +1664,463 @@ void threadSystemGetInfo(ThreadSystem thandle, struct ThreadSystemInfo* outInfo)
     outInfo->executedThreadCount = tfrg_atomic32_load_relaxed(&t->activatedThreadCount_Atomic);
     outInfo->activeThreadCount = tfrg_atomic32_load_relaxed(&t->references_Atomic) - 1;
     outInfo->threadName = t->name;
+    outInfo->scheduler = t->scheduler;
+
+    struct ThreadSystemStats* stats = t->stats;
+    if (!stats)
+        return;
+
+    outInfo->instrumentation = true;
+    outInfo->taskCount = tfrg_atomic64_load_relaxed(&stats->taskCount);
+    outInfo->latencyTotalUSec = tfrg_atomic64_load_relaxed(&stats->latencyTotalUSec);
+    outInfo->latencyMaxUSec = tfrg_atomic64_load_relaxed(&stats->latencyMaxUSec);
+    outInfo->runTotalUSec = tfrg_atomic64_load_relaxed(&stats->runTotalUSec);
+    outInfo->peakQueueDepth = tfrg_atomic64_load_relaxed(&stats->peakQueueDepth);
+
+    for (uint32_t fi = 0; fi < THREAD_SYSTEM_INFO_MAX_TASK_FUNCS; ++fi)
+    {
+        const struct ThreadSystemTaskFuncStats* funcStats = stats->funcs + fi;
+
+        uintptr_t func = tfrg_atomicptr_load_relaxed(&funcStats->func);
+        if (!func)
+            continue;
+
+        struct ThreadSystemTaskFuncInfo* funcInfo = outInfo->taskFuncs + outInfo->taskFuncCount++;
+        funcInfo->func = (const void*)func;
+        funcInfo->count = tfrg_atomic64_load_relaxed(&funcStats->count);
+        funcInfo->runTotalUSec = tfrg_atomic64_load_relaxed(&funcStats->runTotalUSec);
+        funcInfo->runMaxUSec = tfrg_atomic64_load_relaxed(&funcStats->runMaxUSec);
+    }
+
+    int64_t now = getUSec(true);
+
+    for (uint64_t ti = 0; ti < t->threadCount && ti < THREAD_SYSTEM_INFO_MAX_THREADS; ++ti)
+    {
+        const struct ThreadSystemThreadStats* threadStats = stats->threads + ti;
+        struct ThreadSystemThreadInfo*        threadInfo = outInfo->threads + ti;
+
+        threadInfo->taskCount = tfrg_atomic64_load_relaxed(&threadStats->taskCount);
+        threadInfo->busyUSec = tfrg_atomic64_load_relaxed(&threadStats->busyUSec);
+
+        int64_t startTime = (int64_t)tfrg_atomic64_load_relaxed(&threadStats->startTime);
+        int64_t lifetime = startTime ? now - startTime : 0;
+        threadInfo->idleUSec = lifetime > (int64_t)threadInfo->busyUSec ? (uint64_t)lifetime - threadInfo->busyUSec : 0;
+    }
+}
+
+/************************************************************************/
+// Task graph
+/************************************************************************/
+
+// How often waiting thread looks for new tasks to help with
+#define TASK_WAIT_ASSIST_INTERVAL_MS 1
+
+// Value of ThreadSystemTaskNode::successors after the task is finished
+#define TASK_SUCCESSORS_CLOSED ((uintptr_t)1)
+
+struct ThreadSystemTaskLink
+{
+    struct ThreadSystemTaskNode* task;
+    struct ThreadSystemTaskLink* next;
+};
+
+struct ThreadSystemTaskNode
+{
+    struct ThreadSystemData* system;
+    TaskFunc                 func;
+    void*                    user;
+    enum ThreadSystemPriority priority;
+
+    // Unfinished dependencies, plus one until the task is submitted
+    tfrg_atomic32_t pendingCount;
+    // User handle, submitted task until it finishes, each link from a dependency
+    tfrg_atomic32_t references;
+    // Lock-free list of ThreadSystemTaskLink, TASK_SUCCESSORS_CLOSED once finished
+    tfrg_atomicptr_t successors;
+    tfrg_atomic32_t  done;
+    tfrg_atomic32_t  waiterCount;
+    // Suspended tasks waiting for this one, protected by mutex
+    struct ThreadSystemFiber* waitingFibers;
+#if defined(FORGE_DEBUG)
+    tfrg_atomic32_t submitted;
+#endif
+};
+
+static void runGraphTask(void* user, uint64_t threadId);
+
+static void releaseTaskNode(struct ThreadSystemTaskNode* task)
+{
+    if (tfrg_atomic32_add_acq_rel(&task->references, -1) == 1)
+        tf_free(task);
+}
+
+static void dependencyFinished(struct ThreadSystemTaskNode* task)
+{
+    // Last finished dependency hands results of all of them over to the task
+    if (tfrg_atomic32_add_acq_rel(&task->pendingCount, -1) == 1)
+        threadSystemAddTaskPriority(task->system, task->priority, runGraphTask, task);
+}
+
+static void runGraphTask(void* user, uint64_t threadId)
+{
+    struct ThreadSystemTaskNode* task = user;
+
+    if (task->func)
+        task->func(task->user, threadId);
+
+    // Close successor list, dependencies added from now on see the task as finished
+    uintptr_t head;
+    do
+    {
+        head = tfrg_atomicptr_load_relaxed(&task->successors);
+    } while ((uintptr_t)tfrg_atomicptr_cas_acq_rel(&task->successors, head, TASK_SUCCESSORS_CLOSED) != head);
+
+    tfrg_atomic32_store_release(&task->done, 1);
+
+    // Pairs with waiterCount increment in threadSystemWaitTask,
+    // either waiter sees 'done' or we see the waiter
+    tfrg_memorybarrier_full();
+
+    struct ThreadSystemData* t = task->system;
+    if (t && tfrg_atomic32_load_relaxed(&task->waiterCount))
+    {
+        acquireMutex(&t->mutex);
+        wakeAllConditionVariable(&t->conditionTaskDone);
+        resumeWaitingFibers(t, &task->waitingFibers);
+        releaseMutex(&t->mutex);
+    }
+
+    for (struct ThreadSystemTaskLink* link = (struct ThreadSystemTaskLink*)head; link;)
+    {
+        struct ThreadSystemTaskLink* next = link->next;
+        dependencyFinished(link->task);
+        releaseTaskNode(link->task);
+        tf_free(link);
+        link = next;
+    }
+
+    releaseTaskNode(task);
+}
+
+TaskHandle threadSystemCreateTask(ThreadSystem ts, TaskFunc func, void* user)
+{
+    struct ThreadSystemTaskNode* task = tf_calloc(1, sizeof *task);
+    if (!task)
+        return NULL;
+
+    task->system = ts;
+    task->func = func;
+    task->user = user;
+    task->priority = THREAD_SYSTEM_PRIORITY_NORMAL;
+    task->pendingCount = 1;
+    task->references = 1;
+    return task;
+}
+
+void threadSystemAddTaskDependency(TaskHandle task, TaskHandle dependency)
+{
+    if (!VERIFY(task && dependency))
+        return;
+
+#if defined(FORGE_DEBUG)
+    ASSERTMSG(!tfrg_atomic32_load_relaxed(&task->submitted), "Dependency is added to already submitted task");
+#endif
+
+    struct ThreadSystemTaskLink* link = tf_malloc(sizeof *link);
+    if (!link)
+        return;
+
+    link->task = task;
+    tfrg_atomic32_add_relaxed(&task->pendingCount, 1);
+    tfrg_atomic32_add_relaxed(&task->references, 1);
+
+    for (;;)
+    {
+        uintptr_t head = tfrg_atomicptr_load_relaxed(&dependency->successors);
+
+        if (head == TASK_SUCCESSORS_CLOSED)
+        {
+            // Dependency is finished already
+            tfrg_atomic32_add_relaxed(&task->pendingCount, -1);
+            tfrg_atomic32_add_relaxed(&task->references, -1);
+            tf_free(link);
+            return;
+        }
+
+        link->next = (struct ThreadSystemTaskLink*)head;
+        if ((uintptr_t)tfrg_atomicptr_cas_acq_rel(&dependency->successors, head, (uintptr_t)link) == head)
+            return;
+    }
+}
+
+void threadSystemSetTaskPriority(TaskHandle task, enum ThreadSystemPriority priority)
+{
+    if (!VERIFY(task) || !VERIFY(priority < THREAD_SYSTEM_PRIORITY_COUNT))
+        return;
+
+#if defined(FORGE_DEBUG)
+    ASSERTMSG(!tfrg_atomic32_load_relaxed(&task->submitted), "Priority is set for already submitted task");
+#endif
+
+    task->priority = priority;
+}
+
+void threadSystemSubmitTask(TaskHandle task)
+{
+    if (!VERIFY(task))
+        return;
+
+#if defined(FORGE_DEBUG)
+    ASSERTMSG(!tfrg_atomic32_store_relaxed(&task->submitted, 1), "Task is submitted twice");
+#endif
+
+    // Reference is released when the task finishes
+    tfrg_atomic32_add_relaxed(&task->references, 1);
+    dependencyFinished(task);
+}
+
+TaskHandle threadSystemAddContinuation(ThreadSystem ts, TaskHandle predecessor, TaskFunc func, void* user)
+{
+    TaskHandle task = threadSystemCreateTask(ts, func, user);
+    if (!task)
+        return NULL;
+
+    threadSystemAddTaskDependency(task, predecessor);
+    threadSystemSubmitTask(task);
+    return task;
+}
+
+bool threadSystemIsTaskDone(TaskHandle task) { return tfrg_atomic32_load_acquire(&task->done) != 0; }
+
+void threadSystemWaitTask(ThreadSystem thandle, TaskHandle task)
+{
+    struct ThreadSystemData*  t = thandle;
+    struct ThreadSystemFiber* f = getCurrentFiber(t);
+
+    while (!threadSystemIsTaskDone(task))
+    {
+        if (f)
+        {
+            tfrg_atomic32_add_relaxed(&task->waiterCount, 1);
+            tfrg_memorybarrier_full();
+            fiberWait(f, &task->done, &task->waitingFibers);
+            tfrg_atomic32_add_relaxed(&task->waiterCount, -1);
+            continue;
+        }
+
+        if (threadSystemAssist(t))
+            continue;
+
+        if (!t) // dummy run
+        {
+            ASSERTMSG(false, "Task can't finish, some of its dependencies are not submitted");
+            return;
+        }
+
+        tfrg_atomic32_add_relaxed(&task->waiterCount, 1);
+        tfrg_memorybarrier_full();
+
+        acquireMutex(&t->mutex);
+        if (!threadSystemIsTaskDone(task))
+            waitConditionVariable(&t->conditionTaskDone, &t->mutex, TASK_WAIT_ASSIST_INTERVAL_MS);
+        releaseMutex(&t->mutex);
+
+        tfrg_atomic32_add_relaxed(&task->waiterCount, -1);
+    }
+}
+
+void threadSystemReleaseTask(TaskHandle task)
+{
+    if (task)
+        releaseTaskNode(task);
+}
+
+/************************************************************************/
+// Parallel for
+/************************************************************************/
+
+// Max number of split ranges per thread
+#define PARALLEL_FOR_RANGES_PER_THREAD 32
+
+struct ParallelForRange
+{
+    struct ParallelForContext* ctx;
+    uint64_t                   begin;
+    uint64_t                   end;
+};
+
+struct ParallelForContext
+{
+    struct ThreadSystemData*  system;
+    ParallelForFunc           func;
+    void*                     user;
+    uint64_t                  grain;
+    enum ThreadSystemPriority priority;
+
+    // Iterations which are not processed yet
+    tfrg_atomic64_t remaining;
+    // Set under mutex, ThreadSystemData::conditionTaskDone is signaled
+    tfrg_atomic32_t done;
+    // Suspended caller, protected by mutex
+    struct ThreadSystemFiber* waitingFibers;
+
+    struct ParallelForRange* ranges;
+    uint64_t                 rangeCapacity;
+    tfrg_atomic64_t          rangeCount;
+};
+
+// Hint, reads scheduler state without synchronization
+static bool parallelForHasIdleThreads(struct ThreadSystemData* t)
+{
+    if (t->workers)
+    {
+        if (tfrg_atomic32_load_relaxed(&t->sleepingCount))
+            return true;
+
+        // Range split before is stolen already, so split again
+        struct ThreadSystemWorker* w = getCurrentWorker(t);
+        if (w)
+            return (int64_t)tfrg_atomic64_load_relaxed(&w->bottom) <= (int64_t)tfrg_atomic64_load_relaxed(&w->top);
+        return queuedTaskCount(t) == 0;
+    }
+
+    // Idle threads take all queued tasks
+    return queuedTaskCount(t) == 0;
+}
+
+static void parallelForTask(void* user, uint64_t threadId);
+
+static void parallelForRun(struct ParallelForContext* ctx, uint64_t begin, uint64_t end, uint64_t threadId)
+{
+    struct ThreadSystemData* t = ctx->system;
+
+    while (begin < end)
+    {
+        // Give upper half away
+        if (t && end - begin >= ctx->grain * 2 && parallelForHasIdleThreads(t))
+        {
+            uint64_t slot = tfrg_atomic64_add_relaxed(&ctx->rangeCount, 1);
+            if (slot < ctx->rangeCapacity)
+            {
+                uint64_t                 middle = begin + (end - begin) / 2;
+                struct ParallelForRange* range = ctx->ranges + slot;
+
+                *range = (struct ParallelForRange){ ctx, middle, end };
+                end = middle;
+                threadSystemAddTaskPriority(t, ctx->priority, parallelForTask, range);
+                continue;
+            }
+        }
+
+        uint64_t chunkEnd = end - begin > ctx->grain ? begin + ctx->grain : end;
+        ctx->func(ctx->user, begin, chunkEnd, threadId);
+
+        uint64_t processed = chunkEnd - begin;
+        begin = chunkEnd;
+
+        if ((uint64_t)tfrg_atomic64_add_acq_rel(&ctx->remaining, -(int64_t)processed) != processed)
+            continue;
+
+        // Last iterations are processed. Caller polls 'done' without the mutex and returns as soon as it is set,
+        // so 'ctx' can't be accessed after it. Waiting fibers are detached first.
+        struct ThreadSystemFiber* waitingFibers = NULL;
+        if (t)
+        {
+            acquireMutex(&t->mutex);
+            waitingFibers = ctx->waitingFibers;
+            ctx->waitingFibers = NULL;
+        }
+        tfrg_atomic32_store_release(&ctx->done, 1);
+        if (t)
+        {
+            wakeAllConditionVariable(&t->conditionTaskDone);
+            resumeWaitingFibers(t, &waitingFibers);
+            releaseMutex(&t->mutex);
+        }
+    }
+}
+
+static void parallelForTask(void* user, uint64_t threadId)
+{
+    struct ParallelForRange* range = user;
+    parallelForRun(range->ctx, range->begin, range->end, threadId);
+}
+
+void threadSystemParallelFor(ThreadSystem thandle, uint64_t begin, uint64_t end, uint64_t grain, ParallelForFunc func, void* user)
+{
+    if (begin >= end || !VERIFY(func))
+        return;
+
+    struct ThreadSystemData* t = thandle;
+
+    uint64_t count = end - begin;
+    uint64_t threadCount = (t ? t->threadCount : 0) + 1;
+
+    if (grain == 0)
+        grain = count / (threadCount * 8);
+    if (grain == 0)
+        grain = 1;
+
+    struct ParallelForContext ctx = { 0 };
+    ctx.system = t;
+    ctx.func = func;
+    ctx.user = user;
+    ctx.grain = grain;
+    ctx.priority = (enum ThreadSystemPriority)gTaskPriority;
+    ctx.remaining = count;
+
+    if (t && count > grain)
+    {
+        ctx.rangeCapacity = threadCount * PARALLEL_FOR_RANGES_PER_THREAD;
+        if (ctx.rangeCapacity > count / grain)
+            ctx.rangeCapacity = count / grain;
+
+        ctx.ranges = tf_malloc(ctx.rangeCapacity * sizeof(struct ParallelForRange));
+        if (!ctx.ranges)
+            ctx.rangeCapacity = 0;
+    }
+
+    parallelForRun(&ctx, begin, end, UINT64_MAX);
+
+    struct ThreadSystemFiber* f = getCurrentFiber(t);
+
+    while (!tfrg_atomic32_load_acquire(&ctx.done))
+    {
+        if (f)
+        {
+            fiberWait(f, &ctx.done, &ctx.waitingFibers);
+            continue;
+        }
+
+        if (threadSystemAssist(t))
+            continue;
+
+        acquireMutex(&t->mutex);
+        if (!tfrg_atomic32_load_acquire(&ctx.done))
+            waitConditionVariable(&t->conditionTaskDone, &t->mutex, TASK_WAIT_ASSIST_INTERVAL_MS);
+        releaseMutex(&t->mutex);
+    }
+
+    tf_free(ctx.ranges);
+}
+
+/************************************************************************/
+// Instrumentation keys
+/************************************************************************/
+
+static const void* getTaskStatsKey(struct ThreadSystemTask task)
+{
+    if (task.func == runGraphTask)
+    {
+        const struct ThreadSystemTaskNode* node = task.user;
+        if (node->func)
+            return (const void*)node->func;
+    }
+    else if (task.func == parallelForTask)
+    {
+        const struct ParallelForRange* range = task.user;
+        return (const void*)range->ctx->func;
+    }
+
+    return (const void*)task.func;
 }
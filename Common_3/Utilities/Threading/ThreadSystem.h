@@ -36,6 +36,53 @@ extern "C"
     // e.g. when threadSystemAssist() is used
     typedef void (*TaskFunc)(void* user, uint64_t threadId);
 
+    // Processes iterations [begin; end)
+    typedef void (*ParallelForFunc)(void* user, uint64_t begin, uint64_t end, uint64_t threadId);
+
+    enum ThreadSystemScheduler
+    {
+        // All tasks go through one mutex protected queue
+        THREAD_SYSTEM_SCHEDULER_SHARED_QUEUE = 0,
+        // Every worker owns a lock-free deque, idle workers steal from random victims.
+        // Tasks added by a worker thread are pushed to its own deque,
+        // tasks added by other threads go through a shared injection queue.
+        // Sleeping workers are woken one by one, only as many as tasks were added.
+        THREAD_SYSTEM_SCHEDULER_WORK_STEALING,
+        // Shared queue, but every task runs on a fiber.
+        // Task waiting in threadSystemWaitTask or threadSystemParallelFor is suspended
+        // and the thread continues with other tasks, so waits don't take threads out of the pool.
+        // Suspended task is resumed by any thread, so it must not hold a mutex
+        // or rely on thread local storage across the wait.
+        // threadId argument of the task is stale after the wait, threadSystemGetTaskThreadId returns the current one.
+        THREAD_SYSTEM_SCHEDULER_FIBERS,
+        THREAD_SYSTEM_SCHEDULER_COUNT,
+    };
+
+    // Tasks of higher priority lane are taken first, see ThreadSystemInitDesc::weightedLanes
+    enum ThreadSystemPriority
+    {
+        THREAD_SYSTEM_PRIORITY_HIGH = 0,
+        THREAD_SYSTEM_PRIORITY_NORMAL,
+        THREAD_SYSTEM_PRIORITY_BACKGROUND,
+        THREAD_SYSTEM_PRIORITY_COUNT,
+    };
+
+#define THREAD_SYSTEM_LANE_MASK(priority) (1u << (priority))
+#define THREAD_SYSTEM_LANE_MASK_ALL       ((1u << THREAD_SYSTEM_PRIORITY_COUNT) - 1)
+#define THREAD_SYSTEM_MAX_GROUPS          8
+
+    // Workers which serve the same lanes and run on the same cores,
+    // e.g. background group kept off the cores of the render thread
+    struct ThreadSystemGroupDesc
+    {
+        uint64_t threadCount;
+        // THREAD_SYSTEM_LANE_MASK of served priorities, 0 serves all lanes
+        uint32_t laneMask;
+        // Overrides ThreadSystemInitDesc::affinityMask
+        bool     setAffinityMask;
+        uint64_t affinityMask[16];
+    };
+
     struct ThreadSystemInitDesc
     {
         // same as affinity mask from struct ThreadDesc, but for all threads in pool
@@ -53,6 +100,37 @@ extern "C"
         // Thread namings are "ThreadName 1", "ThreadName 2", ...
         // pointer must be valid until threadSystemExit
         const char* threadName;
+
+        enum ThreadSystemScheduler scheduler;
+
+        // THREAD_SYSTEM_SCHEDULER_FIBERS only, 0 picks default values.
+        // Fibers are created on demand. When all of them are busy,
+        // tasks run on thread stack and their waits block the thread.
+        uint32_t fiberCount;
+        uint32_t fiberStackSize;
+
+        // Collect task timing, queue depth and thread utilization, see ThreadSystemInfo.
+        // Costs two timer reads and a few atomics per task.
+        bool instrumentation;
+
+        // Optional profiler zone around every task, use cpuProfileEnter/cpuProfileLeave
+        // and token from getCpuProfileToken. Tasks on fibers get a zone per resume.
+        uint64_t (*pProfileEnter)(uint64_t token);
+        void (*pProfileLeave)(uint64_t token, uint64_t tick);
+        uint64_t profileToken;
+
+        // Strict scheduling always takes task from the highest priority non-empty lane.
+        // Weighted scheduling takes tasks from non-empty lanes in proportion to laneWeights,
+        // so background work progresses under constant high priority load.
+        bool     weightedLanes;
+        // 0 picks default weight of the lane
+        uint32_t laneWeights[THREAD_SYSTEM_PRIORITY_COUNT];
+
+        // Optional, replaces threadCount. Every lane must be served by some group.
+        // Total thread count is limited to getNumCPUCores(), but every group gets at least one thread.
+        // Pointer must be valid during threadSystemInit only.
+        const struct ThreadSystemGroupDesc* pGroups;
+        uint32_t                            groupCount;
     };
 
     struct ThreadSystemExitDesc
@@ -64,6 +142,27 @@ extern "C"
         bool detachThreads;
     };
 
+#define THREAD_SYSTEM_INFO_MAX_THREADS    64
+#define THREAD_SYSTEM_INFO_MAX_TASK_FUNCS 64
+
+    struct ThreadSystemTaskFuncInfo
+    {
+        // TaskFunc of the task, function of the graph task, or ParallelForFunc of parallel for
+        const void* func;
+        uint64_t    count;
+        uint64_t    runTotalUSec;
+        uint64_t    runMaxUSec;
+    };
+
+    struct ThreadSystemThreadInfo
+    {
+        uint64_t taskCount;
+        // Time spent in tasks, nested tasks are counted once
+        uint64_t busyUSec;
+        // Time since thread start not spent in tasks
+        uint64_t idleUSec;
+    };
+
     // It's up to the user to estimate the usefulness of provided information
     struct ThreadSystemInfo
     {
@@ -86,6 +185,25 @@ extern "C"
 
         // Copy of pointer from 'ThreadSystemInitDesc::threadName'
         const char* threadName;
+
+        enum ThreadSystemScheduler scheduler;
+
+        // Rest is filled only if ThreadSystemInitDesc::instrumentation is set.
+        // Tasks executed by threadSystemAssist are not attributed to any thread.
+        bool     instrumentation;
+        uint64_t taskCount;
+        // Time between adding and starting of a task
+        uint64_t latencyTotalUSec;
+        uint64_t latencyMaxUSec;
+        uint64_t runTotalUSec;
+        // Max number of added, but not started tasks
+        uint64_t peakQueueDepth;
+
+        // Functions which don't fit are counted in totals only
+        uint32_t                        taskFuncCount;
+        struct ThreadSystemTaskFuncInfo taskFuncs[THREAD_SYSTEM_INFO_MAX_TASK_FUNCS];
+        // [min(threadCount, THREAD_SYSTEM_INFO_MAX_THREADS)]
+        struct ThreadSystemThreadInfo threads[THREAD_SYSTEM_INFO_MAX_THREADS];
     };
 
     typedef void* ThreadSystem;
@@ -95,6 +213,17 @@ extern "C"
         { 0 },
         UINT64_MAX,
         NULL,
+        THREAD_SYSTEM_SCHEDULER_SHARED_QUEUE,
+        0,
+        0,
+        false,
+        NULL,
+        NULL,
+        0,
+        false,
+        { 0 },
+        NULL,
+        0,
     };
 
     static const struct ThreadSystemExitDesc gThreadSystemExitDescDefault = {
@@ -105,8 +234,12 @@ extern "C"
     bool threadSystemInit(ThreadSystem* out, const struct ThreadSystemInitDesc* desc);
     void threadSystemExit(ThreadSystem* ts, const struct ThreadSystemExitDesc* desc);
 
+    // Adds to THREAD_SYSTEM_PRIORITY_NORMAL lane
     void threadSystemAddTasks(ThreadSystem ts, TaskFunc func, uint64_t count, uint64_t userSize, void* userArray);
 
+    void threadSystemAddTasksPriority(ThreadSystem ts, enum ThreadSystemPriority priority, TaskFunc func, uint64_t count, uint64_t userSize,
+                                      void* userArray);
+
 #define threadSystemAddTaskGroup(ts, func, count, userArray) threadSystemAddTasks(ts, func, count, sizeof *userArray, userArray)
 
     // returns result of expression "task is executed"
@@ -118,12 +251,79 @@ extern "C"
 
     void threadSystemGetInfo(ThreadSystem ts, struct ThreadSystemInfo* outInfo);
 
+    // threadId of the task running on the calling thread, UINT64_MAX outside of tasks.
+    // Equals TaskFunc argument until the task waits on a fiber, afterwards it is the thread which resumed it.
+    uint64_t threadSystemGetTaskThreadId(void);
+
     static inline void threadSystemAddTask(ThreadSystem ts, TaskFunc func, void* user) { threadSystemAddTasks(ts, func, 1, 0, user); }
 
+    static inline void threadSystemAddTaskPriority(ThreadSystem ts, enum ThreadSystemPriority priority, TaskFunc func, void* user)
+    {
+        threadSystemAddTasksPriority(ts, priority, func, 1, 0, user);
+    }
+
     static inline bool threadSystemIsIdle(ThreadSystem ts) { return threadSystemWaitIdleTimeout(ts, 0); }
 
     static inline void threadSystemWaitIdle(ThreadSystem ts) { threadSystemWaitIdleTimeout(ts, UINT32_MAX); }
 
+    // Task graph
+    //
+    // Task handle starts when it is submitted and all its dependencies are finished.
+    // Finished task starts its continuations (tasks which depend on it) right away,
+    // so stages of work are chained without waiting for the whole pool to be idle.
+    //
+    // Usage:
+    //     TaskHandle decode = threadSystemCreateTask(ts, decodeMesh, mesh);
+    //     TaskHandle upload = threadSystemAddContinuation(ts, decode, uploadMesh, mesh);
+    //     threadSystemSubmitTask(decode);
+    //     threadSystemWaitTask(ts, upload);
+    //     threadSystemReleaseTask(decode);
+    //     threadSystemReleaseTask(upload);
+    //
+    // Task with NULL function is a counter: it finishes as soon as all its dependencies finish.
+    // Use it to join a group of tasks, e.g. as a single dependency for the next stage.
+    //
+    // Every created task must be submitted exactly once, then released exactly once.
+    // Handle can be released before the task is finished.
+    typedef struct ThreadSystemTaskNode* TaskHandle;
+
+    TaskHandle threadSystemCreateTask(ThreadSystem ts, TaskFunc func, void* user);
+
+    // 'task' can't start until 'dependency' is finished.
+    // Must be called before 'task' is submitted. 'dependency' can be in any state.
+    void threadSystemAddTaskDependency(TaskHandle task, TaskHandle dependency);
+
+    // THREAD_SYSTEM_PRIORITY_NORMAL by default. Must be called before 'task' is submitted.
+    void threadSystemSetTaskPriority(TaskHandle task, enum ThreadSystemPriority priority);
+
+    void threadSystemSubmitTask(TaskHandle task);
+
+    // Creates and submits task which starts after 'predecessor' is finished
+    TaskHandle threadSystemAddContinuation(ThreadSystem ts, TaskHandle predecessor, TaskFunc func, void* user);
+
+    bool threadSystemIsTaskDone(TaskHandle task);
+
+    // Caller executes other tasks while waiting, and sleeps only when there is nothing to do.
+    // Can be called from a task, with THREAD_SYSTEM_SCHEDULER_FIBERS the task is suspended instead.
+    void threadSystemWaitTask(ThreadSystem ts, TaskHandle task);
+
+    void threadSystemReleaseTask(TaskHandle task);
+
+    // Calls 'func' for [begin; end) split into ranges of at least 'grain' iterations, returns when all are done.
+    // Ranges are added with priority of the calling task, normal outside of tasks.
+    // Range is split in halves only while other threads are looking for work,
+    // so uneven workloads are balanced without choosing chunk count by hand.
+    // Calling thread processes ranges too, and helps with other tasks while waiting
+    // (task running on a fiber is suspended instead).
+    // 'grain' 0 picks one eighth of per-thread share.
+    void threadSystemParallelFor(ThreadSystem ts, uint64_t begin, uint64_t end, uint64_t grain, ParallelForFunc func, void* user);
+
+    static inline void threadSystemAddTaskDependencies(TaskHandle task, uint64_t count, const TaskHandle* dependencies)
+    {
+        for (uint64_t i = 0; i < count; ++i)
+            threadSystemAddTaskDependency(task, dependencies[i]);
+    }
+
 #ifdef __cplusplus
 }
 #endif